@@ -0,0 +1,158 @@
+#pragma once
+
+#include <madbfs/cache.hpp>
+#include <madbfs/workload.hpp>
+
+#include <madbfs-common/aliases.hpp>
+#include <madbfs-common/rpc.hpp>
+
+#include <map>
+#include <unordered_map>
+
+namespace madbfs::cachesim
+{
+    /**
+     * @class Link
+     *
+     * @brief Model of the link to the device: every request costs a round trip plus its payload over
+     * bandwidth.
+     *
+     * Requests are accounted one after another, as if none of them overlapped.
+     */
+    struct Link
+    {
+        usize  latency;      // in microseconds
+        double bandwidth;    // in MiB/s
+
+        double cost(usize payload) const
+        {
+            auto bytes_per_us = bandwidth * 1024 * 1024 / 1e6;
+            return static_cast<double>(latency) + static_cast<double>(payload) / bytes_per_us;
+        }
+    };
+
+    /**
+     * @class Device
+     *
+     * @brief In-memory model of the files on the device.
+     *
+     * Only the type and size of each file are kept, the content is all zeros. The initial state is inferred
+     * from the workload: a path exists from the start unless its first operation created it or failed with
+     * ENOENT, and a file is as large as the farthest byte read from it.
+     */
+    class Device
+    {
+    public:
+        struct File
+        {
+            bool  dir;
+            off_t size = 0;
+        };
+
+        using Files = std::map<String, Shared<File>, std::less<>>;
+
+        /**
+         * @brief Infer the initial state of the device from a workload.
+         *
+         * @param workload The recorded workload.
+         */
+        static Device infer(const workload::Workload& workload);
+
+        /**
+         * @brief Deep copy the device, so each simulation starts from the same state.
+         */
+        Device clone() const;
+
+        /**
+         * @brief Serve a request.
+         *
+         * @param req The request.
+         *
+         * @return Response of the request.
+         */
+        Expect<rpc::Response> serve(rpc::Request& req);
+
+        const Files& files() const { return m_files; }
+
+    private:
+        static rpc::resp::Stat stat(const File& file);
+        static String          parent_of(Str path);
+
+        Expect<Ref<File>>     find(Str path);
+        Expect<Ref<File>>     fd(u64 fd);
+        Vec<Files::iterator>  children(Str path);
+        Expect<Ref<File>>     create(Str path, bool dir);
+        Expect<void>          remove(Str path, bool dir);
+        Expect<rpc::Response> listdir(Str path, Vec<u8>& buf);
+        Expect<rpc::Response> rename(Str from, Str to);
+        Expect<rpc::Response> open(const rpc::req::Open& req);
+        Expect<rpc::Response> stat_path(Str path);
+
+        Files                                 m_files;
+        std::unordered_map<u64, Shared<File>> m_fds;
+        u64                                   m_next_fd = 1;
+    };
+
+    /**
+     * @class Config
+     *
+     * @brief A cache configuration to simulate.
+     */
+    struct Config
+    {
+        usize page_size;     // in bytes
+        usize max_pages;
+        usize cache_size;    // in MiB, as requested
+    };
+
+    /**
+     * @class Result
+     *
+     * @brief Outcome of a simulation.
+     */
+    struct Result
+    {
+        Opt<Config>  config;    // no cache if empty
+        Cache::Stats cache;
+        u64          requests = 0;
+        u64          fetched  = 0;    // bytes read from the device
+        u64          pushed   = 0;    // bytes written to the device
+        u64          skipped  = 0;    // operations on handles opened before the recording started
+        double       seconds  = 0.0;
+
+        double hit_ratio() const
+        {
+            auto total = cache.hits + cache.misses;
+            return total == 0 ? 0.0 : static_cast<double>(cache.hits) / static_cast<double>(total);
+        }
+    };
+
+    /**
+     * @class Simulator
+     *
+     * @brief Run a workload against `Filesystem` backed by a simulated transport, one operation at a time.
+     *
+     * Operations are issued in the order they started. Requests are served from a copy of the `Device` model
+     * and accounted on the `Link` model.
+     */
+    class Simulator
+    {
+    public:
+        Simulator(const workload::Workload& workload, const Device& device, Link link, Opt<Seconds> ttl);
+
+        /**
+         * @brief Simulate the workload with a cache configuration.
+         *
+         * @param config The cache configuration, no cache if empty.
+         */
+        Result run(Opt<Config> config);
+
+    private:
+        const workload::Workload&   m_workload;
+        const Device&               m_device;
+        Link                        m_link;
+        Opt<Seconds>                m_ttl;
+        Vec<const workload::Entry*> m_order;
+        workload::Handles           m_handles;
+    };
+}
@@ -0,0 +1,287 @@
+#include <madbfs/filesystem.hpp>
+#include <madbfs/workload.hpp>
+
+#include <madbfs-cachesim/simulator.hpp>
+
+#include <madbfs-common/log.hpp>
+
+#include <madbfs-gen/version.hpp>
+
+#include <boost/program_options.hpp>
+#include <fmt/base.h>
+#include <fmt/format.h>
+
+#include <charconv>
+#include <iostream>
+
+namespace po       = boost::program_options;
+namespace workload = madbfs::workload;
+
+using namespace madbfs::aliases;
+
+using madbfs::cachesim::Config;
+using madbfs::cachesim::Device;
+using madbfs::cachesim::Link;
+using madbfs::cachesim::Result;
+using madbfs::cachesim::Simulator;
+
+struct Exit
+{
+    int ret;
+};
+
+/**
+ * @class SizeList
+ *
+ * @brief Comma separated list of sizes from the command line.
+ */
+struct SizeList
+{
+    Vec<usize> values;
+};
+
+struct Args
+{
+    std::string file;
+    std::string log_level;
+    SizeList    page_sizes;     // in KiB
+    SizeList    cache_sizes;    // in MiB
+    usize       latency;        // in microseconds
+    double      bandwidth;      // in MiB/s
+    usize       ttl;            // in seconds
+    bool        csv;
+};
+
+std::istream& operator>>(std::istream& in, SizeList& list)
+{
+    auto string = std::string{};
+    in >> string;
+
+    list.values.clear();
+    for (auto part : string | sv::split(',')) {
+        auto value = usize{};
+        auto str   = Str{ part.begin(), part.end() };
+        auto res   = std::from_chars(str.data(), str.data() + str.size(), value);
+        if (res.ec != std::errc{} or res.ptr != str.data() + str.size() or value == 0) {
+            in.setstate(std::ios::failbit);
+            return in;
+        }
+        list.values.push_back(value);
+    }
+
+    return in;
+}
+
+std::variant<Exit, Args> parse_args(int argc, char** argv)
+{
+    auto args = Args{};
+
+    auto desc = po::options_description{ "options" };
+    desc.add_options()                    //
+        ("help,h", "print help")          //
+        ("version,v", "print version")    //
+        ("page-size,p",
+         po::value<SizeList>(&args.page_sizes)->default_value({ { 64, 128, 256, 512 } }, "64,128,256,512")
+             ->value_name("KiB,.."),
+         "page sizes to simulate, rounded up to a power of 2 within [64, 4096]")    //
+        ("cache-size,c",
+         po::value<SizeList>(&args.cache_sizes)->default_value({ { 64, 256, 1024 } }, "64,256,1024")
+             ->value_name("MiB,.."),
+         "cache sizes to simulate")    //
+        ("latency",
+         po::value<usize>(&args.latency)->default_value(500)->value_name("us"),
+         "round trip time of a single request on the simulated link")    //
+        ("bandwidth",
+         po::value<double>(&args.bandwidth)->default_value(40.0)->value_name("MiB/s"),
+         "throughput of the simulated link")    //
+        ("ttl",
+         po::value<usize>(&args.ttl)->default_value(60)->value_name("sec"),
+         "TTL of the stat cache, 0 to disable")    //
+        ("csv", "print the report as CSV")        //
+        ("log-level",
+         po::value<std::string>(&args.log_level)->default_value("off")->value_name("level"),
+         "log level of the filesystem layer")    //
+        ("workload",
+         po::value<std::string>(&args.file)->value_name("file"),
+         "the workload file recorded with 'madbfs-msg record_start' (positional)");
+
+    auto pos = po::positional_options_description{};
+    pos.add("workload", 1);
+
+    auto print_help = [&](bool err) {
+        auto out = err ? stderr : stdout;
+        fmt::println(out, "madbfs-cachesim: simulate the cache on a recorded workload for each config");
+        fmt::println(out, "usage: [options] <workload>");
+        std::cerr << '\n' << desc << '\n';
+        return Exit{ err ? 1 : 0 };
+    };
+
+    if (argc == 1) {
+        return print_help(true);
+    }
+
+    auto vm = po::variables_map{};
+    try {
+        po::store(po::command_line_parser{ argc, argv }.options(desc).positional(pos).run(), vm);
+        po::notify(vm);
+    } catch (const std::exception& e) {
+        fmt::println(stderr, "{}", e.what());
+        return Exit{ 2 };
+    }
+
+    if (vm.count("help")) {
+        return print_help(false);
+    }
+
+    if (vm.count("version")) {
+        fmt::println(stdout, "{}", MADBFS_VERSION_FULL);
+        return Exit{ 0 };
+    }
+
+    if (args.file.empty()) {
+        fmt::println(stderr, "error: no workload file is specified");
+        return Exit{ 1 };
+    } else if (args.bandwidth <= 0.0) {
+        fmt::println(stderr, "error: bandwidth must be positive");
+        return Exit{ 1 };
+    }
+
+    args.csv = vm.count("csv") != 0;
+    return args;
+}
+
+String human_bytes(u64 bytes)
+{
+    constexpr auto units = Array<Str, 5>{ "B", "KiB", "MiB", "GiB", "TiB" };
+
+    auto value = static_cast<double>(bytes);
+    auto unit  = 0uz;
+    while (value >= 1024.0 and unit + 1 < units.size()) {
+        value /= 1024.0;
+        ++unit;
+    }
+
+    return unit == 0 ? fmt::format("{} B", bytes) : fmt::format("{:.1f} {}", value, units[unit]);
+}
+
+void print_report(const workload::Workload& workload, const Args& args, const Vec<Result>& results)
+{
+    if (args.csv) {
+        fmt::println(
+            "page_size,cache_size,hits,misses,evictions,pushes,hit_ratio,requests,fetched,pushed,seconds"
+        );
+        for (const auto& r : results) {
+            fmt::println(
+                "{},{},{},{},{},{},{:.4f},{},{},{},{:.6f}",
+                r.config.transform(&Config::page_size).value_or(0),
+                r.config.transform(&Config::cache_size).value_or(0),
+                r.cache.hits,
+                r.cache.misses,
+                r.cache.evictions,
+                r.cache.pushes,
+                r.hit_ratio(),
+                r.requests,
+                r.fetched,
+                r.pushed,
+                r.seconds
+            );
+        }
+        return;
+    }
+
+    auto best = sr::min_element(results, {}, &Result::seconds);
+
+    fmt::println(
+        "simulated {} operations on {} paths ({} skipped) over a {}us + {} MiB/s link",
+        workload.entries.size(),
+        workload.paths.size() - 1,
+        results.empty() ? 0 : results.front().skipped,
+        args.latency,
+        args.bandwidth
+    );
+    fmt::println("");
+    fmt::println(
+        "  {:>9} {:>9} {:>7} {:>9} {:>9} {:>9} {:>11} {:>11} {:>10}",
+        "page",
+        "cache",
+        "hit%",
+        "misses",
+        "evictions",
+        "requests",
+        "fetched",
+        "pushed",
+        "time (s)"
+    );
+
+    for (auto it = results.begin(); it != results.end(); ++it) {
+        const auto& r = *it;
+
+        auto page  = r.config ? human_bytes(r.config->page_size) : "-";
+        auto cache = r.config ? fmt::format("{} MiB", r.config->cache_size) : "off";
+        auto ratio = r.config ? fmt::format("{:.1f}", r.hit_ratio() * 100) : "-";
+
+        fmt::println(
+            "{} {:>9} {:>9} {:>7} {:>9} {:>9} {:>9} {:>11} {:>11} {:>10.3f}",
+            it == best ? '*' : ' ',
+            page,
+            cache,
+            ratio,
+            r.cache.misses,
+            r.cache.evictions,
+            r.requests,
+            human_bytes(r.fetched),
+            human_bytes(r.pushed),
+            r.seconds
+        );
+    }
+}
+
+int main(int argc, char** argv)
+try {
+    auto parsed = parse_args(argc, argv);
+    if (parsed.index() == 0) {
+        return std::get<0>(parsed).ret;
+    }
+
+    auto args  = std::get<1>(parsed);
+    auto level = madbfs::log::level_from_str(args.log_level);
+    if (not level) {
+        fmt::println(stderr, "error: '{}' is not a valid log level", args.log_level);
+        return 1;
+    }
+
+    auto workload = workload::load(args.file);
+    if (not workload) {
+        fmt::println(stderr, "error: failed to load '{}': {}", args.file, madbfs::err_msg(workload.error()));
+        return 1;
+    }
+
+    madbfs::log::init(*level, "-");
+    madbfs::log::start_async();
+
+    auto device    = Device::infer(*workload);
+    auto link      = Link{ .latency = args.latency, .bandwidth = args.bandwidth };
+    auto ttl       = args.ttl == 0 ? std::nullopt : Opt<Seconds>{ args.ttl };
+    auto simulator = Simulator{ *workload, device, link, ttl };
+
+    auto results = Vec<Result>{};
+    results.push_back(simulator.run(std::nullopt));
+
+    for (auto page_kib : args.page_sizes.values) {
+        for (auto cache_mib : args.cache_sizes.values) {
+            auto caching = madbfs::Caching::of_size(page_kib, cache_mib);
+            results.push_back(simulator.run(Config{ caching.page_size, caching.max_pages, cache_mib }));
+        }
+    }
+
+    print_report(*workload, args, results);
+
+    madbfs::log::shutdown();
+    return 0;
+} catch (const std::exception& e) {
+    fmt::println(stderr, "error: exception occurred: {}", e.what());
+    return 1;
+} catch (...) {
+    fmt::println(stderr, "error: exception occurred (unknown exception)");
+    return 1;
+}
@@ -0,0 +1,507 @@
+#include "madbfs-cachesim/simulator.hpp"
+
+#include <madbfs/connection.hpp>
+#include <madbfs/filesystem.hpp>
+#include <madbfs/transport/transport.hpp>
+
+#include <madbfs-common/log.hpp>
+
+#include <sys/stat.h>
+
+#include <cstring>
+#include <thread>
+
+using namespace madbfs;
+
+// helper functions/classes
+namespace
+{
+    /**
+     * @class SimTransport
+     *
+     * @brief Transport that serves the requests from a `Device` model and accounts them on a `Link` model.
+     */
+    class SimTransport final : public transport::Transport
+    {
+    public:
+        /**
+         * @class Totals
+         *
+         * @brief Accounting of the simulated link, kept outside since the transport is owned by the
+         * connection.
+         */
+        struct Totals
+        {
+            u64    requests = 0;
+            double micros   = 0.0;
+        };
+
+        SimTransport(cachesim::Device device, cachesim::Link link, Totals& totals)
+            : m_device{ std::move(device) }
+            , m_link{ link }
+            , m_totals{ totals }
+        {
+        }
+
+        Str  name() const override { return "sim"; }
+        bool running() const override { return true; }
+
+        void        stop(rpc::Status) override { }
+        Await<void> start() override { co_return; }
+
+        AExpect<rpc::Response> send(rpc::Request req, trace::Context) override
+        {
+            auto payload = req.visit(Overload{
+                [](const rpc::req::Write& r) { return r.in.size(); },
+                [](const auto&) { return 0uz; },
+            });
+
+            auto resp = m_device.serve(req);
+            if (resp and resp->index() == rpc::Response::index_of<rpc::resp::Read>()) {
+                payload = resp->as<rpc::resp::Read>()->read.size();
+            }
+
+            ++m_totals.requests;
+            m_totals.micros += m_link.cost(payload);
+
+            co_return resp;
+        }
+
+        AExpect<rpc::Response> send(rpc::Request req, Milliseconds) override
+        {
+            return send(std::move(req), trace::Context{});
+        }
+
+    private:
+        cachesim::Device m_device;
+        cachesim::Link   m_link;
+        Totals&          m_totals;
+    };
+}
+
+namespace madbfs::cachesim
+{
+    Device Device::infer(const workload::Workload& workload)
+    {
+        using Op = metrics::FuseOp;
+
+        const auto& paths = workload.paths;
+
+        auto seen     = Vec<bool>(paths.size(), false);
+        auto exists   = Vec<bool>(paths.size(), false);
+        auto is_dir   = Vec<bool>(paths.size(), false);
+        auto sizes    = Vec<off_t>(paths.size(), 0);
+        auto fh_paths = std::unordered_map<u64, u32>{};
+
+        auto see = [&](u32 id, bool created) {
+            if (id != 0 and not seen[id]) {
+                seen[id]   = true;
+                exists[id] = not created;
+            }
+        };
+
+        for (const auto& e : workload.entries) {
+            auto id = e.path;
+            if (id == 0) {
+                auto found = fh_paths.find(e.fh);
+                id         = found != fh_paths.end() ? found->second : 0;
+            }
+
+            auto creates = e.op == Op::Mknod or e.op == Op::Mkdir or e.op == Op::Create;
+            see(id, (creates and e.result >= 0) or e.result == -ENOENT);
+            see(e.path2, e.op == Op::Rename and e.result >= 0);
+
+            if ((e.op == Op::Open or e.op == Op::Create) and e.result >= 0) {
+                fh_paths[static_cast<u64>(e.result)] = e.path;
+            } else if (e.op == Op::Readdir or e.op == Op::Rmdir or e.op == Op::Mkdir) {
+                is_dir[id] = true;
+            } else if (e.op == Op::Read and e.result > 0) {
+                sizes[id] = std::max(sizes[id], static_cast<off_t>(e.offset + e.result));
+            }
+        }
+
+        auto device = Device{};
+        device.m_files.emplace("/", std::make_shared<File>(true));
+
+        for (auto id : sv::iota(1uz, paths.size())) {
+            const auto& path = paths[id];
+
+            // parents of every path must exist for the operation to reach it
+            for (auto slash = path.find('/', 1); slash != String::npos; slash = path.find('/', slash + 1)) {
+                auto& parent = device.m_files[path.substr(0, slash)];
+                parent       = std::make_shared<File>(true);
+            }
+
+            if (exists[id] and not device.m_files.contains(path)) {
+                device.m_files.emplace(path, std::make_shared<File>(is_dir[id], sizes[id]));
+            }
+        }
+
+        return device;
+    }
+
+    Device Device::clone() const
+    {
+        auto device = Device{};
+        for (const auto& [path, file] : m_files) {
+            device.m_files.emplace(path, std::make_shared<File>(*file));
+        }
+        return device;
+    }
+
+    Expect<rpc::Response> Device::serve(rpc::Request& req)
+    {
+        namespace req_ = rpc::req;
+        namespace resp = rpc::resp;
+
+        return req.visit(Overload{
+            [&](const req_::Stat& r) -> Expect<rpc::Response> {
+                return find(r.path).transform([&](File& f) { return rpc::Response{ stat(f) }; });
+            },
+            [&](const req_::Listdir& r) -> Expect<rpc::Response> { return listdir(r.path, r.buf); },
+            [&](const req_::Readlink&) -> Expect<rpc::Response> {
+                return Unexpect{ Errc::invalid_argument };    // there is no symlink on the model
+            },
+            [&](const req_::Mknod& r) -> Expect<rpc::Response> {
+                return create(r.path, false).transform([&](File& f) {
+                    return rpc::Response{ resp::Mknod{ stat(f) } };
+                });
+            },
+            [&](const req_::Mkdir& r) -> Expect<rpc::Response> {
+                return create(r.path, true).transform([&](File& f) {
+                    return rpc::Response{ resp::Mkdir{ stat(f) } };
+                });
+            },
+            [&](const req_::Unlink& r) -> Expect<rpc::Response> {
+                return remove(r.path, false).transform([] { return rpc::Response{ resp::Unlink{} }; });
+            },
+            [&](const req_::Rmdir& r) -> Expect<rpc::Response> {
+                return remove(r.path, true).transform([] { return rpc::Response{ resp::Rmdir{} }; });
+            },
+            [&](const req_::Rename& r) -> Expect<rpc::Response> { return rename(r.from, r.to); },
+            [&](const req_::Truncate& r) -> Expect<rpc::Response> {
+                return find(r.path).transform([&](File& f) {
+                    f.size = r.size;
+                    return rpc::Response{ resp::Truncate{ stat(f) } };
+                });
+            },
+            [&](const req_::Utimens& r) -> Expect<rpc::Response> {
+                return find(r.path).transform([&](File& f) {
+                    return rpc::Response{ resp::Utimens{ stat(f) } };
+                });
+            },
+            [&](const req_::CopyFileRange& r) -> Expect<rpc::Response> {
+                auto in  = find(r.in_path);
+                auto out = find(r.out_path);
+                if (not in or not out) {
+                    return Unexpect{ Errc::no_such_file_or_directory };
+                }
+                auto left = std::max<off_t>(in->get().size - r.in_offset, 0);
+                auto size = std::min(static_cast<usize>(left), r.size);
+
+                out->get().size = std::max(out->get().size, r.out_offset + static_cast<off_t>(size));
+                return rpc::Response{ resp::CopyFileRange{ size, stat(*out) } };
+            },
+            [&](const req_::Open& r) -> Expect<rpc::Response> { return open(r); },
+            [&](const req_::Close& r) -> Expect<rpc::Response> {
+                auto node = m_fds.extract(r.fd);
+                if (node.empty()) {
+                    return Unexpect{ Errc::bad_file_descriptor };
+                }
+                return rpc::Response{ resp::Close{ stat(*node.mapped()) } };
+            },
+            [&](const req_::Read& r) -> Expect<rpc::Response> {
+                return fd(r.fd).transform([&](File& f) {
+                    auto left = std::max<off_t>(f.size - r.offset, 0);
+                    auto read = r.out.first(std::min(static_cast<usize>(left), r.out.size()));
+                    std::memset(read.data(), 0, read.size());
+                    return rpc::Response{ resp::Read{ read } };
+                });
+            },
+            [&](const req_::Write& r) -> Expect<rpc::Response> {
+                return fd(r.fd).transform([&](File& f) {
+                    f.size = std::max(f.size, r.offset + static_cast<off_t>(r.in.size()));
+                    return rpc::Response{ resp::Write{ r.in.size() } };
+                });
+            },
+            [&](const req_::StatPath& r) -> Expect<rpc::Response> { return stat_path(r.path); },
+            [&](const req_::Lseek& r) -> Expect<rpc::Response> {
+                return fd(r.fd).and_then([&](File& f) -> Expect<rpc::Response> {
+                    if (r.offset >= f.size) {
+                        return Unexpect{ Errc::no_such_device_or_address };
+                    }
+                    auto offset = r.whence == rpc::Seek::Data ? r.offset : f.size;
+                    return rpc::Response{ resp::Lseek{ offset } };
+                });
+            },
+            [&](const req_::Ping& r) -> Expect<rpc::Response> {
+                return rpc::Response{ resp::Ping{ r.num } };
+            },
+        });
+    }
+
+    rpc::resp::Stat Device::stat(const File& file)
+    {
+        return {
+            .size  = file.size,
+            .links = 1,
+            .mtime = {},
+            .atime = {},
+            .ctime = {},
+            .mode  = static_cast<mode_t>(file.dir ? (S_IFDIR | 0755) : (S_IFREG | 0644)),
+            .uid   = 0,
+            .gid   = 0,
+        };
+    }
+
+    String Device::parent_of(Str path)
+    {
+        auto slash = path.rfind('/');
+        return slash == 0 ? "/" : String{ path.substr(0, slash) };
+    }
+
+    Expect<Ref<Device::File>> Device::find(Str path)
+    {
+        if (auto found = m_files.find(path); found != m_files.end()) {
+            return *found->second;
+        }
+        return Unexpect{ Errc::no_such_file_or_directory };
+    }
+
+    Expect<Ref<Device::File>> Device::fd(u64 fd)
+    {
+        if (auto found = m_fds.find(fd); found != m_fds.end()) {
+            return *found->second;
+        }
+        return Unexpect{ Errc::bad_file_descriptor };
+    }
+
+    Vec<Device::Files::iterator> Device::children(Str path)
+    {
+        auto prefix = path == "/" ? String{ "/" } : String{ path } + '/';
+        auto result = Vec<Files::iterator>{};
+
+        for (auto it = m_files.lower_bound(prefix); it != m_files.end(); ++it) {
+            if (not it->first.starts_with(prefix)) {
+                break;
+            }
+            auto name = Str{ it->first }.substr(prefix.size());
+            if (not name.empty() and name.find('/') == Str::npos) {
+                result.push_back(it);
+            }
+        }
+
+        return result;
+    }
+
+    Expect<Ref<Device::File>> Device::create(Str path, bool dir)
+    {
+        if (m_files.contains(path)) {
+            return Unexpect{ Errc::file_exists };
+        } else if (auto parent = find(parent_of(path)); not parent or not parent->get().dir) {
+            return Unexpect{ Errc::no_such_file_or_directory };
+        }
+        return *m_files.emplace(path, std::make_shared<File>(dir)).first->second;
+    }
+
+    Expect<void> Device::remove(Str path, bool dir)
+    {
+        auto found = m_files.find(path);
+        if (found == m_files.end()) {
+            return Unexpect{ Errc::no_such_file_or_directory };
+        } else if (found->second->dir != dir) {
+            return Unexpect{ dir ? Errc::not_a_directory : Errc::is_a_directory };
+        } else if (dir and not children(path).empty()) {
+            return Unexpect{ Errc::directory_not_empty };
+        }
+        m_files.erase(found);
+        return {};
+    }
+
+    Expect<rpc::Response> Device::listdir(Str path, Vec<u8>& buf)
+    {
+        if (auto dir = find(path); not dir or not dir->get().dir) {
+            return Unexpect{ dir ? Errc::not_a_directory : dir.error() };
+        }
+
+        auto entries = children(path);
+        auto skip    = path == "/" ? 1uz : path.size() + 1;
+        auto names   = entries | sv::transform([&](auto it) { return Str{ it->first }.substr(skip); });
+
+        // names are referred to by the response, so the buffer must not be reallocated in between
+        buf.clear();
+        auto sizes = names | sv::transform([](Str name) { return name.size() + 1; });
+        buf.reserve(sr::fold_left(sizes, 0uz, std::plus{}));
+
+        auto resp = rpc::resp::Listdir{};
+        for (auto [it, name] : sv::zip(entries, names)) {
+            auto start = reinterpret_cast<const char*>(buf.data()) + buf.size();
+            buf.insert(buf.end(), name.begin(), name.end());
+            buf.push_back('\0');
+            resp.entries.emplace_back(Str{ start, name.size() }, stat(*it->second));
+        }
+
+        return rpc::Response{ std::move(resp) };
+    }
+
+    Expect<rpc::Response> Device::rename(Str from, Str to)
+    {
+        auto found = m_files.find(from);
+        if (found == m_files.end()) {
+            return Unexpect{ Errc::no_such_file_or_directory };
+        }
+
+        auto moved = Vec<Pair<String, Shared<File>>>{};
+        auto node  = m_files.extract(found);
+        moved.emplace_back(String{ to }, node.mapped());
+
+        // a directory takes its descendants along
+        auto prefix = String{ from } + '/';
+        for (auto it = m_files.lower_bound(prefix); it != m_files.end() and it->first.starts_with(prefix);) {
+            moved.emplace_back(String{ to } + it->first.substr(from.size()), it->second);
+            it = m_files.erase(it);
+        }
+
+        for (auto& [path, file] : moved) {
+            m_files.insert_or_assign(std::move(path), std::move(file));
+        }
+
+        return rpc::Response{ rpc::resp::Rename{ stat(*m_files.find(to)->second) } };
+    }
+
+    Expect<rpc::Response> Device::open(const rpc::req::Open& req)
+    {
+        namespace flag = rpc::open_flag;
+
+        auto found = m_files.find(req.path);
+        if (found != m_files.end() and (req.flags & flag::exclusive) != 0) {
+            return Unexpect{ Errc::file_exists };
+        } else if (found == m_files.end() and (req.flags & flag::create) == 0) {
+            return Unexpect{ Errc::no_such_file_or_directory };
+        } else if (found == m_files.end()) {
+            auto created = create(req.path, false);
+            if (not created) {
+                return Unexpect{ created.error() };
+            }
+            found = m_files.find(req.path);
+        }
+
+        auto file = found->second;
+        if ((req.flags & flag::truncate) != 0) {
+            file->size = 0;
+        }
+
+        auto fd = m_next_fd++;
+        m_fds.emplace(fd, file);
+
+        return rpc::Response{ rpc::resp::Open{ .fd = fd, .stat = stat(*file) } };
+    }
+
+    Expect<rpc::Response> Device::stat_path(Str path)
+    {
+        auto resp    = rpc::resp::StatPath{ .stats = {}, .status = {} };
+        auto current = String{};
+
+        for (auto part : path | sv::split('/')) {
+            if (part.empty()) {
+                continue;
+            }
+
+            if (not resp.stats.empty() and (resp.stats.back().mode & S_IFMT) != S_IFDIR) {
+                resp.status = Errc::not_a_directory;
+                break;
+            }
+
+            current += '/';
+            current.append(part.begin(), part.end());
+
+            auto file = find(current);
+            if (not file) {
+                resp.status = file.error();
+                break;
+            }
+            resp.stats.push_back(stat(*file));
+        }
+
+        return rpc::Response{ std::move(resp) };
+    }
+
+    Simulator::Simulator(
+        const workload::Workload& workload,
+        const Device&             device,
+        Link                      link,
+        Opt<Seconds>              ttl
+    )
+        : m_workload{ workload }
+        , m_device{ device }
+        , m_link{ link }
+        , m_ttl{ ttl }
+    {
+        for (const auto& entry : m_workload.entries) {
+            m_order.push_back(&entry);
+        }
+        sr::stable_sort(m_order, {}, [](const workload::Entry* entry) { return entry->start; });
+    }
+
+    Result Simulator::run(Opt<Config> config)
+    {
+        auto totals   = SimTransport::Totals{};
+        auto strategy = connection_strategy::Custom{ .create = [&] {
+            return std::make_unique<SimTransport>(m_device.clone(), m_link, totals);
+        } };
+
+        auto caching = config.transform([](const Config& c) {
+            return Caching{ .page_size = c.page_size, .max_pages = c.max_pages };
+        });
+
+        auto ctx    = async::Context{};
+        auto guard  = async::WorkGuard{ ctx.get_executor() };
+        auto thread = std::jthread{ [&] { ctx.run(); } };
+
+        auto connection = Connection{ ctx, strategy };
+        auto fs         = Filesystem{ connection, caching, m_ttl };
+
+        async::spawn(ctx, connection.start(), [](std::exception_ptr e) {
+            log::log_exception(e, "madbfs-cachesim");
+        });
+
+        auto result = Result{ .config = config };
+
+        if (auto res = async::block(ctx, fs.initialize_root()); res) {
+            const auto& paths = m_workload.paths;
+
+            m_handles.clear();
+            for (const auto* entry : m_order) {
+                auto handles = m_handles.map(*entry);
+                if (not handles) {
+                    ++result.skipped;
+                    continue;
+                }
+
+                auto [fh, fh2] = *handles;
+                auto path      = paths[entry->path].empty() ? Str{ "/" } : Str{ paths[entry->path] };
+                auto path2     = paths[entry->path2].empty() ? Str{ "/" } : Str{ paths[entry->path2] };
+
+                m_handles.update(*entry, workload::issue(ctx, fs, *entry, path, path2, fh, fh2));
+            }
+        }
+
+        async::block(ctx, fs.shutdown());
+
+        if (fs.cache()) {
+            result.cache = fs.cache()->stats();
+        }
+        result.requests = totals.requests;
+        result.fetched  = connection.stats().received_bytes;
+        result.pushed   = connection.stats().sent_bytes;
+        result.seconds  = totals.micros / 1e6;
+
+        connection.cancel(Errc::operation_canceled);
+
+        guard.reset();
+        ctx.stop();
+        thread.join();
+
+        return result;
+    }
+}
@@ -29,9 +29,23 @@ namespace madbfs::ipc
         struct SetPageSize     { usize kib; };
         struct SetCacheSize    { usize mib; };
         struct SetTTL          { usize sec; };
+        struct SetTTLPolicy    { String spec; };
         struct SetTimeout      { usize sec; };
+        struct SetWeights      { String spec; };
         struct SetLogLevel     { String lvl; };
         struct Logcat          { bool color; };
+        struct Top             { };
+        struct Pull            { String device; String host; bool resume = false; };
+        struct Push            { String host; String device; bool resume = false; };
+        struct Jobs            { };
+        struct Cancel          { u64 id; };
+        struct Metrics         { };
+        struct SetTraceRate    { usize rate; };
+        struct Trace           { };
+        struct RecordStart     { String file; };
+        struct RecordStop      { };
+        struct CacheMap        { String path; };
+        struct Lag             { };
         struct Unmount         { };
         // clang-format on
 
@@ -45,9 +59,23 @@ namespace madbfs::ipc
             constexpr auto set_page_size    = "set_page_size";
             constexpr auto set_cache_size   = "set_cache_size";
             constexpr auto set_ttl          = "set_ttl";
+            constexpr auto set_ttl_policy   = "set_ttl_policy";
             constexpr auto set_timeout      = "set_timeout";
+            constexpr auto set_weights      = "set_weights";
             constexpr auto set_log_level    = "set_log_level";
             constexpr auto logcat           = "logcat";
+            constexpr auto top              = "top";
+            constexpr auto pull             = "pull";
+            constexpr auto push             = "push";
+            constexpr auto jobs             = "jobs";
+            constexpr auto cancel           = "cancel";
+            constexpr auto metrics          = "metrics";
+            constexpr auto set_trace_rate   = "set_trace_rate";
+            constexpr auto trace            = "trace";
+            constexpr auto record_start     = "record_start";
+            constexpr auto record_stop      = "record_stop";
+            constexpr auto cache_map        = "cache_map";
+            constexpr auto lag              = "lag";
             constexpr auto unmount          = "unmount";
         }
 
@@ -60,9 +88,23 @@ namespace madbfs::ipc
             name::set_page_size,
             name::set_cache_size,
             name::set_ttl,
+            name::set_ttl_policy,
             name::set_timeout,
+            name::set_weights,
             name::set_log_level,
             name::logcat,
+            name::top,
+            name::pull,
+            name::push,
+            name::jobs,
+            name::cancel,
+            name::metrics,
+            name::set_trace_rate,
+            name::trace,
+            name::record_start,
+            name::record_stop,
+            name::cache_map,
+            name::lag,
             name::unmount,
         });
     }
@@ -80,8 +122,21 @@ namespace madbfs::ipc
               op::SetPageSize,
               op::SetCacheSize,
               op::SetTTL,
+              op::SetTTLPolicy,
               op::SetTimeout,
+              op::SetWeights,
               op::SetLogLevel,
+              op::Pull,
+              op::Push,
+              op::Jobs,
+              op::Cancel,
+              op::Metrics,
+              op::SetTraceRate,
+              op::Trace,
+              op::RecordStart,
+              op::RecordStop,
+              op::CacheMap,
+              op::Lag,
               op::Unmount>
     {
         using VarWrapper::VarWrapper;
@@ -92,7 +147,7 @@ namespace madbfs::ipc
      *
      * @brief All possible operations through the IPC.
      */
-    struct Op : util::VarWrapper<FsOp, op::Help, op::Version, op::Logcat>
+    struct Op : util::VarWrapper<FsOp, op::Help, op::Version, op::Logcat, op::Top>
     {
         using VarWrapper::VarWrapper;
     };
@@ -199,6 +254,13 @@ namespace madbfs::ipc
          */
         AExpect<Gen<AExpect<String>>> logcat(op::Logcat opt);
 
+        /**
+         * @brief Start top operation, the server sends a frame of metrics every second.
+         *
+         * @return Generator of frames (JSON).
+         */
+        AExpect<Gen<AExpect<String>>> top();
+
     private:
         Client(Str socket_path, Socket socket)
             : m_socket_path{ socket_path }
@@ -220,6 +282,7 @@ namespace madbfs::ipc
     public:
         using Acceptor = async::unix_socket::Acceptor;
         using OnFsOp   = std::move_only_function<AExpect<boost::json::value>(ipc::FsOp op)>;
+        using OnTop    = std::move_only_function<boost::json::value(bool watched)>;
 
         /**
          * @brief Create IPC server.
@@ -241,10 +304,15 @@ namespace madbfs::ipc
          * @brief Lauch the IPC and listen for request for any `FsOp`.
          *
          * @param on_op Operation request handler.
+         * @param on_top Frame producer for top subscribers.
          *
          * The caller only need to handle `FsOp`, other op will be handled by the Server itself.
+         *
+         * While there are top subscribers, `on_top(true)` is called every second and the frame it returns is
+         * sent to each of them (unless it's null). Once the last one is gone `on_top(false)` is called, so
+         * the producer can stop collecting.
          */
-        Await<void> launch(OnFsOp on_op);
+        Await<void> launch(OnFsOp on_op, OnTop on_top);
 
         /**
          * @brief Stop the IPC listener.
@@ -258,12 +326,14 @@ namespace madbfs::ipc
             : m_socket_path{ path }
             , m_socket{ std::move(acceptor) }
             , m_logcat_timer{ m_socket.get_executor() }
+            , m_top_timer{ m_socket.get_executor() }
         {
         }
 
         Await<void> run();
         Await<void> handle_peer(Socket sock);
         Await<void> logcat_handler();
+        Await<void> top_handler();
 
         String   m_socket_path;
         Acceptor m_socket;
@@ -273,5 +343,73 @@ namespace madbfs::ipc
         Shared<LogcatSink>    m_logcat_sink;
         Vec<LogcatSubscriber> m_logcat_subscribers;
         async::Timer          m_logcat_timer;
+
+        OnTop        m_on_top;
+        Vec<Socket>  m_top_subscribers;
+        async::Timer m_top_timer;
+    };
+
+    /**
+     * @class Exporter
+     *
+     * @brief Serves metrics in OpenMetrics text format over HTTP for scrapers like Prometheus.
+     *
+     * Every `GET` request is answered with a freshly rendered document and the connection is closed right
+     * after. Peers are handled one at a time, like `Server`, so a render must not block for long.
+     */
+    class Exporter
+    {
+    public:
+        using Render = std::move_only_function<String()>;
+
+        /**
+         * @brief Create an exporter.
+         *
+         * @param context Async context.
+         * @param address Either a unix socket path (must contain `/`), or `[<host>:]<port>` for TCP where the
+         *                host defaults to `127.0.0.1`.
+         */
+        static Expect<Exporter> create(async::Context& context, Str address);
+
+        ~Exporter();
+
+        Exporter(Exporter&&)            = default;
+        Exporter& operator=(Exporter&&) = default;
+
+        Exporter(const Exporter&)            = delete;
+        Exporter& operator=(const Exporter&) = delete;
+
+        /**
+         * @brief Launch the exporter and serve requests until stopped.
+         *
+         * @param render Function that renders the metrics (without the terminating `# EOF`).
+         */
+        Await<void> launch(Render render);
+
+        /**
+         * @brief Stop the exporter.
+         */
+        void stop();
+
+        Str address() const { return m_address; }
+
+    private:
+        using Acceptor = Var<async::tcp::Acceptor, async::unix_socket::Acceptor>;
+
+        Exporter(Str address, Acceptor acceptor, bool is_unix)
+            : m_address{ address }
+            , m_acceptor{ std::move(acceptor) }
+            , m_unix{ is_unix }
+        {
+        }
+
+        template <typename Sock>
+        Await<void> handle_peer(Sock sock);
+
+        String   m_address;
+        Acceptor m_acceptor;
+        Render   m_render;
+        bool     m_unix    = false;
+        bool     m_running = false;
     };
 }
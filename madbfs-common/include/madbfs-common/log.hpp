@@ -4,12 +4,21 @@
 
 #include <fmt/format.h>
 #include <fmt/ranges.h>
+#include <spdlog/details/log_msg_buffer.h>
 #include <spdlog/pattern_formatter.h>
 #include <spdlog/sinks/rotating_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include <atomic>
+#include <mutex>
 #include <source_location>
+#include <thread>
+
+// lowest level compiled in, set by the build (trace on debug builds and info on release builds)
+#ifndef MADBFS_LOG_FLOOR
+#    define MADBFS_LOG_FLOOR 0
+#endif
 
 namespace madbfs::log
 {
@@ -19,6 +28,9 @@ namespace madbfs::log
     static constexpr auto logger_pattern = "[%Y-%m-%d|%H:%M:%S] [%^-%L-%$] [%-20!s|%3#] %-20!!: %v";
     static constexpr auto logger_name    = "madbfs-log";
 
+    // calls below this level are removed at compile time regardless of the level set at runtime
+    static constexpr auto level_floor = static_cast<Level>(MADBFS_LOG_FLOOR);
+
     // I have to do this conversion gymnastics because somehow spdlog's string_view is not compaitble with
     // std's string_view.
     static constexpr auto level_names = []() {
@@ -68,6 +80,130 @@ namespace madbfs::log
         FmtWithLoc& operator=(FmtWithLoc&& other)      = delete;
     };
 
+    /**
+     * @class AsyncLogger
+     *
+     * @brief Logger that hands messages over to a background thread through a lock-free ring buffer.
+     *
+     * Only the message itself is formatted on the calling thread (arguments may be views that don't outlive
+     * the call), into a small inline buffer. The pattern (time, level, location) and the sinks run on the
+     * background thread, so a sink that locks or writes to a file never blocks the caller. If the ring is
+     * full the message is dropped instead and the number of dropped messages is reported later.
+     *
+     * Until `start()` is called messages are written to the sinks directly, so the logger can be created
+     * before the process forks into a daemon (threads don't survive a fork).
+     */
+    class AsyncLogger final : public spdlog::logger
+    {
+    public:
+        static constexpr usize capacity = 4096;    // must be a power of two
+
+        AsyncLogger(String name);
+        ~AsyncLogger() override;
+
+        AsyncLogger(AsyncLogger&&)            = delete;
+        AsyncLogger& operator=(AsyncLogger&&) = delete;
+
+        /**
+         * @brief Start the background thread, does nothing if it's already started.
+         */
+        void start();
+
+        /**
+         * @brief Write the queued messages then stop the background thread.
+         *
+         * Messages logged after this are written to the sinks directly.
+         */
+        void stop();
+
+        /**
+         * @brief Add a sink, safe to be called while messages are being written.
+         *
+         * @param sink The sink.
+         */
+        void add_sink(spdlog::sink_ptr sink);
+
+        /**
+         * @brief Get the number of messages dropped because the ring buffer was full.
+         */
+        u64 dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    protected:
+        void sink_it_(const spdlog::details::log_msg& msg) override;
+        void flush_() override;
+
+    private:
+        struct Slot
+        {
+            std::atomic<usize>              seq;
+            spdlog::details::log_msg_buffer msg;
+        };
+
+        /**
+         * @brief Put a message into the ring buffer.
+         *
+         * @return False if the ring buffer is full.
+         */
+        bool push(const spdlog::details::log_msg& msg);
+
+        /**
+         * @brief Take a message out of the ring buffer, only called from the background thread.
+         *
+         * @return False if the next message is not published yet.
+         */
+        bool pop(spdlog::details::log_msg_buffer& msg);
+
+        /**
+         * @brief Write a message to every sink, the sinks lock must be held.
+         */
+        void write(const spdlog::details::log_msg& msg);
+
+        /**
+         * @brief Background thread function.
+         */
+        void work(std::stop_token stop);
+
+        Uniq<Slot[]> m_slots;
+
+        alignas(64) std::atomic<usize> m_head   = 0;    // next position to push
+        alignas(64) std::atomic<u64>   m_signal = 0;    // bumped on push, the background thread waits on it
+        alignas(64) usize              m_tail   = 0;    // next position to pop, only touched by the consumer
+
+        std::atomic<u64>  m_written  = 0;    // messages popped and written to the sinks
+        std::atomic<u64>  m_dropped  = 0;
+        std::atomic<bool> m_started  = false;
+        u64               m_reported = 0;    // dropped messages already reported, guarded by the sinks lock
+
+        std::mutex   m_sinks_mutex;    // the background thread holds it per batch of messages
+        std::jthread m_thread;
+    };
+
+    /**
+     * @brief Set log level.
+     *
+     * @param level New log level.
+     *
+     * @return The level set.
+     *
+     * Messages below `level_floor` are compiled out, so a lower level is raised to it with a warning instead
+     * of silently logging nothing more.
+     */
+    inline Level set_level(Level level) noexcept
+    {
+        if (level >= level_floor) {
+            spdlog::set_level(level);
+            return level;
+        }
+
+        spdlog::set_level(level_floor);
+        spdlog::warn(
+            "log level '{0}' is below '{1}', the lowest level of this build, using '{1}' instead",
+            level_names[level],
+            level_names[level_floor]
+        );
+        return level_floor;
+    }
+
     /**
      * @brief Initialize logger at a specific log level with predefined pattern.
      *
@@ -82,27 +218,55 @@ namespace madbfs::log
         constexpr auto max_size  = 10 * 1000 * 1000_usize;    // 10 MB
         constexpr auto max_files = 5_usize;
 
-        auto logger = std::make_shared<spdlog::logger>(logger_name);
+        auto logger = std::make_shared<AsyncLogger>(logger_name);
 
         if (log_file == "-") {
-            logger->sinks().push_back(
+            logger->add_sink(
                 std::make_shared<spdlog::sinks::stdout_color_sink_mt>(spdlog::color_mode::always)
             );
         } else if (not log_file.empty()) {
-            logger->sinks().push_back(std::make_shared<spdlog::sinks::rotating_file_sink_mt>(
+            logger->add_sink(std::make_shared<spdlog::sinks::rotating_file_sink_mt>(
                 log_file.data(), max_size, max_files, true
             ));
         }
 
         logger->set_pattern(logger_pattern);
+        logger->flush_on(Level::err);    // errors are written before the caller continues
 
         spdlog::register_logger(logger);
         spdlog::set_default_logger(logger);
-        spdlog::set_level(level);
+        set_level(level);
 
         return true;
     }
 
+    /**
+     * @brief Start writing messages of the default logger on a background thread.
+     *
+     * Call this after the process has daemonized, messages are written on the calling thread until then.
+     */
+    inline void start_async() noexcept(false)
+    {
+        if (auto logger = std::dynamic_pointer_cast<AsyncLogger>(spdlog::get(logger_name)); logger) {
+            logger->start();
+        }
+    }
+
+    /**
+     * @brief Add a sink to the default logger.
+     *
+     * @param sink The sink.
+     */
+    inline void add_sink(spdlog::sink_ptr sink) noexcept(false)
+    {
+        auto logger = spdlog::get(logger_name);
+        if (auto async = std::dynamic_pointer_cast<AsyncLogger>(logger); async) {
+            async->add_sink(std::move(sink));
+        } else if (logger) {
+            logger->sinks().push_back(std::move(sink));
+        }
+    }
+
     /**
      * @brief Shut down logger.
      *
@@ -134,16 +298,6 @@ namespace madbfs::log
         return spdlog::get_level();
     }
 
-    /**
-     * @brief Set log level.
-     *
-     * @param level New log level.
-     */
-    inline void set_level(Level level) noexcept
-    {
-        spdlog::set_level(level);
-    }
-
     /**
      * @brief Helper function for creating formatter for logger.
      *
@@ -204,7 +358,9 @@ namespace madbfs::log
         Args&&... args
     )
     {
-        spdlog::log(fmt.loc, level, fmt.fmt, std::forward<Args>(args)...);
+        if (level >= level_floor) {
+            spdlog::log(fmt.loc, level, fmt.fmt, std::forward<Args>(args)...);
+        }
     }
 
     /**
@@ -224,8 +380,10 @@ namespace madbfs::log
         Args&&... args
     )
     {
-        fmt.loc.funcname = name;
-        spdlog::log(fmt.loc, level, fmt.fmt, std::forward<Args>(args)...);
+        if (level >= level_floor) {
+            fmt.loc.funcname = name;
+            spdlog::log(fmt.loc, level, fmt.fmt, std::forward<Args>(args)...);
+        }
     }
 
     /**
@@ -242,7 +400,9 @@ namespace madbfs::log
         Args&&... args
     )
     {
-        spdlog::log(to_spdlog_source_loc(loc), level, fmt, std::forward<Args>(args)...);
+        if (level >= level_floor) {
+            spdlog::log(to_spdlog_source_loc(loc), level, fmt, std::forward<Args>(args)...);
+        }
     }
 
     /**
@@ -260,9 +420,11 @@ namespace madbfs::log
         Args&&... args
     )
     {
-        auto new_loc     = to_spdlog_source_loc(loc);
-        new_loc.funcname = name;
-        spdlog::log(new_loc, level, fmt, std::forward<Args>(args)...);
+        if (level >= level_floor) {
+            auto new_loc     = to_spdlog_source_loc(loc);
+            new_loc.funcname = name;
+            spdlog::log(new_loc, level, fmt, std::forward<Args>(args)...);
+        }
     }
 
     /**
@@ -297,12 +459,19 @@ namespace madbfs
 {
 #define MADBFS_LOG_LOG_ENTRY(Name, Level)                                                                    \
     template <typename... Args>                                                                              \
-    inline void Name(const char* name, log::FmtWithLoc<std::type_identity_t<Args>...> fmt, Args&&... args)   \
+    inline void Name(                                                                                        \
+        [[maybe_unused]] const char*                                    name,                                \
+        [[maybe_unused]] log::FmtWithLoc<std::type_identity_t<Args>...> fmt,                                 \
+        [[maybe_unused]] Args&&... args                                                                      \
+    )                                                                                                        \
     {                                                                                                        \
-        log::log_named(spdlog::level::Level, name, std::move(fmt), std::forward<Args>(args)...);             \
+        if constexpr (spdlog::level::Level >= log::level_floor) {                                            \
+            log::log_named(spdlog::level::Level, name, std::move(fmt), std::forward<Args>(args)...);         \
+        }                                                                                                    \
     }
 
-    // Handy aliases with dedicated severity suffix to `log::log_named` function.
+    // Handy aliases with dedicated severity suffix to `log::log_named` function. Calls below the level floor
+    // are compiled out, though their arguments are still evaluated.
     MADBFS_LOG_LOG_ENTRY(log_t, trace)
     MADBFS_LOG_LOG_ENTRY(log_d, debug)
     MADBFS_LOG_LOG_ENTRY(log_i, info)
@@ -44,6 +44,10 @@ namespace madbfs::rpc
         Read,
         Write,
         Ping,    // special procedure for checking aliveness
+
+        // new procedures are appended so the values above stay the same on the wire for older peers
+        StatPath,
+        Lseek,
     };
 
     enum class OpenMode : u8
@@ -53,16 +57,44 @@ namespace madbfs::rpc
         ReadWrite = 2,
     };
 
+    /**
+     * @brief Extra flags for `Open` procedure.
+     *
+     * The values are independent of the `O_*` values of the host and the device.
+     */
+    namespace open_flag
+    {
+        constexpr u8 create    = 1 << 0;    // O_CREAT
+        constexpr u8 truncate  = 1 << 1;    // O_TRUNC
+        constexpr u8 exclusive = 1 << 2;    // O_EXCL
+    }
+
+    /**
+     * @brief Whence for `Lseek` procedure.
+     *
+     * Only the sparse file queries are sent to the device, the other whences are resolved by the kernel.
+     */
+    enum class Seek : u8
+    {
+        Data = 0,    // SEEK_DATA
+        Hole = 1,    // SEEK_HOLE
+    };
+
     /**
      * @class Id
      *
      * @brief Identifies RPC request/response.
+     *
+     * The highest bit marks a traced request, the response to it carries the timing of the request on the
+     * server (see `Timing`).
      */
     class Id
     {
     public:
         using Inner = u32;
 
+        static constexpr Inner trace_bit = Inner{ 1 } << 31;
+
         struct Hash
         {
             constexpr usize operator()(Id id) const { return std::hash<Inner>{}(id.inner()); }
@@ -77,6 +109,21 @@ namespace madbfs::rpc
 
         constexpr Inner inner() const { return m_inner; }
 
+        /**
+         * @brief Check whether the request is traced.
+         */
+        constexpr bool traced() const { return (m_inner & trace_bit) != 0; }
+
+        /**
+         * @brief Get the same id with the trace bit set or cleared.
+         *
+         * @param traced Whether the request is traced.
+         */
+        constexpr Id with_trace(bool traced) const
+        {
+            return Id{ traced ? m_inner | trace_bit : m_inner & ~trace_bit };
+        }
+
         constexpr auto operator<=>(const Id&) const = default;
 
     private:
@@ -97,11 +144,13 @@ namespace madbfs::rpc
         struct Truncate      { Str path; off_t size; };
         struct Utimens       { Str path; timespec atime; timespec mtime; };
         struct CopyFileRange { Str in_path; off_t in_offset; Str out_path; off_t out_offset; usize size; };
-        struct Open          { Str path; OpenMode mode; };
+        struct Open          { Str path; OpenMode mode; u8 flags; mode_t perm; };
         struct Close         { u64 fd; };
         struct Read          { u64 fd; off_t offset; Span<u8> out; };
         struct Write         { u64 fd; off_t offset; Span<const u8> in; };
         struct Ping          { u64 num; };
+        struct StatPath      { Str path; };
+        struct Lseek         { u64 fd; off_t offset; Seek whence; };
         // clang-format on
     }
 
@@ -127,7 +176,9 @@ namespace madbfs::rpc
               req::Close,
               req::Read,
               req::Write,
-              req::Ping>
+              req::Ping,
+              req::StatPath,
+              req::Lseek>
     {
         // make the base constructor visible
         using VarWrapper::VarWrapper;
@@ -147,35 +198,62 @@ namespace madbfs::rpc
 
     namespace resp
     {
+        struct Stat
+        {
+            off_t    size;
+            nlink_t  links;
+            timespec mtime;
+            timespec atime;
+            timespec ctime;
+            mode_t   mode;
+            uid_t    uid;
+            gid_t    gid;
+        };
+
+        // mutating procedures return the stat of the affected file right after the operation. the stat is
+        // empty if it can't be taken, the operation itself still succeeded then.
         // clang-format off
-        struct Stat;
         struct Listdir       { Vec<Pair<Str, Stat>> entries; }; // uses corresponding `req::Listdir` buf
         struct Readlink      { Str target; };                   // uses corresponding `req::Readlink` buf
-        struct Mknod         { };
-        struct Mkdir         { };
+        struct Mknod         { Opt<Stat> stat; };
+        struct Mkdir         { Opt<Stat> stat; };
         struct Unlink        { };
         struct Rmdir         { };
-        struct Rename        { };
-        struct Truncate      { };
-        struct Utimens       { };
-        struct CopyFileRange { usize size; };
-        struct Open          { u64 fd; };
-        struct Close         { };
+        struct Rename        { Opt<Stat> stat; };               // stat of `to`
+        struct Truncate      { Opt<Stat> stat; };
+        struct Utimens       { Opt<Stat> stat; };
+        struct CopyFileRange { usize size; Opt<Stat> stat; };   // stat of `out_path`
+        struct Open;
+        struct Close         { Opt<Stat> stat; };               // not every transport can provide it
         struct Read          { Span<const u8> read; };          // uses corresponding `req::Read` out
         struct Write         { usize size; };
         struct Ping          { u64 num; };
+        struct StatPath;
+        struct Lseek         { off_t offset; };
         // clang-format on
 
-        struct Stat
+        /**
+         * @brief Opened file descriptor.
+         *
+         * The stat of the file after it is opened is only filled if the request has non-empty `flags`, the
+         * caller needs it to build or update its node without another stat.
+         */
+        struct Open
         {
-            off_t    size;
-            nlink_t  links;
-            timespec mtime;
-            timespec atime;
-            timespec ctime;
-            mode_t   mode;
-            uid_t    uid;
-            gid_t    gid;
+            u64  fd;
+            Stat stat;
+        };
+
+        /**
+         * @brief Stat of each component of a path, from the first component down to the path itself.
+         *
+         * The stats stop at the first component that can't be stat-ed, `status` holds the error of that
+         * component (or `Status{}` if every component exists).
+         */
+        struct StatPath
+        {
+            Vec<Stat> stats;
+            Status    status;
         };
     }
 
@@ -201,7 +279,9 @@ namespace madbfs::rpc
               resp::Close,
               resp::Read,
               resp::Write,
-              resp::Ping>
+              resp::Ping,
+              resp::StatPath,
+              resp::Lseek>
     {
         // make the base constructor visible
         using VarWrapper::VarWrapper;
@@ -212,12 +292,27 @@ namespace madbfs::rpc
         Procedure proc() const { return static_cast<Procedure>(index()); }
     };
 
+    /**
+     * @class Timing
+     *
+     * @brief Time a traced request spent on the server in microseconds.
+     *
+     * `queue` is the time from the receipt of the request until its handler starts, `exec` is the time spent
+     * in the handler.
+     */
+    struct Timing
+    {
+        u32 queue = 0;
+        u32 exec  = 0;
+    };
+
     struct ResponseHeader
     {
         Id        id;
         Procedure proc;
         Status    status;
         u64       size;
+        Timing    timing = {};    // only sent for traced requests
     };
 
     struct FailedResponse
@@ -317,8 +412,15 @@ namespace madbfs::rpc
      * @param proc Response procedure.
      * @param response Response data for the procedure.
      * @param id Response Unique response identifier.
+     * @param timing Server-side timing, only sent if the id is traced.
      */
-    AExpect<void> send_response(Socket& socket, Vec<u8>& buffer, FallibleResponse response, Id id);
+    AExpect<void> send_response(
+        Socket&          socket,
+        Vec<u8>&         buffer,
+        FallibleResponse response,
+        Id               id,
+        Timing           timing = {}
+    );
 
     /**
      * @brief Read request header from socket.
@@ -1,10 +1,12 @@
 #include "madbfs-common/ipc.hpp"
 #include "madbfs-common/log.hpp"
+#include "madbfs-common/util/split.hpp"
 
 #include <madbfs-gen/version.hpp>
 
 #include <boost/json.hpp>
 
+#include <charconv>
 #include <filesystem>
 
 using namespace madbfs;
@@ -48,6 +50,17 @@ namespace
         co_return Expect<void>{};
     }
 
+    /**
+     * @brief Get the optional resume flag of a pull/push operation.
+     *
+     * @param value Value of the operation.
+     */
+    bool resume_of(const json::value& value)
+    {
+        auto resume = value.as_object().if_contains("resume");
+        return resume and json::value_to<bool>(*resume);
+    }
+
     /**
      * @brief Parse message to `Op`.
      *
@@ -80,8 +93,12 @@ namespace
                 return Op{ op::SetCacheSize{ .mib = json::value_to<u32>(json.at("value")) } };
             } else if (op == op::name::set_ttl) {
                 return Op{ op::SetTTL{ .sec = json::value_to<u32>(json.at("value")) } };
+            } else if (op == op::name::set_ttl_policy) {
+                return Op{ op::SetTTLPolicy{ .spec = json::value_to<String>(json.at("value")) } };
             } else if (op == op::name::set_timeout) {
                 return Op{ op::SetTimeout{ .sec = json::value_to<u32>(json.at("value")) } };
+            } else if (op == op::name::set_weights) {
+                return Op{ op::SetWeights{ .spec = json::value_to<String>(json.at("value")) } };
             } else if (op == op::name::set_log_level) {
                 auto level = json::value_to<String>(json.at("value"));
                 if (not log::level_from_str(level)) {
@@ -92,6 +109,40 @@ namespace
                 return Op{ op::SetLogLevel{ .lvl = level } };
             } else if (op == op::name::logcat) {
                 return op::Logcat{ .color = json::value_to<bool>(json.at("value")) };
+            } else if (op == op::name::top) {
+                return op::Top{};
+            } else if (op == op::name::pull) {
+                const auto& value = json.at("value");
+                return Op{ op::Pull{
+                    .device = json::value_to<String>(value.at("device")),
+                    .host   = json::value_to<String>(value.at("host")),
+                    .resume = resume_of(value),
+                } };
+            } else if (op == op::name::push) {
+                const auto& value = json.at("value");
+                return Op{ op::Push{
+                    .host   = json::value_to<String>(value.at("host")),
+                    .device = json::value_to<String>(value.at("device")),
+                    .resume = resume_of(value),
+                } };
+            } else if (op == op::name::jobs) {
+                return Op{ op::Jobs{} };
+            } else if (op == op::name::cancel) {
+                return Op{ op::Cancel{ .id = json::value_to<u64>(json.at("value")) } };
+            } else if (op == op::name::metrics) {
+                return Op{ op::Metrics{} };
+            } else if (op == op::name::set_trace_rate) {
+                return Op{ op::SetTraceRate{ .rate = json::value_to<u32>(json.at("value")) } };
+            } else if (op == op::name::trace) {
+                return Op{ op::Trace{} };
+            } else if (op == op::name::record_start) {
+                return Op{ op::RecordStart{ .file = json::value_to<String>(json.at("value")) } };
+            } else if (op == op::name::record_stop) {
+                return Op{ op::RecordStop{} };
+            } else if (op == op::name::cache_map) {
+                return Op{ op::CacheMap{ .path = json::value_to<String>(json.at("value")) } };
+            } else if (op == op::name::lag) {
+                return Op{ op::Lag{} };
             } else if (op == op::name::unmount) {
                 return Op{ op::Unmount{} };
             }
@@ -110,6 +161,7 @@ namespace madbfs::ipc
 {
     std::deque<LogcatSink::Msg>& LogcatSink::swap()
     {
+        auto lock      = std::scoped_lock{ this->mutex_ };
         auto new_index = (m_index + 1) % 2;
         return m_queue[std::exchange(m_index, new_index)];
     }
@@ -169,15 +221,42 @@ namespace madbfs::ipc
 
         // clang-format off
         auto op_json = std::move(op).visit(Overload{
-            [&](op::Info           ) { return json::value{ { "op", n::info             }                      }; },
-            [&](op::InvalidateCache) { return json::value{ { "op", n::invalidate_cache }                      }; },
-            [&](op::ExpireStat     ) { return json::value{ { "op", n::expire_stat      }                      }; },
-            [&](op::SetPageSize  op) { return json::value{ { "op", n::set_page_size    }, { "value", op.kib } }; },
-            [&](op::SetCacheSize op) { return json::value{ { "op", n::set_cache_size   }, { "value", op.mib } }; },
-            [&](op::SetTTL       op) { return json::value{ { "op", n::set_ttl          }, { "value", op.sec } }; },
-            [&](op::SetTimeout   op) { return json::value{ { "op", n::set_timeout      }, { "value", op.sec } }; },
-            [&](op::SetLogLevel  op) { return json::value{ { "op", n::set_log_level    }, { "value", op.lvl } }; },
-            [&](op::Unmount        ) { return json::value{ { "op", n::unmount          }                      }; },
+            [&](op::Info           ) { return json::value{ { "op", n::info             }                       }; },
+            [&](op::InvalidateCache) { return json::value{ { "op", n::invalidate_cache }                       }; },
+            [&](op::ExpireStat     ) { return json::value{ { "op", n::expire_stat      }                       }; },
+            [&](op::SetPageSize  op) { return json::value{ { "op", n::set_page_size    }, { "value", op.kib  } }; },
+            [&](op::SetCacheSize op) { return json::value{ { "op", n::set_cache_size   }, { "value", op.mib  } }; },
+            [&](op::SetTTL       op) { return json::value{ { "op", n::set_ttl          }, { "value", op.sec  } }; },
+            [&](op::SetTTLPolicy op) { return json::value{ { "op", n::set_ttl_policy   }, { "value", op.spec } }; },
+            [&](op::SetTimeout   op) { return json::value{ { "op", n::set_timeout      }, { "value", op.sec  } }; },
+            [&](op::SetWeights   op) { return json::value{ { "op", n::set_weights      }, { "value", op.spec } }; },
+            [&](op::SetLogLevel  op) { return json::value{ { "op", n::set_log_level    }, { "value", op.lvl  } }; },
+            [&](op::Pull op) {
+                auto value = json::object{
+                    { "device", op.device },
+                    { "host", op.host },
+                    { "resume", op.resume },
+                };
+                return json::value{ { "op", n::pull }, { "value", std::move(value) } };
+            },
+            [&](op::Push op) {
+                auto value = json::object{
+                    { "host", op.host },
+                    { "device", op.device },
+                    { "resume", op.resume },
+                };
+                return json::value{ { "op", n::push }, { "value", std::move(value) } };
+            },
+            [&](op::Jobs           ) { return json::value{ { "op", n::jobs             }                       }; },
+            [&](op::Cancel       op) { return json::value{ { "op", n::cancel           }, { "value", op.id   } }; },
+            [&](op::Metrics        ) { return json::value{ { "op", n::metrics          }                       }; },
+            [&](op::SetTraceRate op) { return json::value{ { "op", n::set_trace_rate   }, { "value", op.rate } }; },
+            [&](op::Trace          ) { return json::value{ { "op", n::trace            }                       }; },
+            [&](op::RecordStart  op) { return json::value{ { "op", n::record_start     }, { "value", op.file } }; },
+            [&](op::RecordStop     ) { return json::value{ { "op", n::record_stop      }                       }; },
+            [&](op::CacheMap     op) { return json::value{ { "op", n::cache_map        }, { "value", op.path } }; },
+            [&](op::Lag            ) { return json::value{ { "op", n::lag              }                       }; },
+            [&](op::Unmount        ) { return json::value{ { "op", n::unmount          }                       }; },
         });
         // clang-format on
 
@@ -238,6 +317,20 @@ namespace madbfs::ipc
         }
     }
 
+    AExpect<Gen<AExpect<String>>> Client::top()
+    {
+        auto op_json = json::value{ { "op", op::name::top } };
+        if (auto res = co_await send_message(m_socket, json::serialize(op_json)); not res) {
+            co_return Unexpect{ res.error() };
+        }
+
+        co_return [sock = &m_socket](this auto) -> Gen<AExpect<String>> {
+            while (sock->is_open()) {
+                co_yield receive_message(*sock);
+            }
+        }();
+    }
+
     AExpect<Gen<AExpect<String>>> Client::logcat(op::Logcat opt)
     {
         auto op_json = json::value{ { "op", op::name::logcat }, { "value", opt.color } };
@@ -289,17 +382,18 @@ namespace madbfs::ipc
         return Server{ path.c_str(), std::move(acc) };
     }
 
-    Await<void> Server::launch(OnFsOp on_op)
+    Await<void> Server::launch(OnFsOp on_op, OnTop on_top)
     {
         log_d(__func__, "ipc launched!");
 
         m_running = true;
         m_on_op   = std::move(on_op);
+        m_on_top  = std::move(on_top);
 
         auto logger = log::get_logger();
         if (not logger) {
             log_e(__func__, "can't find logger with name '{}', logcat won't function", log::logger_name);
-            co_await run();
+            co_await async::wait_all(run(), top_handler());
             co_return;
         }
 
@@ -308,17 +402,17 @@ namespace madbfs::ipc
             m_logcat_sink->set_level(log::Level::off);
             m_logcat_sink->set_formatter(log::create_formatter(log::logger_pattern, false));
 
-            auto& sinks = logger->sinks();
-            sinks.push_back(m_logcat_sink);
+            log::add_sink(m_logcat_sink);
         }
 
-        co_await async::wait_all(run(), logcat_handler());
+        co_await async::wait_all(run(), logcat_handler(), top_handler());
     }
 
     void Server::stop()
     {
         m_running = false;
         m_logcat_timer.cancel();
+        m_top_timer.cancel();
         m_socket.cancel();
         m_socket.close();
     }
@@ -368,6 +462,9 @@ namespace madbfs::ipc
             case Op::index_of<op::Logcat>():
                 m_logcat_subscribers.emplace_back(std::move(sock), op->as<op::Logcat>()->color);
                 co_return;
+            case Op::index_of<op::Top>():
+                m_top_subscribers.push_back(std::move(sock));
+                co_return;
             default:
                 log_c(__func__, "[BUG] not all op variants are handled!");    //
                 co_return;
@@ -473,4 +570,229 @@ namespace madbfs::ipc
 
         log_i(__func__, "end");
     }
+
+    Await<void> Server::top_handler()
+    {
+        using namespace std::chrono_literals;
+
+        log_i(__func__, "start");
+
+        auto inactive_subscribers = Vec<isize>{};
+        auto watched              = false;
+
+        while (m_running) {
+            m_top_timer.expires_after(1s);
+            if (auto res = co_await m_top_timer.async_wait(); not res) {
+                break;
+            }
+
+            if (m_top_subscribers.empty()) {
+                if (watched) {
+                    log_i(__func__, "no subscribers, stop collecting frames");
+                    m_on_top(false);
+                }
+                watched = false;
+                continue;
+            }
+
+            watched = true;
+
+            auto frame = m_on_top(true);
+            if (frame.is_null()) {
+                continue;
+            }
+
+            auto message = json::serialize(frame);
+
+            for (auto&& [i, sock] : m_top_subscribers | sv::enumerate) {
+                if (auto res = co_await send_message(sock, message); not res) {
+                    inactive_subscribers.emplace_back(i);
+                }
+            }
+
+            for (auto idx : inactive_subscribers | sv::reverse) {
+                m_top_subscribers.erase(m_top_subscribers.begin() + idx);
+            }
+
+            inactive_subscribers.clear();
+        }
+
+        if (watched) {
+            m_on_top(false);
+        }
+
+        for (auto& sock : m_top_subscribers) {
+            sock.cancel();
+            sock.close();
+        }
+
+        m_top_subscribers.clear();
+
+        log_i(__func__, "end");
+    }
+}
+
+// ipc.hpp impl: Exporter
+namespace madbfs::ipc
+{
+    Exporter::~Exporter()
+    {
+        if (m_running) {
+            stop();
+        }
+        if (m_unix and not m_address.empty()) {
+            if (auto sock = m_address.c_str(); ::unlink(sock) < 0) {
+                log_e(__func__, "failed to unlink socket: {} [{}]", sock, strerror(errno));
+            }
+        }
+    }
+
+    Expect<Exporter> Exporter::create(async::Context& context, Str address)
+    {
+        auto ec = net::error_code{};
+
+        if (address.contains('/')) {
+            auto path = std::filesystem::absolute(address);
+            auto ep   = async::unix_socket::Endpoint{ path.c_str() };
+            auto acc  = async::unix_socket::Acceptor{ context };
+
+            acc.open(ep.protocol(), ec);
+            acc.bind(ep, ec);
+            acc.listen(acc.max_listen_connections, ec);
+
+            if (ec) {
+                log_e(__func__, "failed to construct acceptor {:?}: {}", path.c_str(), ec.message());
+                return Unexpect{ async::to_generic_err(ec, Errc::address_not_available) };
+            }
+
+            return Exporter{ path.c_str(), std::move(acc), true };
+        }
+
+        auto colon = address.rfind(':');
+        auto host  = colon == Str::npos ? Str{ "127.0.0.1" } : address.substr(0, colon);
+        auto port  = colon == Str::npos ? address : address.substr(colon + 1);
+
+        auto port_num  = u16{};
+        auto [ptr, pe] = std::from_chars(port.begin(), port.end(), port_num);
+        if (pe != std::errc{} or ptr != port.end() or port_num == 0) {
+            log_e(__func__, "invalid port on address {:?}", address);
+            return Unexpect{ Errc::invalid_argument };
+        }
+
+        auto ip = net::ip::make_address(String{ host }, ec);
+        if (ec) {
+            log_e(__func__, "invalid host on address {:?}: {}", address, ec.message());
+            return Unexpect{ Errc::invalid_argument };
+        }
+
+        auto ep  = async::tcp::Endpoint{ ip, port_num };
+        auto acc = async::tcp::Acceptor{ context };
+
+        acc.open(ep.protocol(), ec);
+        acc.set_option(async::tcp::Acceptor::reuse_address(true));
+        acc.bind(ep, ec);
+        acc.listen(acc.max_listen_connections, ec);
+
+        if (ec) {
+            log_e(__func__, "failed to construct acceptor {:?}: {}", address, ec.message());
+            return Unexpect{ async::to_generic_err(ec, Errc::address_not_available) };
+        }
+
+        return Exporter{ fmt::format("{}:{}", host, port_num), std::move(acc), false };
+    }
+
+    Await<void> Exporter::launch(Render render)
+    {
+        log_d(__func__, "exporter launched!");
+
+        m_running = true;
+        m_render  = std::move(render);
+
+        while (m_running) {
+            auto served = co_await std::visit(
+                [&](auto& acceptor) -> Await<bool> {
+                    auto res = co_await acceptor.async_accept();
+                    if (not res) {
+                        log_e(__func__, "socket accept failed: {}", res.error().message());
+                        co_return false;
+                    }
+                    co_await handle_peer(std::move(res).value());
+                    co_return true;
+                },
+                m_acceptor
+            );
+
+            if (not served and not m_running) {
+                break;
+            }
+        }
+    }
+
+    void Exporter::stop()
+    {
+        m_running = false;
+        std::visit(
+            [](auto& acceptor) {
+                acceptor.cancel();
+                acceptor.close();
+            },
+            m_acceptor
+        );
+    }
+
+    template <typename Sock>
+    Await<void> Exporter::handle_peer(Sock sock)
+    {
+        using namespace std::chrono_literals;
+
+        auto request = String{};
+        auto read    = [&] -> AExpect<usize, net::error_code> {
+            auto buf = net::dynamic_buffer(request, max_msg_len);
+            return net::async_read_until(sock, buf, "\r\n\r\n", async::as_expected(net::use_awaitable));
+        };
+
+        // a peer that never finishes its request would block the others
+        auto header = co_await async::timeout(read(), 5000ms, [&] { sock.cancel(); });
+        if (not header or not *header) {
+            co_return;
+        }
+
+        auto line   = Str{ request }.substr(0, request.find("\r\n"));
+        auto parts  = util::split(line, ' ');
+        auto method = parts.size() > 0 ? parts[0] : Str{};
+        auto target = parts.size() > 1 ? parts[1] : Str{};
+
+        auto status = Str{ "200 OK" };
+        auto type   = Str{ "application/openmetrics-text; version=1.0.0; charset=utf-8" };
+        auto body   = String{};
+
+        if (method != "GET") {
+            status = "405 Method Not Allowed";
+            type   = "text/plain; charset=utf-8";
+            body   = "only GET is supported\n";
+        } else if (target != "/" and target != "/metrics") {
+            status = "404 Not Found";
+            type   = "text/plain; charset=utf-8";
+            body   = "metrics are served on /metrics\n";
+        } else {
+            body  = m_render();
+            body += "# EOF\n";
+        }
+
+        auto response = fmt::format(
+            "HTTP/1.1 {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n{}",
+            status,
+            type,
+            body.size(),
+            body
+        );
+
+        if (auto res = co_await async::write_exact<char>(sock, response); not res) {
+            log_w(__func__, "failed to send response: {}", res.error().message());
+        }
+
+        auto ec = net::error_code{};
+        sock.shutdown(Sock::shutdown_both, ec);
+        sock.close(ec);
+    }
 }
@@ -0,0 +1,196 @@
+#include "madbfs-common/log.hpp"
+
+#include <bit>
+
+namespace madbfs::log
+{
+    AsyncLogger::AsyncLogger(String name)
+        : spdlog::logger{ std::move(name) }
+        , m_slots{ std::make_unique<Slot[]>(capacity) }
+    {
+        static_assert(std::has_single_bit(capacity), "capacity must be a power of two");
+
+        for (auto i = 0uz; i < capacity; ++i) {
+            m_slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    AsyncLogger::~AsyncLogger()
+    {
+        stop();
+    }
+
+    void AsyncLogger::start()
+    {
+        if (m_started.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        m_thread = std::jthread{ [this](std::stop_token stop) { work(stop); } };
+    }
+
+    void AsyncLogger::stop()
+    {
+        if (not m_started.exchange(false, std::memory_order_acq_rel)) {
+            return;
+        }
+
+        m_thread.request_stop();
+        m_signal.fetch_add(1, std::memory_order_release);
+        m_signal.notify_one();
+        m_thread.join();
+
+        // messages pushed by callers that saw the logger still started
+        auto lock  = std::scoped_lock{ m_sinks_mutex };
+        auto msg   = spdlog::details::log_msg_buffer{};
+        auto count = 0_u64;
+
+        while (m_tail != m_head.load(std::memory_order_acquire)) {
+            if (pop(msg)) {
+                write(msg);
+                ++count;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        m_written.fetch_add(count, std::memory_order_release);
+        m_written.notify_all();
+    }
+
+    void AsyncLogger::add_sink(spdlog::sink_ptr sink)
+    {
+        auto lock = std::scoped_lock{ m_sinks_mutex };
+        sinks_.push_back(std::move(sink));
+    }
+
+    void AsyncLogger::sink_it_(const spdlog::details::log_msg& msg)
+    {
+        if (not m_started.load(std::memory_order_acquire)) {
+            auto lock = std::scoped_lock{ m_sinks_mutex };
+            write(msg);
+        } else if (push(msg)) {
+            m_signal.fetch_add(1, std::memory_order_release);
+            m_signal.notify_one();
+        } else {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (should_flush_(msg)) {
+            flush_();
+        }
+    }
+
+    void AsyncLogger::flush_()
+    {
+        if (m_started.load(std::memory_order_acquire)) {
+            // every message pushed so far is written before the sinks are flushed
+            auto target  = m_head.load(std::memory_order_acquire);
+            auto written = m_written.load(std::memory_order_acquire);
+            while (written < target) {
+                m_written.wait(written, std::memory_order_acquire);
+                written = m_written.load(std::memory_order_acquire);
+            }
+        }
+
+        auto lock = std::scoped_lock{ m_sinks_mutex };
+        for (auto& sink : sinks_) {
+            try {
+                sink->flush();
+            } catch (const std::exception& e) {
+                err_handler_(e.what());
+            }
+        }
+    }
+
+    bool AsyncLogger::push(const spdlog::details::log_msg& msg)
+    {
+        auto pos = m_head.load(std::memory_order_relaxed);
+
+        while (true) {
+            auto& slot = m_slots[pos & (capacity - 1)];
+            auto  seq  = slot.seq.load(std::memory_order_acquire);
+            auto  diff = static_cast<isize>(seq) - static_cast<isize>(pos);
+
+            if (diff < 0) {
+                return false;    // the slot is still holding a message from the previous lap
+            } else if (diff > 0) {
+                pos = m_head.load(std::memory_order_relaxed);    // another producer claimed the slot
+            } else if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.msg = spdlog::details::log_msg_buffer{ msg };
+                slot.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    bool AsyncLogger::pop(spdlog::details::log_msg_buffer& msg)
+    {
+        auto& slot = m_slots[m_tail & (capacity - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != m_tail + 1) {
+            return false;
+        }
+
+        msg = std::move(slot.msg);
+        slot.seq.store(m_tail + capacity, std::memory_order_release);
+        ++m_tail;
+
+        return true;
+    }
+
+    void AsyncLogger::write(const spdlog::details::log_msg& msg)
+    {
+        for (auto& sink : sinks_) {
+            if (not sink->should_log(msg.level)) {
+                continue;
+            }
+            try {
+                sink->log(msg);
+            } catch (const std::exception& e) {
+                err_handler_(e.what());
+            }
+        }
+    }
+
+    void AsyncLogger::work(std::stop_token stop)
+    {
+        constexpr auto batch = 256uz;    // messages written per lock of the sinks
+
+        auto msg = spdlog::details::log_msg_buffer{};
+
+        while (true) {
+            auto signal = m_signal.load(std::memory_order_acquire);
+            auto count  = 0_u64;
+
+            {
+                auto lock = std::scoped_lock{ m_sinks_mutex };
+                while (count < batch and pop(msg)) {
+                    write(msg);
+                    ++count;
+                }
+
+                if (auto dropped = m_dropped.load(std::memory_order_relaxed); dropped != m_reported) {
+                    auto text = fmt::format("dropped {} messages, log buffer is full", dropped - m_reported);
+                    m_reported = dropped;
+                    write(spdlog::details::log_msg{ name_, Level::warn, text });
+                }
+            }
+
+            if (count > 0) {
+                m_written.fetch_add(count, std::memory_order_release);
+                m_written.notify_all();
+                continue;
+            }
+
+            if (m_tail != m_head.load(std::memory_order_acquire)) {
+                std::this_thread::yield();    // a slot is claimed but its message is not published yet
+                continue;
+            }
+
+            if (stop.stop_requested()) {
+                break;
+            }
+
+            m_signal.wait(signal, std::memory_order_acquire);
+        }
+    }
+}
@@ -154,6 +154,33 @@ namespace
             return std::forward<Self>(self);
         }
 
+        template <typename Self>
+        Self&& write_stat(this Self&& self, const resp::Stat& stat)
+        {
+            self.template write_int<i64>(stat.size);
+            self.template write_int<u64>(stat.links);
+            self.template write_int<i64>(stat.mtime.tv_sec);
+            self.template write_int<i64>(stat.mtime.tv_nsec);
+            self.template write_int<i64>(stat.atime.tv_sec);
+            self.template write_int<i64>(stat.atime.tv_nsec);
+            self.template write_int<i64>(stat.ctime.tv_sec);
+            self.template write_int<i64>(stat.ctime.tv_nsec);
+            self.template write_int<u32>(stat.mode);
+            self.template write_int<u32>(stat.uid);
+            self.template write_int<u32>(stat.gid);
+            return std::forward<Self>(self);
+        }
+
+        template <typename Self>
+        Self&& write_opt_stat(this Self&& self, const Opt<resp::Stat>& stat)
+        {
+            self.template write_int<u8>(stat.has_value());
+            if (stat) {
+                self.write_stat(*stat);
+            }
+            return std::forward<Self>(self);
+        }
+
     protected:
         Vec<u8>& m_buffer;
     };
@@ -205,7 +232,9 @@ namespace
                 case Procedure::Close:
                 case Procedure::Read:
                 case Procedure::Write:
-                case Procedure::Ping: return proc;
+                case Procedure::Ping:
+                case Procedure::StatPath:
+                case Procedure::Lseek: return proc;
                 }
                 return std::nullopt;
             });
@@ -250,6 +279,41 @@ namespace
             });
         }
 
+        Opt<resp::Stat> read_stat()
+        {
+            TRY(size, read_int<i64>());
+            TRY(links, read_int<u64>());
+            TRY(mtime_sec, read_int<i64>());
+            TRY(mtime_nsec, read_int<i64>());
+            TRY(atime_sec, read_int<i64>());
+            TRY(atime_nsec, read_int<i64>());
+            TRY(ctime_sec, read_int<i64>());
+            TRY(ctime_nsec, read_int<i64>());
+            TRY(mode, read_int<u32>());
+            TRY(uid, read_int<u32>());
+            TRY(gid, read_int<u32>());
+
+            return resp::Stat{
+                .size  = static_cast<off_t>(*size),
+                .links = static_cast<nlink_t>(*links),
+                .mtime = to_timespec(*mtime_sec, *mtime_nsec),
+                .atime = to_timespec(*atime_sec, *atime_nsec),
+                .ctime = to_timespec(*ctime_sec, *ctime_nsec),
+                .mode  = static_cast<mode_t>(*mode),
+                .uid   = static_cast<uid_t>(*uid),
+                .gid   = static_cast<gid_t>(*gid),
+            };
+        }
+
+        Opt<Opt<resp::Stat>> read_opt_stat()
+        {
+            TRY(has_stat, read_int<u8>());
+            if (*has_stat == 0) {
+                return Opt<Opt<resp::Stat>>{ std::in_place, std::nullopt };
+            }
+            return read_stat().transform([](resp::Stat stat) { return Opt{ stat }; });
+        }
+
     private:
         usize          m_index = 0;
         Span<const u8> m_buffer;
@@ -298,26 +362,38 @@ namespace
         using PayloadBuilder::write_bytes;
         using PayloadBuilder::write_int;
         using PayloadBuilder::write_path;
+        using PayloadBuilder::write_opt_stat;
+        using PayloadBuilder::write_stat;
+        using PayloadBuilder::write_status;
 
         static constexpr auto header_size = sizeof(Id) + sizeof(Procedure) + sizeof(Status) + sizeof(u64);
+        static constexpr auto timing_size = sizeof(Timing::queue) + sizeof(Timing::exec);
 
-        ResponseBuilder(Vec<u8>& buffer, Id id, Procedure proc, Status status)
+        ResponseBuilder(Vec<u8>& buffer, Id id, Procedure proc, Status status, Timing timing)
             : PayloadBuilder{ buffer }
+            , m_timing_size{ id.traced() ? timing_size : 0 }
         {
             write_id(id).write_procedure(proc).write_status(status);
             write_int<u64>(0);    // will be filled later on build()
+
+            if (id.traced()) {
+                write_int<u32>(timing.queue).write_int<u32>(timing.exec);
+            }
         }
 
         Span<const u8> build()
         {
 
             auto& buf  = m_buffer;
-            auto  size = buf.size() - header_size;
+            auto  size = buf.size() - header_size - m_timing_size;
             auto  arr  = to_net_bytes(static_cast<u64>(size));
             sr::copy_n(arr.begin(), arr.size(), buf.begin() + header_size - sizeof(u64));
 
             return buf;
         }
+
+    private:
+        usize m_timing_size;
     };
 
     /**
@@ -411,6 +487,8 @@ namespace
                 return builder    //
                     .write_path(req.path)
                     .write_open_mode(req.mode)
+                    .write_int<u8>(req.flags)
+                    .write_int<u32>(req.perm)
                     .build();
             },
             [&](req::Close req) {
@@ -432,6 +510,18 @@ namespace
                     .write_bytes(req.in)
                     .build();
             },
+            [&](req::StatPath req) {
+                return builder    //
+                    .write_path(req.path)
+                    .build();
+            },
+            [&](req::Lseek req) {
+                return builder    //
+                    .write_int<u64>(req.fd)
+                    .write_int<i64>(req.offset)
+                    .write_int<u8>(std::to_underlying(req.whence))
+                    .build();
+            },
             [&](req::Ping req) {
                 return builder    //
                     .write_int<u64>(req.num)
@@ -446,74 +536,75 @@ namespace
      * @param buffer Output buffer.
      * @param response Response of an operation.
      * @param id Response unique id.
+     * @param timing Server-side timing, only written if the id is traced.
      *
      * @return The span of the buffer that is written.
      *
      * The buffer will be cleared on every invocation.
      */
-    Span<const u8> build_response(Vec<u8>& buffer, FallibleResponse response, Id id)
+    Span<const u8> build_response(Vec<u8>& buffer, FallibleResponse response, Id id, Timing timing)
     {
         buffer.clear();
 
         if (auto fail = std::get_if<FailedResponse>(&response); fail) {
-            return ResponseBuilder{ buffer, id, fail->proc, fail->status }.build();
+            return ResponseBuilder{ buffer, id, fail->proc, fail->status, timing }.build();
         }
 
         const auto& resp = *std::get_if<Response>(&response);
 
-        auto builder = ResponseBuilder{ buffer, id, resp.proc(), Status{} };
+        auto builder = ResponseBuilder{ buffer, id, resp.proc(), Status{}, timing };
 
         return resp.visit(Overload{
             [&](const resp::Stat& resp) {
                 return builder    //
-                    .write_int<i64>(resp.size)
-                    .write_int<u64>(resp.links)
-                    .write_int<i64>(resp.mtime.tv_sec)
-                    .write_int<i64>(resp.mtime.tv_nsec)
-                    .write_int<i64>(resp.atime.tv_sec)
-                    .write_int<i64>(resp.atime.tv_nsec)
-                    .write_int<i64>(resp.ctime.tv_sec)
-                    .write_int<i64>(resp.ctime.tv_nsec)
-                    .write_int<u32>(resp.mode)
-                    .write_int<u32>(resp.uid)
-                    .write_int<u32>(resp.gid)
+                    .write_stat(resp)
                     .build();
             },
             [&](const resp::Listdir& resp) {
                 builder.write_int<u64>(resp.entries.size());
                 for (const auto& [name, stat] : resp.entries) {
-                    builder    //
-                        .write_path(name)
-                        .write_int<i64>(stat.size)
-                        .write_int<u64>(stat.links)
-                        .write_int<i64>(stat.mtime.tv_sec)
-                        .write_int<i64>(stat.mtime.tv_nsec)
-                        .write_int<i64>(stat.atime.tv_sec)
-                        .write_int<i64>(stat.atime.tv_nsec)
-                        .write_int<i64>(stat.ctime.tv_sec)
-                        .write_int<i64>(stat.ctime.tv_nsec)
-                        .write_int<u32>(stat.mode)
-                        .write_int<u32>(stat.uid)
-                        .write_int<u32>(stat.gid);
+                    builder.write_path(name).write_stat(stat);
                 }
                 return builder.build();
             },
+            [&](const resp::Open& resp) {
+                return builder    //
+                    .write_int<u64>(resp.fd)
+                    .write_stat(resp.stat)
+                    .build();
+            },
+            [&](const resp::CopyFileRange& resp) {
+                return builder    //
+                    .write_int<u64>(resp.size)
+                    .write_opt_stat(resp.stat)
+                    .build();
+            },
             // clang-format off
             [&](const resp::Readlink&      resp) { return builder.write_path(resp.target).build();   },
-            [&](const resp::Mknod&             ) { return builder.build();                           },
-            [&](const resp::Mkdir&             ) { return builder.build();                           },
+            [&](const resp::Mknod&         resp) { return builder.write_opt_stat(resp.stat).build(); },
+            [&](const resp::Mkdir&         resp) { return builder.write_opt_stat(resp.stat).build(); },
             [&](const resp::Unlink&            ) { return builder.build();                           },
             [&](const resp::Rmdir&             ) { return builder.build();                           },
-            [&](const resp::Rename&            ) { return builder.build();                           },
-            [&](const resp::Truncate&          ) { return builder.build();                           },
-            [&](const resp::Utimens&           ) { return builder.build();                           },
-            [&](const resp::CopyFileRange& resp) { return builder.write_int<u64>(resp.size).build(); },
-            [&](const resp::Open&          resp) { return builder.write_int<u64>(resp.fd  ).build(); },
-            [&](const resp::Close&             ) { return builder.build();                           },
+            [&](const resp::Rename&        resp) { return builder.write_opt_stat(resp.stat).build(); },
+            [&](const resp::Truncate&      resp) { return builder.write_opt_stat(resp.stat).build(); },
+            [&](const resp::Utimens&       resp) { return builder.write_opt_stat(resp.stat).build(); },
+            [&](const resp::Close&         resp) { return builder.write_opt_stat(resp.stat).build(); },
             [&](const resp::Read&          resp) { return builder.write_bytes   (resp.read).build(); },
             [&](const resp::Write&         resp) { return builder.write_int<u64>(resp.size).build(); },
             [&](const resp::Ping&          resp) { return builder.write_int<u64>(resp.num ).build(); },
             // clang-format on
+            [&](const resp::StatPath& resp) {
+                builder.write_int<u64>(resp.stats.size());
+                for (const auto& stat : resp.stats) {
+                    builder.write_stat(stat);
+                }
+                return builder.write_status(resp.status).build();
+            },
+            [&](const resp::Lseek& resp) {
+                return builder    //
+                    .write_int<i64>(resp.offset)
+                    .build();
+            },
         });
     }
 
@@ -618,7 +709,14 @@ namespace
         case Procedure::Open: {
             TRY(path, reader.read_path());
             TRY(mode, reader.read_open_mode());
-            return req::Open{ .path = *path, .mode = *mode };
+            TRY(flags, reader.read_int<u8>());
+            TRY(perm, reader.read_int<u32>());
+            return req::Open{
+                .path  = *path,
+                .mode  = *mode,
+                .flags = *flags,
+                .perm  = static_cast<mode_t>(*perm),
+            };
         }
 
         case Procedure::Close: {
@@ -645,6 +743,21 @@ namespace
             return req::Write{ .fd = *fd, .offset = static_cast<off_t>(*offset), .in = *bytes };
         }
 
+        case Procedure::StatPath: {
+            TRY(path, reader.read_path());
+            return req::StatPath{ .path = *path };
+        }
+
+        case Procedure::Lseek: {
+            TRY(fd, reader.read_int<u64>());
+            TRY(offset, reader.read_int<i64>());
+            TRY(whence, reader.read_int<u8>());
+            if (*whence > std::to_underlying(Seek::Hole)) {
+                return std::nullopt;
+            }
+            return req::Lseek{ .fd = *fd, .offset = static_cast<off_t>(*offset), .whence = Seek{ *whence } };
+        }
+
         case Procedure::Ping: {
             TRY(num, reader.read_int<u64>())
             return req::Ping{ .num = *num };
@@ -669,28 +782,8 @@ namespace
 
         switch (req.proc()) {
         case Procedure::Stat: {
-            TRY(size, reader.read_int<i64>());
-            TRY(links, reader.read_int<u64>());
-            TRY(mtime_sec, reader.read_int<i64>());
-            TRY(mtime_nsec, reader.read_int<i64>());
-            TRY(atime_sec, reader.read_int<i64>());
-            TRY(atime_nsec, reader.read_int<i64>());
-            TRY(ctime_sec, reader.read_int<i64>());
-            TRY(ctime_nsec, reader.read_int<i64>());
-            TRY(mode, reader.read_int<u32>());
-            TRY(uid, reader.read_int<u32>());
-            TRY(gid, reader.read_int<u32>());
-
-            return resp::Stat{
-                .size  = static_cast<off_t>(*size),
-                .links = static_cast<nlink_t>(*links),
-                .mtime = to_timespec(*mtime_sec, *mtime_nsec),
-                .atime = to_timespec(*atime_sec, *atime_nsec),
-                .ctime = to_timespec(*ctime_sec, *ctime_nsec),
-                .mode  = static_cast<mode_t>(*mode),
-                .uid   = static_cast<uid_t>(*uid),
-                .gid   = static_cast<uid_t>(*gid),
-            };
+            TRY(stat, reader.read_stat());
+            return *stat;
         }
 
         case Procedure::Listdir: {
@@ -704,17 +797,7 @@ namespace
 
             for (auto _ : sv::iota(0uz, *size)) {
                 TRY(path, reader.read_path());
-                TRY(size, reader.read_int<i64>());
-                TRY(links, reader.read_int<u64>());
-                TRY(mtime_sec, reader.read_int<i64>());
-                TRY(mtime_nsec, reader.read_int<i64>());
-                TRY(atime_sec, reader.read_int<i64>());
-                TRY(atime_nsec, reader.read_int<i64>());
-                TRY(ctime_sec, reader.read_int<i64>());
-                TRY(ctime_nsec, reader.read_int<i64>());
-                TRY(mode, reader.read_int<u32>());
-                TRY(uid, reader.read_int<u32>());
-                TRY(gid, reader.read_int<u32>());
+                TRY(stat, reader.read_stat());
 
                 auto path_u8 = reinterpret_cast<const u8*>(path->data());
                 auto off     = buf.size();
@@ -722,19 +805,7 @@ namespace
                 buf.insert(buf.end(), path_u8, path_u8 + path->size());
                 buf.push_back(0x00);
 
-                slices.emplace_back(
-                    util::Slice{ off, path->size() },
-                    resp::Stat{
-                        .size  = static_cast<off_t>(*size),
-                        .links = static_cast<nlink_t>(*links),
-                        .mtime = to_timespec(*mtime_sec, *mtime_nsec),
-                        .atime = to_timespec(*atime_sec, *atime_nsec),
-                        .ctime = to_timespec(*ctime_sec, *ctime_nsec),
-                        .mode  = static_cast<mode_t>(*mode),
-                        .uid   = static_cast<uid_t>(*uid),
-                        .gid   = static_cast<uid_t>(*gid),
-                    }
-                );
+                slices.emplace_back(util::Slice{ off, path->size() }, *stat);
             }
 
             auto entries = Vec<Pair<Str, resp::Stat>>{};
@@ -758,25 +829,50 @@ namespace
             return resp::Readlink{ .target = Str{ reinterpret_cast<const char*>(buf.data()), path->size() } };
         }
 
-        case Procedure::Mknod: return resp::Mknod{};
-        case Procedure::Mkdir: return resp::Mkdir{};
+        case Procedure::Mknod: {
+            TRY(stat, reader.read_opt_stat());
+            return resp::Mknod{ .stat = *stat };
+        }
+
+        case Procedure::Mkdir: {
+            TRY(stat, reader.read_opt_stat());
+            return resp::Mkdir{ .stat = *stat };
+        }
+
         case Procedure::Unlink: return resp::Unlink{};
         case Procedure::Rmdir: return resp::Rmdir{};
-        case Procedure::Rename: return resp::Rename{};
-        case Procedure::Truncate: return resp::Truncate{};
-        case Procedure::Utimens: return resp::Utimens{};
+
+        case Procedure::Rename: {
+            TRY(stat, reader.read_opt_stat());
+            return resp::Rename{ .stat = *stat };
+        }
+
+        case Procedure::Truncate: {
+            TRY(stat, reader.read_opt_stat());
+            return resp::Truncate{ .stat = *stat };
+        }
+
+        case Procedure::Utimens: {
+            TRY(stat, reader.read_opt_stat());
+            return resp::Utimens{ .stat = *stat };
+        }
 
         case Procedure::CopyFileRange: {
             TRY(size, reader.read_int<u64>());
-            return resp::CopyFileRange{ .size = static_cast<usize>(*size) };
+            TRY(stat, reader.read_opt_stat());
+            return resp::CopyFileRange{ .size = static_cast<usize>(*size), .stat = *stat };
         }
 
         case Procedure::Open: {
             TRY(fd, reader.read_int<u64>());
-            return resp::Open{ .fd = *fd };
+            TRY(stat, reader.read_stat());
+            return resp::Open{ .fd = *fd, .stat = *stat };
         }
 
-        case Procedure::Close: return resp::Close{};
+        case Procedure::Close: {
+            TRY(stat, reader.read_opt_stat());
+            return resp::Close{ .stat = *stat };
+        }
 
         case Procedure::Read: {
             TRY(bytes, reader.read_bytes());
@@ -793,6 +889,26 @@ namespace
             return resp::Write{ .size = static_cast<usize>(*size) };
         }
 
+        case Procedure::StatPath: {
+            TRY(count, reader.read_int<u64>());
+
+            auto stats = Vec<resp::Stat>{};
+            stats.reserve(*count);
+
+            for (auto _ : sv::iota(0uz, *count)) {
+                TRY(stat, reader.read_stat());
+                stats.push_back(*stat);
+            }
+
+            TRY(status, reader.read_status());
+            return resp::StatPath{ .stats = std::move(stats), .status = *status };
+        }
+
+        case Procedure::Lseek: {
+            TRY(offset, reader.read_int<i64>());
+            return resp::Lseek{ .offset = static_cast<off_t>(*offset) };
+        }
+
         case Procedure::Ping: {
             TRY(num, reader.read_int<u64>())
             return resp::Ping{ .num = *num };
@@ -825,6 +941,8 @@ namespace madbfs::rpc
         case Procedure::Read: return "Read";
         case Procedure::Write: return "Write";
         case Procedure::Ping: return "Ping";
+        case Procedure::StatPath: return "StatPath";
+        case Procedure::Lseek: return "Lseek";
         }
 
         return "Unknown";
@@ -868,9 +986,15 @@ namespace madbfs::rpc
         co_return Expect<void>{};
     }
 
-    AExpect<void> send_response(Socket& socket, Vec<u8>& buffer, FallibleResponse response, Id id)
+    AExpect<void> send_response(
+        Socket&          socket,
+        Vec<u8>&         buffer,
+        FallibleResponse response,
+        Id               id,
+        Timing           timing
+    )
     {
-        auto payload = build_response(buffer, response, id);
+        auto payload = build_response(buffer, response, id, timing);
         auto n       = co_await async::write_exact(socket, payload);
         HANDLE_ERROR(n, payload.size(), "failed to send response payload");
         co_return Expect<void>{};
@@ -916,7 +1040,18 @@ namespace madbfs::rpc
             co_return Unexpect{ Status::bad_message };
         }
 
-        co_return ResponseHeader{ .id = id, .proc = *proc, .status = status, .size = size };
+        auto timing = Timing{};
+        if (id.traced()) {
+            auto timing_bytes = Array<u8, sizeof(Timing::queue) + sizeof(Timing::exec)>{};
+            auto n1           = co_await async::read_exact<u8>(socket, timing_bytes);
+            HANDLE_ERROR(n1, timing_bytes.size(), "failed to read response timing");
+
+            auto timing_reader = PayloadReader{ timing_bytes };
+            timing.queue       = timing_reader.read_int<u32>().value();
+            timing.exec        = timing_reader.read_int<u32>().value();
+        }
+
+        co_return ResponseHeader{ .id = id, .proc = *proc, .status = status, .size = size, .timing = timing };
     }
 
     AExpect<Request> receive_request(Socket& socket, Vec<u8>& buffer, RequestHeader header)
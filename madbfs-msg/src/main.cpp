@@ -8,6 +8,7 @@
 #include <boost/program_options.hpp>
 #include <fmt/base.h>
 
+#include <array>
 #include <filesystem>
 #include <iostream>
 #include <regex>
@@ -232,6 +233,64 @@ std::optional<ipc::Op> parse_cmd(std::string_view cmd, std::span<const std::stri
     return ok ? std::optional<ipc::Op>{ std::make_from_tuple<T>(std::move(tuple)) } : std::nullopt;
 }
 
+/**
+ * @brief Make a host path absolute against the current directory of this process.
+ *
+ * The path is resolved by the server, whose working directory is not the same as this process.
+ */
+std::string absolute_host(const std::string& path)
+{
+    auto ec       = std::error_code{};
+    auto absolute = fs::absolute(path, ec);
+    return ec ? path : absolute.lexically_normal().string();
+}
+
+/**
+ * @brief Parse command with a host path argument (record_start), making the path absolute.
+ */
+template <typename T, std::size_t HostIdx, typename... Args>
+std::optional<ipc::Op> parse_host_path(std::string_view cmd, std::span<const std::string> args)
+{
+    auto copy = std::vector<std::string>{ args.begin(), args.end() };
+    if (HostIdx < copy.size()) {
+        copy[HostIdx] = absolute_host(copy[HostIdx]);
+    }
+    return parse_cmd<T, Args...>(cmd, copy);
+}
+
+/**
+ * @brief Parse pull or push command, making the host path absolute.
+ *
+ * The source and destination can be followed by `resume` to continue the files already partially copied.
+ */
+template <typename T, std::size_t HostIdx>
+std::optional<ipc::Op> parse_transfer(std::string_view cmd, std::span<const std::string> args)
+{
+    if (args.size() != 2 and args.size() != 3) {
+        fmt::println(stderr, "error: wrong number of argument on command '{}' (expects 2 or 3 args)", cmd);
+        return std::nullopt;
+    } else if (args.size() == 3 and args[2] != "resume") {
+        fmt::println(stderr, "error: unknown argument '{}' on command '{}' (expects 'resume')", args[2], cmd);
+        return std::nullopt;
+    }
+
+    auto copy = std::array{ args[0], args[1] };
+    copy[HostIdx] = absolute_host(copy[HostIdx]);
+
+    return ipc::Op{ T{ std::move(copy[0]), std::move(copy[1]), args.size() == 3 } };
+}
+
+/**
+ * @brief Parse cache_map command, the path is optional (every cached file if not given).
+ */
+std::optional<ipc::Op> parse_cache_map(std::string_view cmd, std::span<const std::string> args)
+{
+    if (args.empty()) {
+        return ipc::Op{ ipc::op::CacheMap{} };
+    }
+    return parse_cmd<ipc::op::CacheMap, std::string>(cmd, args);
+}
+
 std::optional<ipc::Op> parse_message(std::span<const std::string> message)
 {
     assert(not message.empty());
@@ -245,18 +304,32 @@ std::optional<ipc::Op> parse_message(std::span<const std::string> message)
 
     static const auto parsers = std::unordered_map<std::string_view, Parser*>{ {
         // clang-format off
-        { op::name::help,             parse_cmd<op::Help>                        },
-        { op::name::version,          parse_cmd<op::Version>                     },
-        { op::name::info,             parse_cmd<op::Info>                        },
-        { op::name::invalidate_cache, parse_cmd<op::InvalidateCache>             },
-        { op::name::expire_stat,      parse_cmd<op::ExpireStat>                  },
-        { op::name::set_page_size,    parse_cmd<op::SetPageSize, unsigned long>  },
-        { op::name::set_cache_size,   parse_cmd<op::SetCacheSize, unsigned long> },
-        { op::name::set_ttl,          parse_cmd<op::SetTTL, unsigned long>       },
-        { op::name::set_timeout,      parse_cmd<op::SetTimeout, unsigned long>   },
-        { op::name::set_log_level,    parse_cmd<op::SetLogLevel, std::string>    },
-        { op::name::logcat,           parse_cmd<op::Logcat>                      }, // let color unspecified
-        { op::name::unmount,          parse_cmd<op::Unmount>                     },
+        { op::name::help,             parse_cmd<op::Help>                                    },
+        { op::name::version,          parse_cmd<op::Version>                                 },
+        { op::name::info,             parse_cmd<op::Info>                                    },
+        { op::name::invalidate_cache, parse_cmd<op::InvalidateCache>                         },
+        { op::name::expire_stat,      parse_cmd<op::ExpireStat>                              },
+        { op::name::set_page_size,    parse_cmd<op::SetPageSize, unsigned long>              },
+        { op::name::set_cache_size,   parse_cmd<op::SetCacheSize, unsigned long>             },
+        { op::name::set_ttl,          parse_cmd<op::SetTTL, unsigned long>                   },
+        { op::name::set_ttl_policy,   parse_cmd<op::SetTTLPolicy, std::string>               },
+        { op::name::set_timeout,      parse_cmd<op::SetTimeout, unsigned long>               },
+        { op::name::set_weights,      parse_cmd<op::SetWeights, std::string>                 },
+        { op::name::set_log_level,    parse_cmd<op::SetLogLevel, std::string>                },
+        { op::name::logcat,           parse_cmd<op::Logcat>                                  }, // let color unspecified
+        { op::name::top,              parse_cmd<op::Top>                                     },
+        { op::name::pull,             parse_transfer<op::Pull, 1>                            },
+        { op::name::push,             parse_transfer<op::Push, 0>                            },
+        { op::name::jobs,             parse_cmd<op::Jobs>                                    },
+        { op::name::cancel,           parse_cmd<op::Cancel, unsigned long>                   },
+        { op::name::metrics,          parse_cmd<op::Metrics>                                 },
+        { op::name::set_trace_rate,   parse_cmd<op::SetTraceRate, unsigned long>             },
+        { op::name::trace,            parse_cmd<op::Trace>                                   },
+        { op::name::record_start,     parse_host_path<op::RecordStart, 0, std::string>       },
+        { op::name::record_stop,      parse_cmd<op::RecordStop>                              },
+        { op::name::cache_map,        parse_cache_map                                        },
+        { op::name::lag,              parse_cmd<op::Lag>                                     },
+        { op::name::unmount,          parse_cmd<op::Unmount>                                 },
         // clang-format on
     } };
 
@@ -325,6 +398,92 @@ void pretty_print(json::value const& json, std::string* indent = nullptr)
     }
 }
 
+/**
+ * @brief Format a number of bytes using binary units.
+ */
+std::string human_bytes(double bytes)
+{
+    constexpr auto units = std::array{ "B", "KiB", "MiB", "GiB" };
+
+    auto unit = 0uz;
+    while (bytes >= 1024.0 and unit + 1 < units.size()) {
+        bytes /= 1024.0;
+        ++unit;
+    }
+    return fmt::format("{:.1f} {}", bytes, units[unit]);
+}
+
+/**
+ * @brief Print a frame of `top` operation.
+ *
+ * @param frame The frame.
+ * @param clear Whether to clear the screen first (on terminal).
+ */
+void print_top_frame(const json::value& frame, bool clear)
+{
+    const auto& obj = frame.as_object();
+
+    auto number = [](const json::value& value) {
+        return value.is_null() ? 0.0 : json::value_to<double>(value);    //
+    };
+
+    if (clear) {
+        fmt::print("\033[H\033[2J");
+    }
+
+    const auto& transport = obj.at("transport").as_object();
+    fmt::println(
+        "transport : {} inflight | {:.1f} req/s | sent {}/s | received {}/s | {} reconnects",
+        json::value_to<std::uint64_t>(transport.at("inflight")),
+        number(transport.at("requests")),
+        human_bytes(number(transport.at("sent"))),
+        human_bytes(number(transport.at("received"))),
+        json::value_to<std::uint64_t>(transport.at("reconnects"))
+    );
+
+    fmt::println(
+        "fuse      : read {}/s | write {}/s",
+        human_bytes(number(obj.at("read"))),
+        human_bytes(number(obj.at("write")))
+    );
+
+    if (const auto& cache = obj.at("cache"); cache.is_null()) {
+        fmt::println("cache     : disabled");
+    } else {
+        const auto& hit_rate = cache.at("hit_rate");
+        fmt::println(
+            "cache     : hit rate {} | {:.1f} hits/s | {:.1f} misses/s | {}/{} pages",
+            hit_rate.is_null() ? "-" : fmt::format("{:.1f}%", number(hit_rate) * 100),
+            number(cache.at("hits")),
+            number(cache.at("misses")),
+            json::value_to<std::uint64_t>(cache.at("pages")),
+            json::value_to<std::uint64_t>(cache.at("max_pages"))
+        );
+    }
+
+    fmt::println("\n{:<20} {:>10}", "OPERATION", "OPS/S");
+    for (const auto& [op, rate] : obj.at("ops").as_object()) {
+        fmt::println("{:<20} {:>10.1f}", std::string_view{ op }, number(rate));
+    }
+
+    fmt::println("\n{:<20} {:>10}", "PROCESS", "OPS/S");
+    for (const auto& entry : obj.at("processes").as_array()) {
+        auto name = json::value_to<std::string>(entry.at("name"));
+        fmt::println("{:<20} {:>10.1f}", name, number(entry.at("ops")));
+    }
+
+    fmt::println("\n{:<64} {:>14}", "PATH", "BYTES/S");
+    for (const auto& entry : obj.at("paths").as_array()) {
+        auto path = json::value_to<std::string>(entry.at("path"));
+        if (path.size() > 64) {
+            path = "..." + path.substr(path.size() - 61);
+        }
+        fmt::println("{:<64} {:>12}/s", path, human_bytes(number(entry.at("bytes"))));
+    }
+
+    std::fflush(stdout);
+}
+
 std::vector<Socket> get_socket_list(fs::path search_path)
 {
     auto sockets = std::vector<Socket>{};
@@ -390,13 +549,19 @@ int send_message(std::span<const std::string> message, fs::path socket_path, boo
 
     auto coro = op->visit(madbfs::Overload{
         [&](this auto, ipc::FsOp op) -> madbfs::Await<int> {
-            auto response = co_await client->send(op);
+            auto is_trace = op.holds<ipc::op::Trace>();
+            auto response = co_await client->send(std::move(op));
             if (not response) {
                 fmt::println(stderr, "error: failed to send message: {}", madbfs::err_msg(response.error()));
                 co_return 1;
             }
 
-            pretty_print(*response);
+            // trace is meant to be loaded by other tools, print it as is
+            if (is_trace) {
+                fmt::println("{}", json::serialize(*response));
+            } else {
+                pretty_print(*response);
+            }
 
             sig_set.cancel();
             co_return 0;
@@ -445,6 +610,36 @@ int send_message(std::span<const std::string> message, fs::path socket_path, boo
 
             fmt::println("{:-^80}", "[ LOGCAT END ]");
 
+            sig_set.cancel();
+            co_return 0;
+        },
+        [&](this auto, ipc::op::Top) -> madbfs::Await<int> {
+            auto response = co_await client->top();
+            if (not response) {
+                fmt::println(stderr, "error: failed to send message: {}", madbfs::err_msg(response.error()));
+                co_return 1;
+            }
+
+            auto clear = ::isatty(::fileno(stdout)) != 0;
+
+            for (auto awaitable : *response) {
+                auto message = co_await std::move(awaitable);
+                if (not message) {
+                    break;
+                }
+
+                try {
+                    print_top_frame(json::parse(*message), clear);
+                } catch (const std::exception& e) {
+                    fmt::println(stderr, "error: invalid frame: {}", e.what());
+                    break;
+                }
+
+                if (not clear) {
+                    fmt::println("{:-^80}", "");
+                }
+            }
+
             sig_set.cancel();
             co_return 0;
         },
@@ -0,0 +1,534 @@
+#include <madbfs/connection.hpp>
+#include <madbfs/filesystem.hpp>
+#include <madbfs/metrics.hpp>
+#include <madbfs/workload.hpp>
+
+#include <madbfs-common/log.hpp>
+
+#include <madbfs-gen/version.hpp>
+
+#include <boost/program_options.hpp>
+#include <fmt/base.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <thread>
+
+namespace po       = boost::program_options;
+namespace async    = madbfs::async;
+namespace metrics  = madbfs::metrics;
+namespace workload = madbfs::workload;
+
+using namespace madbfs::aliases;
+
+enum Timing
+{
+    Original,
+    Fast,
+};
+
+struct Exit
+{
+    int ret;
+};
+
+struct Args
+{
+    std::string file;
+    std::string mount;         // replay through the mount if not empty
+    std::string root;          // device root for direct replay
+    std::string log_level;
+    u16         port;          // proxy transport to a running server if not 0, else adb transport
+    usize       cache_size;    // in MiB, 0 disables the cache
+    usize       page_size;     // in KiB
+    usize       ttl;           // in seconds
+    Timing      timing;
+};
+
+std::istream& operator>>(std::istream& in, Timing& t)
+{
+    auto string = std::string{};
+    in >> string;
+
+    // clang-format off
+    if      (string == "original") { t = Timing::Original;           }
+    else if (string == "fast"    ) { t = Timing::Fast;               }
+    else                           { in.setstate(std::ios::failbit); }
+    // clang-format on
+
+    return in;
+}
+
+std::variant<Exit, Args> parse_args(int argc, char** argv)
+{
+    auto args = Args{};
+
+    auto desc = po::options_description{ "options" };
+    desc.add_options()                    //
+        ("help,h", "print help")          //
+        ("version,v", "print version")    //
+        ("mount,m",
+         po::value<std::string>(&args.mount)->value_name("dir"),
+         "replay through a mounted madbfs at dir")    //
+        ("direct,d",
+         "replay directly against the filesystem layer, connecting to the device in 'ANDROID_SERIAL'")    //
+        ("timing,t",
+         po::value<Timing>(&args.timing)->default_value(Timing::Original, "original")->value_name("when"),
+         "issue the operations at their original time or as fast as possible when=[original, fast]")    //
+        ("root",
+         po::value<std::string>(&args.root)->default_value("/")->value_name("path"),
+         "root path on the device (direct only)")    //
+        ("port",
+         po::value<u16>(&args.port)->default_value(0)->value_name("port"),
+         "use the proxy transport to an already running server on port, else adb (direct only)")    //
+        ("cache-size",
+         po::value<usize>(&args.cache_size)->default_value(256)->value_name("MiB"),
+         "cache size, 0 to disable the cache (direct only)")    //
+        ("page-size",
+         po::value<usize>(&args.page_size)->default_value(128)->value_name("KiB"),
+         "page size of the cache (direct only)")    //
+        ("ttl",
+         po::value<usize>(&args.ttl)->default_value(60)->value_name("sec"),
+         "TTL of the stat cache, 0 to disable (direct only)")    //
+        ("log-level",
+         po::value<std::string>(&args.log_level)->default_value("error")->value_name("level"),
+         "log level of the filesystem layer (direct only)")    //
+        ("workload",
+         po::value<std::string>(&args.file)->value_name("file"),
+         "the workload file recorded with 'madbfs-msg record_start' (positional)");
+
+    auto pos = po::positional_options_description{};
+    pos.add("workload", 1);
+
+    auto print_help = [&](bool err) {
+        auto out = err ? stderr : stdout;
+        fmt::println(out, "madbfs-replay: replay a recorded workload and report its latencies");
+        fmt::println(out, "usage: [options] (--mount <dir> | --direct) <workload>");
+        std::cerr << '\n' << desc << '\n';
+        return Exit{ err ? 1 : 0 };
+    };
+
+    if (argc == 1) {
+        return print_help(true);
+    }
+
+    auto vm = po::variables_map{};
+    try {
+        po::store(po::command_line_parser{ argc, argv }.options(desc).positional(pos).run(), vm);
+        po::notify(vm);
+    } catch (const std::exception& e) {
+        fmt::println(stderr, "{}", e.what());
+        return Exit{ 2 };
+    }
+
+    if (vm.count("help")) {
+        return print_help(false);
+    }
+
+    if (vm.count("version")) {
+        fmt::println(stdout, "{}", MADBFS_VERSION_FULL);
+        return Exit{ 0 };
+    }
+
+    if (args.file.empty()) {
+        fmt::println(stderr, "error: no workload file is specified");
+        return Exit{ 1 };
+    } else if (args.mount.empty() == (vm.count("direct") == 0)) {
+        fmt::println(stderr, "error: specify either '--mount' or '--direct'");
+        return Exit{ 1 };
+    }
+
+    return args;
+}
+
+/**
+ * @class Target
+ *
+ * @brief Where the operations are replayed to.
+ */
+class Target
+{
+public:
+    virtual ~Target() = default;
+
+    /**
+     * @brief Issue an operation.
+     *
+     * @param entry The recorded operation.
+     * @param path Path of the operation (raw from FUSE).
+     * @param path2 Second path of the operation.
+     * @param fh Handle to be used in place of the recorded one.
+     * @param fh2 Second handle to be used in place of the recorded one.
+     *
+     * @return Returned value (negative errno on failure) or `std::nullopt` if it can't be replayed.
+     */
+    virtual Opt<i64> issue(const workload::Entry& entry, Str path, Str path2, u64 fh, u64 fh2) = 0;
+};
+
+/**
+ * @class MountTarget
+ *
+ * @brief Replay through a mounted filesystem using syscalls.
+ *
+ * Flush is not issued separately since it's part of close, and only listings from the start of the directory
+ * are replayed (the continuations are issued by the kernel).
+ */
+class MountTarget final : public Target
+{
+public:
+    MountTarget(Str mount)
+        : m_mount{ mount }
+    {
+    }
+
+    Opt<i64> issue(const workload::Entry& e, Str path, Str path2, u64 fh, u64 fh2) override
+    {
+        thread_local auto buf = Vec<char>{};
+
+        auto full  = m_mount + String{ path };
+        auto full2 = m_mount + String{ path2 };
+        auto fd    = static_cast<int>(fh);
+        auto fd2   = static_cast<int>(fh2);
+
+        auto ret = [](i64 res) { return res < 0 ? -static_cast<i64>(errno) : res; };
+
+        switch (e.op) {
+        case metrics::FuseOp::Getattr: {
+            struct stat st;
+            return ret(::lstat(full.c_str(), &st));
+        }
+        case metrics::FuseOp::Readlink: {
+            buf.resize(PATH_MAX);
+            return ret(::readlink(full.c_str(), buf.data(), buf.size()));
+        }
+        case metrics::FuseOp::Mknod: return ret(::mknod(full.c_str(), e.mode, 0));
+        case metrics::FuseOp::Mkdir: return ret(::mkdir(full.c_str(), e.mode));
+        case metrics::FuseOp::Unlink: return ret(::unlink(full.c_str()));
+        case metrics::FuseOp::Rmdir: return ret(::rmdir(full.c_str()));
+        case metrics::FuseOp::Rename:
+            return ret(::renameat2(AT_FDCWD, full.c_str(), AT_FDCWD, full2.c_str(), e.flags));
+        case metrics::FuseOp::Truncate: return ret(::truncate(full.c_str(), e.offset));
+        case metrics::FuseOp::Open: return ret(::open(full.c_str(), static_cast<int>(e.flags)));
+        case metrics::FuseOp::Create:
+            return ret(::open(full.c_str(), static_cast<int>(e.flags) | O_CREAT, e.mode));
+        case metrics::FuseOp::Read: {
+            buf.resize(std::max(buf.size(), e.size));
+            return ret(::pread(fd, buf.data(), e.size, e.offset));
+        }
+        case metrics::FuseOp::Write: {
+            buf.resize(std::max(buf.size(), e.size), 'x');
+            return ret(::pwrite(fd, buf.data(), e.size, e.offset));
+        }
+        case metrics::FuseOp::Flush: return std::nullopt;
+        case metrics::FuseOp::Release: return ret(::close(fd));
+        case metrics::FuseOp::Readdir: {
+            if (e.offset != 0) {
+                return std::nullopt;
+            }
+            auto* dir = ::opendir(full.c_str());
+            if (dir == nullptr) {
+                return -static_cast<i64>(errno);
+            }
+            while (::readdir(dir) != nullptr) { }
+            ::closedir(dir);
+            return 0;
+        }
+        case metrics::FuseOp::Utimens:
+            return ret(::utimensat(AT_FDCWD, full.c_str(), nullptr, AT_SYMLINK_NOFOLLOW));
+        case metrics::FuseOp::Lseek: return ret(::lseek(fd, e.offset, static_cast<int>(e.flags)));
+        case metrics::FuseOp::CopyFileRange: {
+            auto off  = static_cast<off_t>(e.offset);
+            auto off2 = static_cast<off_t>(e.offset2);
+            return ret(::copy_file_range(fd, &off, fd2, &off2, e.size, 0));
+        }
+        }
+
+        return std::nullopt;
+    }
+
+private:
+    String m_mount;
+};
+
+/**
+ * @class DirectTarget
+ *
+ * @brief Replay directly against `Filesystem`, bypassing FUSE and the kernel caches.
+ */
+class DirectTarget final : public Target
+{
+public:
+    DirectTarget(async::Context& ctx, madbfs::Filesystem& fs, Str root)
+        : m_ctx{ ctx }
+        , m_fs{ fs }
+        , m_root{ root == "/" ? "" : root }
+    {
+    }
+
+    Opt<i64> issue(const workload::Entry& e, Str path, Str path2, u64 fh, u64 fh2) override
+    {
+        auto p  = m_root + String{ path.empty() ? "/" : path };
+        auto p2 = m_root + String{ path2.empty() ? "/" : path2 };
+        return workload::issue(m_ctx, m_fs, e, p, p2, fh, fh2);
+    }
+
+private:
+    async::Context&     m_ctx;
+    madbfs::Filesystem& m_fs;
+    String              m_root;
+};
+
+/**
+ * @class Replay
+ *
+ * @brief Replay a workload, the operations of each process are issued in order from a thread of its own.
+ *
+ * Handles are mapped from the recorded ones to the ones returned by the target on open/create. Operations on
+ * a handle opened before the recording started are skipped.
+ */
+class Replay
+{
+public:
+    using Histograms = Array<metrics::Histogram, metrics::fuse_op_count>;
+
+    struct Counts
+    {
+        std::atomic<u64> issued   = 0;
+        std::atomic<u64> skipped  = 0;
+        std::atomic<u64> diverged = 0;    // succeeded when recorded but failed on replay or vice versa
+    };
+
+    Replay(const workload::Workload& workload, Target& target)
+        : m_workload{ workload }
+        , m_target{ target }
+    {
+    }
+
+    /**
+     * @brief Run the replay until every operation is issued.
+     *
+     * @param timing Issue the operations at their original time or as fast as possible.
+     *
+     * @return Time taken to replay the workload.
+     */
+    SteadyClock::duration run(Timing timing)
+    {
+        auto per_pid = std::unordered_map<u32, Vec<const workload::Entry*>>{};
+        for (const auto& entry : m_workload.entries) {
+            per_pid[entry.pid].push_back(&entry);
+        }
+
+        auto start   = SteadyClock::now();
+        auto workers = Vec<std::jthread>{};
+
+        for (auto& [_, entries] : per_pid) {
+            sr::stable_sort(entries, {}, [](const workload::Entry* entry) { return entry->start; });
+            workers.emplace_back([&, start] {
+                for (const auto* entry : entries) {
+                    if (timing == Timing::Original) {
+                        std::this_thread::sleep_until(start + std::chrono::microseconds{ entry->start });
+                    }
+                    issue(*entry);
+                }
+            });
+        }
+        workers.clear();
+
+        return SteadyClock::now() - start;
+    }
+
+    const Histograms& replayed() const { return *m_replayed; }
+    const Counts&     counts() const { return m_counts; }
+
+private:
+    void issue(const workload::Entry& entry)
+    {
+        auto handles = m_handles.map(entry);
+        if (not handles) {
+            ++m_counts.skipped;
+            return;
+        }
+
+        auto [fh, fh2]    = *handles;
+        const auto& paths = m_workload.paths;
+
+        auto start  = SteadyClock::now();
+        auto result = m_target.issue(entry, paths[entry.path], paths[entry.path2], fh, fh2);
+        if (not result) {
+            ++m_counts.skipped;
+            return;
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - start);
+        (*m_replayed)[static_cast<usize>(entry.op)].record(static_cast<u64>(elapsed.count()), *result < 0);
+
+        ++m_counts.issued;
+        if ((*result >= 0) != (entry.result >= 0)) {
+            ++m_counts.diverged;
+        }
+
+        m_handles.update(entry, *result);
+    }
+
+    const workload::Workload& m_workload;
+    Target&                   m_target;
+
+    workload::Handles m_handles;
+
+    Uniq<Histograms> m_replayed = std::make_unique<Histograms>();
+    Counts           m_counts;
+};
+
+void print_report(const workload::Workload& workload, const Replay& replay, SteadyClock::duration elapsed)
+{
+    auto recorded = std::make_unique<Replay::Histograms>();
+    for (const auto& entry : workload.entries) {
+        (*recorded)[static_cast<usize>(entry.op)].record(entry.duration, entry.result < 0);
+    }
+
+    const auto& counts  = replay.counts();
+    auto        seconds = std::chrono::duration<double>{ elapsed }.count();
+
+    fmt::println(
+        "replayed {} of {} operations in {:.3f}s ({} skipped, {} diverged from the recording)",
+        counts.issued.load(),
+        workload.entries.size(),
+        seconds,
+        counts.skipped.load(),
+        counts.diverged.load()
+    );
+    fmt::println("");
+    fmt::println(
+        "{:<16} {:>8} {:>7} {:>9} {:>9} {:>9} {:>9} | {:>9} {:>9}",
+        "op (us)",
+        "count",
+        "errors",
+        "p50",
+        "p90",
+        "p99",
+        "max",
+        "rec p50",
+        "rec p99"
+    );
+
+    for (auto i : sv::iota(0uz, metrics::fuse_op_count)) {
+        auto summary = replay.replayed()[i].summary();
+        auto rec     = (*recorded)[i].summary();
+        if (summary.count == 0 and rec.count == 0) {
+            continue;
+        }
+
+        fmt::println(
+            "{:<16} {:>8} {:>7} {:>9} {:>9} {:>9} {:>9} | {:>9} {:>9}",
+            metrics::to_string(static_cast<metrics::FuseOp>(i)),
+            summary.count,
+            summary.errors,
+            summary.p50,
+            summary.p90,
+            summary.p99,
+            summary.max,
+            rec.p50,
+            rec.p99
+        );
+    }
+}
+
+int replay_direct(const workload::Workload& workload, const Args& args)
+{
+    if (std::getenv("ANDROID_SERIAL") == nullptr) {
+        fmt::println(stderr, "error: 'ANDROID_SERIAL' must be set for direct replay");
+        return 1;
+    }
+
+    auto level = madbfs::log::level_from_str(args.log_level);
+    if (not level) {
+        fmt::println(stderr, "error: '{}' is not a valid log level", args.log_level);
+        return 1;
+    }
+    madbfs::log::init(*level, "-");
+    madbfs::log::start_async();
+
+    auto ctx    = async::Context{};
+    auto guard  = async::WorkGuard{ ctx.get_executor() };
+    auto thread = std::jthread{ [&] { ctx.run(); } };
+
+    namespace strat = madbfs::connection_strategy;
+
+    auto strategy = args.port == 0 ? madbfs::ConnectionStrategy{ strat::Adb{} }
+                                   : madbfs::ConnectionStrategy{ strat::Proxy{ std::nullopt, args.port } };
+
+    auto caching = Opt<madbfs::Caching>{};
+    if (args.cache_size > 0) {
+        caching = madbfs::Caching::of_size(args.page_size, args.cache_size);
+    }
+
+    auto ttl        = args.ttl == 0 ? std::nullopt : Opt<Seconds>{ args.ttl };
+    auto connection = madbfs::Connection{ ctx, strategy };
+    auto fs         = madbfs::Filesystem{ connection, caching, ttl };
+
+    async::spawn(ctx, connection.start(), [](std::exception_ptr e) {
+        madbfs::log::log_exception(e, "madbfs-replay");
+    });
+
+    auto ret = 0;
+    if (auto res = async::block(ctx, fs.initialize_root()); not res) {
+        fmt::println(stderr, "error: failed to initialize root: {}", madbfs::err_msg(res.error()));
+        ret = 1;
+    } else {
+        fmt::println("replaying {} directly with {} transport", args.file, connection.name());
+
+        auto target  = DirectTarget{ ctx, fs, args.root };
+        auto replay  = Replay{ workload, target };
+        auto elapsed = replay.run(args.timing);
+        print_report(workload, replay, elapsed);
+    }
+
+    async::block(ctx, fs.shutdown());
+    connection.cancel(Errc::operation_canceled);
+
+    guard.reset();
+    ctx.stop();
+    thread.join();
+
+    madbfs::log::shutdown();
+    return ret;
+}
+
+int replay_mount(const workload::Workload& workload, const Args& args)
+{
+    fmt::println("replaying {} through {}", args.file, args.mount);
+
+    auto target  = MountTarget{ args.mount };
+    auto replay  = Replay{ workload, target };
+    auto elapsed = replay.run(args.timing);
+    print_report(workload, replay, elapsed);
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+try {
+    auto parsed = parse_args(argc, argv);
+    if (parsed.index() == 0) {
+        return std::get<0>(parsed).ret;
+    }
+
+    auto args     = std::get<1>(parsed);
+    auto workload = workload::load(args.file);
+    if (not workload) {
+        fmt::println(stderr, "error: failed to load '{}': {}", args.file, madbfs::err_msg(workload.error()));
+        return 1;
+    }
+
+    return args.mount.empty() ? replay_direct(*workload, args) : replay_mount(*workload, args);
+} catch (const std::exception& e) {
+    fmt::println(stderr, "error: exception occurred: {}", e.what());
+    return 1;
+} catch (...) {
+    fmt::println(stderr, "error: exception occurred (unknown exception)");
+    return 1;
+}
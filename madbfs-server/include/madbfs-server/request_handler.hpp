@@ -26,6 +26,8 @@ namespace madbfs::server
         rpc::FallibleResponse handle_req(rpc::req::Close req);
         rpc::FallibleResponse handle_req(rpc::req::Read req);
         rpc::FallibleResponse handle_req(rpc::req::Write req);
+        rpc::FallibleResponse handle_req(rpc::req::StatPath req);
+        rpc::FallibleResponse handle_req(rpc::req::Lseek req);
         rpc::FallibleResponse handle_req(rpc::req::Ping req);
 
     private:
@@ -43,14 +43,27 @@ namespace madbfs::server
     private:
         struct Promise
         {
-            Vec<u8>        buf;
-            rpc::Procedure proc;
+            Vec<u8>                 buf;
+            rpc::Procedure          proc;
+            SteadyClock::time_point received;
+        };
+
+        struct Handled
+        {
+            rpc::FallibleResponse response;
+            rpc::Timing           timing;
         };
 
         using Inflight = std::unordered_map<rpc::Id, Promise, rpc::Id::Hash>;
-        using Channel  = async::Channel<Tup<rpc::Id, rpc::FallibleResponse>>;
+        using Channel  = async::Channel<Tup<rpc::Id, Handled>>;
 
-        Await<rpc::FallibleResponse> handle_request(rpc::Request req);
+        /**
+         * @brief Handle a request and measure its timing.
+         *
+         * @param req The request.
+         * @param received Time the request header is received.
+         */
+        Await<Handled> handle_request(rpc::Request req, SteadyClock::time_point received);
 
         AExpect<void> send_response();
 
@@ -71,6 +71,7 @@ try {
 
     auto args = std::get<1>(parsed);
     madbfs::log::init(args.log_level, "-");
+    madbfs::log::start_async();
 
     auto context = madbfs::async::Context{};
     auto server  = madbfs::server::Server{ context, args.port };    // may throw
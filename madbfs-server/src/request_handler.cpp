@@ -46,6 +46,44 @@ namespace
         log::log_loc_named(loc, Level::err, name, "{} [{:}]: {}", msg, ident, strerror(err));
         return static_cast<rpc::Status>(err);
     }
+
+    /**
+     * @brief Convert `struct stat` into its RPC representation.
+     */
+    rpc::resp::Stat to_rpc_stat(const struct stat& filestat)
+    {
+        return {
+            .size  = static_cast<off_t>(filestat.st_size),
+            .links = static_cast<nlink_t>(filestat.st_nlink),
+            .mtime = filestat.st_mtim,
+            .atime = filestat.st_atim,
+            .ctime = filestat.st_ctim,
+            .mode  = static_cast<mode_t>(filestat.st_mode),
+            .uid   = filestat.st_uid,
+            .gid   = filestat.st_gid,
+        };
+    }
+
+    /**
+     * @brief Get the stat of a file after it is modified, without following symlink.
+     *
+     * @param name Log name.
+     * @param path Path to the file (must be null terminated).
+     *
+     * @return The stat or `std::nullopt` if it can't be taken.
+     *
+     * The modification already happened at this point, so failing to stat is not an error of the operation.
+     * The client falls back to a separate stat instead.
+     */
+    Opt<rpc::resp::Stat> stat_after(const char* name, Str path)
+    {
+        struct stat filestat = {};
+        if (::lstat(path.data(), &filestat) < 0) {
+            std::ignore = errno_status(name, path, "failed to stat file after modification");
+            return std::nullopt;
+        }
+        return to_rpc_stat(filestat);
+    }
 }
 
 namespace madbfs::server
@@ -90,18 +128,7 @@ namespace madbfs::server
             buf.insert(buf.end(), name_u8, name_u8 + name.size());
 
             auto slice = util::Slice{ off, name.size() };
-            auto stat  = rpc::resp::Stat{
-                 .size  = static_cast<off_t>(filestat.st_size),
-                 .links = static_cast<nlink_t>(filestat.st_nlink),
-                 .mtime = filestat.st_mtim,
-                 .atime = filestat.st_atim,
-                 .ctime = filestat.st_ctim,
-                 .mode  = static_cast<mode_t>(filestat.st_mode),
-                 .uid   = filestat.st_uid,
-                 .gid   = filestat.st_gid,
-            };
-
-            slices.emplace_back(std::move(slice), std::move(stat));
+            slices.emplace_back(std::move(slice), to_rpc_stat(filestat));
         }
 
         auto entries = Vec<Pair<Str, rpc::resp::Stat>>{};
@@ -125,16 +152,7 @@ namespace madbfs::server
             return failed(req, errno_status(__func__, path, "failed to stat file"));
         }
 
-        return rpc::resp::Stat{
-            .size  = static_cast<off_t>(filestat.st_size),
-            .links = static_cast<nlink_t>(filestat.st_nlink),
-            .mtime = filestat.st_mtim,
-            .atime = filestat.st_atim,
-            .ctime = filestat.st_ctim,
-            .mode  = static_cast<mode_t>(filestat.st_mode),
-            .uid   = filestat.st_uid,
-            .gid   = filestat.st_gid,
-        };
+        return to_rpc_stat(filestat);
     }
 
     rpc::FallibleResponse RequestHandler::handle_req(rpc::req::Readlink req)
@@ -166,7 +184,7 @@ namespace madbfs::server
             return failed(req, errno_status(__func__, path, "failed to create file"));
         }
 
-        return rpc::resp::Mknod{};
+        return rpc::resp::Mknod{ .stat = stat_after(__func__, path) };
     }
 
     rpc::FallibleResponse RequestHandler::handle_req(rpc::req::Mkdir req)
@@ -178,7 +196,7 @@ namespace madbfs::server
             return failed(req, errno_status(__func__, path, "failed to create directory"));
         }
 
-        return rpc::resp::Mkdir{};
+        return rpc::resp::Mkdir{ .stat = stat_after(__func__, path) };
     }
 
     rpc::FallibleResponse RequestHandler::handle_req(rpc::req::Unlink req)
@@ -213,6 +231,10 @@ namespace madbfs::server
         // paths are guaranteed to be absolute for both from and to, so the fds are not required since they
         // will be ignored. see man rename(2).
 
+        auto renamed = [&]() -> rpc::FallibleResponse {
+            return rpc::resp::Rename{ .stat = stat_after(__func__, to) };
+        };
+
         // NOTE: renameat2 is only available from API level 30
         if (m_renameat2_impl) {
             auto res = syscall(SYS_renameat2, 0, from.data(), 0, to.data(), flags);
@@ -222,7 +244,7 @@ namespace madbfs::server
             } else if (res < 0) {
                 return failed(req, errno_status(__func__, from, "failed to rename file"));
             } else {
-                return rpc::resp::Rename{};
+                return renamed();
             }
         }
 
@@ -235,7 +257,7 @@ namespace madbfs::server
             return failed(req, errno_status(__func__, from, "failed to rename file"));
         }
 
-        return rpc::resp::Rename{};
+        return renamed();
     }
 
     rpc::FallibleResponse RequestHandler::handle_req(rpc::req::Truncate req)
@@ -247,7 +269,7 @@ namespace madbfs::server
             return failed(req, errno_status(__func__, path, "failed to truncate file"));
         }
 
-        return rpc::resp::Truncate{};
+        return rpc::resp::Truncate{ .stat = stat_after(__func__, path) };
     }
 
     rpc::FallibleResponse RequestHandler::handle_req(rpc::req::Utimens req)
@@ -262,7 +284,7 @@ namespace madbfs::server
             return failed(req, errno_status(__func__, path, "failed to utimens file"));
         }
 
-        return rpc::resp::Utimens{};
+        return rpc::resp::Utimens{ .stat = stat_after(__func__, path) };
     }
 
     rpc::FallibleResponse RequestHandler::handle_req(rpc::req::CopyFileRange req)
@@ -298,6 +320,15 @@ namespace madbfs::server
             return failed(req, errno_status(__func__, out, "failed to seek file"));
         }
 
+        auto copied_as = [&](usize copied) -> rpc::FallibleResponse {
+            struct stat filestat = {};
+            if (::fstat(out_fd, &filestat) < 0) {
+                std::ignore = errno_status(__func__, out, "failed to stat file after copy");
+                return rpc::resp::CopyFileRange{ .size = copied, .stat = std::nullopt };
+            }
+            return rpc::resp::CopyFileRange{ .size = copied, .stat = to_rpc_stat(filestat) };
+        };
+
         // NOTE: copy_file_range syscall only available from API level 34
         if (m_copy_file_range_impl) {
             auto in_off_  = in_off;     // must be mutable
@@ -305,7 +336,7 @@ namespace madbfs::server
 
             auto res = syscall(SYS_copy_file_range, in_fd, &in_off_, out_fd, &out_off_, size, 0);
             if (res >= 0) {
-                return rpc::resp::CopyFileRange{ .size = static_cast<usize>(res) };
+                return copied_as(static_cast<usize>(res));
             }
 
             if (res < 0 and errno == ENOSYS) {
@@ -355,20 +386,37 @@ namespace madbfs::server
             return failed(req, errno_status(__func__, out, "failed to copy file"));
         }
 
-        return rpc::resp::CopyFileRange{ .size = static_cast<usize>(copied) };
+        return copied_as(copied);
     }
 
     rpc::FallibleResponse RequestHandler::handle_req(rpc::req::Open req)
     {
-        const auto& [path, mode] = req;
-        log_d("open", "path={:?} mode={}", path.data(), static_cast<int>(mode));
+        const auto& [path, mode, flags, perm] = req;
+        log_d("open", "path={:?} mode={} flags={:#x}", path.data(), static_cast<int>(mode), flags);
+
+        auto oflags = static_cast<int>(mode);
+        oflags     |= (flags & rpc::open_flag::create) ? O_CREAT : 0;
+        oflags     |= (flags & rpc::open_flag::truncate) ? O_TRUNC : 0;
+        oflags     |= (flags & rpc::open_flag::exclusive) ? O_EXCL : 0;
 
-        auto fd = ::open(path.data(), static_cast<int>(req.mode));
+        auto fd = ::open(path.data(), oflags, perm);
         if (fd < 0) {
             return failed(req, errno_status(__func__, path, "failed to open file"));
         }
 
-        return rpc::resp::Open{ .fd = static_cast<u64>(fd) };
+        // the stat is only needed by the client when the file might be created or truncated
+        if (flags == 0) {
+            return rpc::resp::Open{ .fd = static_cast<u64>(fd), .stat = {} };
+        }
+
+        struct stat filestat = {};
+        if (auto res = ::fstat(fd, &filestat); res < 0) {
+            auto status = errno_status(__func__, path, "failed to stat opened file");
+            ::close(fd);
+            return failed(req, status);
+        }
+
+        return rpc::resp::Open{ .fd = static_cast<u64>(fd), .stat = to_rpc_stat(filestat) };
     }
 
     rpc::FallibleResponse RequestHandler::handle_req(rpc::req::Close req)
@@ -376,11 +424,18 @@ namespace madbfs::server
         const auto& [fd] = req;
         log_d("close", "fd={}", fd);
 
+        // stat is taken before close so it reflects the final state of the file, failure is not fatal
+        auto        stat     = Opt<rpc::resp::Stat>{};
+        struct stat filestat = {};
+        if (::fstat(static_cast<int>(fd), &filestat) == 0) {
+            stat = to_rpc_stat(filestat);
+        }
+
         if (::close(static_cast<int>(fd)) < 0) {
             return failed(req, errno_status(__func__, fd, "failed to close file"));
         }
 
-        return rpc::resp::Close{};
+        return rpc::resp::Close{ .stat = stat };
     }
 
     rpc::FallibleResponse RequestHandler::handle_req(rpc::req::Read req)
@@ -421,6 +476,52 @@ namespace madbfs::server
         return rpc::resp::Write{ .size = static_cast<usize>(len) };
     }
 
+    rpc::FallibleResponse RequestHandler::handle_req(rpc::req::StatPath req)
+    {
+        const auto& [path] = req;
+        log_d("statpath", "path={:?}", path.data());
+
+        auto stats = Vec<rpc::resp::Stat>{};
+
+        for (auto end = 1uz; end <= path.size(); ++end) {
+            if (end < path.size() and path[end] != '/') {
+                continue;
+            } else if (path[end - 1] == '/') {    // empty component
+                continue;
+            }
+
+            auto prefix = String{ path.substr(0, end) };
+
+            struct stat filestat = {};
+            if (auto res = ::lstat(prefix.c_str(), &filestat); res < 0) {
+                auto status = errno_status(__func__, prefix, "failed to stat file");
+                return rpc::resp::StatPath{ .stats = std::move(stats), .status = status };
+            }
+
+            stats.push_back(to_rpc_stat(filestat));
+        }
+
+        return rpc::resp::StatPath{ .stats = std::move(stats), .status = {} };
+    }
+
+    rpc::FallibleResponse RequestHandler::handle_req(rpc::req::Lseek req)
+    {
+        const auto& [fd, offset, whence] = req;
+        log_d("lseek", "fd={} offset={} whence={}", fd, offset, std::to_underlying(whence));
+
+        auto native = whence == rpc::Seek::Data ? SEEK_DATA : SEEK_HOLE;
+
+        // ENXIO (no more data or offset beyond EOF) is an expected result, not worth an error log
+        auto res = ::lseek(static_cast<int>(fd), offset, native);
+        if (res < 0 and errno == ENXIO) {
+            return failed(req, rpc::Status::no_such_device_or_address);
+        } else if (res < 0) {
+            return failed(req, errno_status(__func__, fd, "failed to seek file"));
+        }
+
+        return rpc::resp::Lseek{ .offset = res };
+    }
+
     rpc::FallibleResponse RequestHandler::handle_req(rpc::req::Ping req)
     {
         return rpc::resp::Ping{ .num = req.num };
@@ -28,8 +28,10 @@ namespace madbfs::server
                 break;
             }
 
+            const auto received = SteadyClock::now();
+
             // buffer must live until the request handled by `handle_request()`
-            auto [it, ok] = m_requests.try_emplace(header->id, Vec<u8>{}, header->proc);
+            auto [it, ok] = m_requests.try_emplace(header->id, Vec<u8>{}, header->proc, received);
             log_d(__func__, "new request [{}] [{}]", header->id.inner(), to_string(header->proc));
             if (not ok) {
                 log_w(
@@ -54,20 +56,20 @@ namespace madbfs::server
             // immediately without waiting for work on worker thread complete
 
             if (const auto id = header->id; req->proc() == rpc::Procedure::Ping) {
-                auto resp = co_await handle_request(std::move(*req));
-                if (auto res = co_await m_channel.async_send({}, { id, std::move(resp) }); not res) {
+                auto handled = co_await handle_request(std::move(*req), received);
+                if (auto res = co_await m_channel.async_send({}, { id, std::move(handled) }); not res) {
                     log_e("handler", "finished with error: {}", res.error().message());
                     m_requests.extract(id);
                 }
             } else {
                 async::spawn(
                     m_pool,
-                    handle_request(std::move(*req)),
-                    [&, id](std::exception_ptr e, rpc::FallibleResponse resp) {
+                    handle_request(std::move(*req), received),
+                    [&, id](std::exception_ptr e, Handled handled) {
                         log::log_exception(e, "handler");
                         async::spawn(
                             m_channel.get_executor(),
-                            m_channel.async_send({}, { id, std::move(resp) }),
+                            m_channel.async_send({}, { id, std::move(handled) }),
                             [&, id](std::exception_ptr e, Expect<void, net::error_code> res) {
                                 log::log_exception(e, "handler");
                                 if (not res) {
@@ -100,11 +102,23 @@ namespace madbfs::server
         }
     }
 
-    Await<rpc::FallibleResponse> Connection::handle_request(rpc::Request req)
+    Await<Connection::Handled> Connection::handle_request(rpc::Request req, SteadyClock::time_point received)
     {
-        co_return std::move(req).visit([&](rpc::IsRequest auto&& req) {
+        const auto start = SteadyClock::now();
+
+        auto response = std::move(req).visit([&](rpc::IsRequest auto&& req) {
             return m_handler.handle_req(std::move(req));
         });
+
+        auto micros = [](SteadyClock::duration duration) {
+            auto count = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+            return static_cast<u32>(std::clamp<i64>(count, 0, std::numeric_limits<u32>::max()));
+        };
+
+        co_return Handled{
+            .response = std::move(response),
+            .timing   = { .queue = micros(start - received), .exec = micros(SteadyClock::now() - start) },
+        };
     }
 
     AExpect<void> Connection::send_response()
@@ -118,13 +132,13 @@ namespace madbfs::server
                 co_return Unexpect{ async::to_generic_err(id_resp.error(), Errc::broken_pipe) };
             }
 
-            auto [id, response] = std::move(*id_resp);
+            auto [id, handled] = std::move(*id_resp);
             log_d(__func__, "new response: {}", id.inner());
 
             if (auto req = m_requests.extract(id); not req.empty()) {
-                auto& [_, proc] = req.mapped();
-                log_d(__func__, "response is [{}]", to_string(proc));
-                std::ignore = co_await rpc::send_response(m_socket, payload_buf, response, id);
+                log_d(__func__, "response is [{}]", to_string(req.mapped().proc));
+                auto& [response, timing] = handled;
+                std::ignore = co_await rpc::send_response(m_socket, payload_buf, response, id, timing);
             } else {
                 log_e(__func__, "response incoming for id {} but no promise registered", id.inner());
             }
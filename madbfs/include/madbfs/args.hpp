@@ -2,6 +2,7 @@
 
 #include "madbfs/adb.hpp"
 #include "madbfs/path.hpp"
+#include "madbfs/ttl_policy.hpp"
 
 #include <madbfs-common/async/async.hpp>
 #include <madbfs-common/log.hpp>
@@ -27,14 +28,23 @@ namespace madbfs::args
         const char* root       = nullptr;
         const char* log_level  = nullptr;
         const char* log_file   = nullptr;
+        const char* ttl_policy = nullptr;
+        const char* metrics    = nullptr;
         int         cache_size = 256;    // in MiB
         int         page_size  = 128;    // in KiB
+        int         prefetch   = 0;      // in MiB
+        int         stream     = 64;     // in MiB
+        int         linger     = 10;     // in seconds
+        int         slots      = 4;
         int         ttl        = 60;     // in seconds
         int         timeout    = 2;      // in seconds
         int         port       = 23237;
         int         no_server  = false;
         int         adb_only   = false;
         int         no_cache   = false;
+        int         persist    = false;
+        int         snapshot   = false;
+        int         walk       = false;
 
         ~MadbfsOpt()
         {
@@ -42,6 +52,8 @@ namespace madbfs::args
             ::free((void*)root);
             ::free((void*)log_level);
             ::free((void*)log_file);
+            ::free((void*)ttl_policy);
+            ::free((void*)metrics);
         }
     };
 
@@ -73,6 +85,9 @@ namespace madbfs::args
     {
         usize cachesize;
         usize pagesize;
+        usize prefetch;
+        usize stream;
+        usize linger;
     };
 
     /**
@@ -90,7 +105,13 @@ namespace madbfs::args
         log::Level    log_level;
         String        log_file;
         i32           ttl;
+        TtlPolicy     ttl_policy;
         i32           timeout;
+        bool          persist_tree;
+        bool          snapshot;
+        bool          walk_tree;
+        String        metrics;
+        usize         queue_slots;
     };
 
     /**
@@ -122,18 +143,27 @@ namespace madbfs::args
 
     static constexpr auto madbfs_opt_spec = std::to_array<fuse_opt>({
         // clang-format off
-        { "--serial=%s",     offsetof(MadbfsOpt, serial),     true },
-        { "--root=%s",       offsetof(MadbfsOpt, root),       true },
-        { "--log-level=%s",  offsetof(MadbfsOpt, log_level),  true },
-        { "--log-file=%s",   offsetof(MadbfsOpt, log_file),   true },
-        { "--cache-size=%d", offsetof(MadbfsOpt, cache_size), true },
-        { "--page-size=%d",  offsetof(MadbfsOpt, page_size),  true },
-        { "--ttl=%d",        offsetof(MadbfsOpt, ttl),        true },
-        { "--timeout=%d",    offsetof(MadbfsOpt, timeout),    true },
-        { "--port=%d",       offsetof(MadbfsOpt, port),       true },
-        { "--no-server",     offsetof(MadbfsOpt, no_server),  true },
-        { "--adb-only",      offsetof(MadbfsOpt, adb_only),   true },
-        { "--no-cache",      offsetof(MadbfsOpt, no_cache),   true },
+        { "--serial=%s",      offsetof(MadbfsOpt, serial),     true },
+        { "--root=%s",        offsetof(MadbfsOpt, root),       true },
+        { "--log-level=%s",   offsetof(MadbfsOpt, log_level),  true },
+        { "--log-file=%s",    offsetof(MadbfsOpt, log_file),   true },
+        { "--cache-size=%d",  offsetof(MadbfsOpt, cache_size), true },
+        { "--page-size=%d",   offsetof(MadbfsOpt, page_size),  true },
+        { "--prefetch=%d",    offsetof(MadbfsOpt, prefetch),   true },
+        { "--stream=%d",      offsetof(MadbfsOpt, stream),     true },
+        { "--linger=%d",      offsetof(MadbfsOpt, linger),     true },
+        { "--ttl=%d",         offsetof(MadbfsOpt, ttl),        true },
+        { "--ttl-policy=%s",  offsetof(MadbfsOpt, ttl_policy), true },
+        { "--timeout=%d",     offsetof(MadbfsOpt, timeout),    true },
+        { "--port=%d",        offsetof(MadbfsOpt, port),       true },
+        { "--no-server",      offsetof(MadbfsOpt, no_server),  true },
+        { "--adb-only",       offsetof(MadbfsOpt, adb_only),   true },
+        { "--no-cache",       offsetof(MadbfsOpt, no_cache),   true },
+        { "--persist",        offsetof(MadbfsOpt, persist),    true },
+        { "--snapshot",       offsetof(MadbfsOpt, snapshot),   true },
+        { "--walk",           offsetof(MadbfsOpt, walk),       true },
+        { "--metrics=%s",     offsetof(MadbfsOpt, metrics),    true },
+        { "--queue-slots=%d", offsetof(MadbfsOpt, slots),      true },
         // clang-format on
         FUSE_OPT_END,
     });
@@ -2,11 +2,14 @@
 
 #include "madbfs/path.hpp"
 #include "madbfs/stat.hpp"
+#include "madbfs/trace.hpp"
 
 #include <madbfs-common/async/async.hpp>
+#include <madbfs-common/rpc.hpp>
 
 #include <saf.hpp>
 
+#include <functional>
 #include <list>
 #include <map>
 #include <unordered_map>
@@ -34,16 +37,26 @@ namespace madbfs
      * @class Page
      *
      * @brief Represent a chunk of file content.
+     *
+     * The buffer may be shared between pages of different files (copy-on-write). A page gets its own copy
+     * of the buffer on the first write.
      */
     class Page
     {
     public:
-        Page(PageKey key, Uniq<char[]> buf, u32 size, u32 page_size);
+        Page(PageKey key, Shared<char[]> buf, u32 size, u32 page_size);
 
         usize read(Span<char> out, usize offset);
         usize write(Span<const char> in, usize offset);
         usize truncate(usize size);
 
+        /**
+         * @brief Create a clean page with another key that shares the buffer of this page.
+         *
+         * @param key Key of the new page.
+         */
+        Page share(PageKey key) const;
+
         usize size() const;
 
         bool is_dirty() const;
@@ -53,11 +66,11 @@ namespace madbfs
         Span<const char> buf() { return { m_data.get(), size() }; }
 
     private:
-        PageKey      m_key;
-        Uniq<char[]> m_data;
-        u32          m_size;
-        u32          m_page_size;
-        bool         m_dirty = false;
+        PageKey        m_key;
+        Shared<char[]> m_data;
+        u32            m_size;
+        u32            m_page_size;
+        bool           m_dirty = false;
     };
 
     /**
@@ -72,16 +85,85 @@ namespace madbfs
      * This Cache stores a pair of real fds for read and write operations, even when the FUSE client opens
      * multiple files. Every file is discriminated by its id. Real fds are not exposed through this mode.
      *
+     * Real fds of files that are no longer opened linger for a while before they are closed, so a file that
+     * is opened again soon after (media scanners, `file`, git) reuses them instead of paying for another
+     * open and close on the device. The number of lingering fds is capped, the least recently closed ones
+     * are closed first.
+     *
      * The class also acts as debouncer for read/write operations because of the nature of it.
      */
     class Cache
     {
     public:
+        static constexpr usize default_max_lingering = 64;
+
         struct LookupEntry;
+        struct Linger;
+
+        using Lru         = std::list<Page>;
+        using Lookup      = std::unordered_map<Id, LookupEntry>;
+        using ReadQueue   = std::unordered_map<PageKey, saf::shared_future<Errc>>;
+        using LingerQueue = std::list<Linger>;
+        using CloseHook   = std::function<void(Id id, path::Path path, const Stat& stat)>;
+
+        enum class FdKind
+        {
+            Read,
+            Write,
+        };
+
+        /**
+         * @class Stats
+         *
+         * @brief Counters of the cache, in pages.
+         */
+        struct Stats
+        {
+            u64 hits      = 0;    // served without a read from the device (known holes included)
+            u64 misses    = 0;    // read from the device
+            u64 evictions = 0;
+            u64 pushes    = 0;    // dirty pages written to the device, on flush or eviction
+        };
+
+        /**
+         * @class Residency
+         *
+         * @brief Snapshot of the cached pages of a file.
+         */
+        struct Residency
+        {
+            path::PathBuf           path;
+            Vec<usize>              resident;    // indices of cached pages, ascending
+            Vec<usize>              dirty;       // indices of dirty pages, ascending
+            u64                     reader;
+            u64                     writer;
+            bool                    pinned;    // the entry is kept even if it has no page
+            SteadyClock::time_point accessed;
+        };
+
+        /**
+         * @class Linger
+         *
+         * @brief Real fd of a file that is not opened anymore, waiting to be closed.
+         */
+        struct Linger
+        {
+            Id                      id;
+            FdKind                  kind;
+            SteadyClock::time_point since;
+        };
 
-        using Lru       = std::list<Page>;
-        using Lookup    = std::unordered_map<Id, LookupEntry>;
-        using ReadQueue = std::unordered_map<PageKey, saf::shared_future<Errc>>;
+        /**
+         * @class Closing
+         *
+         * @brief Real fd of a file to be closed on the device.
+         */
+        struct Closing
+        {
+            Id            id;
+            path::PathBuf path;
+            u64           fd;
+        };
 
         /**
          * @class LookupEntry
@@ -93,6 +175,7 @@ namespace madbfs
         struct LookupEntry
         {
             std::map<usize, Lru::iterator> pages;
+            std::map<usize, usize>         holes;    // known holes on device, start -> end (exclusive)
             path::PathBuf                  path;
 
             u64 reader = 0;    // reader counts from FUSE
@@ -101,11 +184,16 @@ namespace madbfs
             Opt<u64> read_fd  = std::nullopt;    // real file descriptor for read (cache misses) on device
             Opt<u64> write_fd = std::nullopt;    // real file descriptor for write (dirty flushes) on device
 
+            Opt<LingerQueue::iterator> read_linger  = std::nullopt;    // set if read_fd is lingering
+            Opt<LingerQueue::iterator> write_linger = std::nullopt;    // set if write_fd is lingering
+
             i64 read_inflight  = 0;    // read operation not completed yet on real fd
             i64 write_inflight = 0;    // write operation not completed yet on real fd
 
             bool dirty = false;
 
+            SteadyClock::time_point accessed = {};    // last read or write from FUSE
+
             /**
              * @brief Check if an entry is free to be discarded.
              */
@@ -116,6 +204,8 @@ namespace madbfs
                    and writer == 0            //
                    and read_inflight == 0     //
                    and write_inflight == 0    //
+                   and not read_fd            //
+                   and not write_fd           //
                    and not dirty;
             }
         };
@@ -126,10 +216,27 @@ namespace madbfs
          * @param connection Conneciton to device.
          * @param page_size Cache page size.
          * @param max_pages Number of maximum pages the Cache can hold.
+         * @param linger How long real fds of closed files are kept open.
+         * @param max_lingering Maximum number of real fds kept open for closed files.
          *
          * The connection will be held by the instance until it is destroyed.
          */
-        Cache(Connection& connection, usize page_size, usize max_pages);
+        Cache(
+            Connection& connection,
+            usize       page_size,
+            usize       max_pages,
+            Seconds     linger,
+            usize       max_lingering = default_max_lingering
+        );
+
+        /**
+         * @brief Set the function to be called with the stat the device reports when a real fd is closed.
+         *
+         * @param hook Receives the id and path of the file along with the stat.
+         *
+         * The hook is not called if the file has dirty content since the stat doesn't reflect it yet.
+         */
+        void set_close_hook(CloseHook hook) { m_close_hook = std::move(hook); }
 
         /**
          * @brief Hint the cache to open a real fd to a file in the device for further operations.
@@ -140,16 +247,22 @@ namespace madbfs
          *
          * This function will only open a real file if the file is not opened yet. If file is already opened
          * and the mode can upgraded from O_RDONLY or O_WRONLY to O_RDRW the file will be closed then reopened
-         * with the O_RDRW mode.
+         * with the O_RDRW mode. Lingering real fds of the file are taken back and reused.
+         *
+         * @param real_fd Real fd already opened on the device by the caller, e.g. from an open that creates
+         * or truncates the file. It is adopted as the read fd (`OpenMode::Read`) or the write fd (otherwise)
+         * if the entry doesn't have one yet, else it is closed.
          */
-        AExpect<void> hint_open(Id id, path::Path path, OpenMode mode);
+        AExpect<void> hint_open(Id id, path::Path path, OpenMode mode, Opt<u64> real_fd = std::nullopt);
 
         /**
          * @brief Close the associated fd to real file for this node.
          *
          * @param id Associated node Id.
          *
-         * Unlike `hint_open()` this function will immediately close the file descriptor to the real file.
+         * The real fds are not closed immediately once the last reader/writer is gone. They linger until
+         * they have been idle for the linger period (closed on `clean_stale_fds()`) or until they are pushed
+         * out by the lingering fds cap.
          */
         AExpect<void> hint_close(Id id, OpenMode mode);
 
@@ -159,6 +272,7 @@ namespace madbfs
          * @param id File id.
          * @param out Output buffer.
          * @param offset Read offset.
+         * @param trace Trace context of the operation.
          *
          * @return Number of read bytes.
          *
@@ -166,7 +280,7 @@ namespace madbfs
          * LRU. It may also flush an entry (may or may not be related to the file being read) to make space
          * for new data if the LRU pages reaches its maximum.
          */
-        AExpect<usize> read(Id id, Span<char> out, off_t offset);
+        AExpect<usize> read(Id id, Span<char> out, off_t offset, trace::Context trace = {});
 
         /**
          * @brief Write bytes into file with desired id at an offset from buffer.
@@ -174,20 +288,49 @@ namespace madbfs
          * @param id File id.
          * @param in Input buffer.
          * @param offset Write offset.
+         * @param trace Trace context of the operation.
          *
          * @return Numbef of written bytes.
          *
          * This function only writes into the cache in memory. Writes to the actual file on the device will
          * only happen when eviction occurs or `flush()` is explicitly called.
          */
-        AExpect<usize> write(Id id, Span<const char> in, off_t offset);
+        AExpect<usize> write(Id id, Span<const char> in, off_t offset, trace::Context trace = {});
+
+        /**
+         * @brief Pull the first page of a file into the cache ahead of any read.
+         *
+         * @param id File id.
+         * @param path File path.
+         *
+         * This function does nothing if the page is already cached or is still being pulled. The real fd
+         * opened for the operation lingers right after, the same as one opened from FUSE.
+         */
+        AExpect<void> prefetch(Id id, path::Path path);
+
+        /**
+         * @brief Find the next data or hole region of a file.
+         *
+         * @param id File id.
+         * @param offset Offset to start the search from.
+         * @param whence Either `rpc::Seek::Data` or `rpc::Seek::Hole`.
+         *
+         * @return Offset of the found region.
+         *
+         * The query is answered locally if the offset lies in a known hole, otherwise it is sent to the
+         * device. Holes found by `rpc::Seek::Data` are recorded so that reads of pages entirely inside them
+         * are filled with zeros locally instead of being fetched. The caller should flush the file first
+         * since the device doesn't know about dirty pages.
+         */
+        AExpect<off_t> lseek(Id id, off_t offset, rpc::Seek whence);
 
         /**
          * @brief Flush data into actual file to the device.
          *
          * @param id File id.
+         * @param trace Trace context of the operation.
          */
-        AExpect<void> flush(Id id);
+        AExpect<void> flush(Id id, trace::Context trace = {});
 
         /**
          * @brief Truncate a file in the cache.
@@ -204,6 +347,25 @@ namespace madbfs
          */
         AExpect<void> truncate(Id id, usize old_size, usize new_size);
 
+        /**
+         * @brief Update the cache of a file after a range of another file is copied into it on the device.
+         *
+         * @param in_id Source file id.
+         * @param in_off Offset of the range in the source file.
+         * @param out_id Destination file id.
+         * @param out_off Offset of the range in the destination file.
+         * @param size Number of bytes copied.
+         * @param out_size Size of the destination file after the copy.
+         *
+         * @return Number of pages shared with the destination file.
+         *
+         * Like `truncate()`, the actual copy should be done by the caller beforehand. Cached pages of the
+         * destination file within the range are stale, so they are dropped. If both offsets are page-aligned,
+         * clean pages of the source file that are cached are shared with the destination file (copy-on-write)
+         * instead, so the copy is readable right away without going to the device.
+         */
+        Await<usize> copy(Id in_id, off_t in_off, Id out_id, off_t out_off, usize size, usize out_size);
+
         /**
          * @brief Rename/relink path pointed by its id to a new path.
          *
@@ -222,6 +384,16 @@ namespace madbfs
          */
         Await<void> invalidate_one(Id id, bool should_flush);
 
+        /**
+         * @brief Drop clean pages and known holes of a file while keeping its entry.
+         *
+         * @param id File id.
+         *
+         * Used when the file is modified without going through the cache. Dirty pages are kept since they
+         * hold writes that are not on the device yet.
+         */
+        void discard(Id id);
+
         /**
          * @brief Invalidate all entries.
          *
@@ -237,7 +409,9 @@ namespace madbfs
         Await<void> shutdown();
 
         /**
-         * @brief Remove unused fds.
+         * @brief Close real fds that have been lingering for longer than the linger period.
+         *
+         * Lingering fds are queued in the order they become idle, so only the expired ones are visited.
          */
         Await<void> clean_stale_fds();
 
@@ -280,12 +454,38 @@ namespace madbfs
          */
         usize current_pages() const { return m_lru.size(); }
 
+        /**
+         * @brief Get how long real fds of closed files are kept open.
+         */
+        Seconds linger() const { return m_linger; }
+
+        /**
+         * @brief Get current number of lingering real fds.
+         */
+        usize current_lingering() const { return m_lingering.size(); }
+
+        /**
+         * @brief Get current number of pages that are still pulling data from the device.
+         */
+        usize pending_reads() const { return m_read_queue.size(); }
+
+        /**
+         * @brief Get the counters of the cache since its construction.
+         */
+        const Stats& stats() const { return m_stats; }
+
+        /**
+         * @brief Take a snapshot of the cached pages of each file, like `mincore(2)` on every cached file.
+         *
+         * @param under Only files at or under this path are included.
+         *
+         * Pages themselves are never pinned, eviction only follows the LRU order. A file is pinned when its
+         * entry is kept regardless of its pages: it's opened, has operations in flight, holds real fds, or
+         * has dirty content.
+         */
+        Vec<Residency> residency(path::Path under) const;
+
     private:
-        enum class FdKind
-        {
-            Read,
-            Write,
-        };
 
         /**
          * @brief Add new lookup entry for specified id if not exists already.
@@ -297,6 +497,49 @@ namespace madbfs
          */
         Ref<LookupEntry> new_lookup(Id id, path::Path path);
 
+        /**
+         * @brief Remove the lookup entry of a file if it holds nothing anymore.
+         *
+         * @param id File identifier.
+         */
+        void erase_if_free(Id id);
+
+        /**
+         * @brief Put a real fd of a file at the back of the linger queue.
+         *
+         * @param id File identifier.
+         * @param entry Lookup entry of the file.
+         * @param kind Which fd of the entry.
+         *
+         * Does nothing if the entry has no such fd or it is already lingering.
+         */
+        void linger(Id id, LookupEntry& entry, FdKind kind);
+
+        /**
+         * @brief Take a real fd of a file out of the linger queue.
+         *
+         * @param entry Lookup entry of the file.
+         * @param kind Which fd of the entry.
+         */
+        void unlinger(LookupEntry& entry, FdKind kind);
+
+        /**
+         * @brief Close lingering real fds from the front of the linger queue.
+         *
+         * @param deadline Fds that start lingering at or before this time point are closed.
+         * @param keep Fds are closed regardless of the deadline while there are more than this many of them.
+         *
+         * Fds that still have operations in flight are moved to the back of the queue instead.
+         */
+        Await<void> close_lingering(SteadyClock::time_point deadline, usize keep);
+
+        /**
+         * @brief Close real fds on the device and pass the stats they report to the close hook.
+         *
+         * @param fds Fds to be closed.
+         */
+        Await<void> close_fds(Vec<Closing> fds);
+
         /**
          * @brief Look up for pages using its file id.
          *
@@ -312,10 +555,11 @@ namespace madbfs
          * @param fd Real read file descriptor on device.
          * @param out Output buffer.
          * @param offset Read offset.
+         * @param trace Trace context of the operation.
          *
          * May be called on `read()` function call.
          */
-        AExpect<usize> on_miss(u64 fd, Span<char> out, off_t offset);
+        AExpect<usize> on_miss(u64 fd, Span<char> out, off_t offset, trace::Context trace);
 
         /**
          * @brief Operation to do on flush.
@@ -323,18 +567,20 @@ namespace madbfs
          * @param fd Real write file descriptor on device.
          * @param in Input buffer.
          * @param offset Write offset.
+         * @param trace Trace context of the operation.
          *
          * May be called on `read()`, `write()`, `invalidate_one()`, `invalidate_all()`, and `shutdown()`.
          * Will be called on `flush()`.
          */
-        AExpect<usize> on_flush(u64 fd, Span<const char> in, off_t offset);
+        AExpect<usize> on_flush(u64 fd, Span<const char> in, off_t offset, trace::Context trace);
 
         /**
          * @brief Evict last entries in the LRU.
          *
          * @param size Number of last entries to be evicted.
+         * @param trace Trace context of the operation that causes the eviction.
          */
-        Await<void> evict(usize size);
+        Await<void> evict(usize size, trace::Context trace = {});
 
         /**
          * @brief Read file at page index.
@@ -346,17 +592,19 @@ namespace madbfs
          * @param first First index of the page.
          * @param last Last index of the page.
          * @param offset Offset of the read operation.
+         * @param trace Trace context of the operation.
          *
          * The `first` and `last` paramaters are related to the `offset` and `out` buffer size.
          */
         AExpect<usize> read_at(
-            LookupEntry& entry,
-            Span<char>   out,
-            Id           id,
-            usize        index,
-            usize        first,
-            usize        last,
-            off_t        offset
+            LookupEntry&   entry,
+            Span<char>     out,
+            Id             id,
+            usize          index,
+            usize          first,
+            usize          last,
+            off_t          offset,
+            trace::Context trace
         );
 
         /**
@@ -369,6 +617,7 @@ namespace madbfs
          * @param first First index of the page.
          * @param last Last index of the page.
          * @param offset Offset of the read operation.
+         * @param trace Trace context of the operation.
          *
          * The `first` and `last` paramaters are related to the `offset` and `in` buffer size.
          */
@@ -379,7 +628,8 @@ namespace madbfs
             usize            index,
             usize            first,
             usize            last,
-            off_t            offset
+            off_t            offset,
+            trace::Context   trace
         );
 
         /**
@@ -387,8 +637,9 @@ namespace madbfs
          *
          * @param fd Real write file descriptor on device.
          * @param page Page to be flushed.
+         * @param trace Trace context of the operation.
          */
-        AExpect<void> flush_at(u64 fd, Page& page);
+        AExpect<void> flush_at(u64 fd, Page& page, trace::Context trace = {});
 
         Connection& m_connection;
 
@@ -396,9 +647,14 @@ namespace madbfs
         Lookup    m_table;         // lookup table for fast page access
         ReadQueue m_read_queue;    // pages that are still pulling data
 
-        Vec<Tup<Id, FdKind>> m_stale_fds;
+        LingerQueue m_lingering;    // least recently closed is at the front
+
+        usize   m_page_size     = 0;
+        usize   m_max_pages     = 0;
+        Seconds m_linger        = {};
+        usize   m_max_lingering = 0;
 
-        usize m_page_size = 0;
-        usize m_max_pages = 0;
+        Stats     m_stats;
+        CloseHook m_close_hook;
     };
 };
@@ -33,4 +33,13 @@ namespace madbfs::cmd
         auto span = Span<const Str>{ cmd.begin(), cmd.size() };
         co_return co_await exec(span, in, check, merge_err);
     }
+
+    /**
+     * @brief Get the error condition of an error message printed by adb or a shell command.
+     *
+     * @param message Error message (e.g. `stat: '/foo': No such file or directory`).
+     *
+     * @return The error of the first line that is recognized, or `Errc::io_error` if there is none.
+     */
+    Errc parse_error(Str message);
 }
@@ -1,12 +1,15 @@
 #pragma once
 
 #include "madbfs/adb.hpp"
+#include "madbfs/metrics.hpp"
 #include "madbfs/path.hpp"
 #include "madbfs/stat.hpp"
+#include "madbfs/trace.hpp"
 #include "madbfs/transport/transport.hpp"
 
 #include <madbfs-common/async/async.hpp>
 #include <madbfs-common/log.hpp>
+#include <madbfs-common/util/defer.hpp>
 
 #include <saf.hpp>
 
@@ -129,6 +132,22 @@ namespace madbfs
         Connection(const Connection&)            = delete;
         Connection& operator=(const Connection&) = delete;
 
+        /**
+         * @class Stats
+         *
+         * @brief Counters of the requests sent through the connection, kept across transport changes.
+         *
+         * Bytes only count the file data of reads and writes, not the framing of the requests.
+         */
+        struct Stats
+        {
+            u64 inflight       = 0;
+            u64 requests       = 0;
+            u64 sent_bytes     = 0;
+            u64 received_bytes = 0;
+            u64 reconnects     = 0;
+        };
+
         ~Connection();
 
         /**
@@ -194,6 +213,16 @@ namespace madbfs
          */
         AExpect<void> ping(Opt<Seconds> timeout);
 
+        /**
+         * @brief Get the counters of the connection.
+         */
+        const Stats& stats() const { return m_stats; }
+
+        /**
+         * @brief Get the number of requests waiting in the underlying transport.
+         */
+        transport::Transport::Depth depth() const { return m_transport->depth(); }
+
         // directory operations
         // --------------------
 
@@ -215,6 +244,17 @@ namespace madbfs
          */
         AExpect<Stat> stat(path::Path path);
 
+        /**
+         * @brief Get the stat of every component of a path in a single request.
+         *
+         * @param path The path to the file or directory.
+         *
+         * @return Stats of the components from the first one (just below root) down to the path itself, and
+         * the error of the first component that fails (`Errc{}` if none fails). The stats stop at that
+         * component.
+         */
+        AExpect<Pair<Vec<Stat>, Errc>> stat_path(path::Path path);
+
         /**
          * @brief Get the real file pointed by a symlink.
          *
@@ -229,15 +269,19 @@ namespace madbfs
          * @brief Create a new empty file.
          *
          * @param path Path of the new file.
+         *
+         * @return Stat of the new file, empty if the device can't provide it.
          */
-        AExpect<void> mknod(path::Path path, mode_t mode, dev_t dev);
+        AExpect<Opt<Stat>> mknod(path::Path path, mode_t mode, dev_t dev);
 
         /**
          * @brief Make a directory on the device.
          *
          * @param path Path to the directory.
+         *
+         * @return Stat of the new directory, empty if the device can't provide it.
          */
-        AExpect<void> mkdir(path::Path path, mode_t mode);
+        AExpect<Opt<Stat>> mkdir(path::Path path, mode_t mode);
 
         /**
          * @brief Remove a file on the device.
@@ -259,8 +303,10 @@ namespace madbfs
          *
          * @param from Target file.
          * @param to Destination file.
+         *
+         * @return Stat of the destination file after the move, empty if the device can't provide it.
          */
-        AExpect<void> rename(path::Path from, path::Path to, u32 flags);
+        AExpect<Opt<Stat>> rename(path::Path from, path::Path to, u32 flags);
 
         // --------------------
 
@@ -272,8 +318,10 @@ namespace madbfs
          *
          * @param path Path to the file on the device.
          * @param size Size to truncate to.
+         *
+         * @return Stat of the file after truncation, empty if the device can't provide it.
          */
-        AExpect<void> truncate(path::Path path, off_t size);
+        AExpect<Opt<Stat>> truncate(path::Path path, off_t size);
 
         /**
          * @brief Update change time and modification time of a file
@@ -281,8 +329,10 @@ namespace madbfs
          * @param path Path to the file on the device.
          * @param atime Access time.
          * @param mtime Modification time.
+         *
+         * @return Stat of the file after the times are updated, empty if the device can't provide it.
          */
-        AExpect<void> utimens(path::Path path, timespec atime, timespec mtime);
+        AExpect<Opt<Stat>> utimens(path::Path path, timespec atime, timespec mtime);
 
         /**
          * @brief Copy file server-side.
@@ -292,8 +342,11 @@ namespace madbfs
          * @param out Output file path.
          * @param out_off Output offset.
          * @param size Number of bytes to be copied.
+         *
+         * @return Number of bytes copied and the stat of the output file after the copy (empty if the device
+         * can't provide it).
          */
-        AExpect<usize> copy_file_range(
+        AExpect<Pair<usize, Opt<Stat>>> copy_file_range(
             path::Path in,
             off_t      in_off,
             path::Path out,
@@ -306,15 +359,30 @@ namespace madbfs
          *
          * @param path Path to the file on the device.
          * @param mode Mode in which the file will be opened.
+         * @param trace Trace context of the operation.
          */
-        AExpect<u64> open(path::Path path, OpenMode mode);
+        AExpect<u64> open(path::Path path, OpenMode mode, trace::Context trace = {});
+
+        /**
+         * @brief Open a file from the device with extra flags.
+         *
+         * @param path Path to the file on the device.
+         * @param mode Mode in which the file will be opened.
+         * @param flags Combination of `rpc::open_flag` values (create, truncate, exclusive).
+         * @param perm Permission bits of the file if it is created.
+         *
+         * @return File descriptor and the stat of the file after it is opened (and created or truncated).
+         */
+        AExpect<Pair<u64, Stat>> open(path::Path path, OpenMode mode, u8 flags, mode_t perm);
 
         /**
          * @brief Close a file descriptor.
          *
          * @param fd File descriptor to a file on the device.
+         *
+         * @return Stat of the file right before it is closed, if the transport can provide it.
          */
-        AExpect<void> close(u64 fd);
+        AExpect<Opt<Stat>> close(u64 fd);
 
         /**
          * @brief Read from a file on the device.
@@ -322,8 +390,9 @@ namespace madbfs
          * @param fd File descriptor to a file on the device.
          * @param out Buffer to read into.
          * @param offset Offset to read from.
+         * @param trace Trace context of the operation.
          */
-        AExpect<usize> read(u64 fd, Span<char> out, off_t offset);
+        AExpect<usize> read(u64 fd, Span<char> out, off_t offset, trace::Context trace = {});
 
         /**
          * @brief Write to a file on the device.
@@ -331,8 +400,22 @@ namespace madbfs
          * @param fd File descriptor to a file on the device.
          * @param in Buffer to write from.
          * @param offset Offset to write to.
+         * @param trace Trace context of the operation.
          */
-        AExpect<usize> write(u64 fd, Span<const char> in, off_t offset);
+        AExpect<usize> write(u64 fd, Span<const char> in, off_t offset, trace::Context trace = {});
+
+        /**
+         * @brief Find the next data or hole region of a file on the device.
+         *
+         * @param fd File descriptor to a file on the device.
+         * @param offset Offset to start the search from.
+         * @param whence Either `rpc::Seek::Data` or `rpc::Seek::Hole`.
+         *
+         * @return Offset of the found region. `Errc::no_such_device_or_address` if there is no more data
+         * after offset or offset is beyond EOF. `Errc::operation_not_supported` if the transport can't query
+         * the regions.
+         */
+        AExpect<off_t> lseek(u64 fd, off_t offset, rpc::Seek whence);
 
         // ---------------
     private:
@@ -349,16 +432,30 @@ namespace madbfs
          *
          * @param buf Data buffer.
          * @param req Operation request.
+         * @param trace Trace context of the operation.
          */
         template <rpc::IsRequest Req>
-        AExpect<rpc::ToResp<Req>> send_req(Req req)
+        AExpect<rpc::ToResp<Req>> send_req(Req req, trace::Context trace = {})
         {
             constexpr auto max_attempts = 5uz;
 
+            auto watch = metrics::Stopwatch{ metrics::of(rpc::to_proc<Req>()) };
+            auto span  = trace::Scope{ trace, rpc::to_string(rpc::to_proc<Req>()), "connection" };
+
+            ++m_stats.requests;
+            ++m_stats.inflight;
+            auto done = util::defer([&] { --m_stats.inflight; });
+
             auto attempt = 0uz;
             while (attempt++ < max_attempts) {
-                auto resp = co_await m_transport->send_req(std::move(req));
+                auto resp = co_await m_transport->send_req(std::move(req), trace);
                 if (resp) {
+                    if constexpr (std::same_as<Req, rpc::req::Read>) {
+                        m_stats.received_bytes += resp->read.size();
+                    } else if constexpr (std::same_as<Req, rpc::req::Write>) {
+                        m_stats.sent_bytes += resp->size;
+                    }
+                    watch.stop(true);
                     co_return resp;
                 }
 
@@ -383,5 +480,7 @@ namespace madbfs
         ConnectionStrategy         m_strategy;
 
         Opt<saf::shared_future<Errc>> m_reconnection;
+
+        Stats m_stats;
     };
 }
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <madbfs-common/aliases.hpp>
+
+#include <sys/types.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+namespace madbfs
+{
+    /**
+     * @class FairQueue
+     *
+     * @brief Weighted fair queue of FUSE operations across the processes that issue them.
+     *
+     * The queue only kicks in under contention: operations of a process are admitted right away as long as
+     * no other process has an operation in flight or waiting. Otherwise at most `slots` operations are
+     * admitted at once and the next one is picked using self-clocked fair queuing: every operation gets a
+     * finish tag of `max(V, last tag of its process) + 1 / weight` where `V` is the tag of the last admitted
+     * operation, and the lowest tag goes first. A process that floods the filesystem only delays its own
+     * operations, while a process with a higher weight gets a bigger share when there is contention.
+     *
+     * FUSE reports the id of the calling thread, so it's resolved to its process (`Tgid` in
+     * `/proc/<tid>/status`) which is then weighted by its name (`/proc/<pid>/comm`). The queue is meant to
+     * be used from the FUSE worker threads, it blocks the calling thread until its operation is admitted.
+     */
+    class FairQueue
+    {
+    public:
+        static constexpr usize default_slots  = 4;
+        static constexpr u32   default_weight = 8;
+
+        using Weights = std::unordered_map<String, u32>;
+
+        /**
+         * @class Process
+         *
+         * @brief Process an operation belongs to.
+         */
+        struct Process
+        {
+            pid_t  pid;
+            String name;    // fits in small string buffer (comm is at most 15 chars)
+        };
+
+        /**
+         * @class Ticket
+         *
+         * @brief Admission of an operation, the slot is released on destruction.
+         */
+        class Ticket
+        {
+        public:
+            Ticket(FairQueue* queue, Process process)
+                : m_queue{ queue }
+                , m_process{ std::move(process) }
+            {
+            }
+
+            ~Ticket()
+            {
+                if (m_queue) {
+                    m_queue->release(m_process.pid);
+                }
+            }
+
+            Ticket(Ticket&& other) noexcept
+                : m_queue{ std::exchange(other.m_queue, nullptr) }
+                , m_process{ std::move(other.m_process) }
+            {
+            }
+
+            Ticket& operator=(Ticket&&)      = delete;
+            Ticket(const Ticket&)            = delete;
+            Ticket& operator=(const Ticket&) = delete;
+
+            /**
+             * @brief Get the name of the process that issued the operation.
+             */
+            Str process() const { return m_process.name; }
+
+        private:
+            FairQueue* m_queue;
+            Process    m_process;
+        };
+
+        /**
+         * @brief Construct a new queue.
+         *
+         * @param slots Number of operations that can be admitted at once under contention.
+         */
+        FairQueue(usize slots = default_slots);
+
+        /**
+         * @brief Wait until an operation of a thread is admitted.
+         *
+         * @param tid Id of the calling thread (the pid from `fuse_get_context()`).
+         *
+         * @return Ticket that holds the slot.
+         *
+         * The process of a thread is resolved once and remembered, the lookup doesn't hold the lock.
+         */
+        Ticket acquire(pid_t tid);
+
+        /**
+         * @brief Wait until an operation of a process is admitted.
+         *
+         * @param process The process.
+         *
+         * @return Ticket that holds the slot.
+         */
+        Ticket acquire(Process process);
+
+        /**
+         * @brief Find the process of a thread from procfs.
+         *
+         * @param tid Id of the thread.
+         *
+         * @return The process, or pid 0 with an empty name if the thread is gone (or `tid` is 0).
+         */
+        static Process resolve(pid_t tid);
+
+        /**
+         * @brief Parse weights from its string representation.
+         *
+         * @param spec Weights separated by `;` in the form of `<name>=<weight>`.
+         *
+         * @return Parsed weights or `Errc::invalid_argument` if the string is malformed.
+         *
+         * The weight must be a positive integer. Empty string results in empty weights.
+         *
+         * Example: `tumbler=1;ffmpegthumbnailer=1;cp=16`.
+         */
+        static Expect<Weights> parse_weights(Str spec);
+
+        /**
+         * @brief Get the string representation of weights (in the same format `parse_weights()` accepts).
+         *
+         * @param weights The weights.
+         */
+        static String to_string(const Weights& weights);
+
+        /**
+         * @brief Set the weights of processes by their name.
+         *
+         * @param weights New weights, processes not in it use `default_weight`.
+         *
+         * @return Old weights.
+         */
+        Weights set_weights(Weights weights);
+
+        /**
+         * @brief Get the weights of processes by their name.
+         */
+        Weights weights() const;
+
+        /**
+         * @brief Get the number of operations waiting to be admitted.
+         */
+        usize waiting() const;
+
+        /**
+         * @brief Get the number of operations that can be admitted at once under contention.
+         */
+        usize slots() const { return m_slots; }
+
+    private:
+        struct Flow
+        {
+            String name;
+            u32    weight;
+            f64    finish = 0.0;
+            usize  active = 0;    // operations admitted and not released yet
+        };
+
+        using Tag = Pair<f64, u64>;    // finish tag and arrival order
+
+        /**
+         * @brief Release a slot and wake up the waiting operations.
+         *
+         * @param pid Pid of the process that holds the slot.
+         */
+        void release(pid_t pid);
+
+        /**
+         * @brief Get the flow of a process, creating it if it doesn't exist yet.
+         *
+         * @param process The process.
+         *
+         * Must be called while holding the lock.
+         */
+        Flow& flow_of(const Process& process);
+
+        mutable std::mutex      m_mutex;
+        std::condition_variable m_cv;
+
+        std::unordered_map<pid_t, Flow>  m_flows;
+        std::unordered_map<pid_t, pid_t> m_threads;    // tid -> pid
+        std::set<Tag>                    m_waiting;
+        Weights                          m_weights;
+
+        usize m_slots;
+        usize m_active  = 0;
+        u64   m_arrival = 0;
+        f64   m_virtual = 0.0;
+    };
+}
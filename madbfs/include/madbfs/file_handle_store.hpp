@@ -2,6 +2,8 @@
 
 #include "madbfs/stat.hpp"
 
+#include <limits>
+
 namespace madbfs
 {
     class Node;
@@ -23,7 +25,12 @@ namespace madbfs
      *
      * The lifetime of the nodes pointed to by this store should be at the very least from `store()` to
      * `release()`. If you can't guarantee that the node pointed to can't live til `release()`, `erase()`
-     * them.
+     * them. An erased slot is not handed out again until it's released, so state kept per file descriptor
+     * outside of the store is never inherited by a new handle.
+     *
+     * Empty slots are kept in a free list and the slots of the same node are chained together, so every
+     * operation is constant time (`erase()` is linear only to the number of handles of the node). The head
+     * of the chain is stored in the node itself, no lookup is needed to reach it.
      */
     class FileHandleStore
     {
@@ -60,7 +67,7 @@ namespace madbfs
          *
          * @return File descriptor (position of the node in the store).
          *
-         * The time complexity of the opration is linear (depends on number of handles before finding a hole).
+         * The time complexity of the operation is amortized constant (the store grows when it's full).
          */
         u64 store(Node* node, OpenMode mode, u64 real_fd);
 
@@ -69,9 +76,10 @@ namespace madbfs
          *
          * @param fd File descriptor.
          *
-         * @return The released node if exists, else `std::nullopt`.
+         * @return The released handle if exists, else `std::nullopt` (including already erased handle).
          *
-         * The time complexity of the operation is constant.
+         * The slot of an erased handle becomes free again on its release. The time complexity of the
+         * operation is constant.
          */
         Opt<FileHandle> release(u64 fd);
 
@@ -82,7 +90,8 @@ namespace madbfs
          *
          * @return Number of file handle erased.
          *
-         * Iterate the store and erase any handles that has this node pointed by them.
+         * Walk the handle chain of the node and erase every handle in it. The slots stay taken until they
+         * are released.
          */
         usize erase(Node* node);
 
@@ -90,10 +99,40 @@ namespace madbfs
         Span<const FileHandle> iter() const { return m_handles; }
 
         usize capacity() const { return m_handles.size(); }
-        usize count_open() const;
-        usize count_empty() const;
+        usize count_open() const { return m_open; }
+        usize count_erased() const { return m_erased; }
+        usize count_empty() const { return capacity() - m_open - m_erased; }
 
     private:
+        static constexpr u64 npos   = std::numeric_limits<u64>::max();
+        static constexpr u64 erased = npos - 1;    // `prev` of an erased slot waiting for its release
+
+        /**
+         * @class Link
+         *
+         * @brief Links of a slot; free slots are chained by `next` into the free list while used slots are
+         * chained both ways with the other slots of the same node.
+         */
+        struct Link
+        {
+            u64 prev = npos;
+            u64 next = npos;
+        };
+
+        /**
+         * @brief Unlink a used slot from its node chain and put it back to the free list.
+         */
+        void unlink(u64 fd);
+
+        /**
+         * @brief Double the capacity of the store and put the new slots into the free list.
+         */
+        void grow();
+
         Vec<FileHandle> m_handles;
+        Vec<Link>       m_links;    // parallel to m_handles
+        u64             m_free   = npos;
+        usize           m_open   = 0;
+        usize           m_erased = 0;
     };
 }
@@ -4,10 +4,14 @@
 #include "madbfs/file_handle_store.hpp"
 #include "madbfs/node.hpp"
 #include "madbfs/path.hpp"
+#include "madbfs/stream.hpp"
+#include "madbfs/task_group.hpp"
+#include "madbfs/ttl_policy.hpp"
 
 #include <madbfs-common/async/async.hpp>
 #include <madbfs-common/util/var_wrapper.hpp>
 
+#include <filesystem>
 #include <functional>
 
 namespace madbfs
@@ -26,6 +30,17 @@ namespace madbfs
     {
         usize page_size;
         usize max_pages;
+        usize prefetch_budget  = 0;    // in bytes, 0 to disable media prefetch
+        usize stream_threshold = 0;    // in bytes, 0 to only bypass the cache on O_DIRECT
+        usize linger           = 0;    // in seconds, how long real fds of closed files are kept open
+
+        /**
+         * @brief Create the parameters of a cache from its sizes, like the tools take them.
+         *
+         * @param page_kib Page size in KiB, rounded up to a power of 2 within [64, 4096].
+         * @param cache_mib Cache size in MiB, at least a single page is kept.
+         */
+        static Caching of_size(usize page_kib, usize cache_mib);
     };
 
     /**
@@ -38,7 +53,8 @@ namespace madbfs
     class Filesystem
     {
     public:
-        using Filler = std::move_only_function<void(const char* name)>;
+        // returns true if the buffer is full and the listing should stop
+        using Filler = std::move_only_function<bool(const char* name, off_t offset)>;
 
         /**
          * @brief Create a new filesystem.
@@ -46,8 +62,14 @@ namespace madbfs
          * @param connection Reference to active conneciton to device.
          * @param caching Cache parameters or empty for no caching.
          * @param ttl Filesystem node's stat expiration time before re-fetching.
+         * @param mount_root Mounted root on the device, the TTL policy rules are relative to it.
          */
-        Filesystem(Connection& connection, Opt<Caching> caching, Opt<Seconds> ttl);
+        Filesystem(
+            Connection&  connection,
+            Opt<Caching> caching,
+            Opt<Seconds> ttl,
+            path::Path   mount_root = {}
+        );
 
         /**
          * @brief Destroy filesystem.
@@ -72,7 +94,7 @@ namespace madbfs
 
         // fuse operations
         // ---------------
-        AExpect<void>      readdir(path::Path path, Filler filler);
+        AExpect<void>      readdir(path::Path path, off_t offset, Filler filler, bool prefetch = true);
         AExpect<NamedStat> getattr(path::Path path);
 
         AExpect<Str>       readlink(path::Path path);
@@ -85,10 +107,12 @@ namespace madbfs
         AExpect<void>      truncate(path::Path path, off_t size);
 
         AExpect<u64>   open(path::Path path, int flags);
-        AExpect<usize> read(u64 fd, Span<char> out, off_t offset);
-        AExpect<usize> write(u64 fd, Str in, off_t offset);
-        AExpect<void>  flush(u64 fd);
+        AExpect<u64>   create(path::Path path, mode_t mode, int flags);
+        AExpect<usize> read(u64 fd, Span<char> out, off_t offset, trace::Context trace = {});
+        AExpect<usize> write(u64 fd, Str in, off_t offset, trace::Context trace = {});
+        AExpect<void>  flush(u64 fd, trace::Context trace = {});
         AExpect<void>  release(u64 fd);
+        AExpect<off_t> lseek(u64 fd, off_t offset, int whence);
 
         AExpect<usize> copy_file_range(
             path::Path in_path,
@@ -112,10 +136,31 @@ namespace madbfs
         /**
          * @brief Shut down the filesystem and stop every async operation.
          *
-         * Call this before destructor. This is needed to do proper flushing for the `Cache`.
+         * Call this before destructor. Background tasks (e.g. media prefetch, tree preload) are stopped at
+         * their next batch and awaited before the `Cache` is flushed.
          */
         Await<void> shutdown();
 
+        /**
+         * @brief List every directory under a path ahead of time.
+         *
+         * @param path Path to the top directory.
+         *
+         * @return Number of directories listed.
+         *
+         * Directories are listed level by level, a few of them at once. Directories that are synced already
+         * are not listed again but their subdirectories are still visited. Directories that fail to be
+         * listed are skipped. The preload stops early once `shutdown()` is called.
+         */
+        AExpect<usize> preload(path::Path path);
+
+        /**
+         * @brief Run `preload()` as a background task that `shutdown()` stops and awaits.
+         *
+         * @param path Path to the top directory.
+         */
+        Await<void> start_preload(path::Path path);
+
         /**
          * @brief Set a new TTL for file system nodes.
          *
@@ -125,11 +170,43 @@ namespace madbfs
          */
         Opt<Seconds> set_ttl(Opt<Seconds> ttl);
 
+        /**
+         * @brief Set a new TTL policy for file system nodes.
+         *
+         * @param policy New policy (empty policy to use the global TTL for every node).
+         *
+         * @return Old TTL policy.
+         *
+         * The policy takes precedence over the global TTL for the paths it matches.
+         */
+        TtlPolicy set_ttl_policy(TtlPolicy policy);
+
         /**
          * @brief Mark all nodes as expired.
          */
         usize expires_all();
 
+        /**
+         * @brief Save the node tree into a snapshot file.
+         *
+         * @param file Path to the snapshot file on host.
+         *
+         * @return Number of nodes saved.
+         */
+        Expect<usize> save_snapshot(const std::filesystem::path& file) const;
+
+        /**
+         * @brief Load the node tree from a snapshot file.
+         *
+         * @param file Path to the snapshot file on host.
+         *
+         * @return Number of nodes loaded.
+         *
+         * This function must be called before any operation is done on the filesystem. All the loaded nodes
+         * are marked as expired and will be revalidated lazily on access.
+         */
+        Expect<usize> load_snapshot(const std::filesystem::path& file);
+
         /**
          * @brief Get cache structure.
          */
@@ -145,6 +222,14 @@ namespace madbfs
          */
         const Node& root() const { return m_root; }
 
+        /**
+         * @brief Count the nodes in the tree, root included.
+         *
+         * The count is kept by the nodes themselves, so it's constant time. There is only one tree per
+         * process, nodes detached from it for the duration of an operation are counted too.
+         */
+        usize node_count() const { return Node::count(); }
+
         /**
          * @brief Get TTL.
          *
@@ -152,6 +237,11 @@ namespace madbfs
          */
         Opt<Seconds> ttl() const { return m_ttl; }
 
+        /**
+         * @brief Get TTL policy.
+         */
+        const TtlPolicy& ttl_policy() const { return m_ttl_policy; }
+
         /**
          * @brief Get open file handle store.
          */
@@ -159,20 +249,78 @@ namespace madbfs
 
     private:
         /**
-         * @brief Fetch file stat from remote at `path` then create a child node on `parent`.
+         * @brief Fetch stats of the missing components of `path` from remote in one request then create the
+         * nodes starting from `parent`.
+         *
+         * @param parent Deepest existing node on the path, new nodes will be created under it.
+         * @param path Full path to the file.
+         * @param depth Number of components of `path` that `parent` already covers.
          *
-         * @param parent Parent on which the child node will be created.
-         * @param path Path to the file.
+         * Fails with `Errc::not_a_directory` if an intermediate component is not a directory. The first
+         * component that can't be found is cached as an `Error` node (if the error is cacheable).
          */
-        AExpect<Ref<Node>> build(Node& parent, path::Path path);
+        AExpect<Ref<Node>> build_missing(Node& parent, path::Path path, usize depth);
 
         /**
-         * @brief Same as build but force directory only, fails with `Errc::not_a_directory` if not directory.
+         * @brief Store a file handle for a node whose real fd is already opened on the device.
          *
-         * @param parent Parent on which the child node will be created.
-         * @param path Path to the file.
+         * @param node The opened node.
+         * @param path Path to the node.
+         * @param mode Mode the node is opened with.
+         * @param real_fd Real fd on the device, handed to the cache if it is enabled.
+         *
+         * @return File handle.
+         */
+        AExpect<u64> store_handle(Node& node, path::Path path, OpenMode mode, u64 real_fd);
+
+        /**
+         * @brief Store a file handle that bypasses the cache for a node whose real fd is already opened.
+         *
+         * @param node The opened node.
+         * @param mode Mode the node is opened with.
+         * @param real_fd Real fd on the device, owned by the stream.
+         *
+         * @return File handle.
+         *
+         * Dirty pages of the node are flushed first so the stream sees them on the device, the node is clean
+         * afterwards.
          */
-        AExpect<Ref<Node>> build_directory(Node& parent, path::Path path);
+        AExpect<u64> store_stream(Node& node, OpenMode mode, u64 real_fd);
+
+        /**
+         * @brief Switch a cached file handle to bypass the cache.
+         *
+         * @param fd File handle.
+         * @param handle The file handle data.
+         *
+         * Dirty pages of the node are flushed and the node is clean afterwards. A new real fd is opened for
+         * the stream and the handle stops being counted by the cache.
+         */
+        AExpect<void> start_stream(u64 fd, FileHandle handle);
+
+        /**
+         * @brief Track the access pattern of a cached file handle and switch it to stream once the
+         * sequential run reaches the stream threshold.
+         *
+         * @param fd File handle.
+         * @param handle The file handle data.
+         * @param offset Offset of the access.
+         * @param size Size of the access.
+         *
+         * The handle stays cached if the switch fails.
+         */
+        Await<void> detect_sequential(u64 fd, FileHandle handle, off_t offset, usize size);
+
+        /**
+         * @brief Store a new file handle.
+         *
+         * @param node The opened node.
+         * @param mode Mode the node is opened with.
+         * @param real_fd Real fd on the device.
+         *
+         * @return File handle.
+         */
+        u64 new_handle(Node& node, OpenMode mode, u64 real_fd);
 
         /**
          * @brief Traverse the node or build a new node.
@@ -189,6 +337,53 @@ namespace madbfs
          */
         AExpect<void> update(Node& node, path::Path path);
 
+        /**
+         * @brief List a directory on remote and merge the result into the node's children.
+         *
+         * @param dir The directory node.
+         * @param path Path to the directory.
+         *
+         * New entries are added and missing entries are removed. Expired entries are refreshed from the
+         * listing while unexpired ones are left untouched. The directory is marked as synced afterwards.
+         */
+        AExpect<void> sync_children(Node& dir, path::Path path);
+
+        /**
+         * @brief Revalidate the expired children of a directory together.
+         *
+         * @param dir The directory node.
+         * @param path Path to the directory.
+         *
+         * The directory is stat-ed once. If its mtime is unchanged, expired children whose state is fully
+         * determined by their name (links, special files, error nodes) get their expiration extended. The
+         * rest (or every child if the mtime changed) are refreshed with a single `sync_children()`. This
+         * costs at most two requests regardless of the number of children.
+         */
+        AExpect<void> revalidate_children(Node& dir, path::Path path);
+
+        /**
+         * @brief List a directory if it is not synced yet for `preload()`.
+         *
+         * @param path Path to the directory.
+         *
+         * @return Paths of the subdirectories.
+         */
+        AExpect<Vec<path::PathBuf>> preload_dir(path::Path path);
+
+        /**
+         * @brief Get the TTL of a node at path.
+         *
+         * @param path Path to the node.
+         *
+         * @return TTL from the policy if any of its rule matches, else the global TTL (never if disabled).
+         */
+        Seconds ttl_of(path::Path path) const;
+
+        /**
+         * @brief Reset the expiration of all nodes according to current TTL and TTL policy.
+         */
+        void reset_expirations();
+
         /**
          * @brief Visit all nodes while doing operation on them.
          *
@@ -196,6 +391,16 @@ namespace madbfs
          */
         void walk(Node& start, std::function<void(Node&)> func);
 
+        /**
+         * @brief Apply the stat returned by a mutating operation.
+         *
+         * @param node The mutated node.
+         * @param stat Stat after the operation, empty if the device can't provide it.
+         *
+         * A missing stat expires the node instead, so the next access fetches it again.
+         */
+        void apply_stat(Node& node, Opt<Stat> stat);
+
         /**
          * @brief Replace the node variant with the new one while invalidating the current one.
          *
@@ -208,13 +413,56 @@ namespace madbfs
          */
         Await<void> mutate_and_invalidate(Node& node, File file);
 
+        /**
+         * @brief Prefetch the first page of media files inside a directory in the background.
+         *
+         * @param dir The directory node.
+         * @param path Path to the directory.
+         *
+         * Thumbnailers read the header of every file right after listing a directory of pictures or videos.
+         * If the directory is dominated by media files, this function pulls those headers into the cache
+         * ahead of time in batches, limited by the prefetch budget. It returns right after the prefetch is
+         * scheduled. The prefetch is a background task, it stops at the next batch once `shutdown()` is
+         * called.
+         */
+        Await<void> prefetch_media(Node& dir, path::Path path);
+
+        /**
+         * @brief Run a coroutine in the background, tracked so `shutdown()` can wait for it.
+         *
+         * @param name Name of the task for logging, must have static storage duration.
+         * @param task The coroutine; it should check `m_stopping` between its steps.
+         */
+        Await<void> spawn_background(const char* name, Await<void> task);
+
+        /**
+         * @class Run
+         *
+         * @brief Sequential access run of a cached file handle.
+         */
+        struct Run
+        {
+            off_t next   = 0;    // offset right after the last access
+            usize length = 0;    // bytes accessed sequentially so far
+        };
+
         Connection& m_connection;
 
         Node            m_root;
         Opt<Cache>      m_cache;
         FileHandleStore m_handles;
 
+        std::unordered_map<u64, Stream> m_streams;    // file handles that bypass the cache
+        std::unordered_map<u64, Run>    m_runs;
+
+        path::PathBuf m_mount_root;
+
         Opt<Seconds> m_ttl              = std::nullopt;
+        TtlPolicy    m_ttl_policy       = {};
+        usize        m_prefetch_budget  = 0;
+        usize        m_stream_threshold = 0;
+        TaskGroup    m_background       = {};
+        bool         m_stopping         = false;
         bool         m_root_initialized = false;
     };
 }
@@ -2,8 +2,11 @@
 
 #include "madbfs/args.hpp"
 #include "madbfs/connection.hpp"
+#include "madbfs/fair_queue.hpp"
 #include "madbfs/filesystem.hpp"
+#include "madbfs/metrics.hpp"
 #include "madbfs/path.hpp"
+#include "madbfs/transfer.hpp"
 
 #include <madbfs-common/ipc.hpp>
 
@@ -26,12 +29,18 @@ namespace madbfs
     public:
         Madbfs(
             struct fuse*     fuse,
+            Str              serial,
             args::Connection connection,
             Opt<Caching>     caching,
             path::Path       custom_root,
             Str              mount_point,
             Opt<Seconds>     ttl,
-            Opt<Seconds>     timeout
+            TtlPolicy        ttl_policy,
+            Opt<Seconds>     timeout,
+            bool             persist_tree,
+            bool             walk_tree,
+            Str              metrics_address,
+            usize            queue_slots
         );
 
         ~Madbfs();
@@ -72,12 +81,26 @@ namespace madbfs
 
         Filesystem&     fs() { return m_fs; }
         async::Context& ctx() { return m_async_ctx; }
+        FairQueue&      queue() { return m_queue; }
 
         Str mountpoint() const { return m_mountpoint; }
 
     private:
         struct IpcHandler;
 
+        /**
+         * @class TopBaseline
+         *
+         * @brief Counters at the previous top frame, the rates of the next frame are relative to them.
+         */
+        struct TopBaseline
+        {
+            SteadyClock::time_point            time;
+            Array<u64, metrics::fuse_op_count> ops;
+            Opt<Cache::Stats>                  cache;
+            Connection::Stats                  transport;
+        };
+
         /**
          * @brief Prepare and create connection to device.
          *
@@ -95,6 +118,16 @@ namespace madbfs
          */
         static Opt<ipc::Server> create_ipc(async::Context& ctx);
 
+        /**
+         * @brief Create a metrics exporter.
+         *
+         * @param ctx Async context.
+         * @param address Address to listen on, `"unix"` for the default unix socket path.
+         *
+         * @return Exporter if success else `std::nullopt`.
+         */
+        static Opt<ipc::Exporter> create_exporter(async::Context& ctx, Str address);
+
         /**
          * @brief Function for work thread on which async context will run on.
          */
@@ -109,6 +142,20 @@ namespace madbfs
          */
         AExpect<boost::json::value> ipc_handler(ipc::FsOp op);
 
+        /**
+         * @brief Render the metrics of the filesystem in OpenMetrics text format (without `# EOF`).
+         */
+        String openmetrics() const;
+
+        /**
+         * @brief Produce a frame of the `top` view: rates since the previous frame and current gauges.
+         *
+         * @param watched Whether there are still subscribers, the collection stops if not.
+         *
+         * @return The frame, or null on the first call since it has no previous frame to compare with.
+         */
+        boost::json::value top_frame(bool watched);
+
         /**
          * @brief Watch connection status.
          *
@@ -122,22 +169,39 @@ namespace madbfs
          */
         Await<void> reaper();
 
+        /**
+         * @brief Get the current depths of the queues served by the event loop.
+         */
+        metrics::Loop::Depth loop_depth() const;
+
+        /**
+         * @brief Measure how late a periodic timer fires to detect handlers that hold up the event loop.
+         */
+        Await<void> lag_probe();
+
         struct fuse* m_fuse;
 
         async::Context   m_async_ctx;
         async::WorkGuard m_work_guard;    // to prevent `async::Context` from returning immediately
         std::jthread     m_work_thread;
 
-        Connection       m_connection;
-        Filesystem       m_fs;
-        Opt<ipc::Server> m_ipc;
+        Connection         m_connection;
+        Filesystem         m_fs;
+        FairQueue          m_queue;
+        Transfers          m_transfers;
+        Opt<ipc::Server>   m_ipc;
+        Opt<ipc::Exporter> m_exporter;
 
         async::Timer    m_watchdog_timer;
         async::Timer    m_reaper_timer;
+        async::Timer    m_lag_timer;
         net::signal_set m_signal;
 
         path::PathBuf m_root;    // custom root for mounting subdirectory
         String        m_mountpoint;
         Opt<Seconds>  m_timeout;
+
+        Opt<std::filesystem::path> m_tree_snapshot;    // location of node tree snapshot if persisted
+        Opt<TopBaseline>           m_top_baseline;     // only while there are top subscribers
     };
 }
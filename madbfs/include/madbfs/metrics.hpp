@@ -0,0 +1,384 @@
+#pragma once
+
+#include <madbfs-common/rpc.hpp>
+
+#include <atomic>
+#include <bit>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace madbfs::metrics
+{
+    /**
+     * @enum FuseOp
+     *
+     * @brief FUSE operations that are measured.
+     */
+    enum class FuseOp : u8
+    {
+        Getattr,
+        Readlink,
+        Mknod,
+        Mkdir,
+        Unlink,
+        Rmdir,
+        Rename,
+        Truncate,
+        Open,
+        Create,
+        Read,
+        Write,
+        Flush,
+        Release,
+        Readdir,
+        Utimens,
+        Lseek,
+        CopyFileRange,
+    };
+
+    constexpr usize fuse_op_count   = static_cast<usize>(FuseOp::CopyFileRange) + 1;
+    constexpr usize procedure_count = std::variant_size_v<rpc::Request::Var>;
+
+    /**
+     * @brief Return string representation of enum FuseOp.
+     */
+    Str to_string(FuseOp op);
+
+    /**
+     * @class Summary
+     *
+     * @brief Summary of a histogram, latencies (and their sum) are in microseconds.
+     */
+    struct Summary
+    {
+        u64 count  = 0;
+        u64 errors = 0;
+        u64 sum    = 0;
+        u64 p50    = 0;
+        u64 p90    = 0;
+        u64 p99    = 0;
+        u64 max    = 0;
+    };
+
+    /**
+     * @class Histogram
+     *
+     * @brief Latency histogram with log-linear buckets in the manner of HDR histogram.
+     *
+     * Values below `2^sub_bits` have a bucket each, above that every power of two is split into `2^sub_bits`
+     * buckets, so the relative error of a reported value is at most `2^-sub_bits` (12.5%). Values above
+     * `2^max_exp` microseconds (about 19 hours) are put into the last bucket.
+     *
+     * Recording is lock-free: every thread increments relaxed atomic counters in a shard of its own (threads
+     * are assigned to shards round-robin), so it's cheap enough to be always on. A summary adds up the
+     * shards, it may miss the recordings that happen at the same time.
+     */
+    class Histogram
+    {
+    public:
+        static constexpr usize sub_bits     = 3;
+        static constexpr usize max_exp      = 36;
+        static constexpr usize bucket_count = (max_exp - sub_bits + 2) << sub_bits;
+        static constexpr usize shard_count  = 16;
+
+        /**
+         * @brief Record a latency.
+         *
+         * @param micros Latency in microseconds.
+         * @param error Whether the operation failed.
+         */
+        void record(u64 micros, bool error);
+
+        /**
+         * @class Snapshot
+         *
+         * @brief Counters of a histogram added up from its shards at one point in time.
+         *
+         * Everything derived from the same snapshot is consistent, e.g. the cumulative counts never exceed
+         * the total count even while latencies are being recorded.
+         */
+        struct Snapshot
+        {
+            Array<u64, bucket_count> buckets = {};
+
+            u64 count  = 0;
+            u64 errors = 0;
+            u64 sum    = 0;
+            u64 max    = 0;
+
+            /**
+             * @brief Summarize the latencies.
+             */
+            Summary summary() const;
+
+            /**
+             * @brief Count the latencies at or below each bound.
+             *
+             * @param bounds Upper bounds in microseconds in ascending order.
+             *
+             * @return Cumulative counts, one for each bound.
+             *
+             * A bucket is counted for a bound only if its highest value is at or below it, so a latency
+             * slightly below a bound that shares a bucket with values above it is counted for the next bound.
+             */
+            Vec<u64> count_below(Span<const u64> bounds) const;
+        };
+
+        /**
+         * @brief Add up the counters of every shard.
+         */
+        Snapshot snapshot() const;
+
+        /**
+         * @brief Summarize the recorded latencies.
+         */
+        Summary summary() const { return snapshot().summary(); }
+
+        /**
+         * @brief Count the recorded latencies at or below each bound.
+         *
+         * @param bounds Upper bounds in microseconds in ascending order.
+         *
+         * @return Cumulative counts, one for each bound (see `Snapshot::count_below`).
+         */
+        Vec<u64> count_below(Span<const u64> bounds) const { return snapshot().count_below(bounds); }
+
+        /**
+         * @brief Get the bucket of a value.
+         *
+         * @param value The value.
+         */
+        static constexpr usize bucket_of(u64 value)
+        {
+            if (value < (1uz << sub_bits)) {
+                return value;
+            }
+
+            auto exp  = static_cast<usize>(std::bit_width(value)) - 1;
+            auto sub  = (value >> (exp - sub_bits)) & ((1uz << sub_bits) - 1);
+            auto slot = ((exp - sub_bits + 1) << sub_bits) + sub;
+
+            return std::min(slot, bucket_count - 1);
+        }
+
+        /**
+         * @brief Get the highest value that falls into a bucket.
+         *
+         * @param bucket The bucket.
+         */
+        static constexpr u64 highest_of(usize bucket)
+        {
+            if (bucket < (1uz << sub_bits)) {
+                return bucket;
+            }
+
+            auto exp   = (bucket >> sub_bits) + sub_bits - 1;
+            auto sub   = bucket & ((1uz << sub_bits) - 1);
+            auto lower = ((1uz << sub_bits) | sub) << (exp - sub_bits);
+
+            return lower + (1uz << (exp - sub_bits)) - 1;
+        }
+
+    private:
+        struct alignas(64) Shard
+        {
+            Array<std::atomic<u64>, bucket_count> buckets = {};
+            std::atomic<u64>                      errors  = 0;
+            std::atomic<u64>                      sum     = 0;
+            std::atomic<u64>                      max     = 0;
+        };
+
+        Array<Shard, shard_count> m_shards;
+    };
+
+    /**
+     * @brief Get the histogram of a FUSE operation.
+     *
+     * @param op The operation.
+     *
+     * Histograms live for the whole process, so they can be recorded into from any thread at any time.
+     */
+    Histogram& of(FuseOp op);
+
+    /**
+     * @brief Get the histogram of an RPC procedure (measured on the client side, retries included).
+     *
+     * @param proc The procedure.
+     */
+    Histogram& of(rpc::Procedure proc);
+
+    /**
+     * @class Activity
+     *
+     * @brief Bytes read and written per path and operations per process within a window of time.
+     *
+     * Unlike the histograms, a recording needs a lock and a lookup, so nothing is recorded unless it is
+     * enabled (by a live view like `madbfs-msg top`). The window is collected and restarted with `take()`.
+     */
+    class Activity
+    {
+    public:
+        static constexpr usize max_keys  = 4096;    // the rest is put under `other_key`
+        static constexpr Str   other_key = "<other>";
+
+        struct Window
+        {
+            std::unordered_map<String, u64> path_bytes;     // bytes read and written through FUSE
+            std::unordered_map<String, u64> process_ops;    // FUSE operations issued
+
+            u64 read_bytes  = 0;
+            u64 write_bytes = 0;
+        };
+
+        /**
+         * @brief Enable or disable recording, the current window is discarded on disable.
+         *
+         * @param enabled Whether to record.
+         */
+        void set_enabled(bool enabled);
+
+        /**
+         * @brief Check whether recording is enabled.
+         */
+        bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief Record a read or write of a file.
+         *
+         * @param path Path of the file.
+         * @param bytes Number of bytes read or written.
+         * @param write Whether it's a write.
+         */
+        void record_io(Str path, u64 bytes, bool write);
+
+        /**
+         * @brief Record an operation issued by a process.
+         *
+         * @param process Name of the process.
+         */
+        void record_op(Str process);
+
+        /**
+         * @brief Get the current window and start a new one.
+         */
+        Window take();
+
+    private:
+        std::atomic<bool> m_enabled = false;
+        std::mutex        m_mutex;
+        Window            m_window;
+    };
+
+    /**
+     * @brief Get the activity of the filesystem.
+     *
+     * Like the histograms, it lives for the whole process.
+     */
+    Activity& activity();
+
+    /**
+     * @class Loop
+     *
+     * @brief Lateness of a periodic timer on the event loop and the moments it stalled.
+     *
+     * All async work runs on a single thread, so a handler that runs for long delays every other handler,
+     * the timer included. The lateness is recorded into a histogram, while a lateness above the stall
+     * threshold is also kept along with the queue depths at that moment.
+     */
+    class Loop
+    {
+    public:
+        static constexpr auto  interval        = Milliseconds{ 100 };    // period of the timer
+        static constexpr u64   stall_threshold = 50'000;                 // microseconds
+        static constexpr usize max_stalls      = 32;                     // the oldest is dropped first
+
+        struct Depth
+        {
+            u64 transport_queued   = 0;    // requests waiting to be written to the transport
+            u64 transport_inflight = 0;    // requests waiting for their response
+            u64 connection         = 0;    // requests issued by the filesystem, retries included
+            u64 read_queue         = 0;    // cache pages still pulling data
+        };
+
+        struct Stall
+        {
+            std::chrono::system_clock::time_point time;
+            u64                                   lag;    // microseconds
+            Depth                                 depth;
+        };
+
+        /**
+         * @brief Record the lateness of the timer.
+         *
+         * @param lag Lateness in microseconds.
+         * @param depth Queue depths at the time the timer fired.
+         */
+        void record(u64 lag, const Depth& depth);
+
+        /**
+         * @brief Get the lateness histogram.
+         */
+        const Histogram& lag() const { return *m_lag; }
+
+        /**
+         * @brief Get the latest stalls, oldest first.
+         */
+        Vec<Stall> stalls() const;
+
+    private:
+        Uniq<Histogram>    m_lag = std::make_unique<Histogram>();
+        mutable std::mutex m_mutex;
+        std::deque<Stall>  m_stalls;
+    };
+
+    /**
+     * @brief Get the event loop lag of the filesystem.
+     *
+     * Like the histograms, it lives for the whole process.
+     */
+    Loop& loop();
+
+    /**
+     * @class Stopwatch
+     *
+     * @brief Measure the latency of an operation.
+     *
+     * The latency is recorded on `stop()` or on destruction as an error if it's not stopped.
+     */
+    class Stopwatch
+    {
+    public:
+        Stopwatch(Histogram& histogram)
+            : m_histogram{ &histogram }
+            , m_start{ SteadyClock::now() }
+        {
+        }
+
+        ~Stopwatch()
+        {
+            if (m_histogram) {
+                stop(false);
+            }
+        }
+
+        Stopwatch(Stopwatch&&)            = delete;
+        Stopwatch& operator=(Stopwatch&&) = delete;
+
+        /**
+         * @brief Record the latency up to now.
+         *
+         * @param ok Whether the operation succeeded.
+         */
+        void stop(bool ok)
+        {
+            auto elapsed = SteadyClock::now() - m_start;
+            auto micros  = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+            std::exchange(m_histogram, nullptr)->record(static_cast<u64>(micros), not ok);
+        }
+
+    private:
+        Histogram*              m_histogram;
+        SteadyClock::time_point m_start;
+    };
+}
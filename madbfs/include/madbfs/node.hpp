@@ -7,11 +7,14 @@
 
 #include <atomic>
 #include <functional>
+#include <limits>
+#include <map>
 #include <unordered_set>
 
 namespace madbfs
 {
     class Connection;
+    class FileHandleStore;
     class Node;
 }
 
@@ -37,6 +40,11 @@ namespace madbfs::node
      * @class Directory
      *
      * @brief Represent a directory.
+     *
+     * Every child gets a cookie on insertion that increases monotonically within the directory. Listing the
+     * children by cookie gives a stable order that is not disturbed by insertion or removal of other
+     * children, so the cookie can be used as the readdir offset. A child that replaces another one with the
+     * same name keeps the cookie of the replaced child.
      */
     class Directory
     {
@@ -60,7 +68,8 @@ namespace madbfs::node
         };
 
         // NOTE: use with caution, Node::m_name field must not be modified unless the node is extracted
-        using List = std::unordered_set<Uniq<Node>, NodeHash, NodeEq>;
+        using List  = std::unordered_set<Uniq<Node>, NodeHash, NodeEq>;
+        using Order = std::map<u64, Node*>;
 
         Directory() = default;
 
@@ -110,12 +119,31 @@ namespace madbfs::node
          */
         Expect<Uniq<Node>> extract(Str name);
 
-        List&       children() { return m_children; }
-        const List& children() const { return m_children; }
+        /**
+         * @brief Remove every child.
+         */
+        void clear();
+
+        /**
+         * @brief Get children in insertion order, starting right after a cookie.
+         *
+         * @param cookie Cookie of the last listed child, 0 to start from the beginning.
+         *
+         * @return Range of cookie and node pairs.
+         */
+        auto list_after(u64 cookie) const
+        {
+            return sr::subrange{ m_order.upper_bound(cookie), m_order.end() };
+        }
+
+        const List&  children() const { return m_children; }
+        const Order& order() const { return m_order; }
 
     private:
-        List m_children;
-        bool m_has_readdir = false;
+        List  m_children;
+        Order m_order;
+        u64   m_next_cookie = 1;
+        bool  m_has_readdir = false;
     };
 
     /**
@@ -181,14 +209,22 @@ namespace madbfs
             , m_stat{ std::move(stat) }
             , m_value{ std::move(value) }
         {
+            s_count.fetch_add(1, std::memory_order::relaxed);
         }
 
+        ~Node() { s_count.fetch_sub(1, std::memory_order::relaxed); }
+
         Node(Node&&)                  = delete;
         Node& operator=(Node&& other) = delete;
 
         Node(const Node&)            = delete;
         Node& operator=(const Node&) = delete;
 
+        /**
+         * @brief Number of nodes alive in the process, kept on construction and destruction.
+         */
+        static usize count() { return s_count.load(std::memory_order::relaxed); }
+
         Id id() const { return m_id; };
 
         void set_name(Str name) { m_name = name; }
@@ -200,6 +236,7 @@ namespace madbfs
         Node*       parent() const { return m_parent; }
         const File& value() const { return m_value; }
         const Stat& stat() const { return m_stat; }
+        u64         cookie() const { return m_cookie; }
 
         /**
          * @brief Set expiration from current time + duration.
@@ -336,13 +373,19 @@ namespace madbfs
         bool is_error() const { return std::holds_alternative<node::Error>(m_value); }
 
     private:
-        inline static std::atomic<u64> s_id_counter = 0;
+        friend class node::Directory;         // assigns cookie
+        friend class madbfs::FileHandleStore;    // chains the handles
+
+        inline static std::atomic<u64>   s_id_counter = 0;
+        inline static std::atomic<usize> s_count      = 0;
 
         Node*     m_parent     = nullptr;
         String    m_name       = {};
         Id        m_id         = {};
         Stat      m_stat       = {};
         Timepoint m_expiration = Timepoint::max();
+        u64       m_cookie     = 0;    // position in parent directory listing, see `node::Directory`
+        u64       m_handles    = std::numeric_limits<u64>::max();    // see `FileHandleStore`
         File      m_value;
     };
 }
@@ -20,6 +20,7 @@ namespace madbfs::operations
     i32 rename(const char*, const char*, u32) noexcept;
     i32 truncate(const char*, off_t, fuse_file_info*) noexcept;
     i32 open(const char*, fuse_file_info*) noexcept;
+    i32 create(const char*, mode_t, fuse_file_info*) noexcept;
     i32 read(const char*, char*, usize, off_t, fuse_file_info*) noexcept;
     i32 write(const char*, const char*, usize, off_t, fuse_file_info*) noexcept;
     i32 flush(const char*, fuse_file_info*) noexcept;
@@ -28,6 +29,8 @@ namespace madbfs::operations
     i32 access(const char*, i32) noexcept;
     i32 utimens(const char*, const timespec tv[2], fuse_file_info*) noexcept;
 
+    off_t lseek(const char*, off_t, int, fuse_file_info*) noexcept;
+
     isize copy_file_range(
         const char*            path_in,
         struct fuse_file_info* fi_in,
@@ -70,7 +73,7 @@ namespace madbfs::operations
         .init            = madbfs::operations::init,       // entry point of fuse_main
         .destroy         = madbfs::operations::destroy,    // exit point of fuse_main
         .access          = madbfs::operations::access,
-        .create          = nullptr,
+        .create          = madbfs::operations::create,
         .lock            = nullptr,
         .utimens         = madbfs::operations::utimens,
         .bmap            = nullptr,
@@ -81,6 +84,6 @@ namespace madbfs::operations
         .flock           = nullptr,
         .fallocate       = nullptr,
         .copy_file_range = madbfs::operations::copy_file_range,
-        .lseek           = nullptr,
+        .lseek           = madbfs::operations::lseek,
     };
 }
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <madbfs-common/async/async.hpp>
+
+#include <saf.hpp>
+
+#include <deque>
+
+namespace madbfs
+{
+    class Connection;
+}
+
+namespace madbfs
+{
+    /**
+     * @class Stream
+     *
+     * @brief Uncached I/O on a real fd through a small private ring buffer.
+     *
+     * Sequential reads are served from a ring of fixed-size chunks. Each read schedules the chunks that
+     * follow it, so several large `Read` requests are in flight at once while the current one is consumed.
+     * A read that doesn't continue from the previous one is forwarded as is and doesn't touch the ring.
+     *
+     * Writes are coalesced into a chunk that is sent in the background once it is full or a non-contiguous
+     * write arrives, with at most as many writes in flight as the ring size. Errors of the background writes
+     * are reported by the next write or by `flush()`.
+     *
+     * The data never goes through `Cache`, so one-shot transfers of large files don't evict the pages that
+     * are used interactively. Chunks are shared with their in-flight requests, so the stream can be
+     * destroyed at any time, though pending writes are lost unless it is flushed first.
+     */
+    class Stream
+    {
+    public:
+        static constexpr usize default_chunk_size = 1024 * 1024;
+        static constexpr usize default_depth      = 4;
+
+        /**
+         * @brief Construct a new stream.
+         *
+         * @param connection Connection to the device.
+         * @param fd Real fd on the device.
+         * @param chunk_size Size of a single read/write request.
+         * @param depth Number of chunks in the ring (maximum number of requests in flight).
+         */
+        Stream(
+            Connection& connection,
+            u64         fd,
+            usize       chunk_size = default_chunk_size,
+            usize       depth      = default_depth
+        );
+
+        /**
+         * @brief Read from the file.
+         *
+         * @param out Buffer to read into.
+         * @param offset Offset to read from.
+         *
+         * @return Number of bytes read.
+         *
+         * Pending writes are flushed first.
+         */
+        AExpect<usize> read(Span<char> out, off_t offset);
+
+        /**
+         * @brief Write into the file.
+         *
+         * @param in Buffer to write from.
+         * @param offset Offset to write to.
+         *
+         * @return Number of bytes accepted.
+         */
+        AExpect<usize> write(Span<const char> in, off_t offset);
+
+        /**
+         * @brief Send pending writes and wait for every write in flight.
+         */
+        AExpect<void> flush();
+
+        /**
+         * @brief Get the real fd on the device.
+         */
+        u64 fd() const { return m_fd; }
+
+        /**
+         * @brief Check whether the file has been written through this stream.
+         */
+        bool modified() const { return m_modified; }
+
+    private:
+        struct Chunk
+        {
+            usize                    index;
+            usize                    size;
+            Uniq<char[]>             data;
+            saf::shared_future<Errc> ready;
+        };
+
+        /**
+         * @brief Request a chunk in the background if it is not in the ring already.
+         *
+         * @param exec Executor to spawn the request on.
+         * @param index Index of the chunk.
+         */
+        void schedule(async::Executor exec, usize index);
+
+        /**
+         * @brief Wait for a chunk in the ring.
+         *
+         * @param exec Executor to spawn the request on if the chunk is not scheduled.
+         * @param index Index of the chunk.
+         */
+        AExpect<Shared<Chunk>> fetch(async::Executor exec, usize index);
+
+        /**
+         * @brief Send the pending write in the background.
+         */
+        AExpect<void> submit();
+
+        /**
+         * @brief Wait until at most `keep` writes are in flight.
+         *
+         * @param keep Number of writes allowed to stay in flight.
+         */
+        AExpect<void> drain(usize keep);
+
+        Connection& m_connection;
+        u64         m_fd;
+        usize       m_chunk_size;
+
+        Vec<Shared<Chunk>> m_ring;
+        off_t              m_position = 0;    // end of last read
+        bool               m_modified = false;
+
+        Vec<char>                            m_pending;
+        off_t                                m_pending_offset = 0;
+        std::deque<saf::shared_future<Errc>> m_writes;
+    };
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <madbfs-common/async/async.hpp>
+
+#include <saf.hpp>
+
+namespace madbfs
+{
+    /**
+     * @class TaskGroup
+     *
+     * @brief Count of the tasks running in the background that can be waited until it drops to zero.
+     *
+     * A task calls `enter()` when it starts and `leave()` when it completes, the last one to leave wakes up
+     * whoever waits on `wait()`. The group is not thread safe, all of its functions are expected to be called
+     * from the thread the async context runs on.
+     */
+    class TaskGroup
+    {
+    public:
+        /**
+         * @brief Count a task that starts.
+         */
+        void enter() { ++m_count; }
+
+        /**
+         * @brief Uncount a task that completes, waking up the waiters if it's the last one.
+         */
+        void leave();
+
+        /**
+         * @brief Wait until no task is running.
+         */
+        Await<void> wait();
+
+        usize count() const { return m_count; }
+
+    private:
+        usize                         m_count = 0;
+        Opt<saf::promise<Errc>>       m_idle;    // set while someone waits
+        Opt<saf::shared_future<Errc>> m_idle_future;
+    };
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <madbfs-common/aliases.hpp>
+
+#include <atomic>
+#include <mutex>
+
+namespace madbfs::trace
+{
+    /**
+     * @enum Side
+     *
+     * @brief Where a span is measured.
+     */
+    enum class Side : u8
+    {
+        Client,
+        Server,
+    };
+
+    /**
+     * @class Event
+     *
+     * @brief A span of time spent in a part of a traced operation.
+     *
+     * Name and category must have static lifetime.
+     */
+    struct Event
+    {
+        u64                     trace;
+        Str                     name;
+        Str                     category;
+        Side                    side;
+        SteadyClock::time_point start;
+        SteadyClock::time_point end;
+    };
+
+    /**
+     * @class Context
+     *
+     * @brief Trace context of an operation, passed down to every layer the operation goes through.
+     *
+     * A default constructed context is not sampled, recording into it does nothing. Copying it is cheap.
+     */
+    class Context
+    {
+    public:
+        Context() = default;
+
+        explicit Context(u64 id)
+            : m_id{ id }
+        {
+        }
+
+        /**
+         * @brief Get the id of the trace, 0 if not sampled.
+         */
+        u64 id() const { return m_id; }
+
+        /**
+         * @brief Check whether the operation is sampled.
+         */
+        bool sampled() const { return m_id != 0; }
+
+        /**
+         * @brief Record a span of this trace.
+         *
+         * @param name Name of the span.
+         * @param category Category of the span (the layer it's measured in).
+         * @param start Start of the span.
+         * @param end End of the span.
+         * @param side Where the span is measured.
+         */
+        void record(
+            Str                     name,
+            Str                     category,
+            SteadyClock::time_point start,
+            SteadyClock::time_point end  = SteadyClock::now(),
+            Side                    side = Side::Client
+        ) const;
+
+    private:
+        u64 m_id = 0;
+    };
+
+    /**
+     * @class Scope
+     *
+     * @brief Record a span from construction until destruction.
+     */
+    class Scope
+    {
+    public:
+        Scope(Context context, Str name, Str category)
+            : m_context{ context }
+            , m_name{ name }
+            , m_category{ category }
+            , m_start{ context.sampled() ? SteadyClock::now() : SteadyClock::time_point{} }
+        {
+        }
+
+        ~Scope()
+        {
+            if (m_context.sampled()) {
+                m_context.record(m_name, m_category, m_start);
+            }
+        }
+
+        Scope(Scope&&)            = delete;
+        Scope& operator=(Scope&&) = delete;
+
+    private:
+        Context                 m_context;
+        Str                     m_name;
+        Str                     m_category;
+        SteadyClock::time_point m_start;
+    };
+
+    /**
+     * @class Recorder
+     *
+     * @brief Sample operations and keep the most recent spans of the sampled ones.
+     *
+     * One in every `rate` operations is sampled (0 disables tracing, the default). Starting an operation is a
+     * relaxed atomic load when tracing is disabled, the spans are kept in a ring buffer behind a lock.
+     */
+    class Recorder
+    {
+    public:
+        static constexpr usize max_spans = 16384;    // older spans are overwritten
+
+        /**
+         * @brief Set the sampling rate.
+         *
+         * @param rate Sample one in every `rate` operations, 0 disables tracing.
+         *
+         * @return The old rate.
+         */
+        u32 set_rate(u32 rate) { return m_rate.exchange(rate, std::memory_order_relaxed); }
+
+        /**
+         * @brief Get the sampling rate.
+         */
+        u32 rate() const { return m_rate.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief Start an operation, it's sampled according to the rate.
+         */
+        Context start();
+
+        /**
+         * @brief Keep a span.
+         *
+         * @param event The span.
+         */
+        void record(Event event);
+
+        /**
+         * @brief Take the kept spans in the order they are recorded.
+         */
+        Vec<Event> take();
+
+    private:
+        std::atomic<u32> m_rate    = 0;
+        std::atomic<u64> m_counter = 0;
+
+        std::mutex m_mutex;
+        Vec<Event> m_events;
+        usize      m_next = 0;    // position to be overwritten once full
+    };
+
+    /**
+     * @brief Get the trace recorder, it lives for the whole process.
+     */
+    Recorder& recorder();
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include "madbfs/path.hpp"
+#include "madbfs/task_group.hpp"
+
+#include <madbfs-common/async/async.hpp>
+
+#include <filesystem>
+#include <map>
+
+namespace madbfs
+{
+    class Filesystem;
+}
+
+namespace madbfs
+{
+    /**
+     * @class Transfers
+     *
+     * @brief Bulk pull/push jobs between the device and the host that don't go through FUSE.
+     *
+     * A job copies a file or a whole directory tree. It runs in the background on the async context of the
+     * filesystem and shares its connection. Files are transferred in large chunks through handles that
+     * bypass the cache (`O_DIRECT`), so each file is read or written through a pipelined stream, and several
+     * files are transferred in parallel.
+     *
+     * A file that already exists at the destination is overwritten, unless the job is started with `resume`.
+     * Then a destination file that is not larger than the source is checked against it: if the last chunk
+     * before its end has the same content on both sides, the transfer continues from its size (a file with
+     * the same size is considered complete), otherwise it is transferred again from the start. Running the
+     * same job again after it is interrupted only transfers the rest.
+     *
+     * The host file I/O is blocking, so it runs on a thread of its own instead of the async context.
+     */
+    class Transfers
+    {
+    public:
+        static constexpr usize default_parallel   = 4;
+        static constexpr usize default_chunk_size = 1024 * 1024;
+        static constexpr usize max_finished       = 64;
+
+        enum class Kind
+        {
+            Pull,
+            Push,
+        };
+
+        enum class Status
+        {
+            Running,
+            Done,
+            Failed,
+            Cancelled,
+        };
+
+        struct Progress
+        {
+            usize done  = 0;
+            usize total = 0;
+        };
+
+        /**
+         * @class Job
+         *
+         * @brief State and progress of a job.
+         */
+        struct Job
+        {
+            u64                   id;
+            Kind                  kind;
+            path::PathBuf         device;
+            std::filesystem::path host;
+            bool                  resume;
+
+            Status   status = Status::Running;
+            Errc     error  = {};    // first error encountered, the job goes on with the other files
+            Progress files  = {};
+            Progress bytes  = {};    // resumed bytes count as done
+
+            bool cancel = false;
+        };
+
+        /**
+         * @brief Construct a new job manager.
+         *
+         * @param fs Filesystem the jobs operate on.
+         * @param parallel Number of files transferred at once in a job.
+         * @param chunk_size Size of a single read/write of a file.
+         */
+        Transfers(Filesystem& fs, usize parallel = default_parallel, usize chunk_size = default_chunk_size);
+
+        /**
+         * @brief Start a job that copies a file or directory from the device to the host.
+         *
+         * @param device Path on the device (root of the filesystem included).
+         * @param host Absolute path on the host.
+         * @param resume Continue the files already partially copied to the host instead of overwriting.
+         *
+         * @return Id of the job or `Errc::invalid_argument` if the host path is not absolute.
+         */
+        AExpect<u64> pull(path::PathBuf device, std::filesystem::path host, bool resume = false);
+
+        /**
+         * @brief Start a job that copies a file or directory from the host to the device.
+         *
+         * @param host Absolute path on the host.
+         * @param device Path on the device (root of the filesystem included).
+         * @param resume Continue the files already partially copied to the device instead of overwriting.
+         *
+         * @return Id of the job or `Errc::invalid_argument` if the host path is not absolute.
+         */
+        AExpect<u64> push(std::filesystem::path host, path::PathBuf device, bool resume = false);
+
+        /**
+         * @brief Request a running job to stop.
+         *
+         * @param id Id of the job.
+         *
+         * @return The job or `Errc::no_such_process` if there is no such job.
+         *
+         * The job stops after the chunks in flight are done.
+         */
+        Expect<Ref<const Job>> cancel(u64 id);
+
+        /**
+         * @brief Cancel every running job and wait for them to stop.
+         */
+        Await<void> shutdown();
+
+        /**
+         * @brief Get all the jobs, running or finished.
+         */
+        const std::map<u64, Shared<Job>>& jobs() const { return m_jobs; }
+
+    private:
+        struct Entry
+        {
+            path::PathBuf         device;
+            std::filesystem::path host;
+            usize                 size;
+        };
+
+        /**
+         * @brief Register a new job and run it in the background.
+         *
+         * @param kind Kind of the job.
+         * @param device Path on the device.
+         * @param host Path on the host.
+         * @param resume Whether partially copied files are continued.
+         */
+        AExpect<u64> start(Kind kind, path::PathBuf device, std::filesystem::path host, bool resume);
+
+        /**
+         * @brief Run a job until it is finished.
+         *
+         * @param job The job.
+         */
+        Await<void> run(Shared<Job> job);
+
+        /**
+         * @brief List the files to pull, creating the directories on the host along the way.
+         *
+         * @param job The job.
+         */
+        AExpect<Vec<Entry>> scan_device(Job& job);
+
+        /**
+         * @brief List the files to push, creating the directories on the device along the way.
+         *
+         * @param job The job.
+         */
+        AExpect<Vec<Entry>> scan_host(Job& job);
+
+        /**
+         * @brief Copy a single file from the device to the host.
+         *
+         * @param job The job.
+         * @param entry The file.
+         */
+        AExpect<void> pull_file(Job& job, const Entry& entry);
+
+        /**
+         * @brief Copy a single file from the host to the device.
+         *
+         * @param job The job.
+         * @param entry The file.
+         */
+        AExpect<void> push_file(Job& job, const Entry& entry);
+
+        /**
+         * @brief Check whether a partial copy of a file has the same content as the file over its last chunk.
+         *
+         * @param device Path of the file on the device.
+         * @param host Host file descriptor.
+         * @param size Size of the partial copy, not larger than the file.
+         *
+         * @return True if the chunk before `size` is the same on the device and the host.
+         */
+        AExpect<bool> same_tail(path::Path device, int host, usize size);
+
+        /**
+         * @brief Read from a host file on the I/O thread.
+         *
+         * @param fd Host file descriptor.
+         * @param out Output buffer.
+         * @param offset Read offset.
+         *
+         * @return Number of bytes read, less than the buffer size only at the end of the file.
+         */
+        AExpect<usize> read_host(int fd, Span<char> out, usize offset);
+
+        /**
+         * @brief Write the whole buffer into a host file on the I/O thread.
+         *
+         * @param fd Host file descriptor.
+         * @param in Input buffer.
+         * @param offset Write offset.
+         */
+        AExpect<void> write_host(int fd, Span<const char> in, usize offset);
+
+        Filesystem&      m_fs;
+        net::thread_pool m_pool;
+        usize            m_parallel;
+        usize            m_chunk_size;
+
+        std::map<u64, Shared<Job>> m_jobs;
+        u64                        m_next_id = 1;
+        TaskGroup                  m_running = {};
+    };
+}
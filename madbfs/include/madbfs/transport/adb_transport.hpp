@@ -27,13 +27,14 @@ namespace madbfs::transport
 
         // overrides
         // ---------
-        Str  name() const override { return "adb"; }
-        bool running() const override { return m_running; }
+        Str   name() const override { return "adb"; }
+        bool  running() const override { return m_running; }
+        Depth depth() const override;
 
         void stop(rpc::Status status) override;
 
         Await<void>            start() override;
-        AExpect<rpc::Response> send(rpc::Request req) override;
+        AExpect<rpc::Response> send(rpc::Request req, trace::Context trace) override;
         AExpect<rpc::Response> send(rpc::Request req, Milliseconds timeout) override;
         // ---------
 
@@ -85,6 +86,7 @@ namespace madbfs::transport
 
         net::thread_pool m_pool;
 
+        usize          m_queued  = 0;    // requests sent to the channel but not yet received from it
         rpc::Id::Inner m_counter = 0;
         bool           m_running = false;
     };
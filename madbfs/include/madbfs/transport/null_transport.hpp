@@ -30,7 +30,7 @@ namespace madbfs::transport
         void        stop(rpc::Status) override { }
         Await<void> start() override { co_return; }
 
-        AExpect<rpc::Response> send(rpc::Request) override { co_return Unexpect{ m_errc }; }
+        AExpect<rpc::Response> send(rpc::Request, trace::Context) override { co_return Unexpect{ m_errc }; }
         AExpect<rpc::Response> send(rpc::Request, Milliseconds) override { co_return Unexpect{ m_errc }; }
         // ---------
 
@@ -39,13 +39,14 @@ namespace madbfs::transport
 
         // overrides
         // ---------
-        Str  name() const override { return "proxy"; }
-        bool running() const override { return m_running; }
+        Str   name() const override { return "proxy"; }
+        bool  running() const override { return m_running; }
+        Depth depth() const override;
 
         void stop(rpc::Status status) override;
 
         Await<void>            start() override;
-        AExpect<rpc::Response> send(rpc::Request req) override;
+        AExpect<rpc::Response> send(rpc::Request req, trace::Context trace) override;
         AExpect<rpc::Response> send(rpc::Request req, Milliseconds timeout) override;
 
         // ---------
@@ -57,6 +58,11 @@ namespace madbfs::transport
         {
             rpc::Request                        req;
             saf::promise<Expect<rpc::Response>> result;
+
+            // only set for traced requests
+            trace::Context          trace  = {};
+            SteadyClock::time_point queued = {};
+            SteadyClock::time_point sent   = {};
         };
 
         using Inflight = std::unordered_map<rpc::Id, Promise, rpc::Id::Hash>;
@@ -70,9 +76,21 @@ namespace madbfs::transport
         ProxyTransport(Uniq<Process> process, rpc::Socket socket);
 
         /**
-         * @brief Generate next id.
+         * @brief Generate next id, the trace bit is left for the caller to set.
+         */
+        rpc::Id next_id() { return ++m_counter & ~rpc::Id::trace_bit; }    // starts from 1
+
+        /**
+         * @brief Record the spans of a traced request once its response header is received.
+         *
+         * @param promise The request.
+         * @param timing Timing of the request on the server.
+         * @param received Time the response header is received.
+         *
+         * The clocks of the device and the host are not comparable, so the server spans are put in the middle
+         * of the round trip, assuming the network latency is the same both ways.
          */
-        rpc::Id next_id() { return ++m_counter; }    // starts from 1
+        void record_round_trip(const Promise& promise, rpc::Timing timing, SteadyClock::time_point received);
 
         /**
          * @brief Detached coroutine for sending requests.
@@ -90,6 +108,7 @@ namespace madbfs::transport
         Channel     m_channel;
         Inflight    m_requests;
 
+        usize          m_queued  = 0;    // requests sent to the channel but not yet received from it
         rpc::Id::Inner m_counter = 0;
         bool           m_running = false;
     };
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "madbfs/trace.hpp"
+
 #include <madbfs-common/aliases.hpp>
 #include <madbfs-common/rpc.hpp>
 
@@ -8,6 +10,17 @@ namespace madbfs::transport
     class Transport
     {
     public:
+        /**
+         * @class Depth
+         *
+         * @brief Number of requests waiting in the transport.
+         */
+        struct Depth
+        {
+            usize queued   = 0;    // waiting in the channel to be written to the socket
+            usize inflight = 0;    // written to the socket, waiting for the response
+        };
+
         virtual ~Transport() = default;
 
         /**
@@ -20,6 +33,13 @@ namespace madbfs::transport
          */
         virtual bool running() const = 0;
 
+        /**
+         * @brief Get the number of requests waiting in the transport.
+         *
+         * Transports without a queue of their own report zero.
+         */
+        virtual Depth depth() const { return {}; }
+
         /**
          * @brief Cancel all operation then stop and close the client sender/receiver channel and the socket.
          *
@@ -39,10 +59,13 @@ namespace madbfs::transport
          * @brief Send request through the transport.
          *
          * @param req The requested procedure.
+         * @param trace Trace context of the operation the request is part of.
          *
          * @return The returned response or error.
+         *
+         * A transport may record spans of the request (and the timing on the server) if the trace is sampled.
          */
-        virtual AExpect<rpc::Response> send(rpc::Request req) = 0;
+        virtual AExpect<rpc::Response> send(rpc::Request req, trace::Context trace) = 0;
 
         /**
          * @brief Send request through the transport.
@@ -58,14 +81,15 @@ namespace madbfs::transport
          * @brief Request send wrapper.
          *
          * @param req Operation request.
+         * @param trace Trace context of the operation the request is part of.
          *
          * This function checks the returned response variant type from `send()` to match the corresponding
          * request. Use this instead of `send()`
          */
         template <rpc::IsRequest Req>
-        AExpect<rpc::ToResp<Req>> send_req(Req req)
+        AExpect<rpc::ToResp<Req>> send_req(Req req, trace::Context trace = {})
         {
-            if (auto res = co_await send(std::move(req)); not res) {
+            if (auto res = co_await send(std::move(req), trace); not res) {
                 co_return Unexpect{ res.error() };
             } else if (auto resp = std::get_if<rpc::ToResp<Req>>(&*res); resp != nullptr) {
                 co_return std::move(*resp);
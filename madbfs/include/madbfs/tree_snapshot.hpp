@@ -0,0 +1,58 @@
+#pragma once
+
+#include "madbfs/path.hpp"
+
+#include <madbfs-common/aliases.hpp>
+
+#include <filesystem>
+
+namespace madbfs
+{
+    class Node;
+}
+
+namespace madbfs::tree_snapshot
+{
+    /**
+     * @brief Get the default location of the tree snapshot file of a device.
+     *
+     * @param serial Serial of the device.
+     * @param root Custom root of the mount on the device.
+     *
+     * @return `$XDG_CACHE_HOME/madbfs/<serial>.tree` (or `$HOME/.cache` if `XDG_CACHE_HOME` is not set), or
+     * `std::nullopt` if neither of the env variables is defined.
+     *
+     * If the root is not the device root, the root path is appended to the serial with '/' replaced by '%'
+     * so that each mounted subdirectory has its own snapshot.
+     */
+    Opt<std::filesystem::path> default_path(Str serial, path::Path root);
+
+    /**
+     * @brief Serialize a node tree into a file.
+     *
+     * @param root Root node of the tree.
+     * @param file Path to the snapshot file on host.
+     *
+     * @return Number of nodes written.
+     *
+     * Only names, stats, and sync state of the nodes are written. `Error` nodes are skipped while symlinks
+     * are written without their target (lazy). The file is written atomically by writing into a temporary
+     * file first then renaming it. The format uses the native endianness since it is meant to be read by the
+     * same host only.
+     */
+    Expect<usize> save(const Node& root, const std::filesystem::path& file);
+
+    /**
+     * @brief Deserialize a node tree from a file into a root node.
+     *
+     * @param root Root node, must be a directory with no children.
+     * @param file Path to the snapshot file on host.
+     *
+     * @return Number of nodes loaded.
+     *
+     * Every loaded node (including the root, whose stat is replaced as well) is marked as expired, so it
+     * will be revalidated lazily on its next access. A directory that is revalidated and found unchanged
+     * keeps its sync state, so no listdir is needed for it.
+     */
+    Expect<usize> load(Node& root, const std::filesystem::path& file);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "madbfs/path.hpp"
+
+#include <madbfs-common/aliases.hpp>
+
+namespace madbfs
+{
+    /**
+     * @class TtlPolicy
+     *
+     * @brief Table of path patterns mapped to stat TTL.
+     *
+     * A pattern is either a path prefix or a glob. A pattern that contains any of `*`, `?`, or `[` is a glob
+     * and is matched against the whole path using `fnmatch(3)` (wildcards may match `/`). Any other pattern
+     * is a prefix that matches the path itself and everything under it, compared per component. Paths are
+     * relative to the mounted root.
+     *
+     * Rules are evaluated in order, the first matching rule wins. Paths that match none of the rules use the
+     * global TTL of the filesystem.
+     */
+    class TtlPolicy
+    {
+    public:
+        struct Rule
+        {
+            String       pattern;
+            Opt<Seconds> ttl;    // std::nullopt means never expire
+            bool         glob;
+        };
+
+        /**
+         * @brief Parse policy from its string representation.
+         *
+         * @param spec Rules separated by `;` in the form of `<pattern>=<seconds>`.
+         *
+         * @return Parsed policy or `Errc::invalid_argument` if the string is malformed.
+         *
+         * A TTL of 0 seconds disables the expiration for the matched paths, the same as the global TTL.
+         * Empty string results in an empty policy.
+         *
+         * Example: `/DCIM/Camera=5;/Android/media/*WhatsApp*=10;/system=3600`.
+         */
+        static Expect<TtlPolicy> parse(Str spec);
+
+        /**
+         * @brief Find the TTL of a path.
+         *
+         * @param path Path on the device to be matched.
+         * @param root The mounted root on the device, stripped from the path before matching.
+         *
+         * @return TTL of the first matching rule or `std::nullopt` if there is no rule that matches (paths
+         * outside of the root never match).
+         */
+        Opt<Opt<Seconds>> match(path::Path path, path::Path root = {}) const;
+
+        /**
+         * @brief Get the string representation of the policy (in the same format `parse()` accepts).
+         */
+        String to_string() const;
+
+        /**
+         * @brief Get the rules of the policy.
+         */
+        Span<const Rule> rules() const { return m_rules; }
+
+        /**
+         * @brief Check whether the policy has no rule.
+         */
+        bool empty() const { return m_rules.empty(); }
+
+    private:
+        Vec<Rule> m_rules;
+    };
+}
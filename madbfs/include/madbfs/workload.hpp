@@ -0,0 +1,238 @@
+#pragma once
+
+#include "madbfs/metrics.hpp"
+
+#include <madbfs-common/aliases.hpp>
+#include <madbfs-common/async/async.hpp>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+namespace madbfs
+{
+    class Filesystem;
+}
+
+namespace madbfs::workload
+{
+    /**
+     * @class Call
+     *
+     * @brief Arguments of a FUSE operation as issued by the kernel.
+     *
+     * Fields that are not used by the operation are left zero.
+     */
+    struct Call
+    {
+        metrics::FuseOp op;
+        Str             path    = {};    // raw path from FUSE (relative to the mount)
+        Str             path2   = {};    // rename destination, copy_file_range output
+        u32             flags   = 0;     // open flags, rename flags, lseek whence
+        u32             mode    = 0;     // mknod, mkdir, and create mode
+        u64             fh      = 0;
+        u64             fh2     = 0;     // copy_file_range output
+        i64             offset  = 0;     // read, write, lseek, and readdir offset, truncate size
+        i64             offset2 = 0;     // copy_file_range output offset
+        u64             size    = 0;     // read, write, and copy_file_range size
+    };
+
+    /**
+     * @class Entry
+     *
+     * @brief A recorded FUSE operation, paths are referred to by their id.
+     */
+    struct Entry
+    {
+        metrics::FuseOp op;
+        u32             pid;
+        u32             path;    // 0 if none
+        u32             path2;
+        u32             flags;
+        u32             mode;
+        u64             fh;
+        u64             fh2;
+        i64             offset;
+        i64             offset2;
+        u64             size;
+        i64             result;      // returned value, negative errno on failure
+        u64             start;       // microseconds since the recording started
+        u32             duration;    // microseconds
+    };
+
+    /**
+     * @class Workload
+     *
+     * @brief A recorded workload loaded from a file.
+     */
+    struct Workload
+    {
+        Vec<String> paths;      // indexed by path id, the first one is empty
+        Vec<Entry>  entries;    // in the order they completed
+    };
+
+    /**
+     * @brief Load a recorded workload from a file.
+     *
+     * @param file Path to the workload file.
+     *
+     * @return The workload or `Errc::bad_message` if the file is not a workload or corrupted.
+     *
+     * A file truncated in the middle of a record (e.g. the recording process crashed) is loaded up to the
+     * last complete record.
+     */
+    Expect<Workload> load(const std::filesystem::path& file);
+
+    /**
+     * @class Handles
+     *
+     * @brief Map of the handles recorded in a workload to the ones returned when it's replayed.
+     *
+     * Operations on a handle opened before the recording started can't be mapped, so they are skipped. The
+     * map can be shared by threads replaying different processes.
+     */
+    class Handles
+    {
+    public:
+        /**
+         * @brief Map the handles used by an operation.
+         *
+         * @param entry The recorded operation.
+         *
+         * @return The handle and the second handle (0 if not used by the operation), or `std::nullopt` if one
+         * of them is not known.
+         */
+        Opt<Pair<u64, u64>> map(const Entry& entry) const;
+
+        /**
+         * @brief Remember the handle returned by a replayed open/create, or forget a released one.
+         *
+         * @param entry The recorded operation.
+         * @param result Value returned on replay, negative errno on failure.
+         */
+        void update(const Entry& entry, i64 result);
+
+        /**
+         * @brief Forget every handle.
+         */
+        void clear();
+
+    private:
+        mutable std::mutex           m_mutex;
+        std::unordered_map<u64, u64> m_handles;    // recorded -> replayed
+    };
+
+    /**
+     * @brief Issue a recorded operation directly against the filesystem layer and wait for it to complete.
+     *
+     * @param ctx Async context of the filesystem, it must be run on another thread.
+     * @param fs The filesystem.
+     * @param entry The recorded operation.
+     * @param path Path of the operation on the device, root included ("/" if the operation has none).
+     * @param path2 Second path of the operation.
+     * @param fh Handle to be used in place of the recorded one.
+     * @param fh2 Second handle to be used in place of the recorded one.
+     *
+     * @return Returned value, negative errno on failure.
+     *
+     * Reads and writes use a scratch buffer of the calling thread.
+     */
+    i64 issue(async::Context& ctx, Filesystem& fs, const Entry& entry, Str path, Str path2, u64 fh, u64 fh2);
+
+    /**
+     * @class Recorder
+     *
+     * @brief Record every FUSE operation into a compact binary file.
+     *
+     * Paths are interned: a path is written once with its id the first time it's seen, then operations refer
+     * to it by id. Records are buffered and written to the file once the buffer is full or on stop. The
+     * format uses the native endianness since it is meant to be replayed on the same host.
+     *
+     * Checking whether the recorder is recording is a relaxed atomic load, recording itself takes a lock.
+     */
+    class Recorder
+    {
+    public:
+        static constexpr usize flush_threshold = 64 * 1024;
+
+        /**
+         * @class Stats
+         *
+         * @brief Summary of a finished recording.
+         */
+        struct Stats
+        {
+            String file;
+            u64    entries = 0;
+            u64    paths   = 0;
+            u64    bytes   = 0;
+        };
+
+        /**
+         * @brief Start recording into a file, the file is truncated.
+         *
+         * @param file Path to the workload file on host.
+         *
+         * @return `Errc::device_or_resource_busy` if it's already recording.
+         */
+        Expect<void> start(const std::filesystem::path& file);
+
+        /**
+         * @brief Stop recording and close the file.
+         *
+         * @return Summary of the recording or `Errc::invalid_argument` if it's not recording.
+         */
+        Expect<Stats> stop();
+
+        /**
+         * @brief Check whether it's recording.
+         */
+        bool recording() const { return m_recording.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief Record an operation.
+         *
+         * @param call Arguments of the operation.
+         * @param pid Id of the process (thread) that issued the operation.
+         * @param start Start of the operation.
+         * @param end End of the operation.
+         * @param result Value returned to FUSE, negative errno on failure.
+         */
+        void record(
+            const Call&             call,
+            u32                     pid,
+            SteadyClock::time_point start,
+            SteadyClock::time_point end,
+            i64                     result
+        );
+
+    private:
+        /**
+         * @brief Get the id of a path, the path is written if it's new (lock must be held).
+         */
+        u32 intern(Str path);
+
+        /**
+         * @brief Write the buffered records into the file (lock must be held).
+         */
+        bool flush();
+
+        std::atomic<bool> m_recording = false;
+
+        std::mutex                      m_mutex;
+        std::ofstream                   m_out;
+        std::filesystem::path           m_file;
+        SteadyClock::time_point         m_origin;
+        std::unordered_map<String, u32> m_paths;
+        Vec<char>                       m_buf;
+        u64                             m_entries = 0;
+        u64                             m_bytes   = 0;
+    };
+
+    /**
+     * @brief Get the workload recorder, it lives for the whole process.
+     */
+    Recorder& recorder();
+}
@@ -105,6 +105,7 @@ namespace madbfs::args
             "    --log-level=<enum>     log level to use\n"
             "                             (default: \"warning\")\n"
             "                             (enum: {0:n})\n"
+            "                             (levels below \"{1}\" are compiled out of this build)\n"
             "    --log-file=<path>      log file to write to\n"
             "                             (default: \"-\" for stdout)\n"
             "    --cache-size=<int>     maximum size of the cache in MiB\n"
@@ -118,9 +119,26 @@ namespace madbfs::args
             "                             (maximum: 4096)\n"
             "                             (value will be rounded up to the next power of 2)\n"
             "                             (ignored if 'no-cache' is provided)\n"
+            "    --prefetch=<int>       budget in MiB for prefetching headers of media files on readdir\n"
+            "                             (default: 0)\n"
+            "                             (set to 0 to disable it)\n"
+            "                             (ignored if 'no-cache' is provided)\n"
+            "    --stream=<int>         size in MiB above which a file bypasses the cache on open\n"
+            "                             (also the length of sequential access that switches to it)\n"
+            "                             (default: 64)\n"
+            "                             (set to 0 to only bypass the cache on O_DIRECT)\n"
+            "                             (ignored if 'no-cache' is provided)\n"
+            "    --linger=<int>         seconds a device fd of a closed file is kept open for reuse\n"
+            "                             (default: 10)\n"
+            "                             (at most 64 of them are kept, least recently closed go first)\n"
+            "                             (ignored if 'no-cache' is provided)\n"
             "    --ttl=<int>            set the TTL of the stat cache of the filesystem in seconds\n"
             "                             (default: 60)\n"
             "                             (set to 0 to disable it)\n"
+            "    --ttl-policy=<str>     set the TTL for specific paths, overriding the global TTL\n"
+            "                             (format: \"<pattern>=<sec>[;<pattern>=<sec>...]\")\n"
+            "                             (pattern is a path prefix or a glob if it has any of '*?[')\n"
+            "                             (first matching rule wins, set sec to 0 to never expire)\n"
             "    --timeout=<int>        set the timeout of every remote operation\n"
             "                             (default: 2)\n"
             "                             (set to 0 to disable it)\n"
@@ -131,8 +149,23 @@ namespace madbfs::args
             "                             (fall back to adb shell calls if connection failed)\n"
             "                             (useful for debugging the server)\n"
             "    --adb-only             don't launch server and don't try to connect\n"
-            "    --no-cache             don't use data caching\n",
-            log::level_names
+            "    --no-cache             don't use data caching\n"
+            "    --persist              persist the file tree (names and stats) across mounts\n"
+            "                             (saved under $XDG_CACHE_HOME/madbfs/<serial>.tree on unmount)\n"
+            "    --snapshot             mount read-only and treat the device as frozen\n"
+            "                             (TTL is disabled and the kernel keeps the data and attributes)\n"
+            "                             (useful for backups; 'ttl' and 'ttl-policy' are ignored)\n"
+            "    --walk                 list every directory in the background on mount\n"
+            "                             (ignored if 'snapshot' is not provided)\n"
+            "    --metrics=<addr>       serve metrics in OpenMetrics format over HTTP on a local socket\n"
+            "                             (addr is \"unix\", a unix socket path, or \"[<host>:]<port>\")\n"
+            "                             (\"unix\" is $XDG_RUNTIME_DIR/madbfs-metrics@<serial>.sock)\n"
+            "                             (host defaults to 127.0.0.1)\n"
+            "    --queue-slots=<int>    operations admitted at once when several processes contend\n"
+            "                             (default: 4)\n"
+            "                             (a process alone is never queued)\n",
+            log::level_names,
+            log::level_to_str(log::level_floor)
         );
 
         fmt::println(stdout, "\nOptions for libfuse:");
@@ -209,6 +242,43 @@ namespace madbfs::args
             co_return ParseResult{ 1 };
         }
 
+        if (madbfs_opt.prefetch < 0) {
+            fmt::println(stderr, "error: prefetch budget must not be negative");
+            co_return ParseResult{ 1 };
+        }
+
+        if (madbfs_opt.stream < 0) {
+            fmt::println(stderr, "error: stream threshold must not be negative");
+            co_return ParseResult{ 1 };
+        }
+
+        if (madbfs_opt.linger < 0) {
+            fmt::println(stderr, "error: linger period must not be negative");
+            co_return ParseResult{ 1 };
+        }
+
+        if (madbfs_opt.slots < 1) {
+            fmt::println(stderr, "error: queue slots must be positive");
+            co_return ParseResult{ 1 };
+        }
+
+        auto ttl_policy = TtlPolicy{};
+        if (madbfs_opt.ttl_policy != nullptr) {
+            if (auto policy = TtlPolicy::parse(madbfs_opt.ttl_policy); policy) {
+                ttl_policy = std::move(*policy);
+            } else {
+                fmt::println(stderr, "error: invalid ttl policy '{}'", madbfs_opt.ttl_policy);
+                co_return ParseResult{ 1 };
+            }
+        }
+
+        // nothing changes on a frozen device, so there is nothing to revalidate
+        if (madbfs_opt.snapshot) {
+            madbfs_opt.ttl = 0;
+            ttl_policy     = TtlPolicy{};
+            ::fuse_opt_add_arg(&args, "-oro");
+        }
+
         if (madbfs_opt.port > std::numeric_limits<u16>::max() or madbfs_opt.port <= 0) {
             fmt::println("[madbfs] invalid port {}", madbfs_opt.port);
             ::fuse_opt_free_args(&args);
@@ -305,20 +375,29 @@ namespace madbfs::args
             caching = Caching{
                 .cachesize = std::max(std::bit_ceil(static_cast<usize>(madbfs_opt.cache_size)), 128uz),
                 .pagesize = std::clamp(std::bit_ceil(static_cast<usize>(madbfs_opt.page_size)), 64uz, 4096uz),
+                .prefetch = static_cast<usize>(madbfs_opt.prefetch),
+                .stream   = static_cast<usize>(madbfs_opt.stream),
+                .linger   = static_cast<usize>(madbfs_opt.linger),
             };
         }
 
         co_return ParseResult::Opt{
             .opt = {
-                .mount      = std::move(mountpoint),
-                .serial     = madbfs_opt.serial,
-                .root       = std::move(root),
-                .connection = connection,
-                .caching    = caching,
-                .log_level  = log_level.value(),
-                .log_file   = log_file,
-                .ttl        = madbfs_opt.ttl,
-                .timeout    = madbfs_opt.timeout,
+                .mount        = std::move(mountpoint),
+                .serial       = madbfs_opt.serial,
+                .root         = std::move(root),
+                .connection   = connection,
+                .caching      = caching,
+                .log_level    = log_level.value(),
+                .log_file     = log_file,
+                .ttl          = madbfs_opt.ttl,
+                .ttl_policy   = std::move(ttl_policy),
+                .timeout      = madbfs_opt.timeout,
+                .persist_tree = madbfs_opt.persist != 0,
+                .snapshot     = madbfs_opt.snapshot != 0,
+                .walk_tree    = madbfs_opt.snapshot != 0 and madbfs_opt.walk != 0,
+                .metrics      = madbfs_opt.metrics ? madbfs_opt.metrics : "",
+                .queue_slots  = static_cast<usize>(madbfs_opt.slots),
             },
             .args = args,
         };
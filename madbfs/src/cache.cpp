@@ -13,12 +13,61 @@ namespace
         ++counter;
         return madbfs::util::defer([&] { --counter; });
     }
+
+    /**
+     * @brief Find the known hole that contains an offset.
+     *
+     * @param holes Known holes, start -> end (exclusive).
+     * @param offset Offset to be looked up.
+     *
+     * @return Iterator to the hole or `holes.end()` if the offset is not in any known hole.
+     */
+    auto find_hole(const std::map<madbfs::usize, madbfs::usize>& holes, madbfs::usize offset)
+    {
+        auto it = holes.upper_bound(offset);
+        if (it == holes.begin()) {
+            return holes.end();
+        }
+        --it;
+        return offset < it->second ? it : holes.end();
+    }
+
+    /**
+     * @brief Remove the range [first, last) from known holes, splitting holes that partially overlap it.
+     *
+     * @param holes Known holes, start -> end (exclusive).
+     * @param first Start of the range.
+     * @param last End of the range (exclusive).
+     */
+    void erase_holes(std::map<madbfs::usize, madbfs::usize>& holes, madbfs::usize first, madbfs::usize last)
+    {
+        auto it = holes.upper_bound(first);
+        if (it != holes.begin()) {
+            --it;
+        }
+
+        while (it != holes.end() and it->first < last) {
+            auto [start, end] = *it;
+            if (end <= first) {
+                ++it;
+                continue;
+            }
+
+            it = holes.erase(it);
+            if (start < first) {
+                holes.emplace(start, first);
+            }
+            if (end > last) {
+                holes.emplace(last, end);
+            }
+        }
+    }
 }
 
 // cache.hpp impl: Page
 namespace madbfs
 {
-    Page::Page(PageKey key, Uniq<char[]> buf, u32 size, u32 page_size)
+    Page::Page(PageKey key, Shared<char[]> buf, u32 size, u32 page_size)
         : m_key{ key }
         , m_data{ std::move(buf) }
         , m_size{ size }
@@ -48,6 +97,13 @@ namespace madbfs
             end = std::min(end, m_page_size);
         }
 
+        // copy-on-write: other pages still see the old content
+        if (m_data.use_count() > 1) {
+            auto data = std::make_unique_for_overwrite<char[]>(m_page_size);
+            std::copy_n(m_data.get(), m_page_size, data.get());
+            m_data = std::move(data);
+        }
+
         std::copy_n(in.data(), end - offset, m_data.get() + offset);
         m_size = std::max(end, m_size);
 
@@ -59,6 +115,11 @@ namespace madbfs
         return m_size = std::min(static_cast<u32>(size), m_page_size);
     }
 
+    Page Page::share(PageKey key) const
+    {
+        return Page{ key, m_data, m_size, m_page_size };
+    }
+
     usize Page::size() const
     {
         return m_size;
@@ -78,14 +139,22 @@ namespace madbfs
 // cache.hpp impl: Cache
 namespace madbfs
 {
-    Cache::Cache(Connection& connection, usize page_size, usize max_pages)
+    Cache::Cache(
+        Connection& connection,
+        usize       page_size,
+        usize       max_pages,
+        Seconds     linger,
+        usize       max_lingering
+    )
         : m_connection{ connection }
         , m_page_size{ std::bit_ceil(page_size) }
         , m_max_pages{ max_pages }
+        , m_linger{ linger }
+        , m_max_lingering{ max_lingering }
     {
     }
 
-    AExpect<void> Cache::hint_open(Id id, path::Path path, OpenMode mode)
+    AExpect<void> Cache::hint_open(Id id, path::Path path, OpenMode mode, Opt<u64> real_fd)
     {
         // only adding new entry, actual open will be performed on read/write
         log_d(__func__, "[id={}|mode={}] {:?}", id.inner(), std::to_underlying(mode), path);
@@ -102,15 +171,23 @@ namespace madbfs
         entry.reader += mode == OpenMode::Read or mode == OpenMode::ReadWrite;
         entry.writer += mode == OpenMode::Write or mode == OpenMode::ReadWrite;
 
-        // see note on clean_stale_fds() function body regarding m_stale_fds
-
-        if (prev_reader == 0 and entry.reader > 0) {
-            log_t(__func__, "cancel stale [id={}|mode={}]", id.inner(), std::to_underlying(mode));
-            std::erase_if(m_stale_fds, [&](const auto& v) { return v == Tup{ id, FdKind::Read }; });
+        // lingering fds are reused as is, saving the open and close on the device
+        if (prev_reader == 0 and entry.reader > 0 and entry.read_linger) {
+            log_t(__func__, "reuse lingering [id={}|mode={}]", id.inner(), std::to_underlying(mode));
+            unlinger(entry, FdKind::Read);
         }
-        if (prev_writer == 0 and entry.writer > 0) {
-            log_t(__func__, "cancel stale [id={}|mode={}]", id.inner(), std::to_underlying(mode));
-            std::erase_if(m_stale_fds, [&](const auto& v) { return v == Tup{ id, FdKind::Write }; });
+        if (prev_writer == 0 and entry.writer > 0 and entry.write_linger) {
+            log_t(__func__, "reuse lingering [id={}|mode={}]", id.inner(), std::to_underlying(mode));
+            unlinger(entry, FdKind::Write);
+        }
+
+        if (real_fd) {
+            auto& fd = mode == OpenMode::Read ? entry.read_fd : entry.write_fd;
+            if (not fd) {
+                fd = real_fd;
+            } else {
+                co_await close_fds({ Closing{ id, path.owned(), *real_fd } });
+            }
         }
 
         co_return Expect<void>{};
@@ -118,7 +195,7 @@ namespace madbfs
 
     AExpect<void> Cache::hint_close(Id id, OpenMode mode)
     {
-        // only mark id's fd as stale on empty reader/writer, actual close performed on clean_stale_fds()
+        // fds only start lingering on empty reader/writer, actual close performed on clean_stale_fds()
         log_d(__func__, "[id={}|mode={}]", id.inner(), std::to_underlying(mode));
 
         auto may_entry = lookup(id);
@@ -140,21 +217,25 @@ namespace madbfs
         entry.reader -= reader_decr;
         entry.writer -= writer_decr;
 
-        // see note on clean_stale_fds() function body regarding m_stale_fds
-
         if (entry.reader == 0 and entry.read_fd) {
-            log_t(__func__, "mark stale [id={}|mode={}]", id.inner(), std::to_underlying(mode));
-            m_stale_fds.emplace_back(id, FdKind::Read);
+            log_t(__func__, "linger [id={}|mode={}]", id.inner(), std::to_underlying(mode));
+            linger(id, entry, FdKind::Read);
         }
         if (entry.writer == 0 and entry.write_fd) {
-            log_t(__func__, "mark stale [id={}|mode={}]", id.inner(), std::to_underlying(mode));
-            m_stale_fds.emplace_back(id, FdKind::Write);
+            log_t(__func__, "linger [id={}|mode={}]", id.inner(), std::to_underlying(mode));
+            linger(id, entry, FdKind::Write);
+        }
+
+        erase_if_free(id);
+
+        if (m_lingering.size() > m_max_lingering) {
+            co_await close_lingering(SteadyClock::time_point::min(), m_max_lingering);
         }
 
         co_return Expect<void>{};
     }
 
-    AExpect<usize> Cache::read(Id id, Span<char> out, off_t offset)
+    AExpect<usize> Cache::read(Id id, Span<char> out, off_t offset, trace::Context trace)
     {
         auto first = static_cast<usize>(offset) / m_page_size;
         auto last  = (static_cast<usize>(offset) + out.size() - 1) / m_page_size;
@@ -166,8 +247,11 @@ namespace madbfs
             log_e(__func__, "read [{}] is requested but no entry (forgot to open?)", id.inner());
             co_return Unexpect{ Errc::bad_file_descriptor };
         }
+        entry->get().accessed = SteadyClock::now();
 
-        auto work = [&](usize idx) { return read_at(entry->get(), out, id, idx, first, last, offset); };
+        auto work = [&](usize idx) {
+            return read_at(entry->get(), out, id, idx, first, last, offset, trace);
+        };
         auto res  = co_await async::wait_all(sv::iota(first, last + 1) | sv::transform(work));
 
         auto read = 0uz;
@@ -182,7 +266,7 @@ namespace madbfs
         co_return read;
     }
 
-    AExpect<usize> Cache::write(Id id, Span<const char> in, off_t offset)
+    AExpect<usize> Cache::write(Id id, Span<const char> in, off_t offset, trace::Context trace)
     {
         auto first = static_cast<usize>(offset) / m_page_size;
         auto last  = (static_cast<usize>(offset) + in.size() - 1) / m_page_size;
@@ -194,9 +278,14 @@ namespace madbfs
             log_e(__func__, "read [{}] is requested but no entry (forgot to open?)", id.inner());
             co_return Unexpect{ Errc::bad_file_descriptor };
         }
-        entry->get().dirty = true;
+        entry->get().dirty    = true;
+        entry->get().accessed = SteadyClock::now();
 
-        auto work = [&](usize idx) { return write_at(entry->get(), in, id, idx, first, last, offset); };
+        erase_holes(entry->get().holes, static_cast<usize>(offset), static_cast<usize>(offset) + in.size());
+
+        auto work = [&](usize idx) {
+            return write_at(entry->get(), in, id, idx, first, last, offset, trace);
+        };
         auto res  = co_await async::wait_all(sv::iota(first, last + 1) | sv::transform(work));
 
         auto written = 0uz;
@@ -211,7 +300,80 @@ namespace madbfs
         co_return written;
     }
 
-    AExpect<void> Cache::flush(Id id)
+    AExpect<void> Cache::prefetch(Id id, path::Path path)
+    {
+        if (auto entry = lookup(id); entry and entry->get().pages.contains(0)) {
+            co_return Expect<void>{};
+        } else if (m_read_queue.contains(PageKey{ id, 0 })) {
+            co_return Expect<void>{};
+        }
+
+        log_d(__func__, "start [id={}] {:?}", id.inner(), path);
+
+        // act as a reader so the fd is handled the same way as the one opened from FUSE
+        if (auto res = co_await hint_open(id, path, OpenMode::Read); not res) {
+            co_return Unexpect{ res.error() };
+        }
+
+        auto entry = lookup(id);
+        if (not entry) {
+            co_return Unexpect{ Errc::operation_canceled };
+        }
+
+        // reading a single byte is enough to pull the whole page
+        auto sink = Array<char, 1>{};
+        auto res  = co_await read_at(entry->get(), sink, id, 0, 0, 0, 0, {});
+
+        std::ignore = co_await hint_close(id, OpenMode::Read);
+
+        co_return res.transform(sink_void);
+    }
+
+    AExpect<off_t> Cache::lseek(Id id, off_t offset, rpc::Seek whence)
+    {
+        auto may_entry = lookup(id);
+        if (not may_entry) {
+            log_e(__func__, "lseek [{}] is requested but no entry (forgot to open?)", id.inner());
+            co_return Unexpect{ Errc::bad_file_descriptor };
+        }
+
+        auto& entry = may_entry->get();
+        auto  start = static_cast<usize>(offset);
+
+        if (auto hole = find_hole(entry.holes, start); hole != entry.holes.end()) {
+            log_t(__func__, "known hole [id={}|hole={} - {}]", id.inner(), hole->first, hole->second);
+            co_return whence == rpc::Seek::Data ? static_cast<off_t>(hole->second) : offset;
+        }
+
+        if (not entry.read_fd) {
+            auto fd = co_await m_connection.open(entry.path, OpenMode::Read);
+            if (not fd) {
+                co_return Unexpect{ fd.error() };
+            }
+            entry.read_fd = *fd;
+        }
+
+        auto read_incr_lock = scoped_increment(entry.read_inflight);
+
+        auto res = co_await m_connection.lseek(*entry.read_fd, offset, whence);
+        if (not res) {
+            co_return Unexpect{ res.error() };
+        }
+
+        // the entry may have been invalidated while waiting for the device
+        auto found = static_cast<usize>(*res);
+        if (auto again = lookup(id); again and whence == rpc::Seek::Data and found > start) {
+            log_d(__func__, "new hole [id={}|hole={} - {}]", id.inner(), start, found);
+            auto [it, inserted] = again->get().holes.emplace(start, found);
+            if (not inserted) {
+                it->second = std::max(it->second, found);
+            }
+        }
+
+        co_return *res;
+    }
+
+    AExpect<void> Cache::flush(Id id, trace::Context trace)
     {
         auto entry = lookup(id);
         if (not entry) {
@@ -226,7 +388,7 @@ namespace madbfs
         log_d(__func__, "flush: start [id={}|idx={}]", id.inner(), pages | sv::keys);
 
         if (auto& e = entry->get(); not e.write_fd) {
-            auto fd = co_await m_connection.open(e.path, OpenMode::Write);
+            auto fd = co_await m_connection.open(e.path, OpenMode::Write, trace);
             if (not fd) {
                 co_return Unexpect{ fd.error() };
             }
@@ -239,7 +401,7 @@ namespace madbfs
             if (not page->is_dirty()) {
                 continue;
             }
-            auto res = co_await flush_at(*entry->get().write_fd, *page);
+            auto res = co_await flush_at(*entry->get().write_fd, *page, trace);
             if (not res) {
                 log_e(__func__, "failed to flush [{}]: {}", id.inner(), err_msg(res.error()));
                 co_return Unexpect{ res.error() };
@@ -259,6 +421,9 @@ namespace madbfs
         }
         auto& entry = may_entry->get();
 
+        // known holes may be filled or extended by the truncation, forget them
+        entry.holes.clear();
+
         auto old_num_pages = old_size / m_page_size + (old_size % m_page_size != 0);
         auto new_num_pages = new_size / m_page_size + (new_size % m_page_size != 0);
 
@@ -318,6 +483,72 @@ namespace madbfs
         co_return Expect<void>{};
     }
 
+    Await<usize> Cache::copy(Id in_id, off_t in_off, Id out_id, off_t out_off, usize size, usize out_size)
+    {
+        auto out_entry = lookup(out_id);
+        if (not out_entry or size == 0) {
+            co_return 0;
+        }
+
+        // copying a range within the same file may overlap, just drop the stale pages for that
+        auto in_entry = in_id != out_id ? lookup(in_id) : std::nullopt;
+        auto aligned  = in_off % static_cast<off_t>(m_page_size) == 0
+                    and out_off % static_cast<off_t>(m_page_size) == 0;
+
+        auto& out   = out_entry->get();
+        auto  start = static_cast<usize>(out_off);
+        auto  first = start / m_page_size;
+        auto  last  = (start + size - 1) / m_page_size;
+
+        log_d(__func__, "start [in={}|out={}|idx={} - {}]", in_id.inner(), out_id.inner(), first, last);
+
+        erase_holes(out.holes, start, start + size);
+
+        auto shared = 0uz;
+
+        for (auto index : sv::iota(first, last + 1)) {
+            if (auto found = out.pages.find(index); found != out.pages.end()) {
+                if (found->second->is_dirty()) {
+                    continue;    // written after the copy, the page is newer than the device
+                }
+                m_lru.erase(found->second);
+                out.pages.erase(found);
+            }
+
+            if (not aligned or not in_entry or m_read_queue.contains(PageKey{ out_id, index })) {
+                continue;
+            }
+
+            auto& in     = in_entry->get();
+            auto  source = in.pages.find(static_cast<usize>(in_off) / m_page_size + index - first);
+            if (source == in.pages.end() or source->second->is_dirty()) {
+                continue;
+            }
+
+            const auto& page = *source->second;
+
+            // the page must lie within the copied range, a partial page must be the end of the new file
+            auto begin = (index - first) * m_page_size;
+            if (begin + page.size() > size) {
+                continue;
+            } else if (page.size() < m_page_size and index * m_page_size + page.size() != out_size) {
+                continue;
+            }
+
+            log_t(__func__, "share [in={}|out={}|idx={}]", in_id.inner(), out_id.inner(), index);
+
+            m_lru.emplace_front(page.share(PageKey{ out_id, index }));
+            out.pages.emplace(index, m_lru.begin());
+            ++shared;
+        }
+
+        if (m_lru.size() > m_max_pages) {
+            co_await evict(m_lru.size() - m_max_pages);
+        }
+
+        co_return shared;
+    }
+
     Await<void> Cache::rename(Id id, path::Path new_name)
     {
         if (auto found = m_table.find(id); found != m_table.end()) {
@@ -336,6 +567,8 @@ namespace madbfs
             }
         }
 
+        auto to_close = Vec<Closing>{};
+
         if (auto entry = m_table.extract(id); not entry.empty()) {
             if (entry.mapped().dirty and not should_flush) {
                 log_w(__func__, "[{}] is dirty but invalidated without flush!", id.inner());
@@ -343,7 +576,40 @@ namespace madbfs
             for (auto page : entry.mapped().pages | sv::values) {
                 m_lru.erase(page);
             }
+
+            // no one uses the lingering fds, the rest are left to their handles
+            if (entry.mapped().read_linger) {
+                to_close.emplace_back(id, entry.mapped().path, *entry.mapped().read_fd);
+                unlinger(entry.mapped(), FdKind::Read);
+            }
+            if (entry.mapped().write_linger) {
+                to_close.emplace_back(id, entry.mapped().path, *entry.mapped().write_fd);
+                unlinger(entry.mapped(), FdKind::Write);
+            }
+        }
+
+        co_await close_fds(std::move(to_close));
+    }
+
+    void Cache::discard(Id id)
+    {
+        auto entry = lookup(id);
+        if (not entry) {
+            return;
         }
+
+        log_d(__func__, "discard [id={}]", id.inner());
+
+        entry->get().holes.clear();
+        std::erase_if(entry->get().pages, [&](const auto& kv) {
+            if (kv.second->is_dirty()) {
+                return false;
+            }
+            m_lru.erase(kv.second);
+            return true;
+        });
+
+        erase_if_free(id);
     }
 
     Await<void> Cache::invalidate_all()
@@ -366,101 +632,37 @@ namespace madbfs
 
         m_table.clear();
         m_lru.clear();
+        m_lingering.clear();
     }
 
     Await<void> Cache::clean_stale_fds()
     {
-        using namespace std::chrono_literals;
-
-        // TODO: made these two members so no repeated allocation?
-        auto finished_fds    = std::vector<u64>{};
-        auto stale_to_remove = std::vector<u64>{};
-
-        log_d(__func__, "start erasing stale fds [count={}]", m_stale_fds.size());
-
-        // NOTE: m_stale_fds must not be operated on between yielding points, else the data might be not
-        // synchronized
-
-        for (auto i : sv::iota(0uz, m_stale_fds.size())) {
-            auto [id, kind] = m_stale_fds[i];
-
-            auto lookup = m_table.find(id);
-            if (lookup == m_table.end()) {
-                stale_to_remove.push_back(i);
-                continue;
-            }
-
-            auto& entry = lookup->second;
-            auto  fd    = Opt<u64>{};
-
-            switch (kind) {
-            case FdKind::Read: entry.read_inflight == 0 ? entry.read_fd.swap(fd) : void(); break;
-            case FdKind::Write: entry.write_inflight == 0 ? entry.write_fd.swap(fd) : void(); break;
-            }
-
-            if (fd) {
-                finished_fds.emplace_back(*fd);
-                stale_to_remove.push_back(i);
-            } else {
-                log_d(
-                    __func__,
-                    "stale but has reader/writer? [reader={}|writer={}] [read_in={}|write_in={}]",
-                    entry.reader,
-                    entry.writer,
-                    entry.read_inflight,
-                    entry.write_inflight
-                );
-            }
-        }
-
-        for (auto i : stale_to_remove | sv::reverse) {
-            m_stale_fds.erase(m_stale_fds.begin() + static_cast<isize>(i));
-        }
-        stale_to_remove.clear();
-
-        // >> yielding point
-        for (auto fd : finished_fds) {
-            if (auto res = co_await m_connection.close(fd); not res) {
-                log_w(__func__, "failure on closing fd [{}]: {}", fd, err_msg(res.error()));
-            }
-        }
-
-        finished_fds.clear();
-
-        log_d(__func__, "finish erasing stale fds [count={}]", stale_to_remove.size());
-
-        for (auto it = m_table.begin(); it != m_table.end();) {
-            if (it->second.is_free()) {
-                const auto& [id, entry] = *it;
-                log_d(__func__, "remove free entry for [{}] {:?}", id.inner(), entry.path);
-                it = m_table.erase(it);
-            } else {
-                ++it;
-            }
-        }
+        log_d(__func__, "start closing lingering fds [count={}]", m_lingering.size());
+        co_await close_lingering(SteadyClock::now() - m_linger, m_max_lingering);
+        log_d(__func__, "finish closing lingering fds [count={}]", m_lingering.size());
     }
 
     Await<void> Cache::invalidate_fds(bool close)
     {
-        auto to_close = Vec<u64>{};
+        auto to_close = Vec<Closing>{};
 
-        for (auto& entry : m_table | sv::values) {
+        for (auto& [id, entry] : m_table) {
             if (entry.read_fd) {
-                to_close.emplace_back(*entry.read_fd);
+                to_close.emplace_back(id, entry.path, *entry.read_fd);
                 entry.read_fd.reset();
             }
             if (entry.write_fd) {
-                to_close.emplace_back(*entry.write_fd);
+                to_close.emplace_back(id, entry.path, *entry.write_fd);
                 entry.write_fd.reset();
             }
+            entry.read_linger.reset();
+            entry.write_linger.reset();
         }
 
+        m_lingering.clear();
+
         if (close) {
-            for (auto fd : to_close) {
-                if (auto res = co_await m_connection.close(fd); not res) {
-                    log_e(__func__, "failure on closing fd [{}]: {}", fd, err_msg(res.error()));
-                }
-            }
+            co_await close_fds(std::move(to_close));
         }
     }
 
@@ -478,12 +680,153 @@ namespace madbfs
         log_i(__func__, "max pages can be stored changed to: {}", new_max_pages);
     }
 
+    Vec<Cache::Residency> Cache::residency(path::Path under) const
+    {
+        auto is_under = [&](Str path) {
+            if (under.is_root() or path == under.str()) {
+                return true;
+            }
+            return path.starts_with(under.str()) and path[under.str().size()] == '/';
+        };
+
+        auto result = Vec<Residency>{};
+
+        for (const auto& entry : m_table | sv::values) {
+            if (not is_under(entry.path.str())) {
+                continue;
+            }
+
+            auto residency = Residency{
+                .path     = entry.path,
+                .resident = {},
+                .dirty    = {},
+                .reader   = entry.reader,
+                .writer   = entry.writer,
+                .pinned   = entry.reader > 0 or entry.writer > 0 or entry.read_inflight > 0
+                       or entry.write_inflight > 0 or entry.read_fd or entry.write_fd or entry.dirty,
+                .accessed = entry.accessed,
+            };
+
+            for (const auto& [index, page] : entry.pages) {
+                residency.resident.push_back(index);
+                if (page->is_dirty()) {
+                    residency.dirty.push_back(index);
+                }
+            }
+
+            result.push_back(std::move(residency));
+        }
+
+        return result;
+    }
+
     Ref<Cache::LookupEntry> Cache::new_lookup(Id id, path::Path path)
     {
-        auto [it, _] = m_table.try_emplace(id, std::map<usize, Lru::iterator>{}, path.owned());
+        auto [it, inserted] = m_table.try_emplace(id, std::map<usize, Lru::iterator>{}, path.owned());
+        if (inserted) {
+            it->second.accessed = SteadyClock::now();
+        }
         return std::ref(it->second);
     }
 
+    void Cache::erase_if_free(Id id)
+    {
+        if (auto found = m_table.find(id); found != m_table.end() and found->second.is_free()) {
+            log_d(__func__, "remove free entry for [{}] {:?}", id.inner(), found->second.path);
+            m_table.erase(found);
+        }
+    }
+
+    void Cache::linger(Id id, LookupEntry& entry, FdKind kind)
+    {
+        auto& fd      = kind == FdKind::Read ? entry.read_fd : entry.write_fd;
+        auto& waiting = kind == FdKind::Read ? entry.read_linger : entry.write_linger;
+
+        if (fd and not waiting) {
+            waiting = m_lingering.insert(m_lingering.end(), Linger{ id, kind, SteadyClock::now() });
+        }
+    }
+
+    void Cache::unlinger(LookupEntry& entry, FdKind kind)
+    {
+        auto& waiting = kind == FdKind::Read ? entry.read_linger : entry.write_linger;
+        if (waiting) {
+            m_lingering.erase(*waiting);
+            waiting.reset();
+        }
+    }
+
+    Await<void> Cache::close_lingering(SteadyClock::time_point deadline, usize keep)
+    {
+        auto to_close = Vec<Closing>{};
+        auto busy     = LingerQueue{};
+
+        // NOTE: m_lingering must not be operated on between yielding points, else the data might be not
+        // synchronized
+
+        while (not m_lingering.empty()) {
+            auto& front = m_lingering.front();
+            if (front.since > deadline and m_lingering.size() + busy.size() <= keep) {
+                break;
+            }
+
+            auto found = m_table.find(front.id);
+            if (found == m_table.end()) {
+                // NOTE: getting here is a bug in implementation
+                log_c(__func__, "[BUG] lingering fd of [{}] has no entry", front.id.inner());
+                m_lingering.pop_front();
+                continue;
+            }
+
+            auto& entry    = found->second;
+            auto  is_read  = front.kind == FdKind::Read;
+            auto& fd       = is_read ? entry.read_fd : entry.write_fd;
+            auto& waiting  = is_read ? entry.read_linger : entry.write_linger;
+            auto  inflight = is_read ? entry.read_inflight : entry.write_inflight;
+
+            if (inflight != 0) {
+                log_d(__func__, "lingering but has inflight [id={}|inflight={}]", front.id.inner(), inflight);
+                busy.splice(busy.end(), m_lingering, m_lingering.begin());    // iterators stay valid
+                continue;
+            }
+
+            auto id = front.id;
+
+            to_close.emplace_back(id, entry.path, *fd);
+            fd.reset();
+            waiting.reset();
+            m_lingering.pop_front();
+
+            erase_if_free(id);
+        }
+
+        // busy fds are given another linger period
+        for (auto& linger : busy) {
+            linger.since = SteadyClock::now();
+        }
+        m_lingering.splice(m_lingering.end(), busy);
+
+        // >> yielding point
+        co_await close_fds(std::move(to_close));
+    }
+
+    Await<void> Cache::close_fds(Vec<Closing> fds)
+    {
+        for (const auto& [id, path, fd] : fds) {
+            auto res = co_await m_connection.close(fd);
+            if (not res) {
+                log_w(__func__, "failure on closing fd [{}]: {}", fd, err_msg(res.error()));
+                continue;
+            }
+
+            // dirty content is not on the device yet, the stat would roll back what FUSE has seen
+            auto entry = lookup(id);
+            if (*res and m_close_hook and not (entry and entry->get().dirty)) {
+                m_close_hook(id, path, **res);
+            }
+        }
+    }
+
     // NOTE: std::unordered_map guarantees reference of its element valid even if new value inserted
     // (path parameter not nullopt)
     Opt<Ref<Cache::LookupEntry>> Cache::lookup(Id id)
@@ -494,23 +837,26 @@ namespace madbfs
         return std::nullopt;
     }
 
-    AExpect<usize> Cache::on_miss(u64 fd, Span<char> out, off_t offset)
+    AExpect<usize> Cache::on_miss(u64 fd, Span<char> out, off_t offset, trace::Context trace)
     {
-        return m_connection.read(fd, out, offset);
+        return m_connection.read(fd, out, offset, trace);
     }
 
-    AExpect<usize> Cache::on_flush(u64 fd, Span<const char> in, off_t offset)
+    AExpect<usize> Cache::on_flush(u64 fd, Span<const char> in, off_t offset, trace::Context trace)
     {
-        return m_connection.write(fd, in, offset);
+        return m_connection.write(fd, in, offset, trace);
     }
 
-    Await<void> Cache::evict(usize size)
+    Await<void> Cache::evict(usize size, trace::Context trace)
     {
+        auto span = trace::Scope{ trace, "evict", "cache" };
+
         while (size-- > 0 and not m_lru.empty()) {
             auto page      = std::move(m_lru.back());
             auto [id, idx] = page.key();
 
             m_lru.pop_back();
+            ++m_stats.evictions;
 
             auto entry = lookup(id);
             if (not entry) {
@@ -524,7 +870,7 @@ namespace madbfs
                 auto write_incr_lock = scoped_increment(entry->get().write_inflight);
 
                 if (auto& e = entry->get(); not e.write_fd) {
-                    auto fd = co_await m_connection.open(e.path, OpenMode::Write);
+                    auto fd = co_await m_connection.open(e.path, OpenMode::Write, trace);
                     if (not fd) {
                         log_c(__func__, "force push [id={}|idx={}] can't open file", id.inner(), idx);
                         continue;
@@ -532,24 +878,31 @@ namespace madbfs
                     e.write_fd = *fd;
                 }
 
-                if (auto res = co_await flush_at(*entry->get().write_fd, page); not res) {
+                if (auto res = co_await flush_at(*entry->get().write_fd, page, trace); not res) {
                     log_c(__func__, "failed to force push page [id={}|idx={}]", id.inner(), idx);
                 }
+
+                // the file may be closed already, don't keep the fd opened for the push forever
+                if (entry->get().writer == 0) {
+                    linger(id, entry->get(), FdKind::Write);
+                }
             }
 
             // this is done last since flush_at requires entry to still exists
             entry->get().pages.erase(idx);
+            erase_if_free(id);
         }
     }
 
     AExpect<usize> Cache::read_at(
-        LookupEntry& entry,
-        Span<char>   out,
-        Id           id,
-        usize        index,
-        usize        first,
-        usize        last,
-        off_t        offset
+        LookupEntry&   entry,
+        Span<char>     out,
+        Id             id,
+        usize          index,
+        usize          first,
+        usize          last,
+        off_t          offset,
+        trace::Context trace
     )
     {
         auto read_incr_lock = scoped_increment(entry.read_inflight);
@@ -559,7 +912,8 @@ namespace madbfs
         auto key = PageKey{ id, index };
 
         if (auto queued = m_read_queue.find(key); queued != m_read_queue.end()) {
-            auto fut = queued->second;
+            auto span = trace::Scope{ trace, "wait read queue", "cache" };
+            auto fut  = queued->second;
             co_await fut.async_wait();
             if (auto err = fut.get(); static_cast<bool>(err)) {
                 co_return Unexpect{ err };
@@ -568,9 +922,29 @@ namespace madbfs
 
         auto page_entry = entry.pages.find(index);
         if (page_entry == entry.pages.end()) {
+            if (auto hole = find_hole(entry.holes, index * m_page_size);
+                hole != entry.holes.end() and (index + 1) * m_page_size <= hole->second) {
+                // the whole page is in a known hole, no need to ask the device for zeros
+                log_t(__func__, "hole: [id={}|idx={}]", id.inner(), index);
+
+                auto data = std::make_unique<char[]>(m_page_size);    // value-initialized: zeros
+                m_lru.emplace_front(key, std::move(data), m_page_size, m_page_size);
+                page_entry = entry.pages.emplace(index, m_lru.begin()).first;
+
+                if (m_lru.size() > m_max_pages) {
+                    co_await evict(m_lru.size() - m_max_pages, trace);
+                }
+            }
+        }
+
+        if (page_entry != entry.pages.end()) {
+            ++m_stats.hits;
+        } else {
             // cache miss
+            ++m_stats.misses;
+
             if (not entry.read_fd) {
-                auto fd = co_await m_connection.open(entry.path, OpenMode::Read);
+                auto fd = co_await m_connection.open(entry.path, OpenMode::Read, trace);
                 if (not fd) {
                     co_return Unexpect{ fd.error() };
                 }
@@ -581,9 +955,10 @@ namespace madbfs
             auto future  = promise.get_future().share();
             m_read_queue.emplace(key, std::move(future));
 
-            auto data    = std::make_unique<char[]>(m_page_size);
-            auto span    = Span{ data.get(), m_page_size };
-            auto may_len = co_await on_miss(*entry.read_fd, span, static_cast<off_t>(index * m_page_size));
+            auto data     = std::make_unique<char[]>(m_page_size);
+            auto span     = Span{ data.get(), m_page_size };
+            auto page_off = static_cast<off_t>(index * m_page_size);
+            auto may_len  = co_await on_miss(*entry.read_fd, span, page_off, trace);
             if (not may_len) {
                 promise.set_value(may_len.error());
                 m_read_queue.erase(key);
@@ -601,7 +976,7 @@ namespace madbfs
             m_read_queue.erase(key);
 
             if (m_lru.size() > m_max_pages) {
-                co_await evict(m_lru.size() - m_max_pages);
+                co_await evict(m_lru.size() - m_max_pages, trace);
             }
         }
 
@@ -643,7 +1018,8 @@ namespace madbfs
         usize            index,
         usize            first,
         usize            last,
-        off_t            offset
+        off_t            offset,
+        trace::Context   trace
     )
     {
         log_t(__func__, "write: [id={}|idx={}]", id.inner(), index);
@@ -651,7 +1027,8 @@ namespace madbfs
         auto key = PageKey{ id, index };
 
         if (auto queued = m_read_queue.find(key); queued != m_read_queue.end()) {
-            auto fut = queued->second;
+            auto span = trace::Scope{ trace, "wait read queue", "cache" };
+            auto fut  = queued->second;
             co_await fut.async_wait();
             if (auto err = fut.get(); static_cast<bool>(err)) {
                 co_return Unexpect{ err };
@@ -665,7 +1042,7 @@ namespace madbfs
             page_entry  = p;
 
             if (m_lru.size() > m_max_pages) {
-                co_await evict(m_lru.size() - m_max_pages);
+                co_await evict(m_lru.size() - m_max_pages, trace);
             }
         }
 
@@ -702,12 +1079,13 @@ namespace madbfs
         co_return written;
     }
 
-    AExpect<void> Cache::flush_at(u64 fd, Page& page)
+    AExpect<void> Cache::flush_at(u64 fd, Page& page, trace::Context trace)
     {
         log_t(__func__, "flush: [id={}|idx={}]", page.key().id.inner(), page.key().index);
 
         if (auto queued = m_read_queue.find(page.key()); queued != m_read_queue.end()) {
-            auto fut = queued->second;
+            auto span = trace::Scope{ trace, "wait read queue", "cache" };
+            auto fut  = queued->second;
             co_await fut.async_wait();
             if (auto err = fut.get(); static_cast<bool>(err)) {
                 co_return Unexpect{ err };
@@ -721,13 +1099,15 @@ namespace madbfs
         while (written < page.size()) {
             auto span = page.buf().subspan(written);
             auto off  = page.key().index * m_page_size + written;
-            auto res  = co_await on_flush(fd, span, static_cast<off_t>(off));
+            auto res  = co_await on_flush(fd, span, static_cast<off_t>(off), trace);
             if (not res) {
                 co_return Unexpect{ res.error() };
             }
             written += *res;
         }
 
+        ++m_stats.pushes;
+
         page.set_dirty(false);
         co_return Expect<void>{};
     }
@@ -217,4 +217,9 @@ namespace madbfs::cmd
 
         co_return std::move(out);
     }
+
+    Errc parse_error(Str message)
+    {
+        return to_errc(parse_stderr(message));
+    }
 }
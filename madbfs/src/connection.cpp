@@ -15,6 +15,23 @@ using namespace madbfs;
 // helper functions/classes
 namespace
 {
+    /**
+     * @brief Convert stat from its RPC representation.
+     */
+    Stat to_stat(const rpc::resp::Stat& stat)
+    {
+        return {
+            .links = stat.links,
+            .size  = stat.size,
+            .mtime = stat.mtime,
+            .atime = stat.atime,
+            .ctime = stat.ctime,
+            .mode  = stat.mode,
+            .uid   = stat.uid,
+            .gid   = stat.gid,
+        };
+    }
+
     Await<Uniq<transport::Transport>> create_transport(const ConnectionStrategy& strat)
     {
         using namespace madbfs;
@@ -158,6 +175,7 @@ namespace madbfs
 
         const auto old = m_transport->name();
         m_transport    = co_await create_transport(m_strategy);
+        ++m_stats.reconnects;
 
         log_i(__func__, "{} transport replaced with {} transport", old, m_transport->name());
 
@@ -217,17 +235,22 @@ namespace madbfs
     {
         auto req = rpc::req::Stat{ .path = path };
 
-        co_return (co_await send_req(req)).transform([](rpc::resp::Stat resp) {
-            return Stat{
-                .links = resp.links,
-                .size  = resp.size,
-                .mtime = resp.mtime,
-                .atime = resp.atime,
-                .ctime = resp.ctime,
-                .mode  = resp.mode,
-                .uid   = resp.uid,
-                .gid   = resp.gid,
-            };
+        co_return (co_await send_req(req)).transform(to_stat);
+    }
+
+    AExpect<Pair<Vec<Stat>, Errc>> Connection::stat_path(path::Path path)
+    {
+        auto req = rpc::req::StatPath{ .path = path };
+
+        co_return (co_await send_req(req)).transform([](rpc::resp::StatPath resp) {
+            auto stats = Vec<Stat>{};
+            stats.reserve(resp.stats.size());
+
+            for (const auto& stat : resp.stats) {
+                stats.push_back(to_stat(stat));
+            }
+
+            return Pair{ std::move(stats), resp.status };
         });
     }
 
@@ -241,16 +264,20 @@ namespace madbfs
         });
     }
 
-    AExpect<void> Connection::mknod(path::Path path, mode_t mode, dev_t dev)
+    AExpect<Opt<Stat>> Connection::mknod(path::Path path, mode_t mode, dev_t dev)
     {
         auto req = rpc::req::Mknod{ .path = path, .mode = mode, .dev = dev };
-        co_return (co_await send_req(req)).transform(sink_void);
+        co_return (co_await send_req(req)).transform([](rpc::resp::Mknod resp) {
+            return resp.stat.transform(to_stat);
+        });
     }
 
-    AExpect<void> Connection::mkdir(path::Path path, mode_t mode)
+    AExpect<Opt<Stat>> Connection::mkdir(path::Path path, mode_t mode)
     {
         auto req = rpc::req::Mkdir{ .path = path, .mode = mode };
-        co_return (co_await send_req(req)).transform(sink_void);
+        co_return (co_await send_req(req)).transform([](rpc::resp::Mkdir resp) {
+            return resp.stat.transform(to_stat);
+        });
     }
 
     AExpect<void> Connection::unlink(path::Path path)
@@ -265,25 +292,31 @@ namespace madbfs
         co_return (co_await send_req(req)).transform(sink_void);
     }
 
-    AExpect<void> Connection::rename(path::Path from, path::Path to, u32 flags)
+    AExpect<Opt<Stat>> Connection::rename(path::Path from, path::Path to, u32 flags)
     {
         auto req = rpc::req::Rename{ .from = from, .to = to, .flags = flags };
-        co_return (co_await send_req(req)).transform(sink_void);
+        co_return (co_await send_req(req)).transform([](rpc::resp::Rename resp) {
+            return resp.stat.transform(to_stat);
+        });
     }
 
-    AExpect<void> Connection::truncate(path::Path path, off_t size)
+    AExpect<Opt<Stat>> Connection::truncate(path::Path path, off_t size)
     {
         auto req = rpc::req::Truncate{ .path = path, .size = size };
-        co_return (co_await send_req(req)).transform(sink_void);
+        co_return (co_await send_req(req)).transform([](rpc::resp::Truncate resp) {
+            return resp.stat.transform(to_stat);
+        });
     }
 
-    AExpect<void> Connection::utimens(path::Path path, timespec atime, timespec mtime)
+    AExpect<Opt<Stat>> Connection::utimens(path::Path path, timespec atime, timespec mtime)
     {
         auto req = rpc::req::Utimens{ .path = path, .atime = atime, .mtime = mtime };
-        co_return (co_await send_req(req)).transform(sink_void);
+        co_return (co_await send_req(req)).transform([](rpc::resp::Utimens resp) {
+            return resp.stat.transform(to_stat);
+        });
     }
 
-    AExpect<usize> Connection::copy_file_range(
+    AExpect<Pair<usize, Opt<Stat>>> Connection::copy_file_range(
         path::Path in,
         off_t      in_off,
         path::Path out,
@@ -299,22 +332,40 @@ namespace madbfs
             .size       = size,
         };
 
-        co_return (co_await send_req(req)).transform(proj(&rpc::resp::CopyFileRange::size));
+        co_return (co_await send_req(req)).transform([](rpc::resp::CopyFileRange resp) {
+            return Pair{ resp.size, resp.stat.transform(to_stat) };
+        });
     }
 
-    AExpect<u64> Connection::open(path::Path path, OpenMode mode)
+    AExpect<u64> Connection::open(path::Path path, OpenMode mode, trace::Context trace)
     {
         auto req = rpc::req::Open{ .path = path, .mode = static_cast<rpc::OpenMode>(mode) };
-        co_return (co_await send_req(req)).transform(proj(&rpc::resp::Open::fd));
+        co_return (co_await send_req(req, trace)).transform(proj(&rpc::resp::Open::fd));
     }
 
-    AExpect<void> Connection::close(u64 fd)
+    AExpect<Pair<u64, Stat>> Connection::open(path::Path path, OpenMode mode, u8 flags, mode_t perm)
+    {
+        auto req = rpc::req::Open{
+            .path  = path,
+            .mode  = static_cast<rpc::OpenMode>(mode),
+            .flags = flags,
+            .perm  = perm,
+        };
+
+        co_return (co_await send_req(req)).transform([](rpc::resp::Open resp) {
+            return Pair{ resp.fd, to_stat(resp.stat) };
+        });
+    }
+
+    AExpect<Opt<Stat>> Connection::close(u64 fd)
     {
         auto req = rpc::req::Close{ .fd = fd };
-        co_return (co_await send_req(req)).transform(sink_void);
+        co_return (co_await send_req(req)).transform([](rpc::resp::Close resp) {
+            return resp.stat.transform(to_stat);
+        });
     }
 
-    AExpect<usize> Connection::read(u64 fd, Span<char> out, off_t offset)
+    AExpect<usize> Connection::read(u64 fd, Span<char> out, off_t offset, trace::Context trace)
     {
         auto req = rpc::req::Read{
             .fd     = fd,
@@ -322,14 +373,22 @@ namespace madbfs
             .out    = Span{ reinterpret_cast<u8*>(out.data()), out.size() },
         };
 
-        co_return (co_await send_req(req)).transform([](rpc::resp::Read resp) { return resp.read.size(); });
+        co_return (co_await send_req(req, trace)).transform([](rpc::resp::Read resp) {
+            return resp.read.size();
+        });
     }
 
-    AExpect<usize> Connection::write(u64 fd, Span<const char> in, off_t offset)
+    AExpect<usize> Connection::write(u64 fd, Span<const char> in, off_t offset, trace::Context trace)
     {
         auto bytes = Span{ reinterpret_cast<const u8*>(in.data()), in.size() };
         auto req   = rpc::req::Write{ .fd = fd, .offset = offset, .in = bytes };
-        co_return (co_await send_req(req)).transform(proj(&rpc::resp::Write::size));
+        co_return (co_await send_req(req, trace)).transform(proj(&rpc::resp::Write::size));
+    }
+
+    AExpect<off_t> Connection::lseek(u64 fd, off_t offset, rpc::Seek whence)
+    {
+        auto req = rpc::req::Lseek{ .fd = fd, .offset = offset, .whence = whence };
+        co_return (co_await send_req(req)).transform(proj(&rpc::resp::Lseek::offset));
     }
 
     Await<Opt<Errc>> Connection::check_reconnection()
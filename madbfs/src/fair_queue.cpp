@@ -0,0 +1,226 @@
+#include "madbfs/fair_queue.hpp"
+
+#include <madbfs-common/log.hpp>
+#include <madbfs-common/util/split.hpp>
+
+#include <charconv>
+#include <fstream>
+
+namespace
+{
+    // flows that are idle are forgotten once there are this many of them
+    constexpr auto max_flows = 256uz;
+
+    // resolved threads are forgotten all at once when there are this many of them
+    constexpr auto max_threads = 4096uz;
+}
+
+// fair_queue.hpp impl
+namespace madbfs
+{
+    FairQueue::FairQueue(usize slots)
+        : m_slots{ std::max(slots, 1uz) }
+    {
+    }
+
+    FairQueue::Ticket FairQueue::acquire(pid_t tid)
+    {
+        {
+            auto lock = std::unique_lock{ m_mutex };
+            if (auto pid = m_threads.find(tid); pid != m_threads.end()) {
+                if (auto flow = m_flows.find(pid->second); flow != m_flows.end()) {
+                    auto process = Process{ .pid = pid->second, .name = flow->second.name };
+                    lock.unlock();
+                    return acquire(std::move(process));
+                }
+            }
+        }
+
+        // procfs is read without the lock, the other threads shouldn't wait for it
+        auto process = resolve(tid);
+
+        {
+            auto lock = std::unique_lock{ m_mutex };
+            if (m_threads.size() >= max_threads) {
+                m_threads.clear();
+            }
+            m_threads.insert_or_assign(tid, process.pid);
+        }
+
+        return acquire(std::move(process));
+    }
+
+    FairQueue::Ticket FairQueue::acquire(Process process)
+    {
+        auto lock = std::unique_lock{ m_mutex };
+
+        auto& flow  = flow_of(process);
+        auto  start = std::max(m_virtual, flow.finish);
+
+        flow.finish = start + 1.0 / flow.weight;
+
+        auto tag = Tag{ flow.finish, m_arrival++ };
+
+        // no other process has an operation in flight or waiting, there is no one to be fair to
+        if (m_waiting.empty() and (m_active < m_slots or flow.active == m_active)) {
+            ++flow.active;
+            ++m_active;
+            m_virtual = tag.first;
+            return Ticket{ this, { .pid = process.pid, .name = flow.name } };
+        }
+
+        m_waiting.insert(tag);
+        m_cv.wait(lock, [&] { return m_active < m_slots and *m_waiting.begin() == tag; });
+        m_waiting.erase(m_waiting.begin());
+
+        // the flow is looked up again, it may have been forgotten while waiting
+        auto& admitted = flow_of(process);
+
+        ++admitted.active;
+        ++m_active;
+        m_virtual = tag.first;
+
+        // the next one in line may be admitted as well if there are free slots
+        if (not m_waiting.empty() and m_active < m_slots) {
+            m_cv.notify_all();
+        }
+
+        return Ticket{ this, { .pid = process.pid, .name = admitted.name } };
+    }
+
+    FairQueue::Process FairQueue::resolve(pid_t tid)
+    {
+        // kernel-initiated operations (e.g. release) may come with pid 0
+        if (tid <= 0) {
+            return { .pid = 0, .name = {} };
+        }
+
+        auto status = std::ifstream{ fmt::format("/proc/{}/status", tid) };
+        if (not status) {
+            return { .pid = 0, .name = {} };
+        }
+
+        auto pid = tid;
+        for (auto line = String{}; std::getline(status, line);) {
+            if (not line.starts_with("Tgid:")) {
+                continue;
+            }
+            auto value = util::strip(Str{ line }.substr(5));
+            std::from_chars(value.begin(), value.end(), pid);
+            break;
+        }
+
+        auto comm = std::ifstream{ fmt::format("/proc/{}/comm", pid) };
+        auto name = String{};
+        std::getline(comm, name);
+
+        return { .pid = pid, .name = std::move(name) };
+    }
+
+    Expect<FairQueue::Weights> FairQueue::parse_weights(Str spec)
+    {
+        auto weights = Weights{};
+
+        for (auto entry : util::split(spec, ';')) {
+            entry = util::strip(entry);
+            if (entry.empty()) {
+                continue;
+            }
+
+            auto eq = entry.rfind('=');
+            if (eq == Str::npos) {
+                return Unexpect{ Errc::invalid_argument };
+            }
+
+            auto name  = util::strip(entry.substr(0, eq));
+            auto value = util::strip(entry.substr(eq + 1));
+
+            auto weight    = 0u;
+            auto [ptr, ec] = std::from_chars(value.begin(), value.end(), weight);
+            if (ec != std::errc{} or ptr != value.end() or weight == 0 or name.empty()) {
+                return Unexpect{ Errc::invalid_argument };
+            }
+
+            weights.insert_or_assign(String{ name }, weight);
+        }
+
+        return weights;
+    }
+
+    String FairQueue::to_string(const Weights& weights)
+    {
+        auto sorted = weights | sr::to<Vec<Pair<String, u32>>>();
+        sr::sort(sorted);
+
+        auto buf = String{};
+        for (const auto& [name, weight] : sorted) {
+            if (not buf.empty()) {
+                buf += ';';
+            }
+            fmt::format_to(std::back_inserter(buf), "{}={}", name, weight);
+        }
+        return buf;
+    }
+
+    FairQueue::Weights FairQueue::set_weights(Weights weights)
+    {
+        auto lock = std::unique_lock{ m_mutex };
+        auto old  = std::exchange(m_weights, std::move(weights));
+
+        for (auto& flow : m_flows | sv::values) {
+            auto found  = m_weights.find(flow.name);
+            flow.weight = found != m_weights.end() ? found->second : default_weight;
+        }
+
+        return old;
+    }
+
+    FairQueue::Weights FairQueue::weights() const
+    {
+        auto lock = std::unique_lock{ m_mutex };
+        return m_weights;
+    }
+
+    usize FairQueue::waiting() const
+    {
+        auto lock = std::unique_lock{ m_mutex };
+        return m_waiting.size();
+    }
+
+    void FairQueue::release(pid_t pid)
+    {
+        auto lock = std::unique_lock{ m_mutex };
+
+        // a flow is never forgotten while it has operations in flight
+        if (auto flow = m_flows.find(pid); flow != m_flows.end()) {
+            --flow->second.active;
+        }
+        --m_active;
+
+        if (not m_waiting.empty()) {
+            m_cv.notify_all();
+        }
+    }
+
+    FairQueue::Flow& FairQueue::flow_of(const Process& process)
+    {
+        if (auto found = m_flows.find(process.pid); found != m_flows.end()) {
+            return found->second;
+        }
+
+        // an idle flow has no operation in flight nor waiting with a tag after the virtual time
+        if (m_flows.size() >= max_flows) {
+            std::erase_if(m_flows, [&](const auto& kv) {
+                return kv.second.active == 0 and kv.second.finish <= m_virtual;
+            });
+        }
+
+        auto found  = m_weights.find(process.name);
+        auto weight = found != m_weights.end() ? found->second : default_weight;
+
+        log_d(__func__, "new flow [pid={}|name={:?}|weight={}]", process.pid, process.name, weight);
+
+        auto flow = Flow{ .name = process.name, .weight = weight };
+        return m_flows.emplace(process.pid, std::move(flow)).first->second;
+    }
+}
@@ -10,7 +10,10 @@ namespace madbfs
 {
     Opt<FileHandle> FileHandleStore::find(u64 fd)
     {
-        return fd < m_handles.size() ? Opt{ m_handles[fd] } : std::nullopt;
+        if (fd >= m_handles.size() or m_handles[fd].node == nullptr) {
+            return std::nullopt;
+        }
+        return m_handles[fd];
     }
 
     Opt<FileHandle> FileHandleStore::find(u64 fd, OpenMode mode)
@@ -27,54 +30,97 @@ namespace madbfs
 
     u64 FileHandleStore::store(Node* node, OpenMode mode, u64 real_fd)
     {
-        if (auto found = sr::find(m_handles, nullptr, &FileHandle::node); found != m_handles.end()) {
-            auto dist               = static_cast<usize>(found - m_handles.begin());
-            m_handles[dist].node    = node;
-            m_handles[dist].mode    = mode;
-            m_handles[dist].real_fd = real_fd;
-            return dist;
+        if (m_free == npos) {
+            grow();
         }
 
-        auto size = m_handles.size();
+        auto fd = m_free;
+        m_free  = m_links[fd].next;
 
-        if (m_handles.empty()) {
-            m_handles.resize(1024, {});    // 1024 seats by default is reasonable I guess
-        } else {
-            m_handles.resize(size * 2, {});    // should I add upper limit?
-        }
+        m_handles[fd] = { .node = node, .mode = mode, .real_fd = real_fd };
 
-        m_handles[size].node    = node;
-        m_handles[size].mode    = mode;
-        m_handles[size].real_fd = real_fd;
+        // push front into the chain of the node
+        m_links[fd] = { .prev = npos, .next = node->m_handles };
+        if (node->m_handles != npos) {
+            m_links[node->m_handles].prev = fd;
+        }
+        node->m_handles = fd;
 
-        return size;
+        ++m_open;
+        return fd;
     }
 
     Opt<FileHandle> FileHandleStore::release(u64 fd)
     {
-        return fd < m_handles.size() ? Opt{ std::exchange(m_handles[fd], {}) } : std::nullopt;
+        if (fd >= m_handles.size()) {
+            return std::nullopt;
+        } else if (m_links[fd].prev == erased) {
+            m_links[fd] = { .prev = npos, .next = m_free };
+            m_free      = fd;
+            --m_erased;
+            return std::nullopt;
+        } else if (m_handles[fd].node == nullptr) {
+            return std::nullopt;
+        }
+
+        auto handle = m_handles[fd];
+        unlink(fd);
+        return handle;
     }
 
     usize FileHandleStore::erase(Node* node)
     {
         auto count = 0uz;
-        for (auto& v : m_handles) {
-            if (v.node == node) {
-                v.node = nullptr;
-                ++count;
-            }
+        for (auto fd = node->m_handles; fd != npos; ++count) {
+            auto next = m_links[fd].next;
+
+            m_handles[fd] = {};
+            m_links[fd]   = { .prev = erased, .next = npos };
+
+            fd = next;
         }
+
+        node->m_handles = npos;
+
+        m_open   -= count;
+        m_erased += count;
+
         return count;
     }
 
-    usize FileHandleStore::count_open() const
+    void FileHandleStore::unlink(u64 fd)
     {
-        auto count = sr::count_if(m_handles, [](const FileHandle& h) { return h.node != nullptr; });
-        return static_cast<usize>(count);
+        auto [prev, next] = m_links[fd];
+
+        if (prev != npos) {
+            m_links[prev].next = next;
+        } else {
+            m_handles[fd].node->m_handles = next;
+        }
+
+        if (next != npos) {
+            m_links[next].prev = prev;
+        }
+
+        m_handles[fd] = {};
+        m_links[fd]   = { .prev = npos, .next = m_free };
+        m_free        = fd;
+
+        --m_open;
     }
 
-    usize FileHandleStore::count_empty() const
+    void FileHandleStore::grow()
     {
-        return capacity() - count_open();
+        auto size     = m_handles.size();
+        auto new_size = size == 0 ? 1024uz : size * 2;    // 1024 seats by default is reasonable I guess
+
+        m_handles.resize(new_size, {});
+        m_links.resize(new_size, {});
+
+        // lower fds are handed out first
+        for (auto fd = new_size; fd-- > size;) {
+            m_links[fd] = { .prev = npos, .next = m_free };
+            m_free      = fd;
+        }
     }
 }
@@ -2,13 +2,16 @@
 
 #include "madbfs/connection.hpp"
 #include "madbfs/node.hpp"
+#include "madbfs/tree_snapshot.hpp"
 
 #include <madbfs-common/log.hpp>
 
 #include <fmt/std.h>
 #include <sys/stat.h>
 
+#include <bit>
 #include <cassert>
+#include <cctype>
 
 using namespace madbfs;
 
@@ -28,74 +31,134 @@ namespace
            and err != std::errc::resource_unavailable_try_again;
     }
 
+    // minimum number of expired children of a directory before they are revalidated together
+    constexpr auto bulk_revalidation_min = 8uz;
+
     Opt<Cache> construct_cache(Connection& connection, Opt<Caching> caching)
     {
-        return caching.transform([&](auto c) { return Cache{ connection, c.page_size, c.max_pages }; });
+        return caching.transform([&](auto c) {
+            return Cache{ connection, c.page_size, c.max_pages, Seconds{ c.linger } };
+        });
+    }
+
+    /**
+     * @brief Check whether a file is a picture, video, or audio file based on its extension.
+     *
+     * @param name File name.
+     */
+    bool is_media_file(Str name)
+    {
+        static constexpr auto extensions = std::to_array<Str>({
+            "jpg", "jpeg", "png", "gif", "webp", "heic", "heif", "bmp", "dng",    // pictures
+            "mp4", "mkv", "webm", "3gp", "mov", "avi",                           // videos
+            "mp3", "flac", "ogg", "opus", "m4a", "wav",                          // audios
+        });
+
+        auto dot = name.rfind('.');
+        if (dot == Str::npos or name.size() - dot - 1 > 4) {
+            return false;
+        }
+
+        auto ext   = name.substr(dot + 1);
+        auto lower = Array<char, 4>{};
+        sr::transform(ext, lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        return sr::find(extensions, Str{ lower.data(), ext.size() }) != extensions.end();
     }
 }
 
 // filesystem.hpp impl
 namespace madbfs
 {
-    Filesystem::Filesystem(Connection& connection, Opt<Caching> caching, Opt<Seconds> ttl)
+    Caching Caching::of_size(usize page_kib, usize cache_mib)
+    {
+        auto page_size = std::bit_ceil(std::clamp(page_kib, 64uz, 4096uz)) * 1024;
+        auto max_pages = std::max(cache_mib * 1024 * 1024 / page_size, 1uz);
+        return { .page_size = page_size, .max_pages = max_pages };
+    }
+
+    Filesystem::Filesystem(
+        Connection&  connection,
+        Opt<Caching> caching,
+        Opt<Seconds> ttl,
+        path::Path   mount_root
+    )
         : m_connection{ connection }
         , m_root{ "/", nullptr, {}, node::Directory{} }
         , m_cache{ construct_cache(connection, caching) }
+        , m_mount_root{ mount_root.owned() }
         , m_ttl{ ttl }
+        , m_prefetch_budget{ caching.transform(&Caching::prefetch_budget).value_or(0) }
+        , m_stream_threshold{ caching.transform(&Caching::stream_threshold).value_or(0) }
     {
+        // real fds outlive the handles in cache mode, the stat of the file arrives once they are closed
+        if (m_cache) {
+            m_cache->set_close_hook([this](Id id, path::Path path, const Stat& stat) {
+                if (auto node = traverse(path); node and node->get().id() == id) {
+                    node->get().set_stat(stat);
+                }
+            });
+        }
     }
 
-    AExpect<Ref<Node>> Filesystem::build(Node& parent, path::Path path)
+    AExpect<Ref<Node>> Filesystem::build_missing(Node& parent, path::Path path, usize depth)
     {
-        const auto name = path.filename();
+        if (auto dir = parent.as_directory(); not dir) {
+            co_return Unexpect{ dir.error() };
+        }
 
-        auto build_then_expire = [&](Str name, Stat stat, File file) {
-            return parent.build(name, std::move(stat), std::move(file)).transform([&](Node& node) {
-                node.expires_after(m_ttl.value_or(Seconds::max()));
-                return std::ref(node);
-            });
-        };
+        auto res = co_await m_connection.stat_path(path);
+        if (not res) {
+            co_return Unexpect{ res.error() };
+        }
 
-        auto stat = co_await m_connection.stat(path);
-        if (not stat.has_value()) {
-            auto err = stat.error();
-            if (should_cache_error(err)) {
-                std::ignore = build_then_expire(name, {}, node::Error{ err });
+        const auto& [stats, status] = *res;
+
+        auto names        = path.iter() | sr::to<Vec<Str>>();
+        auto current      = &parent;
+        auto current_path = path::PathBuf{};
+
+        log_d(__func__, "{:?}: {} of {} components missing", path, names.size() - depth, names.size());
+
+        for (auto i = 0uz; i < names.size(); ++i) {
+            current_path.extend(names[i]);
+            if (i < depth) {
+                continue;
             }
-            co_return Unexpect{ err };
-        }
 
-        switch (stat->mode & S_IFMT) {
-        case S_IFREG: co_return build_then_expire(name, *stat, node::Regular{});
-        case S_IFDIR: co_return build_then_expire(name, *stat, node::Directory{});
-        case S_IFLNK: co_return build_then_expire(name, *stat, node::Link{});
-        default: co_return build_then_expire(name, *stat, node::Other{});
-        }
-    }
+            if (i >= stats.size()) {
+                auto err = status != Errc{} ? status : Errc::io_error;
+                if (should_cache_error(err)) {
+                    if (auto built = current->build(names[i], {}, node::Error{ err }); built) {
+                        built->get().expires_after(ttl_of(current_path));
+                    }
+                }
+                co_return Unexpect{ err };
+            }
 
-    AExpect<Ref<Node>> Filesystem::build_directory(Node& parent, path::Path path)
-    {
-        const auto name = path.filename();
+            const auto& stat = stats[i];
+            if (i + 1 < names.size() and (stat.mode & S_IFMT) != S_IFDIR) {
+                co_return Unexpect{ Errc::not_a_directory };
+            }
 
-        auto build_then_expire = [&](Str name, Stat stat, File file) {
-            return parent.build(name, std::move(stat), std::move(file)).transform([&](Node& node) {
-                node.expires_after(m_ttl.value_or(Seconds::max()));
-                return std::ref(node);
-            });
-        };
+            auto file = File{};
+            switch (stat.mode & S_IFMT) {
+            case S_IFREG: file = node::Regular{}; break;
+            case S_IFDIR: file = node::Directory{}; break;
+            case S_IFLNK: file = node::Link{}; break;
+            default: file = node::Other{}; break;
+            }
 
-        auto stat = co_await m_connection.stat(path);
-        if (not stat.has_value()) {
-            auto err = stat.error();
-            if (should_cache_error(err)) {
-                std::ignore = build_then_expire(name, {}, node::Error{ err });
+            auto built = current->build(names[i], stat, std::move(file));
+            if (not built) {
+                co_return Unexpect{ built.error() };
             }
-            co_return Unexpect{ err };
-        } else if ((stat->mode & S_IFMT) != S_IFDIR) {
-            co_return Unexpect{ Errc::not_a_directory };
+
+            current = &built->get();
+            current->expires_after(ttl_of(current_path));
         }
 
-        co_return build_then_expire(name, *stat, node::Directory{});
+        co_return *current;
     }
 
     Expect<Ref<Node>> Filesystem::traverse(path::Path path)
@@ -125,6 +188,7 @@ namespace madbfs
 
         auto* current      = &m_root;
         auto  current_path = path::PathBuf{};
+        auto  depth        = 0uz;
 
         // iterate until parent
         for (auto name : path.parent_path().iter()) {
@@ -136,28 +200,42 @@ namespace madbfs
                     }
                 }
                 current = &next->get();
+                ++depth;
                 continue;
             }
 
-            auto next = co_await build_directory(*current, current_path);
-            if (not next) {
-                co_return Unexpect{ next.error() };
-            }
-
-            current = &next->get();
+            // the rest of the path is not known yet, fetch all of them at once
+            co_return co_await build_missing(*current, path, depth);
         }
 
         current_path.extend(path.filename());
         if (auto found = current->traverse(path.filename()); found.has_value()) {
-            if (auto& node = found->get(); node.expired()) {
+            auto& node = found->get();
+            if (not node.expired()) {
+                co_return found;
+            }
+
+            auto& siblings = current->as_directory()->get().children();
+            auto  expired  = sr::count_if(siblings, [](const Uniq<Node>& n) { return n->expired(); });
+
+            if (static_cast<usize>(expired) < bulk_revalidation_min) {
                 if (auto res = co_await update(node, current_path); not res) {
                     co_return Unexpect{ res.error() };
                 }
+                co_return found;
+            }
+
+            if (auto res = co_await revalidate_children(*current, path.parent_path()); not res) {
+                co_return Unexpect{ res.error() };
+            }
+
+            // the node may have been removed by the revalidation
+            if (auto found = current->traverse(path.filename()); found.has_value()) {
+                co_return found;
             }
-            co_return found;
         }
 
-        co_return co_await build(*current, current_path);
+        co_return co_await build_missing(*current, path, depth);
     }
 
     AExpect<void> Filesystem::update(Node& node, path::Path path)
@@ -171,7 +249,7 @@ namespace madbfs
             auto err = new_stat.error();
             if (should_cache_error(err)) {
                 co_await mutate_and_invalidate(node, node::Error{ err });
-                node.expires_after(m_ttl.value_or(Seconds::max()));
+                node.expires_after(ttl_of(path));
             }
             co_return Unexpect{ err };
         }
@@ -179,7 +257,7 @@ namespace madbfs
         // no change
         if (not node.is_error() and not detect_modification(old_stat, *new_stat)) {
             log_d(__func__, "unchanged: {:?}", path);
-            node.expires_after(m_ttl.value_or(Seconds::max()));
+            node.expires_after(ttl_of(path));
             co_return Expect<void>{};
         }
 
@@ -189,28 +267,28 @@ namespace madbfs
         case S_IFREG: {
             node.set_stat(*new_stat);
             co_await mutate_and_invalidate(node, node::Regular{});    // invalidate currently held data
-            node.expires_after(m_ttl.value_or(Seconds::max()));
+            node.expires_after(ttl_of(path));
         } break;
         case S_IFDIR: {
             if (S_ISDIR(old_stat.mode)) {    // previously directory
                 node.set_stat(*new_stat);
                 node.set_synced(false);    // don't mutate, force rescan
-                node.expires_after(m_ttl.value_or(Seconds::max()));
+                node.expires_after(ttl_of(path));
             } else {
                 node.set_stat(*new_stat);
                 co_await mutate_and_invalidate(node, node::Directory{});    // not directory, becomes one
-                node.expires_after(m_ttl.value_or(Seconds::max()));
+                node.expires_after(ttl_of(path));
             }
         } break;
         case S_IFLNK: {
             node.set_stat(*new_stat);
             co_await mutate_and_invalidate(node, node::Link{});
-            node.expires_after(m_ttl.value_or(Seconds::max()));
+            node.expires_after(ttl_of(path));
         } break;
         default: {
             node.set_stat(*new_stat);
             co_await mutate_and_invalidate(node, node::Other{});
-            node.expires_after(m_ttl.value_or(Seconds::max()));
+            node.expires_after(ttl_of(path));
         } break;
         }
 
@@ -240,6 +318,95 @@ namespace madbfs
         }
     }
 
+    Await<void> Filesystem::prefetch_media(Node& dir, path::Path path)
+    {
+        // a directory is considered dominated by media if at least half of its regular files are media
+        constexpr auto min_media = 4uz;
+
+        if (not m_cache or m_prefetch_budget == 0) {
+            co_return;
+        }
+
+        const auto page_size = m_cache->page_size();
+        const auto budget    = std::min(m_prefetch_budget, page_size * m_cache->max_pages() / 2);
+
+        auto regulars = 0uz;
+        auto medias   = 0uz;
+        auto total    = 0uz;
+        auto targets  = Vec<Pair<Id, path::PathBuf>>{};
+
+        for (const auto& node : dir.as_directory()->get().children()) {
+            if (not node->is_regular()) {
+                continue;
+            }
+
+            ++regulars;
+            if (not is_media_file(node->name())) {
+                continue;
+            }
+
+            ++medias;
+            auto cost = std::min(static_cast<usize>(node->stat().size), page_size);
+            if (cost == 0 or total + cost > budget) {
+                continue;
+            }
+
+            if (auto file_path = path.extend_copy(node->name()); file_path) {
+                total += cost;
+                targets.emplace_back(node->id(), std::move(*file_path));
+            }
+        }
+
+        if (medias < min_media or medias * 2 < regulars or targets.empty()) {
+            co_return;
+        }
+
+        log_i(__func__, "prefetch {} media files [{} KiB] {:?}", targets.size(), total / 1024, path);
+
+        auto work = [this](this auto, Vec<Pair<Id, path::PathBuf>> targets) -> Await<void> {
+            constexpr auto batch_size = 8z;
+
+            auto failed = 0uz;
+            for (auto batch : targets | sv::chunk(batch_size)) {
+                if (m_stopping) {
+                    log_d("prefetch_media", "stopped [count={}|failed={}]", targets.size(), failed);
+                    co_return;
+                }
+                auto fetch = [&](const auto& t) { return m_cache->prefetch(t.first, t.second); };
+                for (auto&& res : co_await async::wait_all(batch | sv::transform(fetch))) {
+                    failed += not res.has_value();
+                }
+            }
+            log_d("prefetch_media", "finished [count={}|failed={}]", targets.size(), failed);
+        };
+
+        co_await spawn_background("prefetch_media", work(std::move(targets)));
+    }
+
+    Await<void> Filesystem::spawn_background(const char* name, Await<void> task)
+    {
+        if (m_stopping) {
+            co_return;
+        }
+
+        m_background.enter();
+
+        auto exec = co_await async::current_executor();
+        async::spawn(exec, std::move(task), [this, name](std::exception_ptr e) {
+            log::log_exception(e, name);
+            m_background.leave();
+        });
+    }
+
+    void Filesystem::apply_stat(Node& node, Opt<Stat> stat)
+    {
+        if (stat) {
+            node.set_stat(std::move(*stat));
+        } else {
+            node.expires_after(Seconds{ 0 });
+        }
+    }
+
     void Filesystem::walk(Node& start, std::function<void(Node&)> func)
     {
         auto stack = Vec<Node*>{ &start };
@@ -258,113 +425,223 @@ namespace madbfs
         }
     }
 
-    AExpect<void> Filesystem::readdir(path::Path path, Filler filler)
+    AExpect<void> Filesystem::sync_children(Node& dir, path::Path path)
     {
-        auto current = &m_root;
-
-        if (not path.is_root()) {
-            auto maybe_node = co_await traverse_or_build(path);
-            if (not maybe_node.has_value()) {
-                co_return Unexpect{ maybe_node.error() };
-            }
-            current = &maybe_node->get();
+        auto maybe_dir = dir.as_directory();
+        if (not maybe_dir) {
+            co_return Unexpect{ maybe_dir.error() };
         }
 
-        auto current_dir = current->as_directory();
-        if (not current_dir) {
-            co_return Unexpect{ current_dir.error() };
-        }
-
-        auto& list    = current_dir->get().children();
+        auto& list    = maybe_dir->get();
         auto  pathbuf = path.extend_copy("dummy").value();
 
-        auto build_file = [&](Str name, mode_t mode) -> Await<File> {
+        auto build_file = [&](Str name, mode_t mode) -> File {
             auto renamed = pathbuf.rename(name);
             assert(renamed);
 
             switch (mode & S_IFMT) {
-            case S_IFREG: co_return node::Regular{};
-            case S_IFDIR: co_return node::Directory{};
-            case S_IFLNK: co_return node::Link{};
-            default: co_return node::Other{};
+            case S_IFREG: return node::Regular{};
+            case S_IFDIR: return node::Directory{};
+            case S_IFLNK: return node::Link{};
+            default: return node::Other{};
             }
         };
 
-        if (not current->has_synced()) {
-            auto may_stats = co_await m_connection.statdir(path);
-            if (not may_stats) {
-                co_return Unexpect{ may_stats.error() };
+        auto may_stats = co_await m_connection.statdir(path);
+        if (not may_stats) {
+            co_return Unexpect{ may_stats.error() };
+        }
+
+        if (list.children().empty()) {
+            for (auto [stat, name] : may_stats.value()) {
+                log_d(__func__, "[{:?}] new entry    : {:?}", dir.name(), name);
+
+                auto file  = build_file(name, stat.mode);
+                auto child = std::make_unique<Node>(name, &dir, std::move(stat), std::move(file));
+                child->expires_after(ttl_of(pathbuf));
+                std::ignore = list.insert(std::move(child), false);
             }
 
-            if (list.empty()) {
-                for (auto [stat, name] : may_stats.value()) {
-                    log_d(__func__, "[{:?}] new entry    : {:?}", current->name(), name);
+            dir.set_synced(true);
+            co_return Expect<void>{};
+        }
+
+        // cookies of the entries that still exist, existing entries keep their cookies (readdir offsets)
+        auto seen = Vec<u64>{};
+        seen.reserve(list.children().size());
 
-                    auto file  = co_await build_file(name, stat.mode);
-                    auto child = std::make_unique<Node>(name, current, std::move(stat), std::move(file));
-                    child->expires_after(m_ttl.value_or(Seconds::max()));
-                    list.emplace(std::move(child));
-                }
+        // update old entries or add a new one if not exists
+        for (auto [stat, name] : may_stats.value()) {
+            auto found = list.find(name);
+            if (not found) {
+                log_d(__func__, "[{:?}] new entry: {:?}", dir.name(), name);
+
+                auto file  = build_file(name, stat.mode);
+                auto child = std::make_unique<Node>(name, &dir, std::move(stat), std::move(file));
+                child->expires_after(ttl_of(pathbuf));
+                seen.push_back(list.insert(std::move(child), false)->first.get().cookie());
+
+                continue;
+            }
+
+            auto& child = found->get();
+            seen.push_back(child.cookie());
+
+            if (child.is_error()) {    // Error node
+                log_d(__func__, "[{:?}]   changed: {:?}", dir.name(), name);
+
+                auto file = build_file(name, stat.mode);
+                child.set_stat(std::move(stat));
+                co_await mutate_and_invalidate(child, std::move(file));
+                child.expires_after(ttl_of(pathbuf));
+            } else if (not child.expired()) {
+                log_d(__func__, "[{:?}]     fresh: {:?}", dir.name(), name);
+            } else if (not detect_modification(child.stat(), stat)) {
+                log_d(__func__, "[{:?}] unchanged: {:?}", dir.name(), name);
+
+                std::ignore = pathbuf.rename(name);
+                child.expires_after(ttl_of(pathbuf));
+            } else if (child.is_directory() and S_ISDIR(stat.mode)) {
+                log_d(__func__, "[{:?}]   changed: {:?}", dir.name(), name);
+
+                // same as update(), don't mutate, force rescan
+                std::ignore = pathbuf.rename(name);
+                child.set_stat(std::move(stat));
+                child.set_synced(false);
+                child.expires_after(ttl_of(pathbuf));
             } else {
-                auto new_list = std::unordered_set<Str>{};
+                log_d(__func__, "[{:?}]   changed: {:?}", dir.name(), name);
 
-                // update old entries or add a new one if not exists
-                for (auto [stat, name] : may_stats.value()) {
-                    new_list.emplace(name);
+                auto file = build_file(name, stat.mode);
+                child.set_stat(std::move(stat));
+                co_await mutate_and_invalidate(child, std::move(file));
+                child.expires_after(ttl_of(pathbuf));
+            }
+        }
 
-                    auto found = list.find(name);
-                    if (found == list.end()) {
-                        log_d(__func__, "[{:?}] new entry: {:?}", current->name(), name);
+        // remove old entries if doesn't exist in new entries; both are ordered by cookie
+        sr::sort(seen);
 
-                        auto file  = co_await build_file(name, stat.mode);
-                        auto child = std::make_unique<Node>(name, current, std::move(stat), std::move(file));
-                        child->expires_after(m_ttl.value_or(Seconds::max()));
-                        list.emplace(std::move(child));
+        auto removed = Vec<Node*>{};
+        auto seen_it = seen.begin();
+        for (auto [cookie, node] : list.order()) {
+            while (seen_it != seen.end() and *seen_it < cookie) {
+                ++seen_it;
+            }
+            if (seen_it == seen.end() or *seen_it != cookie) {
+                removed.push_back(node);
+            }
+        }
 
-                        continue;
-                    }
+        auto removed_ids = Vec<Id>{};
+        removed_ids.reserve(removed.size());
 
-                    auto& child = (**found);
-                    if (child.is_error()) {    // Error node
-                        log_d(__func__, "[{:?}]   changed: {:?}", current->name(), name);
-
-                        auto file = co_await build_file(name, stat.mode);
-                        child.set_stat(std::move(stat));
-                        co_await mutate_and_invalidate(child, std::move(file));
-                        child.expires_after(m_ttl.value_or(Seconds::max()));
-                    } else if (child.expired() and detect_modification(child.stat(), stat)) {
-                        log_d(__func__, "[{:?}]   changed: {:?}", current->name(), name);
-
-                        auto file = co_await build_file(name, stat.mode);
-                        child.set_stat(std::move(stat));
-                        co_await mutate_and_invalidate(child, std::move(file));
-                        child.expires_after(m_ttl.value_or(Seconds::max()));
-                    }
+        for (auto node : removed) {
+            log_d(__func__, "[{:?}]   removed: {:?}", dir.name(), node->name());
 
-                    log_d(__func__, "[{:?}] unchanged: {:?}", current->name(), name);
-                }
+            // open handles of the subtree must not outlive it, the kernel may release them later
+            walk(*node, [&](Node& n) { m_handles.erase(&n), removed_ids.push_back(n.id()); });
+            std::ignore = list.erase(node->name());
+        }
 
-                // remove old entries if doesn't exist in new entries
-                for (auto it = list.begin(); it != list.end();) {
-                    auto name = (**it).name();
-                    if (not new_list.contains(name)) {
-                        log_d(__func__, "[{:?}]   removed: {:?}", current->name(), name);
-                        if (m_cache) {
-                            co_await m_cache->invalidate_one((**it).id(), false);    // should I flush
-                        }
-                        it = list.erase(it);
-                        continue;
-                    }
-                    ++it;
-                }
+        if (m_cache) {
+            for (auto id : removed_ids) {
+                co_await m_cache->invalidate_one(id, false);    // should I flush
+            }
+        }
+
+        dir.set_synced(true);
+        co_return Expect<void>{};
+    }
+
+    AExpect<void> Filesystem::revalidate_children(Node& dir, path::Path path)
+    {
+        const auto old_stat = dir.stat();
+
+        if (auto res = co_await update(dir, path); not res) {
+            co_return Unexpect{ res.error() };
+        }
+
+        auto maybe_dir = dir.as_directory();
+        if (not maybe_dir) {
+            co_return Unexpect{ maybe_dir.error() };
+        }
+
+        // unchanged mtime means no entry is created, removed, or renamed inside the directory. the state of
+        // entries that is fully determined by the name can't have changed then (symlink targets, special
+        // files, and non-existing entries). regular files and directories may still have changed content
+        // which doesn't show up on the parent mtime though, they need one listdir. so do the entries that
+        // failed for other reasons than not existing (e.g. EACCES or EIO), the failure may be transient.
+        const auto unchanged = not detect_modification(old_stat, dir.stat());
+
+        auto name_bound = [](const Node& node) {
+            if (auto err = node.as_error(); err) {
+                return err->error == Errc::no_such_file_or_directory;
+            }
+            return not node.is_regular() and not node.is_directory();
+        };
+
+        auto pathbuf = path.extend_copy("dummy").value();
+        auto pending = 0uz;
+
+        for (const auto& child : maybe_dir->get().children()) {
+            if (not child->expired()) {
+                continue;
+            } else if (unchanged and name_bound(*child)) {
+                std::ignore = pathbuf.rename(child->name());
+                child->expires_after(ttl_of(pathbuf));
+            } else {
+                ++pending;
             }
+        }
+
+        log_d(__func__, "{:?}: unchanged={} pending={}", path, unchanged, pending);
 
-            current->set_synced(true);
+        if (pending == 0) {
+            co_return Expect<void>{};
         }
 
-        for (const auto& node : std::as_const(list)) {
-            if (not node->is_error()) {
-                filler(node->name().data());
+        co_return co_await sync_children(dir, path);
+    }
+
+    AExpect<void> Filesystem::readdir(path::Path path, off_t offset, Filler filler, bool prefetch)
+    {
+        auto current = &m_root;
+
+        if (path.is_root() and m_root.expired()) {
+            if (auto res = co_await update(m_root, path); not res) {
+                co_return Unexpect{ res.error() };
+            }
+        } else if (not path.is_root()) {
+            auto maybe_node = co_await traverse_or_build(path);
+            if (not maybe_node.has_value()) {
+                co_return Unexpect{ maybe_node.error() };
+            }
+            current = &maybe_node->get();
+        }
+
+        auto current_dir = current->as_directory();
+        if (not current_dir) {
+            co_return Unexpect{ current_dir.error() };
+        }
+
+        // only a fresh listing triggers a prefetch; a cached listing or a continuation of one already did
+        if (not current->has_synced()) {
+            if (auto res = co_await sync_children(*current, path); not res) {
+                co_return Unexpect{ res.error() };
+            }
+            if (prefetch and offset == 0) {
+                co_await prefetch_media(*current, path);
+            }
+        }
+
+        // existing entries keep their cookies across re-sync, so resuming from offset stays consistent
+        for (auto [cookie, node] : current_dir->get().list_after(static_cast<u64>(offset))) {
+            if (node->is_error()) {
+                continue;
+            }
+            if (filler(node->name().data(), static_cast<off_t>(cookie))) {
+                break;
             }
         }
 
@@ -422,17 +699,20 @@ namespace madbfs
             overwrite = true;
         }
 
-        if (auto created = co_await m_connection.mknod(path, mode, dev); not created) {
+        auto created = co_await m_connection.mknod(path, mode, dev);
+        if (not created) {
             parent->get().refresh_stat(timespec_omit, timespec_now);
             co_return Unexpect{ created.error() };
         }
 
-        co_return (co_await m_connection.stat(path))
-            .and_then([&](Stat stat) {
-                auto node = std::make_unique<Node>(name, &parent->get(), std::move(stat), node::Regular{});
-                return dir.insert(std::move(node), overwrite);
-            })
-            .transform([&](auto&& pair) { return pair.first; });
+        // the node can't be built without a stat, fetch it separately if the device didn't provide it
+        auto stat = *created ? Expect<Stat>{ **created } : co_await m_connection.stat(path);
+        if (not stat) {
+            co_return Unexpect{ stat.error() };
+        }
+
+        auto node = std::make_unique<Node>(name, &parent->get(), std::move(*stat), node::Regular{});
+        co_return dir.insert(std::move(node), overwrite).transform([&](auto&& pair) { return pair.first; });
     }
 
     AExpect<Ref<Node>> Filesystem::mkdir(path::Path path, mode_t mode)
@@ -455,17 +735,20 @@ namespace madbfs
             overwrite = true;
         }
 
-        if (auto created = co_await m_connection.mkdir(path, mode); not created) {
+        auto created = co_await m_connection.mkdir(path, mode);
+        if (not created) {
             parent->get().refresh_stat(timespec_omit, timespec_now);
             co_return Unexpect{ created.error() };
         }
 
-        co_return (co_await m_connection.stat(path))
-            .and_then([&](Stat stat) {
-                auto node = std::make_unique<Node>(name, &parent->get(), std::move(stat), node::Directory{});
-                return dir.insert(std::move(node), overwrite);
-            })
-            .transform([&](auto&& pair) { return pair.first; });
+        // the node can't be built without a stat, fetch it separately if the device didn't provide it
+        auto stat = *created ? Expect<Stat>{ **created } : co_await m_connection.stat(path);
+        if (not stat) {
+            co_return Unexpect{ stat.error() };
+        }
+
+        auto node = std::make_unique<Node>(name, &parent->get(), std::move(*stat), node::Directory{});
+        co_return dir.insert(std::move(node), overwrite).transform([&](auto&& pair) { return pair.first; });
     }
 
     AExpect<void> Filesystem::unlink(path::Path path)
@@ -573,9 +856,9 @@ namespace madbfs
             }
         }
 
-        auto res = co_await m_connection.rename(from, to, flags);
-        if (not res) {
-            co_return Unexpect{ res.error() };
+        auto new_stat = co_await m_connection.rename(from, to, flags);
+        if (not new_stat) {
+            co_return Unexpect{ new_stat.error() };
         }
 
         from_parent->refresh_stat(timespec_omit, timespec_now);
@@ -588,6 +871,7 @@ namespace madbfs
 
         node->set_name(to.filename());
         node->set_parent(&to_parent->get());
+        apply_stat(*node, *new_stat);
         auto overwritten = to_dir->get().insert(std::move(node), true).value();
 
         if ((flags & RENAME_EXCHANGE) != 0) {
@@ -618,11 +902,8 @@ namespace madbfs
         if (not node) {
             co_return Unexpect{ node.error() };
         }
-        if (auto res = co_await m_connection.utimens(path, atime, mtime); not res) {
-            co_return Unexpect{ res.error() };
-        }
-        co_return (co_await m_connection.stat(path)).transform([&](Stat stat) {
-            node->get().set_stat(std::move(stat));
+        co_return (co_await m_connection.utimens(path, atime, mtime)).transform([&](Opt<Stat> stat) {
+            apply_stat(node->get(), std::move(stat));
         });
     }
 
@@ -635,8 +916,9 @@ namespace madbfs
             co_return Unexpect{ may_file.error() };
         }
 
-        if (auto res = co_await m_connection.truncate(path, size); not res) {
-            co_return Unexpect{ res.error() };
+        auto new_stat = co_await m_connection.truncate(path, size);
+        if (not new_stat) {
+            co_return Unexpect{ new_stat.error() };
         }
 
         auto& node = may_node->get();
@@ -649,8 +931,13 @@ namespace madbfs
             std::ignore = co_await m_cache->truncate(node.id(), old_size, new_size);
         }
 
-        node.set_size(size);
-        node.refresh_stat(timespec_omit, timespec_now);
+        if (*new_stat) {
+            node.set_stat(**new_stat);
+        } else {
+            node.set_size(size);
+            node.refresh_stat(timespec_omit, timespec_now);
+            node.expires_after(Seconds{ 0 });
+        }
 
         co_return Expect<void>{};
     }
@@ -667,20 +954,211 @@ namespace madbfs
         auto& node = may_node->get();
         auto  mode = static_cast<OpenMode>(O_ACCMODE & flags);
 
+        // with atomic O_TRUNC, the kernel passes O_TRUNC here instead of calling truncate() beforehand
+        auto truncate = (flags & O_TRUNC) != 0 and mode != OpenMode::Read;
+
+        // a file that is going to be truncated is too small to be streamed by size
+        auto size   = truncate ? 0uz : static_cast<usize>(node.stat().size);
+        auto direct = (flags & O_DIRECT) != 0 or (m_stream_threshold != 0 and size >= m_stream_threshold);
+        auto stream = m_cache.has_value() and direct;
+
+        if (truncate or stream) {
+            // cache only needs the fd for flushing
+            auto real_mode = m_cache and not stream ? OpenMode::Write : mode;
+            auto rpc_flags = truncate ? rpc::open_flag::truncate : u8{ 0 };
+
+            auto opened = co_await m_connection.open(path, real_mode, rpc_flags, 0);
+            if (not opened) {
+                co_return Unexpect{ opened.error() };
+            }
+
+            auto [real_fd, stat] = *opened;
+
+            // error from Cache::truncate are from eviction only, which should not matter for this file
+            if (m_cache and truncate) {
+                std::ignore = co_await m_cache->truncate(node.id(), static_cast<usize>(node.stat().size), 0);
+            }
+
+            node.set_stat(stat);
+
+            if (stream) {
+                co_return co_await store_stream(node, mode, real_fd);
+            }
+            co_return co_await store_handle(node, path, mode, real_fd);
+        }
+
         // send hint to cache to prepare a real fd that can be used for further operations
         if (m_cache) {
             co_return (co_await m_cache->hint_open(node.id(), path, mode)).transform([&] {
-                return m_handles.store(&node, mode, 0);
+                return new_handle(node, mode, 0);
             });
         } else {
             co_return (co_await m_connection.open(path, mode)).transform([&](u64 real_fd) {
-                return m_handles.store(&node, mode, real_fd);
+                return new_handle(node, mode, real_fd);
             });
         }
     }
 
-    AExpect<usize> Filesystem::read(u64 fd, Span<char> out, off_t offset)
+    AExpect<u64> Filesystem::create(path::Path path, mode_t mode, int flags)
+    {
+        auto parent  = co_await traverse_or_build(path.parent_path());
+        auto may_dir = parent.and_then([](Node& node) { return node.as_directory(); });
+
+        if (not may_dir) {
+            co_return Unexpect{ may_dir.error() };
+        }
+
+        auto& dir       = may_dir->get();
+        auto  name      = path.filename();
+        auto  overwrite = false;
+
+        if (auto node = dir.find(name); node) {
+            if (not node->get().is_error()) {
+                if ((flags & O_EXCL) != 0) {
+                    co_return Unexpect{ Errc::file_exists };
+                }
+                co_return co_await open(path, flags);
+            }
+            overwrite = true;
+        }
+
+        auto stream    = m_cache.has_value() and (flags & O_DIRECT) != 0;
+        auto open_mode = static_cast<OpenMode>(O_ACCMODE & flags);
+        auto real_mode = m_cache and not stream and open_mode == OpenMode::ReadWrite ? OpenMode::Write
+                                                                                      : open_mode;
+
+        auto rpc_flags = u8{ rpc::open_flag::create };
+        if ((flags & O_TRUNC) != 0) {
+            rpc_flags |= rpc::open_flag::truncate;
+        }
+        if ((flags & O_EXCL) != 0) {
+            rpc_flags |= rpc::open_flag::exclusive;
+        }
+
+        auto opened = co_await m_connection.open(path, real_mode, rpc_flags, mode & ~S_IFMT);
+        if (not opened) {
+            parent->get().refresh_stat(timespec_omit, timespec_now);
+            co_return Unexpect{ opened.error() };
+        }
+
+        auto [real_fd, stat] = *opened;
+
+        auto node     = std::make_unique<Node>(name, &parent->get(), std::move(stat), node::Regular{});
+        auto inserted = dir.insert(std::move(node), overwrite);
+        if (not inserted) {
+            std::ignore = co_await m_connection.close(real_fd);
+            co_return Unexpect{ inserted.error() };
+        }
+
+        if (stream) {
+            co_return co_await store_stream(inserted->first, open_mode, real_fd);
+        }
+        co_return co_await store_handle(inserted->first, path, open_mode, real_fd);
+    }
+
+    AExpect<u64> Filesystem::store_handle(Node& node, path::Path path, OpenMode mode, u64 real_fd)
+    {
+        if (m_cache) {
+            co_return (co_await m_cache->hint_open(node.id(), path, mode, real_fd)).transform([&] {
+                return new_handle(node, mode, 0);
+            });
+        } else {
+            co_return new_handle(node, mode, real_fd);
+        }
+    }
+
+    AExpect<u64> Filesystem::store_stream(Node& node, OpenMode mode, u64 real_fd)
+    {
+        // the stream reads from the device directly, it must see the writes still in the cache
+        if (auto res = co_await m_cache->flush(node.id()); not res) {
+            std::ignore = co_await m_connection.close(real_fd);
+            co_return Unexpect{ res.error() };
+        }
+        if (auto file = node.as_regular(); file) {
+            file->get().dirty = false;
+        }
+
+        log_i(__func__, "[real_fd={}|size={}] bypass the cache", real_fd, node.stat().size);
+
+        auto fd = new_handle(node, mode, real_fd);
+        m_streams.try_emplace(fd, m_connection, real_fd);
+
+        co_return fd;
+    }
+
+    AExpect<void> Filesystem::start_stream(u64 fd, FileHandle handle)
+    {
+        auto& node = *handle.node;
+
+        // the handle may be erased or released while suspended, its slot must not get a stream then
+        auto erased = [&] {
+            auto current = m_handles.find(fd);
+            return not current or current->node != handle.node;
+        };
+
+        // writes through the cache before the switch are pushed here, the stream branches of flush() and
+        // release() won't see them
+        if (auto res = co_await m_cache->flush(node.id()); not res) {
+            co_return Unexpect{ res.error() };
+        } else if (erased()) {
+            co_return Unexpect{ Errc::bad_file_descriptor };
+        }
+        if (auto file = node.as_regular(); file) {
+            file->get().dirty = false;
+        }
+
+        auto path    = node.build_path();
+        auto real_fd = co_await m_connection.open(path, handle.mode);
+        if (not real_fd) {
+            co_return Unexpect{ real_fd.error() };
+        } else if (erased()) {
+            std::ignore = co_await m_connection.close(*real_fd);
+            co_return Unexpect{ Errc::bad_file_descriptor };
+        }
+
+        log_i(__func__, "[fd={}|real_fd={}] sequential access, bypass the cache {:?}", fd, *real_fd, path);
+
+        // the handle won't use the cache anymore
+        std::ignore = co_await m_cache->hint_close(node.id(), handle.mode);
+
+        m_streams.try_emplace(fd, m_connection, *real_fd);
+        m_runs.erase(fd);
+
+        co_return Expect<void>{};
+    }
+
+    Await<void> Filesystem::detect_sequential(u64 fd, FileHandle handle, off_t offset, usize size)
     {
+        if (not m_cache or m_stream_threshold == 0) {
+            co_return;
+        }
+
+        auto& run  = m_runs[fd];
+        run.length = offset == run.next ? run.length + size : size;
+        run.next   = offset + static_cast<off_t>(size);
+
+        if (run.length < m_stream_threshold) {
+            co_return;
+        }
+
+        if (auto res = co_await start_stream(fd, handle); not res) {
+            log_w(__func__, "[fd={}] failed to start streaming: {}", fd, err_msg(res.error()));
+            m_runs.erase(fd);
+        }
+    }
+
+    u64 Filesystem::new_handle(Node& node, OpenMode mode, u64 real_fd)
+    {
+        // an erased slot is only handed out again after its release, which drops its stream and run
+        auto fd = m_handles.store(&node, mode, real_fd);
+        assert(not m_streams.contains(fd) and not m_runs.contains(fd));
+
+        return fd;
+    }
+
+    AExpect<usize> Filesystem::read(u64 fd, Span<char> out, off_t offset, trace::Context trace)
+    {
+        auto span   = trace::Scope{ trace, "read", "filesystem" };
         auto handle = m_handles.find(fd, OpenMode::Read);
         if (not handle) {
             co_return Unexpect{ Errc::bad_file_descriptor };
@@ -691,16 +1169,23 @@ namespace madbfs
             return ret;
         };
 
-        if (m_cache) {
-            co_return (co_await m_cache->read(handle->node->id(), out, offset)).transform(after);
+        if (not m_streams.contains(fd)) {
+            co_await detect_sequential(fd, *handle, offset, out.size());
+        }
+
+        if (auto stream = m_streams.find(fd); stream != m_streams.end()) {
+            co_return (co_await stream->second.read(out, offset)).transform(after);
+        } else if (m_cache) {
+            co_return (co_await m_cache->read(handle->node->id(), out, offset, trace)).transform(after);
         } else {
             assert(handle->real_fd != 0 && "on no-cache, the file descriptor is exposed directly, not 0");
-            co_return (co_await m_connection.read(handle->real_fd, out, offset)).transform(after);
+            co_return (co_await m_connection.read(handle->real_fd, out, offset, trace)).transform(after);
         }
     }
 
-    AExpect<usize> Filesystem::write(u64 fd, Str in, off_t offset)
+    AExpect<usize> Filesystem::write(u64 fd, Str in, off_t offset, trace::Context trace)
     {
+        auto span   = trace::Scope{ trace, "write", "filesystem" };
         auto handle = m_handles.find(fd, OpenMode::Write);
         if (not handle) {
             co_return Unexpect{ Errc::bad_file_descriptor };
@@ -713,6 +1198,14 @@ namespace madbfs
 
         auto& file = may_file->get();
 
+        if (not m_streams.contains(fd)) {
+            co_await detect_sequential(fd, *handle, offset, in.size());
+        }
+
+        // the iterator is not used after suspension, a stream opened meanwhile may rehash the table
+        auto       stream   = m_streams.find(fd);
+        const auto streamed = stream != m_streams.end();
+
         auto after = [&](usize ret) {
             // the file size is defined as offset + size from last write if it's higher than previous size
             auto new_size = offset + static_cast<off_t>(ret);
@@ -721,20 +1214,24 @@ namespace madbfs
             handle->node->set_size(size);
             handle->node->refresh_stat(timespec_omit, timespec_now);
 
-            file.dirty = true;
+            // pending writes of a stream are tracked by the stream itself
+            file.dirty = file.dirty or not streamed;
 
             return ret;
         };
 
-        if (m_cache) {
-            co_return (co_await m_cache->write(handle->node->id(), in, offset)).transform(after);
+        if (streamed) {
+            co_return (co_await stream->second.write(in, offset)).transform(after);
+        } else if (m_cache) {
+            co_return (co_await m_cache->write(handle->node->id(), in, offset, trace)).transform(after);
         } else {
-            co_return (co_await m_connection.write(handle->real_fd, in, offset)).transform(after);
+            co_return (co_await m_connection.write(handle->real_fd, in, offset, trace)).transform(after);
         }
     }
 
-    AExpect<void> Filesystem::flush(u64 fd)
+    AExpect<void> Filesystem::flush(u64 fd, trace::Context trace)
     {
+        auto span   = trace::Scope{ trace, "flush", "filesystem" };
         auto handle = m_handles.find(fd);
         if (not handle) {
             co_return Unexpect{ Errc::bad_file_descriptor };
@@ -745,13 +1242,27 @@ namespace madbfs
             co_return Unexpect{ Errc::bad_file_descriptor };
         }
 
+        if (auto stream = m_streams.find(fd); stream != m_streams.end()) {
+            if (auto res = co_await stream->second.flush(); not res) {
+                co_return Unexpect{ res.error() };
+            }
+
+            // pages of this file in the cache may be outdated by the stream
+            if (stream->second.modified()) {
+                m_cache->discard(handle->node->id());
+                handle->node->refresh_stat(timespec_omit, timespec_now);
+            }
+
+            co_return Expect<void>{};
+        }
+
         auto& file = may_file->get();
         if (not file.dirty) {
             co_return Expect<void>{};    // no writes, do nothing
         }
 
         if (m_cache) {
-            co_return (co_await m_cache->flush(handle->node->id())).transform([&] {
+            co_return (co_await m_cache->flush(handle->node->id(), trace)).transform([&] {
                 handle->node->refresh_stat(timespec_omit, timespec_now);
                 file.dirty = false;
             });
@@ -764,7 +1275,31 @@ namespace madbfs
 
     AExpect<void> Filesystem::release(u64 fd)
     {
+        // the stream is released even if its handle was erased on invalidation
+        auto stream = m_streams.extract(fd);
         auto handle = m_handles.release(fd);
+
+        m_runs.erase(fd);
+
+        if (not stream.empty()) {
+            auto flushed = co_await stream.mapped().flush();
+            auto closed  = co_await m_connection.close(stream.mapped().fd());
+
+            if (handle) {
+                if (stream.mapped().modified()) {
+                    m_cache->discard(handle->node->id());
+                }
+                if (closed and *closed) {
+                    handle->node->set_stat(**closed);
+                }
+            }
+
+            if (not flushed) {
+                co_return Unexpect{ flushed.error() };
+            }
+            co_return closed.transform(sink_void);
+        }
+
         if (not handle) {
             co_return Unexpect{ Errc::bad_file_descriptor };
         }
@@ -788,10 +1323,53 @@ namespace madbfs
         if (m_cache) {
             co_return co_await m_cache->hint_close(handle->node->id(), handle->mode);
         } else {
-            co_return co_await m_connection.close(handle->real_fd);
+            co_return (co_await m_connection.close(handle->real_fd)).transform([&](Opt<Stat> stat) {
+                if (stat) {
+                    handle->node->set_stat(*stat);
+                }
+            });
         }
     }
 
+    AExpect<off_t> Filesystem::lseek(u64 fd, off_t offset, int whence)
+    {
+        if (whence != SEEK_DATA and whence != SEEK_HOLE) {
+            co_return Unexpect{ Errc::invalid_argument };
+        }
+
+        auto handle = m_handles.find(fd);
+        if (not handle) {
+            co_return Unexpect{ Errc::bad_file_descriptor };
+        }
+
+        // the device doesn't know about dirty pages, seeking without them would land on stale data
+        if (auto flushed = co_await flush(fd); not flushed) {
+            co_return Unexpect{ flushed.error() };
+        }
+
+        auto seek = whence == SEEK_DATA ? rpc::Seek::Data : rpc::Seek::Hole;
+        auto res  = Expect<off_t>{};
+
+        if (auto stream = m_streams.find(fd); stream != m_streams.end()) {
+            res = co_await m_connection.lseek(stream->second.fd(), offset, seek);
+        } else if (m_cache) {
+            res = co_await m_cache->lseek(handle->node->id(), offset, seek);
+        } else {
+            res = co_await m_connection.lseek(handle->real_fd, offset, seek);
+        }
+
+        if (res or res.error() != Errc::operation_not_supported) {
+            co_return res;
+        }
+
+        // the whole file is data when the regions can't be queried, same as the kernel default
+        auto size = handle->node->stat().size;
+        if (offset >= size) {
+            co_return Unexpect{ Errc::no_such_device_or_address };
+        }
+        co_return seek == rpc::Seek::Data ? offset : size;
+    }
+
     AExpect<usize> Filesystem::copy_file_range(
         path::Path in_path,
         u64        in_fd,
@@ -821,11 +1399,25 @@ namespace madbfs
             co_return Unexpect{ copied.error() };
         }
 
-        co_return (co_await m_connection.stat(out_path)).and_then([&](Stat new_stat) {
-            in_node->get().refresh_stat(timespec_now, timespec_omit);
-            out_node->get().set_stat(new_stat);
-            return copied;
-        });
+        auto [size_copied, new_stat] = *copied;
+
+        auto end      = static_cast<usize>(out_off) + size_copied;
+        auto out_size = new_stat ? static_cast<usize>(new_stat->size)
+                                 : std::max(static_cast<usize>(out_node->get().stat().size), end);
+
+        in_node->get().refresh_stat(timespec_now, timespec_omit);
+        apply_stat(out_node->get(), std::move(new_stat));
+
+        // the source pages are often still cached, so the copy can be read back without the device
+        if (m_cache) {
+            auto in_id  = in_node->get().id();
+            auto out_id = out_node->get().id();
+            auto shared = co_await m_cache->copy(in_id, in_off, out_id, out_off, size_copied, out_size);
+
+            log_d(__func__, "shared {} pages [{} -> {}]", shared, in_id.inner(), out_id.inner());
+        }
+
+        co_return size_copied;
     }
 
     Expect<void> Filesystem::symlink(path::Path path, Str target)
@@ -887,11 +1479,98 @@ namespace madbfs
 
     Await<void> Filesystem::shutdown()
     {
+        m_stopping = true;
+
+        // background tasks stop at their next batch
+        co_await m_background.wait();
+
         if (m_cache) {
             co_await m_cache->shutdown();
         }
     }
 
+    AExpect<usize> Filesystem::preload(path::Path path)
+    {
+        constexpr auto batch_size = 8z;
+
+        log_i(__func__, "start {:?}", path);
+
+        auto pending = Vec<path::PathBuf>{};
+        auto listed  = 0uz;
+        auto failed  = 0uz;
+
+        pending.push_back(path.owned());
+
+        while (not pending.empty()) {
+            auto level = std::exchange(pending, {});
+            for (auto batch : level | sv::chunk(batch_size)) {
+                if (m_stopping) {
+                    log_i(__func__, "stopped {:?} [listed={}|failed={}]", path, listed, failed);
+                    co_return listed;
+                }
+                auto list = [&](const path::PathBuf& dir) { return preload_dir(dir); };
+                for (auto&& res : co_await async::wait_all(batch | sv::transform(list))) {
+                    if (not res) {
+                        ++failed;
+                        continue;
+                    }
+                    ++listed;
+                    sr::move(*res, std::back_inserter(pending));
+                }
+            }
+        }
+
+        log_i(__func__, "finished {:?} [listed={}|failed={}]", path, listed, failed);
+
+        co_return listed;
+    }
+
+    Await<void> Filesystem::start_preload(path::Path path)
+    {
+        auto work = [this](this auto, path::PathBuf path) -> Await<void> {
+            std::ignore = co_await preload(path);
+        };
+        co_await spawn_background("preload", work(path.owned()));
+    }
+
+    AExpect<Vec<path::PathBuf>> Filesystem::preload_dir(path::Path path)
+    {
+        auto may_node = co_await traverse_or_build(path);
+        if (not may_node) {
+            co_return Unexpect{ may_node.error() };
+        }
+
+        auto& node = may_node->get();
+        if (path.is_root() and node.expired()) {
+            if (auto res = co_await update(node, path); not res) {
+                co_return Unexpect{ res.error() };
+            }
+        }
+
+        auto dir = node.as_directory();
+        if (not dir) {
+            co_return Unexpect{ dir.error() };
+        }
+
+        if (not node.has_synced()) {
+            if (auto res = co_await sync_children(node, path); not res) {
+                co_return Unexpect{ res.error() };
+            }
+        }
+
+        auto subdirs = Vec<path::PathBuf>{};
+        for (const auto& child : dir->get().children()) {
+            if (not child->is_directory()) {
+                continue;
+            }
+            if (auto child_path = path.extend_copy(child->name()); child_path) {
+                subdirs.push_back(std::move(*child_path));
+            }
+        }
+
+        co_return subdirs;
+    }
+
     Opt<Seconds> Filesystem::set_ttl(Opt<Seconds> ttl)
     {
         auto old = std::exchange(m_ttl, ttl);
@@ -903,15 +1582,54 @@ namespace madbfs
         // on change from ttl on to ttl off, sets all nodes expiration to never
 
         log_i(__func__, "ttl changed [{} -> {}] resetting expirations", old, ttl);
-        walk(m_root, [=](Node& node) { node.expires_after(ttl.value_or(Seconds::max())); });
+        reset_expirations();
 
         return old;
     }
 
+    TtlPolicy Filesystem::set_ttl_policy(TtlPolicy policy)
+    {
+        auto old = std::exchange(m_ttl_policy, std::move(policy));
+
+        const auto old_str = old.to_string();
+        const auto new_str = m_ttl_policy.to_string();
+        log_i(__func__, "ttl policy changed [{:?} -> {:?}] resetting expirations", old_str, new_str);
+        reset_expirations();
+
+        return old;
+    }
+
+    Seconds Filesystem::ttl_of(path::Path path) const
+    {
+        if (m_ttl_policy.empty()) {
+            return m_ttl.value_or(Seconds::max());
+        }
+        return m_ttl_policy.match(path, m_mount_root).value_or(m_ttl).value_or(Seconds::max());
+    }
+
+    void Filesystem::reset_expirations()
+    {
+        if (m_ttl_policy.empty()) {
+            walk(m_root, [&](Node& node) { node.expires_after(m_ttl.value_or(Seconds::max())); });
+        } else {
+            walk(m_root, [&](Node& node) { node.expires_after(ttl_of(node.build_path())); });
+        }
+    }
+
     usize Filesystem::expires_all()
     {
         auto count = 0uz;
         walk(m_root, [&](Node& node) { ++count, node.expires_after(Seconds{ 0 }); });
         return count;
     }
+
+    Expect<usize> Filesystem::save_snapshot(const std::filesystem::path& file) const
+    {
+        return tree_snapshot::save(m_root, file);
+    }
+
+    Expect<usize> Filesystem::load_snapshot(const std::filesystem::path& file)
+    {
+        return tree_snapshot::load(m_root, file);
+    }
 }
@@ -1,5 +1,10 @@
 #include "madbfs/madbfs.hpp"
 
+#include "madbfs/metrics.hpp"
+#include "madbfs/trace.hpp"
+#include "madbfs/tree_snapshot.hpp"
+#include "madbfs/workload.hpp"
+
 #include <madbfs-common/log.hpp>
 
 #define FUSE_USE_VERSION 31
@@ -28,6 +33,8 @@ namespace madbfs
 
             const auto ttl_sec     = madbfs.fs().ttl().transform(&Seconds::count).value_or(0);
             const auto timeout_sec = madbfs.m_timeout.transform(&Seconds::count).value_or(0);
+            const auto ttl_policy  = madbfs.fs().ttl_policy().to_string();
+            const auto weights     = FairQueue::to_string(madbfs.m_queue.weights());
 
             if (cache) {
                 const auto page_size     = cache->page_size();
@@ -40,7 +47,9 @@ namespace madbfs
                     { "root", madbfs.m_root.str() },
                     { "log_level", log::level_to_str(log::get_level()) },
                     { "ttl", ttl_sec },
+                    { "ttl_policy", ttl_policy },
                     { "timeout", timeout_sec },
+                    { "weights", weights },
                     { "cache",
                       { { "page_size", page_size / 1024 },
                         { "cache_size",
@@ -54,7 +63,9 @@ namespace madbfs
                     { "root", madbfs.m_root.str() },
                     { "log_level", log::level_to_str(log::get_level()) },
                     { "ttl", ttl_sec },
+                    { "ttl_policy", ttl_policy },
                     { "timeout", timeout_sec },
+                    { "weights", weights },
                     { "cache", nullptr },
                 };
             }
@@ -148,6 +159,22 @@ namespace madbfs
             };
         }
 
+        AExpect<json::value> handle(ipc::op::SetTTLPolicy policy)
+        {
+            auto new_policy = TtlPolicy::parse(policy.spec);
+            if (not new_policy) {
+                co_return Unexpect{ new_policy.error() };
+            }
+
+            const auto old_policy = madbfs.fs().set_ttl_policy(std::move(*new_policy));
+
+            co_return json::value{
+                { "ttl_policy",
+                  { { "old", old_policy.to_string() },    //
+                    { "new", madbfs.fs().ttl_policy().to_string() } } },
+            };
+        }
+
         AExpect<json::value> handle(ipc::op::SetTimeout ttl)
         {
             auto old = std::exchange(madbfs.m_timeout, ttl.sec < 1 ? std::nullopt : Opt<Seconds>{ ttl.sec });
@@ -158,11 +185,34 @@ namespace madbfs
             };
         }
 
+        AExpect<json::value> handle(ipc::op::SetWeights weights)
+        {
+            auto new_weights = FairQueue::parse_weights(weights.spec);
+            if (not new_weights) {
+                co_return Unexpect{ new_weights.error() };
+            }
+
+            const auto old_weights = madbfs.m_queue.set_weights(std::move(*new_weights));
+
+            co_return json::value{
+                { "weights",
+                  { { "old", FairQueue::to_string(old_weights) },    //
+                    { "new", FairQueue::to_string(madbfs.m_queue.weights()) } } },
+            };
+        }
+
         AExpect<json::value> handle(ipc::op::SetLogLevel op)
         {
             const auto prev_level = log::get_level();
             const auto new_level  = log::level_from_str(op.lvl).value_or(prev_level);
 
+            // messages below the floor are compiled out, the level would be accepted but print nothing
+            if (new_level < log::level_floor) {
+                const auto floor = log::level_to_str(log::level_floor);
+                log_w(__func__, "rejected log level {:?}, lowest level of this build is {:?}", op.lvl, floor);
+                co_return Unexpect{ Errc::operation_not_supported };
+            }
+
             log::set_level(new_level);
 
             co_return json::value{
@@ -172,16 +222,425 @@ namespace madbfs
             };
         }
 
+        AExpect<json::value> handle(ipc::op::Pull pull)
+        {
+            auto device = device_path(pull.device);
+            if (not device) {
+                co_return Unexpect{ device.error() };
+            }
+
+            auto id = co_await madbfs.m_transfers.pull(std::move(*device), pull.host, pull.resume);
+            if (not id) {
+                co_return Unexpect{ id.error() };
+            }
+
+            co_return json::value{ { "id", *id } };
+        }
+
+        AExpect<json::value> handle(ipc::op::Push push)
+        {
+            auto device = device_path(push.device);
+            if (not device) {
+                co_return Unexpect{ device.error() };
+            }
+
+            auto id = co_await madbfs.m_transfers.push(push.host, std::move(*device), push.resume);
+            if (not id) {
+                co_return Unexpect{ id.error() };
+            }
+
+            co_return json::value{ { "id", *id } };
+        }
+
+        AExpect<json::value> handle(ipc::op::Jobs)
+        {
+            auto jobs = json::array{};
+
+            for (const auto& job : madbfs.m_transfers.jobs() | sv::values) {
+                jobs.push_back(json::value{
+                    { "id", job->id },
+                    { "kind", job->kind == Transfers::Kind::Pull ? "pull" : "push" },
+                    { "device", job->device.str() },
+                    { "host", job->host.string() },
+                    { "resume", job->resume },
+                    { "status", status_str(job->status) },
+                    { "error", job->error == Errc{} ? "" : err_msg(job->error) },
+                    { "files", { { "done", job->files.done }, { "total", job->files.total } } },
+                    { "bytes", { { "done", job->bytes.done }, { "total", job->bytes.total } } },
+                });
+            }
+
+            co_return json::value{ { "jobs", std::move(jobs) } };
+        }
+
+        AExpect<json::value> handle(ipc::op::Cancel cancel)
+        {
+            auto job = madbfs.m_transfers.cancel(cancel.id);
+            if (not job) {
+                co_return Unexpect{ job.error() };
+            }
+
+            co_return json::value{
+                { "id", job->get().id },
+                { "status", status_str(job->get().status) },
+            };
+        }
+
+        AExpect<json::value> handle(ipc::op::Metrics)
+        {
+            auto to_json = [](const metrics::Summary& summary) {
+                return json::value{
+                    { "count", summary.count },
+                    { "errors", summary.errors },
+                    { "p50", summary.p50 },
+                    { "p90", summary.p90 },
+                    { "p99", summary.p99 },
+                    { "max", summary.max },
+                };
+            };
+
+            auto fuse = json::object{};
+            for (auto i : sv::iota(0uz, metrics::fuse_op_count)) {
+                auto op      = static_cast<metrics::FuseOp>(i);
+                auto summary = metrics::of(op).summary();
+                if (summary.count != 0) {
+                    fuse.emplace(metrics::to_string(op), to_json(summary));
+                }
+            }
+
+            auto procs = json::object{};
+            for (auto i : sv::iota(0uz, metrics::procedure_count)) {
+                auto proc    = static_cast<rpc::Procedure>(i);
+                auto summary = metrics::of(proc).summary();
+                if (summary.count != 0) {
+                    procs.emplace(rpc::to_string(proc), to_json(summary));
+                }
+            }
+
+            co_return json::value{ { "fuse", std::move(fuse) }, { "rpc", std::move(procs) } };
+        }
+
+        AExpect<json::value> handle(ipc::op::SetTraceRate rate)
+        {
+            auto old = trace::recorder().set_rate(static_cast<u32>(rate.rate));
+            co_return json::value{
+                { "trace_rate", { { "old", old }, { "new", trace::recorder().rate() } } },
+            };
+        }
+
+        AExpect<json::value> handle(ipc::op::Trace)
+        {
+            using std::chrono::duration_cast, std::chrono::microseconds;
+
+            constexpr auto client_pid = 1;
+            constexpr auto server_pid = 2;
+
+            auto events = trace::recorder().take();
+            auto origin = events.empty() ? SteadyClock::time_point{}
+                                         : sr::min(events, {}, &trace::Event::start).start;
+
+            auto micros = [](SteadyClock::duration duration) {
+                return duration_cast<microseconds>(duration).count();
+            };
+
+            auto trace_events = json::array{};
+            trace_events.reserve(events.size() + 2);
+
+            for (auto [pid, name] : { Pair{ client_pid, "madbfs" }, Pair{ server_pid, "madbfs-server" } }) {
+                trace_events.push_back(json::value{
+                    { "name", "process_name" },
+                    { "ph", "M" },
+                    { "pid", pid },
+                    { "args", { { "name", name } } },
+                });
+            }
+
+            // complete events, a trace gets a thread of its own so its spans are nested on a single row
+            for (const auto& event : events) {
+                trace_events.push_back(json::value{
+                    { "name", event.name },
+                    { "cat", event.category },
+                    { "ph", "X" },
+                    { "ts", micros(event.start - origin) },
+                    { "dur", micros(event.end - event.start) },
+                    { "pid", event.side == trace::Side::Client ? client_pid : server_pid },
+                    { "tid", event.trace },
+                });
+            }
+
+            co_return json::value{
+                { "traceEvents", std::move(trace_events) },
+                { "displayTimeUnit", "ms" },
+            };
+        }
+
+        AExpect<json::value> handle(ipc::op::RecordStart record)
+        {
+            auto file = std::filesystem::path{ record.file };
+            if (not file.is_absolute()) {
+                co_return Unexpect{ Errc::invalid_argument };
+            }
+
+            if (auto res = workload::recorder().start(file); not res) {
+                co_return Unexpect{ res.error() };
+            }
+
+            co_return json::value{ { "file", record.file } };
+        }
+
+        AExpect<json::value> handle(ipc::op::RecordStop)
+        {
+            auto stats = workload::recorder().stop();
+            if (not stats) {
+                co_return Unexpect{ stats.error() };
+            }
+
+            co_return json::value{
+                { "file", stats->file },
+                { "entries", stats->entries },
+                { "paths", stats->paths },
+                { "bytes", stats->bytes },
+            };
+        }
+
+        AExpect<json::value> handle(ipc::op::CacheMap map)
+        {
+            const auto& cache = madbfs.fs().cache();
+            if (not cache) {
+                co_return Unexpect{ Errc::operation_not_supported };
+            }
+
+            auto under = device_path(map.path);
+            if (not under) {
+                co_return Unexpect{ under.error() };
+            }
+
+            auto residencies = cache->residency(*under);
+            sr::sort(residencies, {}, [](const Cache::Residency& res) { return res.path.str(); });
+
+            const auto page_size = cache->page_size();
+            const auto now       = SteadyClock::now();
+
+            auto files = json::array{};
+            for (const auto& res : residencies) {
+                auto node = madbfs.fs().traverse(res.path);
+                auto size = node ? Opt<usize>{ static_cast<usize>(node->get().stat().size) } : std::nullopt;
+
+                auto spanned = res.resident.empty() ? 0uz : res.resident.back() + 1;
+                auto pages   = size ? std::max((*size + page_size - 1) / page_size, spanned) : spanned;
+
+                // one char per page: '.' not cached, 'r' cached, 'd' cached and dirty
+                auto bitmap = String(pages, '.');
+                for (auto index : res.resident) {
+                    bitmap[index] = 'r';
+                }
+                for (auto index : res.dirty) {
+                    bitmap[index] = 'd';
+                }
+
+                auto age = std::chrono::duration_cast<Milliseconds>(now - res.accessed);
+
+                files.push_back(json::value{
+                    { "path", res.path.str() },
+                    { "size", size ? json::value(*size) : json::value(nullptr) },
+                    { "pages", pages },
+                    { "resident", res.resident.size() },
+                    { "dirty", res.dirty.size() },
+                    { "map", bitmap },
+                    { "readers", res.reader },
+                    { "writers", res.writer },
+                    { "pinned", res.pinned },
+                    { "age", age.count() },
+                });
+            }
+
+            co_return json::value{
+                { "page_size", page_size / 1024 },
+                { "files", std::move(files) },
+            };
+        }
+
+        AExpect<json::value> handle(ipc::op::Lag)
+        {
+            auto to_json = [](const metrics::Loop::Depth& depth) {
+                return json::value{
+                    { "transport_queued", depth.transport_queued },
+                    { "transport_inflight", depth.transport_inflight },
+                    { "connection", depth.connection },
+                    { "read_queue", depth.read_queue },
+                };
+            };
+
+            const auto& loop    = metrics::loop();
+            const auto  summary = loop.lag().summary();
+            const auto  now     = std::chrono::system_clock::now();
+
+            auto stalls = json::array{};
+            for (const auto& stall : loop.stalls()) {
+                auto age = std::chrono::duration_cast<Milliseconds>(now - stall.time);
+                stalls.push_back(json::value{
+                    { "age", age.count() },
+                    { "lag", stall.lag },
+                    { "depth", to_json(stall.depth) },
+                });
+            }
+
+            auto lag = json::value{
+                { "count", summary.count },
+                { "p50", summary.p50 },
+                { "p90", summary.p90 },
+                { "p99", summary.p99 },
+                { "max", summary.max },
+            };
+
+            co_return json::value{
+                { "interval", metrics::Loop::interval.count() },
+                { "threshold", metrics::Loop::stall_threshold },
+                { "lag", std::move(lag) },
+                { "depth", to_json(madbfs.loop_depth()) },
+                { "stalls", std::move(stalls) },
+            };
+        }
+
         AExpect<json::value> handle(ipc::op::Unmount)
         {
             ::fuse_exit(madbfs.m_fuse);
             co_return json::value{ nullptr };
         }
 
+        /**
+         * @brief Resolve a device path of a job relative to the custom root.
+         *
+         * @param path Path as seen from the mountpoint, `..` can't go above the custom root.
+         */
+        Expect<path::PathBuf> device_path(Str path) const
+        {
+            auto inner = path::resolve(madbfs.m_root.view(), fmt::format("/{}", path));
+            if (madbfs.m_root.is_root() or inner.is_root()) {
+                return madbfs.m_root.is_root() ? inner : madbfs.m_root;
+            }
+
+            auto full = fmt::format("{}{}", madbfs.m_root.str(), inner.str());
+            return ok_or(path::create_buf(std::move(full)), Errc::invalid_argument);
+        }
+
+        static Str status_str(Transfers::Status status)
+        {
+            switch (status) {
+            case Transfers::Status::Running: return "running";
+            case Transfers::Status::Done: return "done";
+            case Transfers::Status::Failed: return "failed";
+            case Transfers::Status::Cancelled: return "cancelled";
+            }
+            return "unknown";
+        }
+
         Madbfs& madbfs;
     };
 }
 
+// helper functions/classes
+namespace
+{
+    using namespace madbfs;
+
+    /**
+     * @brief Upper bounds of the buckets of exported latency histograms in microseconds, with their `le`.
+     */
+    constexpr auto latency_buckets = std::to_array<Pair<u64, Str>>({
+        // clang-format off
+        { 100,        "0.0001"  },
+        { 250,        "0.00025" },
+        { 500,        "0.0005"  },
+        { 1'000,      "0.001"   },
+        { 2'500,      "0.0025"  },
+        { 5'000,      "0.005"   },
+        { 10'000,     "0.01"    },
+        { 25'000,     "0.025"   },
+        { 50'000,     "0.05"    },
+        { 100'000,    "0.1"     },
+        { 250'000,    "0.25"    },
+        { 500'000,    "0.5"     },
+        { 1'000'000,  "1.0"     },
+        { 2'500'000,  "2.5"     },
+        { 5'000'000,  "5.0"     },
+        { 10'000'000, "10.0"    },
+        // clang-format on
+    });
+
+    /**
+     * @brief Escape a string to be used as an OpenMetrics label value.
+     *
+     * @param str The string.
+     */
+    String escape_label(Str str)
+    {
+        auto escaped = String{};
+        for (auto ch : str) {
+            switch (ch) {
+            case '\\': escaped += R"(\\)"; break;
+            case '"': escaped += R"(\")"; break;
+            case '\n': escaped += R"(\n)"; break;
+            default: escaped += ch;
+            }
+        }
+        return escaped;
+    }
+
+    /**
+     * @brief Write latency histograms and their error counters as OpenMetrics metric families.
+     *
+     * @param out Output string.
+     * @param family Name of the families, `madbfs_<family>_latency_seconds` and `madbfs_<family>_errors`.
+     * @param label Name of the label that tells the histograms apart.
+     * @param histograms Pairs of label value and histogram, empty histograms are skipped.
+     */
+    void write_latencies(
+        String&                                          out,
+        Str                                              family,
+        Str                                              label,
+        Span<const Pair<Str, const metrics::Histogram*>> histograms
+    )
+    {
+        auto bounds = latency_buckets | sv::keys | sr::to<Vec<u64>>();
+        auto errors = String{};
+
+        auto out_it = std::back_inserter(out);
+        auto err_it = std::back_inserter(errors);
+
+        fmt::format_to(out_it, "# TYPE madbfs_{}_latency_seconds histogram\n", family);
+        fmt::format_to(out_it, "# UNIT madbfs_{}_latency_seconds seconds\n", family);
+        fmt::format_to(err_it, "# TYPE madbfs_{}_errors counter\n", family);
+
+        for (const auto& [name, histogram] : histograms) {
+            // the buckets and the count come from the same snapshot so a bucket never exceeds +Inf
+            auto snapshot = histogram->snapshot();
+            auto summary  = snapshot.summary();
+            if (summary.count == 0) {
+                continue;
+            }
+
+            auto prefix = fmt::format("madbfs_{}_latency_seconds", family);
+            auto tag    = fmt::format("{}=\"{}\"", label, name);
+            auto counts = snapshot.count_below(bounds);
+
+            for (auto i : sv::iota(0uz, counts.size())) {
+                auto le = latency_buckets[i].second;
+                fmt::format_to(out_it, "{}_bucket{{{},le=\"{}\"}} {}\n", prefix, tag, le, counts[i]);
+            }
+
+            auto sum = static_cast<double>(summary.sum) / 1'000'000;
+
+            fmt::format_to(out_it, "{}_bucket{{{},le=\"+Inf\"}} {}\n", prefix, tag, summary.count);
+            fmt::format_to(out_it, "{}_count{{{}}} {}\n", prefix, tag, summary.count);
+            fmt::format_to(out_it, "{}_sum{{{}}} {}\n", prefix, tag, sum);
+            fmt::format_to(err_it, "madbfs_{}_errors_total{{{}}} {}\n", family, tag, summary.errors);
+        }
+
+        out += errors;
+    }
+}
+
 // madbfs.hpp impl: Madbfs
 namespace madbfs
 {
@@ -227,6 +686,35 @@ namespace madbfs
         return std::move(*ipc);
     }
 
+    Opt<ipc::Exporter> Madbfs::create_exporter(async::Context& ctx, Str address)
+    {
+        auto resolved = String{ address };
+
+        if (address == "unix") {
+            const auto* serial = std::getenv("ANDROID_SERIAL");
+            if (serial == nullptr) {
+                return {};
+            }
+
+            const auto* runtime = std::getenv("XDG_RUNTIME_DIR");
+
+            resolved  = runtime ? runtime : "/tmp";
+            resolved += '/';
+            resolved += "madbfs-metrics@";    // outside of the `madbfs@*.sock` IPC sockets
+            resolved += serial;
+            resolved += ".sock";
+        }
+
+        auto exporter = ipc::Exporter::create(ctx, resolved);
+        if (not exporter.has_value()) {
+            log_e(__func__, "failed to initialize metrics exporter: {}", err_msg(exporter.error()));
+            return {};
+        }
+
+        log_i(__func__, "succesfully created metrics exporter: {}", exporter->address());
+        return std::move(*exporter);
+    }
+
     void Madbfs::work_thread_function(async::Context& ctx)
     {
         try {
@@ -242,29 +730,49 @@ namespace madbfs
 
     Madbfs::Madbfs(
         struct fuse*     fuse,
+        Str              serial,
         args::Connection connection,
         Opt<Caching>     caching,
         path::Path       custom_root,
         Str              mountpoint,
         Opt<Seconds>     ttl,
-        Opt<Seconds>     timeout
+        TtlPolicy        ttl_policy,
+        Opt<Seconds>     timeout,
+        bool             persist_tree,
+        bool             walk_tree,
+        Str              metrics_address,
+        usize            queue_slots
     )
         : m_fuse{ fuse }
         , m_async_ctx{}
         , m_work_guard{ m_async_ctx.get_executor() }
         , m_work_thread{ [this] { work_thread_function(m_async_ctx); } }
         , m_connection{ prepare_connection(m_async_ctx, connection) }
-        , m_fs{ m_connection, caching, ttl }
+        , m_fs{ m_connection, caching, ttl, custom_root }
+        , m_queue{ queue_slots }
+        , m_transfers{ m_fs }
         , m_ipc{ create_ipc(m_async_ctx) }
+        , m_exporter{ metrics_address.empty() ? std::nullopt : create_exporter(m_async_ctx, metrics_address) }
         , m_watchdog_timer{ m_async_ctx }
         , m_reaper_timer{ m_async_ctx }
+        , m_lag_timer{ m_async_ctx }
         , m_signal{ m_async_ctx, SIGINT, SIGTERM }
         , m_root{ custom_root.owned() }
         , m_mountpoint{ mountpoint }
         , m_timeout{ timeout }
     {
         if (m_ipc) {
-            auto coro = m_ipc->launch([this](ipc::FsOp op) { return ipc_handler(op); });
+            auto coro = m_ipc->launch(
+                [this](ipc::FsOp op) { return ipc_handler(op); },
+                [this](bool watched) { return top_frame(watched); }
+            );
+            async::spawn(m_async_ctx, std::move(coro), [](std::exception_ptr e) {
+                log::log_exception(e, "Madbfs");
+            });
+        }
+
+        if (m_exporter) {
+            auto coro = m_exporter->launch([this] { return openmetrics(); });
             async::spawn(m_async_ctx, std::move(coro), [](std::exception_ptr e) {
                 log::log_exception(e, "Madbfs");
             });
@@ -272,6 +780,7 @@ namespace madbfs
 
         async::spawn(m_async_ctx, watchdog(), [](std::exception_ptr e) { log::log_exception(e, "Madbfs"); });
         async::spawn(m_async_ctx, reaper(), [](std::exception_ptr e) { log::log_exception(e, "Madbfs"); });
+        async::spawn(m_async_ctx, lag_probe(), [](std::exception_ptr e) { log::log_exception(e, "Madbfs"); });
 
         async::spawn(m_async_ctx, m_connection.start(), [](std::exception_ptr e) {
             log::log_exception(e, "Madbfs");
@@ -286,9 +795,25 @@ namespace madbfs
             }
         });
 
+        m_fs.set_ttl_policy(std::move(ttl_policy));
+
         if (auto result = async::block(m_async_ctx, m_fs.initialize_root()); not result) {
             log_c(__func__, "Failed to initialize root");
         }
+
+        // FUSE is not serving any request yet at this point, so it is safe to load directly
+        if (persist_tree) {
+            m_tree_snapshot = tree_snapshot::default_path(serial, m_root.view());
+            if (m_tree_snapshot) {
+                std::ignore = m_fs.load_snapshot(*m_tree_snapshot);
+            } else {
+                log_w(__func__, "neither XDG_CACHE_HOME nor HOME is set, file tree won't be persisted");
+            }
+        }
+
+        if (walk_tree) {
+            async::block(m_async_ctx, m_fs.start_preload(m_root.view()));
+        }
     }
 
     Madbfs::~Madbfs()
@@ -299,10 +824,31 @@ namespace madbfs
             m_ipc->stop();
         }
 
+        if (m_exporter) {
+            m_exporter->stop();
+        }
+
+        // no more FUSE operations from here, write out what's still buffered
+        if (workload::recorder().recording()) {
+            std::ignore = workload::recorder().stop();
+        }
+
         m_watchdog_timer.cancel();
         m_reaper_timer.cancel();
+        m_lag_timer.cancel();
 
+        async::block(m_async_ctx, m_transfers.shutdown());
         async::block(m_async_ctx, m_fs.shutdown());
+
+        // the tree belongs to the context thread, background tasks are awaited by the shutdown above
+        if (m_tree_snapshot) {
+            auto save = [&]() -> Await<void> {
+                std::ignore = m_fs.save_snapshot(*m_tree_snapshot);
+                co_return;
+            };
+            async::block(m_async_ctx, save());
+        }
+
         m_connection.cancel(Errc::operation_canceled);
 
         m_work_guard.reset();
@@ -366,6 +912,177 @@ namespace madbfs
         co_return co_await op.visit([&](auto&& op) { return handler.handle(op); });
     }
 
+    json::value Madbfs::top_frame(bool watched)
+    {
+        constexpr auto max_entries = 10uz;
+
+        auto& activity = metrics::activity();
+
+        if (not watched) {
+            activity.set_enabled(false);
+            m_top_baseline.reset();
+            return json::value{ nullptr };
+        }
+
+        const auto& cache = m_fs.cache();
+
+        auto now = TopBaseline{
+            .time      = SteadyClock::now(),
+            .ops       = {},
+            .cache     = cache ? Opt<Cache::Stats>{ cache->stats() } : std::nullopt,
+            .transport = m_connection.stats(),
+        };
+        for (auto i : sv::iota(0uz, metrics::fuse_op_count)) {
+            now.ops[i] = metrics::of(static_cast<metrics::FuseOp>(i)).summary().count;
+        }
+
+        auto prev   = std::exchange(m_top_baseline, now);
+        auto window = activity.take();
+
+        if (not prev) {
+            activity.set_enabled(true);
+            return json::value{ nullptr };
+        }
+
+        auto secs = std::chrono::duration<f64>(now.time - prev->time).count();
+        auto rate = [&](u64 curr, u64 last) { return static_cast<f64>(curr - last) / secs; };
+
+        auto ops = json::object{};
+        for (auto i : sv::iota(0uz, metrics::fuse_op_count)) {
+            if (now.ops[i] != prev->ops[i]) {
+                auto op = static_cast<metrics::FuseOp>(i);
+                ops.emplace(metrics::to_string(op), rate(now.ops[i], prev->ops[i]));
+            }
+        }
+
+        auto cache_json = json::value{ nullptr };
+        if (now.cache and prev->cache) {
+            auto hits     = now.cache->hits - prev->cache->hits;
+            auto misses   = now.cache->misses - prev->cache->misses;
+            auto hit_rate = json::value{ nullptr };    // no lookup, no rate
+
+            if (hits + misses != 0) {
+                hit_rate = static_cast<f64>(hits) / static_cast<f64>(hits + misses);
+            }
+
+            cache_json = json::value{
+                { "hits", rate(now.cache->hits, prev->cache->hits) },
+                { "misses", rate(now.cache->misses, prev->cache->misses) },
+                { "hit_rate", hit_rate },
+                { "pages", cache->current_pages() },
+                { "max_pages", cache->max_pages() },
+            };
+        }
+
+        // only the busiest entries, sorted from the busiest
+        auto top_of = [&](const std::unordered_map<String, u64>& counters, Str key, Str value) {
+            using Entry = Pair<String, u64>;
+
+            auto entries = counters | sr::to<Vec<Entry>>();
+            auto count   = std::min(entries.size(), max_entries);
+            auto middle  = entries.begin() + static_cast<isize>(count);
+
+            sr::partial_sort(entries, middle, sr::greater{}, &Entry::second);
+
+            auto array = json::array{};
+            for (const auto& [name, counter] : entries | sv::take(count)) {
+                auto label = name.empty() ? Str{ "<unknown>" } : Str{ name };
+                array.push_back(json::value{ { key, label }, { value, counter / secs } });
+            }
+            return array;
+        };
+
+        return json::value{
+            { "interval", secs },
+            { "ops", std::move(ops) },
+            { "read", window.read_bytes / secs },
+            { "write", window.write_bytes / secs },
+            { "cache", std::move(cache_json) },
+            { "transport",
+              { { "inflight", now.transport.inflight },
+                { "requests", rate(now.transport.requests, prev->transport.requests) },
+                { "sent", rate(now.transport.sent_bytes, prev->transport.sent_bytes) },
+                { "received", rate(now.transport.received_bytes, prev->transport.received_bytes) },
+                { "reconnects", now.transport.reconnects - prev->transport.reconnects } } },
+            { "paths", top_of(window.path_bytes, "path", "bytes") },
+            { "processes", top_of(window.process_ops, "name", "ops") },
+        };
+    }
+
+    String Madbfs::openmetrics() const
+    {
+        auto out = String{};
+        auto it  = std::back_inserter(out);
+
+        const auto* serial = std::getenv("ANDROID_SERIAL");
+
+        fmt::format_to(it, "# TYPE madbfs_mount info\n");
+        fmt::format_to(
+            it,
+            "madbfs_mount_info{{serial=\"{}\",transport=\"{}\",root=\"{}\"}} 1\n",
+            escape_label(serial ? serial : ""),
+            escape_label(m_connection.name()),
+            escape_label(m_root.str())
+        );
+
+        if (const auto& cache = m_fs.cache(); cache) {
+            const auto& stats = cache->stats();
+
+            fmt::format_to(it, "# TYPE madbfs_cache_hits counter\n");
+            fmt::format_to(it, "madbfs_cache_hits_total {}\n", stats.hits);
+            fmt::format_to(it, "# TYPE madbfs_cache_misses counter\n");
+            fmt::format_to(it, "madbfs_cache_misses_total {}\n", stats.misses);
+            fmt::format_to(it, "# TYPE madbfs_cache_evictions counter\n");
+            fmt::format_to(it, "madbfs_cache_evictions_total {}\n", stats.evictions);
+            fmt::format_to(it, "# TYPE madbfs_cache_pushes counter\n");
+            fmt::format_to(it, "madbfs_cache_pushes_total {}\n", stats.pushes);
+            fmt::format_to(it, "# TYPE madbfs_cache_pages gauge\n");
+            fmt::format_to(it, "madbfs_cache_pages {}\n", cache->current_pages());
+            fmt::format_to(it, "# TYPE madbfs_cache_max_pages gauge\n");
+            fmt::format_to(it, "madbfs_cache_max_pages {}\n", cache->max_pages());
+            fmt::format_to(it, "# TYPE madbfs_cache_page_size_bytes gauge\n");
+            fmt::format_to(it, "# UNIT madbfs_cache_page_size_bytes bytes\n");
+            fmt::format_to(it, "madbfs_cache_page_size_bytes {}\n", cache->page_size());
+        }
+
+        const auto& stats = m_connection.stats();
+
+        fmt::format_to(it, "# TYPE madbfs_transport_inflight gauge\n");
+        fmt::format_to(it, "madbfs_transport_inflight {}\n", stats.inflight);
+        fmt::format_to(it, "# TYPE madbfs_transport_requests counter\n");
+        fmt::format_to(it, "madbfs_transport_requests_total {}\n", stats.requests);
+        fmt::format_to(it, "# TYPE madbfs_transport_sent_bytes counter\n");
+        fmt::format_to(it, "# UNIT madbfs_transport_sent_bytes bytes\n");
+        fmt::format_to(it, "madbfs_transport_sent_bytes_total {}\n", stats.sent_bytes);
+        fmt::format_to(it, "# TYPE madbfs_transport_received_bytes counter\n");
+        fmt::format_to(it, "# UNIT madbfs_transport_received_bytes bytes\n");
+        fmt::format_to(it, "madbfs_transport_received_bytes_total {}\n", stats.received_bytes);
+        fmt::format_to(it, "# TYPE madbfs_transport_reconnects counter\n");
+        fmt::format_to(it, "madbfs_transport_reconnects_total {}\n", stats.reconnects);
+
+        fmt::format_to(it, "# TYPE madbfs_tree_nodes gauge\n");
+        fmt::format_to(it, "madbfs_tree_nodes {}\n", m_fs.node_count());
+
+        using Entry = Pair<Str, const metrics::Histogram*>;
+
+        auto fuse_ops = Vec<Entry>{};
+        for (auto i : sv::iota(0uz, metrics::fuse_op_count)) {
+            auto op = static_cast<metrics::FuseOp>(i);
+            fuse_ops.emplace_back(metrics::to_string(op), &metrics::of(op));
+        }
+
+        auto procs = Vec<Entry>{};
+        for (auto i : sv::iota(0uz, metrics::procedure_count)) {
+            auto proc = static_cast<rpc::Procedure>(i);
+            procs.emplace_back(rpc::to_string(proc), &metrics::of(proc));
+        }
+
+        write_latencies(out, "fuse", "op", fuse_ops);
+        write_latencies(out, "rpc", "proc", procs);
+
+        return out;
+    }
+
     Await<void> Madbfs::watchdog()
     {
         using namespace std::chrono_literals;
@@ -407,8 +1124,11 @@ namespace madbfs
         using namespace std::chrono_literals;
         constexpr auto interval = 10s;
 
+        // lingering fds are closed within one tick after their linger period ends
+        auto tick = m_fs.cache() ? std::clamp(m_fs.cache()->linger(), 1s, interval) : interval;
+
         while (true) {
-            m_reaper_timer.expires_after(interval);
+            m_reaper_timer.expires_after(tick);
             if (auto res = co_await m_reaper_timer.async_wait(); not res) {
                 break;
             }
@@ -419,10 +1139,51 @@ namespace madbfs
 
             const auto& handles = m_fs.handles();
 
-            auto cap   = handles.capacity();
-            auto empty = handles.count_empty();
+            auto cap    = handles.capacity();
+            auto open   = handles.count_open();
+            auto erased = handles.count_erased();
+            auto empty  = handles.count_empty();
+
+            log_i(
+                __func__,
+                "file handles [cap={:>04d}|open={:>04d}|erased={:>04d}|empty={:>04d}]",
+                cap,
+                open,
+                erased,
+                empty
+            );
+        }
+    }
+
+    metrics::Loop::Depth Madbfs::loop_depth() const
+    {
+        auto transport = m_connection.depth();
+        return {
+            .transport_queued   = transport.queued,
+            .transport_inflight = transport.inflight,
+            .connection         = m_connection.stats().inflight,
+            .read_queue         = m_fs.cache() ? m_fs.cache()->pending_reads() : 0,
+        };
+    }
 
-            log_i(__func__, "file handles [cap={:>04d}|open={:>04d}|empty={:>04d}]", cap, cap - empty, empty);
+    Await<void> Madbfs::lag_probe()
+    {
+        auto& loop = metrics::loop();
+
+        while (true) {
+            m_lag_timer.expires_after(metrics::Loop::interval);
+            if (auto res = co_await m_lag_timer.async_wait(); not res) {
+                break;
+            }
+
+            // the timer is late by as long as the handlers queued before it were running
+            auto late = std::max(SteadyClock::now() - m_lag_timer.expiry(), SteadyClock::duration::zero());
+            auto lag  = static_cast<u64>(std::chrono::duration_cast<std::chrono::microseconds>(late).count());
+
+            loop.record(lag, loop_depth());
+            if (lag >= metrics::Loop::stall_threshold) {
+                log_w(__func__, "event loop stalled for {}us", lag);
+            }
         }
     }
 }
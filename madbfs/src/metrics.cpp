@@ -0,0 +1,240 @@
+#include "madbfs/metrics.hpp"
+
+// helper functions/classes
+namespace
+{
+    using madbfs::metrics::Histogram;
+
+    std::atomic<madbfs::usize> g_next_shard = 0;
+
+    madbfs::Array<Histogram, madbfs::metrics::fuse_op_count>   g_fuse_ops   = {};
+    madbfs::Array<Histogram, madbfs::metrics::procedure_count> g_procedures = {};
+
+    madbfs::metrics::Activity g_activity;
+    madbfs::metrics::Loop     g_loop;
+
+    /**
+     * @brief Add to the counter of a key, keys over the limit share a single counter.
+     *
+     * @param counters The counters.
+     * @param key The key.
+     * @param value Value to add.
+     */
+    void add_to(std::unordered_map<madbfs::String, madbfs::u64>& counters, madbfs::Str key, madbfs::u64 value)
+    {
+        using madbfs::metrics::Activity;
+
+        auto owned = madbfs::String{ key };
+        if (counters.size() >= Activity::max_keys and not counters.contains(owned)) {
+            owned = Activity::other_key;
+        }
+        counters[std::move(owned)] += value;
+    }
+
+    /**
+     * @brief Get the shard of the calling thread.
+     */
+    madbfs::usize current_shard()
+    {
+        thread_local const auto shard = g_next_shard.fetch_add(1, std::memory_order_relaxed);
+        return shard % Histogram::shard_count;
+    }
+}
+
+// metrics.hpp impl
+namespace madbfs::metrics
+{
+    Str to_string(FuseOp op)
+    {
+        switch (op) {
+        case FuseOp::Getattr: return "getattr";
+        case FuseOp::Readlink: return "readlink";
+        case FuseOp::Mknod: return "mknod";
+        case FuseOp::Mkdir: return "mkdir";
+        case FuseOp::Unlink: return "unlink";
+        case FuseOp::Rmdir: return "rmdir";
+        case FuseOp::Rename: return "rename";
+        case FuseOp::Truncate: return "truncate";
+        case FuseOp::Open: return "open";
+        case FuseOp::Create: return "create";
+        case FuseOp::Read: return "read";
+        case FuseOp::Write: return "write";
+        case FuseOp::Flush: return "flush";
+        case FuseOp::Release: return "release";
+        case FuseOp::Readdir: return "readdir";
+        case FuseOp::Utimens: return "utimens";
+        case FuseOp::Lseek: return "lseek";
+        case FuseOp::CopyFileRange: return "copy_file_range";
+        }
+
+        return "unknown";
+    }
+
+    void Histogram::record(u64 micros, bool error)
+    {
+        auto& shard = m_shards[current_shard()];
+
+        shard.buckets[bucket_of(micros)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(micros, std::memory_order_relaxed);
+        if (error) {
+            shard.errors.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        auto max = shard.max.load(std::memory_order_relaxed);
+        while (micros > max) {
+            if (shard.max.compare_exchange_weak(max, micros, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+    }
+
+    Histogram::Snapshot Histogram::snapshot() const
+    {
+        auto snapshot = Snapshot{};
+
+        for (const auto& shard : m_shards) {
+            for (auto i : sv::iota(0uz, bucket_count)) {
+                auto count          = shard.buckets[i].load(std::memory_order_relaxed);
+                snapshot.buckets[i] += count;
+                snapshot.count      += count;
+            }
+            snapshot.errors += shard.errors.load(std::memory_order_relaxed);
+            snapshot.sum    += shard.sum.load(std::memory_order_relaxed);
+            snapshot.max     = std::max(snapshot.max, shard.max.load(std::memory_order_relaxed));
+        }
+
+        return snapshot;
+    }
+
+    Summary Histogram::Snapshot::summary() const
+    {
+        auto summary = Summary{
+            .count  = count,
+            .errors = errors,
+            .sum    = sum,
+            .max    = max,
+        };
+
+        if (summary.count == 0) {
+            return summary;
+        }
+
+        // value at the given quantile, never above the recorded maximum
+        auto percentile = [&](u64 permille) {
+            auto rank = std::max((summary.count * permille + 999) / 1000, 1uz);
+            auto seen = 0uz;
+            for (auto i : sv::iota(0uz, bucket_count)) {
+                seen += buckets[i];
+                if (seen >= rank) {
+                    return std::min(highest_of(i), summary.max);
+                }
+            }
+            return summary.max;
+        };
+
+        summary.p50 = percentile(500);
+        summary.p90 = percentile(900);
+        summary.p99 = percentile(990);
+
+        return summary;
+    }
+
+    Vec<u64> Histogram::Snapshot::count_below(Span<const u64> bounds) const
+    {
+        auto counts = Vec<u64>(bounds.size());
+        auto bound  = 0uz;
+        auto seen   = 0ul;
+
+        for (auto i : sv::iota(0uz, bucket_count)) {
+            while (bound < bounds.size() and highest_of(i) > bounds[bound]) {
+                counts[bound++] = seen;
+            }
+            if (bound == bounds.size()) {
+                break;
+            }
+            seen += buckets[i];
+        }
+
+        while (bound < bounds.size()) {
+            counts[bound++] = seen;
+        }
+
+        return counts;
+    }
+
+    void Activity::set_enabled(bool enabled)
+    {
+        auto lock = std::scoped_lock{ m_mutex };
+        m_enabled.store(enabled, std::memory_order_relaxed);
+        if (not enabled) {
+            m_window = {};
+        }
+    }
+
+    void Activity::record_io(Str path, u64 bytes, bool write)
+    {
+        if (not enabled()) {
+            return;
+        }
+
+        auto lock = std::scoped_lock{ m_mutex };
+        add_to(m_window.path_bytes, path, bytes);
+        (write ? m_window.write_bytes : m_window.read_bytes) += bytes;
+    }
+
+    void Activity::record_op(Str process)
+    {
+        if (not enabled()) {
+            return;
+        }
+
+        auto lock = std::scoped_lock{ m_mutex };
+        add_to(m_window.process_ops, process, 1);
+    }
+
+    Activity::Window Activity::take()
+    {
+        auto lock = std::scoped_lock{ m_mutex };
+        return std::exchange(m_window, {});
+    }
+
+    void Loop::record(u64 lag, const Depth& depth)
+    {
+        m_lag->record(lag, false);
+        if (lag < stall_threshold) {
+            return;
+        }
+
+        auto lock = std::scoped_lock{ m_mutex };
+        if (m_stalls.size() >= max_stalls) {
+            m_stalls.pop_front();
+        }
+        m_stalls.push_back({ .time = std::chrono::system_clock::now(), .lag = lag, .depth = depth });
+    }
+
+    Vec<Loop::Stall> Loop::stalls() const
+    {
+        auto lock = std::scoped_lock{ m_mutex };
+        return { m_stalls.begin(), m_stalls.end() };
+    }
+
+    Histogram& of(FuseOp op)
+    {
+        return g_fuse_ops[static_cast<usize>(op)];
+    }
+
+    Histogram& of(rpc::Procedure proc)
+    {
+        return g_procedures[static_cast<usize>(proc)];
+    }
+
+    Activity& activity()
+    {
+        return g_activity;
+    }
+
+    Loop& loop()
+    {
+        return g_loop;
+    }
+}
@@ -36,6 +36,7 @@ namespace madbfs::node
     Opt<Uniq<Node>> Directory::erase(Str name)
     {
         if (auto found = m_children.find(name); found != m_children.end()) {
+            m_order.erase((*found)->m_cookie);
             return std::move(m_children.extract(found).value());
         }
         return std::nullopt;
@@ -48,10 +49,16 @@ namespace madbfs::node
             return Unexpect{ Errc::file_exists };
         }
 
+        // a replacing node takes over the position of the replaced one, so a listing in progress sees it
+        // exactly once
         auto released = Uniq<Node>{};
         if (found != m_children.end()) {
-            released = std::move(m_children.extract(found).value());
+            released       = std::move(m_children.extract(found).value());
+            node->m_cookie = released->m_cookie;
+        } else {
+            node->m_cookie = m_next_cookie++;
         }
+        m_order.insert_or_assign(node->m_cookie, node.get());
 
         auto [back, _] = m_children.emplace(std::move(node));
         return Pair{ std::ref(*back->get()), std::move(released) };
@@ -60,10 +67,17 @@ namespace madbfs::node
     Expect<Uniq<Node>> Directory::extract(Str name)
     {
         if (auto found = m_children.find(name); found != m_children.end()) {
+            m_order.erase((*found)->m_cookie);
             return std::move(m_children.extract(found).value());
         }
         return Unexpect{ Errc::no_such_file_or_directory };
     }
+
+    void Directory::clear()
+    {
+        m_order.clear();
+        m_children.clear();
+    }
 }
 
 // node.hpp impl: Node
@@ -2,10 +2,14 @@
 
 #include "madbfs/args.hpp"
 #include "madbfs/madbfs.hpp"
+#include "madbfs/metrics.hpp"
+#include "madbfs/trace.hpp"
+#include "madbfs/workload.hpp"
 
 #include <madbfs-common/log.hpp>
 
 using namespace madbfs;
+using metrics::FuseOp;
 
 // helper functions/classes
 namespace
@@ -20,24 +24,69 @@ namespace
         return *static_cast<Madbfs*>(ctx);
     }
 
+    /**
+     * @brief Get the value returned to FUSE as recorded in a workload.
+     *
+     * @param res Result of the operation.
+     *
+     * @return The value for operations that return a number (size, fd, offset), 0 for the others, or the
+     * negative errno on failure.
+     */
+    template <typename T>
+    i64 workload_result(const Expect<T>& res)
+    {
+        if (not res) {
+            return -static_cast<i64>(res.error());
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            return static_cast<i64>(*res);
+        } else {
+            return 0;
+        }
+    }
+
     /**
      * @brief Interface sync code of FUSE with async code of madbfs on the tree access using future.
      *
-     * @param fn The member function of `Filesystem`.
-     * @param args Arguments to be passed into the member function.
+     * @param call The FUSE operation and its arguments, its latency is recorded (waiting in the fair queue
+     * included).
+     * @param fn Function that creates the coroutine from the filesystem and the trace context.
      *
-     * @return The return value of the member function.
+     * @return The return value of the coroutine.
+     *
+     * The calling thread waits for its turn in the fair queue first, so a process that floods the filesystem
+     * with requests doesn't starve the others. If the operation is sampled for tracing, the wait in the queue
+     * and the whole operation are recorded as spans. If a workload is being recorded, the operation is
+     * appended to it.
      */
-    template <typename Ret, typename... Args>
-    Ret invoke_fs(Await<Ret> (Filesystem::*fn)(Args...), std::type_identity_t<Args>... args) noexcept
+    template <typename Fn>
+    auto invoke_fs_traced(const workload::Call& call, Fn&& fn) noexcept
+        -> typename std::invoke_result_t<Fn, Filesystem&, trace::Context>::value_type
     {
         auto& data = get_data();
         auto& ctx  = data.ctx();
         auto& fs   = data.fs();
+        auto  pid  = ::fuse_get_context()->pid;
+
+        auto watch = metrics::Stopwatch{ metrics::of(call.op) };
+        auto trace = trace::recorder().start();
+        auto start = SteadyClock::now();
 
         try {
-            auto coro = (fs.*fn)(std::forward<Args>(args)...);
-            return async::block(ctx, std::move(coro));
+            auto ticket = data.queue().acquire(pid);
+            metrics::activity().record_op(ticket.process());
+            trace.record("queue", "fuse", start);
+
+            auto coro = std::invoke(std::forward<Fn>(fn), fs, trace);
+            auto res  = async::block(ctx, std::move(coro));
+            watch.stop(res.has_value());
+            trace.record(metrics::to_string(call.op), "fuse", start);
+
+            if (auto& recorder = workload::recorder(); recorder.recording()) {
+                auto end = SteadyClock::now();
+                recorder.record(call, static_cast<u32>(pid), start, end, workload_result(res));
+            }
+
+            return res;
         } catch (const std::exception& e) {
             log_c(__func__, "exception occurred: {}", e.what());
         } catch (...) {
@@ -46,6 +95,30 @@ namespace
         return Unexpect{ Errc::io_error };
     }
 
+    /**
+     * @brief Call a member function of `Filesystem` from FUSE, see `invoke_fs_traced()`.
+     *
+     * @param call The FUSE operation and its arguments.
+     * @param fn The member function of `Filesystem`.
+     * @param args Arguments to be passed into the member function.
+     *
+     * @return The return value of the member function.
+     *
+     * The trace context is not passed to the member function, only the queue and the operation as a whole
+     * are recorded if it's sampled.
+     */
+    template <typename Ret, typename... Args>
+    Ret invoke_fs(
+        const workload::Call& call,
+        Await<Ret> (Filesystem::*fn)(Args...),
+        std::type_identity_t<Args>... args
+    ) noexcept
+    {
+        return invoke_fs_traced(call, [&](Filesystem& fs, trace::Context) {
+            return (fs.*fn)(std::forward<Args>(args)...);
+        });
+    }
+
     /**
      * @brief Factory function for lambda that convert `std::errc` into its integer value and logs it.
      *
@@ -83,6 +156,7 @@ namespace
             case std::errc::permission_denied:
             case std::errc::read_only_file_system:
             case std::errc::filename_too_long:
+            case std::errc::no_such_device_or_address:    // lseek past the last data
             case std::errc::invalid_argument: {
                 if (log::get_level() <= log::Level::debug) {
                     const auto& msg = err_msg(err);
@@ -145,29 +219,59 @@ namespace
 // operations.hpp impl
 namespace madbfs::operations
 {
-    void* init(fuse_conn_info* conn, fuse_config*) noexcept
+    void* init(fuse_conn_info* conn, fuse_config* cfg) noexcept
     {
-        if (conn->want & FUSE_CAP_ATOMIC_O_TRUNC) {
-            log_w(
-                __func__,
-                "fuse sets atomic O_TRUNC capability, but filesystem doesn't support it, disabling..."
-            );
-            conn->want &= ~static_cast<u32>(FUSE_CAP_ATOMIC_O_TRUNC);
+        // the process has daemonized by now, the logging thread wouldn't survive the fork before this
+        log::start_async();
+
+        // O_TRUNC is handled on open() so the kernel won't need to call truncate() beforehand
+        if (conn->capable & FUSE_CAP_ATOMIC_O_TRUNC) {
+            conn->want |= FUSE_CAP_ATOMIC_O_TRUNC;
         }
 
         auto* args = static_cast<args::ParsedOpt*>(::fuse_get_context()->private_data);
         assert(args != nullptr and "data should not be empty!");
 
+        // the device is frozen, whatever the kernel has cached stays valid for the whole mount
+        if (args->snapshot) {
+            constexpr auto forever = 365.0 * 24 * 60 * 60;
+
+            cfg->kernel_cache     = 1;
+            cfg->attr_timeout     = forever;
+            cfg->entry_timeout    = forever;
+            cfg->negative_timeout = forever;
+        }
+
         auto caching = args->caching.transform([](auto& c) {
             auto page_size = c.pagesize * 1024;
-            return Caching{ .page_size = page_size, .max_pages = (c.cachesize * 1024 * 1024) / page_size };
+            return Caching{
+                .page_size        = page_size,
+                .max_pages        = (c.cachesize * 1024 * 1024) / page_size,
+                .prefetch_budget  = c.prefetch * 1024 * 1024,
+                .stream_threshold = c.stream * 1024 * 1024,
+                .linger           = c.linger,
+            };
         });
 
         auto ttl     = args->ttl < 1 ? std::nullopt : Opt<Seconds>{ args->ttl };
         auto timeout = args->timeout < 1 ? std::nullopt : Opt<Seconds>{ args->timeout };
         auto fuse    = ::fuse_get_context()->fuse;
 
-        return new Madbfs{ fuse, args->connection, caching, args->root, args->mount, ttl, timeout };
+        return new Madbfs{
+            fuse,
+            args->serial,
+            args->connection,
+            caching,
+            args->root,
+            args->mount,
+            ttl,
+            args->ttl_policy,
+            timeout,
+            args->persist_tree,
+            args->walk_tree,
+            args->metrics,
+            args->queue_slots,
+        };
     }
 
     void destroy(void* private_data) noexcept
@@ -190,8 +294,8 @@ namespace madbfs::operations
     {
         log_i(__func__, "{:?}", path);
 
-        auto named_stat = get_data().create_path(path).and_then([](path::Path p) {
-            return invoke_fs(&Filesystem::getattr, p);
+        auto named_stat = get_data().create_path(path).and_then([&](path::Path p) {
+            return invoke_fs({ .op = FuseOp::Getattr, .path = path }, &Filesystem::getattr, p);
         });
         if (not named_stat.has_value()) {
             return fuse_err(__func__, path)(named_stat.error());
@@ -225,7 +329,9 @@ namespace madbfs::operations
 
         return get_data()
             .create_path(path)
-            .and_then([](path::Path p) { return invoke_fs(&Filesystem::readlink, p); })
+            .and_then([&](path::Path p) {
+                return invoke_fs({ .op = FuseOp::Readlink, .path = path }, &Filesystem::readlink, p);
+            })
             .and_then([&](Str target) { return resolve_symlink({ buf, size }, target); })
             .transform_error(fuse_err(__func__, path))
             .error_or(0);
@@ -237,7 +343,10 @@ namespace madbfs::operations
 
         return get_data()
             .create_path(path)
-            .and_then([=](path::Path p) { return invoke_fs(&Filesystem::mknod, p, mode, dev); })
+            .and_then([=](path::Path p) {
+                auto call = workload::Call{ .op = FuseOp::Mknod, .path = path, .mode = mode };
+                return invoke_fs(call, &Filesystem::mknod, p, mode, dev);
+            })
             .transform_error(fuse_err(__func__, path))
             .error_or(0);
     }
@@ -248,7 +357,10 @@ namespace madbfs::operations
 
         return get_data()
             .create_path(path)
-            .and_then([=](path::Path p) { return invoke_fs(&Filesystem::mkdir, p, mode | S_IFDIR); })
+            .and_then([=](path::Path p) {
+                auto call = workload::Call{ .op = FuseOp::Mkdir, .path = path, .mode = mode };
+                return invoke_fs(call, &Filesystem::mkdir, p, mode | S_IFDIR);
+            })
             .transform_error(fuse_err(__func__, path))
             .error_or(0);
     }
@@ -259,7 +371,9 @@ namespace madbfs::operations
 
         return get_data()
             .create_path(path)
-            .and_then([](path::Path p) { return invoke_fs(&Filesystem::unlink, p); })
+            .and_then([&](path::Path p) {
+                return invoke_fs({ .op = FuseOp::Unlink, .path = path }, &Filesystem::unlink, p);
+            })
             .transform_error(fuse_err(__func__, path))
             .error_or(0);
     }
@@ -270,7 +384,9 @@ namespace madbfs::operations
 
         return get_data()
             .create_path(path)
-            .and_then([](path::Path p) { return invoke_fs(&Filesystem::rmdir, p); })
+            .and_then([&](path::Path p) {
+                return invoke_fs({ .op = FuseOp::Rmdir, .path = path }, &Filesystem::rmdir, p);
+            })
             .transform_error(fuse_err(__func__, path))
             .error_or(0);
     }
@@ -282,7 +398,10 @@ namespace madbfs::operations
 
         return get_data()
             .create_path2(from, to)
-            .and_then([&](auto p) { return invoke_fs(&Filesystem::rename, p[0], p[1], flags); })
+            .and_then([&](auto p) {
+                auto call = workload::Call{ .op = FuseOp::Rename, .path = from, .path2 = to, .flags = flags };
+                return invoke_fs(call, &Filesystem::rename, p[0], p[1], flags);
+            })
             .transform_error(fuse_err(__func__, from))
             .error_or(0);
     }
@@ -293,7 +412,10 @@ namespace madbfs::operations
 
         return get_data()
             .create_path(path)
-            .and_then([&](path::Path p) { return invoke_fs(&Filesystem::truncate, p, size); })
+            .and_then([&](path::Path p) {
+                auto call = workload::Call{ .op = FuseOp::Truncate, .path = path, .offset = size };
+                return invoke_fs(call, &Filesystem::truncate, p, size);
+            })
             .transform_error(fuse_err(__func__, path))
             .error_or(0);
     }
@@ -304,7 +426,34 @@ namespace madbfs::operations
 
         return get_data()
             .create_path(path)
-            .and_then([&](path::Path p) { return invoke_fs(&Filesystem::open, p, fi->flags); })
+            .and_then([&](path::Path p) {
+                auto call = workload::Call{
+                    .op    = FuseOp::Open,
+                    .path  = path,
+                    .flags = static_cast<u32>(fi->flags),
+                };
+                return invoke_fs(call, &Filesystem::open, p, fi->flags);
+            })
+            .transform([&](u64 fd) { fi->fh = fd; })
+            .transform_error(fuse_err(__func__, path))
+            .error_or(0);
+    }
+
+    i32 create(const char* path, mode_t mode, fuse_file_info* fi) noexcept
+    {
+        log_i(__func__, "{:?} [mode={:#o}|flags={:#08o}]", path, mode, fi->flags);
+
+        return get_data()
+            .create_path(path)
+            .and_then([&](path::Path p) {
+                auto call = workload::Call{
+                    .op    = FuseOp::Create,
+                    .path  = path,
+                    .flags = static_cast<u32>(fi->flags),
+                    .mode  = mode,
+                };
+                return invoke_fs(call, &Filesystem::create, p, mode, fi->flags);
+            })
             .transform([&](u64 fd) { fi->fh = fd; })
             .transform_error(fuse_err(__func__, path))
             .error_or(0);
@@ -314,7 +463,19 @@ namespace madbfs::operations
     {
         log_i(__func__, "[offset={}|size={}] {:?}", offset, size, path);
 
-        auto res = invoke_fs(&Filesystem::read, fi->fh, { buf, size }, offset);
+        auto call = workload::Call{
+            .op     = FuseOp::Read,
+            .path   = path ? path : "",
+            .fh     = fi->fh,
+            .offset = offset,
+            .size   = size,
+        };
+        auto res = invoke_fs_traced(call, [&](Filesystem& fs, trace::Context trace) {
+            return fs.read(fi->fh, { buf, size }, offset, trace);
+        });
+        if (res.has_value()) {
+            metrics::activity().record_io(path ? path : "", res.value(), false);
+        }
         return res.has_value() ? static_cast<i32>(res.value()) : fuse_err(__func__, path)(res.error());
     }
 
@@ -322,7 +483,19 @@ namespace madbfs::operations
     {
         log_i(__func__, "[offset={}|size={}] {:?}", offset, size, path);
 
-        auto res = invoke_fs(&Filesystem::write, fi->fh, { buf, size }, offset);
+        auto call = workload::Call{
+            .op     = FuseOp::Write,
+            .path   = path ? path : "",
+            .fh     = fi->fh,
+            .offset = offset,
+            .size   = size,
+        };
+        auto res = invoke_fs_traced(call, [&](Filesystem& fs, trace::Context trace) {
+            return fs.write(fi->fh, { buf, size }, offset, trace);
+        });
+        if (res.has_value()) {
+            metrics::activity().record_io(path ? path : "", res.value(), true);
+        }
         return res.has_value() ? static_cast<i32>(res.value()) : fuse_err(__func__, path)(res.error());
     }
 
@@ -330,7 +503,10 @@ namespace madbfs::operations
     {
         log_i(__func__, "{:?}", path);
 
-        auto res = invoke_fs(&Filesystem::flush, fi->fh);
+        auto call = workload::Call{ .op = FuseOp::Flush, .path = path ? path : "", .fh = fi->fh };
+        auto res  = invoke_fs_traced(call, [&](Filesystem& fs, trace::Context trace) {
+            return fs.flush(fi->fh, trace);
+        });
         return res.transform_error(fuse_err(__func__, path)).error_or(0);
     }
 
@@ -338,7 +514,8 @@ namespace madbfs::operations
     {
         log_i(__func__, "{:?}", path);
 
-        auto res = invoke_fs(&Filesystem::release, fi->fh);
+        auto call = workload::Call{ .op = FuseOp::Release, .path = path ? path : "", .fh = fi->fh };
+        auto res  = invoke_fs(call, &Filesystem::release, fi->fh);
         return res.transform_error(fuse_err(__func__, path)).error_or(0);
     }
 
@@ -346,18 +523,24 @@ namespace madbfs::operations
         const char*                         path,
         void*                               buf,
         fuse_fill_dir_t                     filler,
-        [[maybe_unused]] off_t              offset,
+        off_t                               offset,
         [[maybe_unused]] fuse_file_info*    fi,
         [[maybe_unused]] fuse_readdir_flags flags
     ) noexcept
     {
-        log_i(__func__, "{:?}", path);
+        log_i(__func__, "[offset={}] {:?}", offset, path);
 
-        const auto fill = [&](const char* name) { filler(buf, name, nullptr, 0, FUSE_FILL_DIR_PLUS); };
+        // entries are passed with their offset so the kernel can resume the listing in the next call
+        const auto fill = [&](const char* name, off_t off) {
+            return filler(buf, name, nullptr, off, FUSE_FILL_DIR_PLUS) != 0;
+        };
 
         return get_data()
             .create_path(path)
-            .and_then([&](path::Path p) { return invoke_fs(&Filesystem::readdir, p, fill); })
+            .and_then([&](path::Path p) {
+                auto call = workload::Call{ .op = FuseOp::Readdir, .path = path, .offset = offset };
+                return invoke_fs(call, &Filesystem::readdir, p, offset, fill);
+            })
             .transform_error(fuse_err(__func__, path))
             .error_or(0);
     }
@@ -373,11 +556,29 @@ namespace madbfs::operations
 
         return get_data()
             .create_path(path)
-            .and_then([&](path::Path p) { return invoke_fs(&Filesystem::utimens, p, tv[0], tv[1]); })
+            .and_then([&](path::Path p) {
+                auto call = workload::Call{ .op = FuseOp::Utimens, .path = path };
+                return invoke_fs(call, &Filesystem::utimens, p, tv[0], tv[1]);
+            })
             .transform_error(fuse_err(__func__, path))
             .error_or(0);
     }
 
+    off_t lseek(const char* path, off_t offset, int whence, fuse_file_info* fi) noexcept
+    {
+        log_i(__func__, "[offset={}|whence={}] {:?}", offset, whence, path);
+
+        auto call = workload::Call{
+            .op     = FuseOp::Lseek,
+            .path   = path ? path : "",
+            .flags  = static_cast<u32>(whence),
+            .fh     = fi->fh,
+            .offset = offset,
+        };
+        auto res = invoke_fs(call, &Filesystem::lseek, fi->fh, offset, whence);
+        return res.has_value() ? res.value() : fuse_err(__func__, path)(res.error());
+    }
+
     isize copy_file_range(
         const char*            in_path,
         struct fuse_file_info* in_fi,
@@ -394,8 +595,18 @@ namespace madbfs::operations
         );
 
         auto res = get_data().create_path2(in_path, out_path).and_then([&](auto p) {
-            auto op = &Filesystem::copy_file_range;
-            return invoke_fs(op, p[0], in_fi->fh, in_off, p[1], out_fi->fh, out_off, size);
+            auto fn   = &Filesystem::copy_file_range;
+            auto call = workload::Call{
+                .op      = FuseOp::CopyFileRange,
+                .path    = in_path,
+                .path2   = out_path,
+                .fh      = in_fi->fh,
+                .fh2     = out_fi->fh,
+                .offset  = in_off,
+                .offset2 = out_off,
+                .size    = size,
+            };
+            return invoke_fs(call, fn, p[0], in_fi->fh, in_off, p[1], out_fi->fh, out_off, size);
         });
         return res ? static_cast<isize>(res.value()) : fuse_err(__func__, in_path)(res.error());
     }
@@ -0,0 +1,207 @@
+#include "madbfs/stream.hpp"
+
+#include "madbfs/connection.hpp"
+
+#include <madbfs-common/log.hpp>
+
+// stream.hpp impl
+namespace madbfs
+{
+    Stream::Stream(Connection& connection, u64 fd, usize chunk_size, usize depth)
+        : m_connection{ connection }
+        , m_fd{ fd }
+        , m_chunk_size{ chunk_size }
+        , m_ring(depth)
+    {
+    }
+
+    AExpect<usize> Stream::read(Span<char> out, off_t offset)
+    {
+        if (auto res = co_await flush(); not res) {
+            co_return Unexpect{ res.error() };
+        }
+
+        // random access gains nothing from the ring
+        if (offset != m_position) {
+            auto res = co_await m_connection.read(m_fd, out, offset);
+            if (res) {
+                m_position = offset + static_cast<off_t>(*res);
+            }
+            co_return res;
+        }
+
+        auto exec = co_await async::current_executor();
+        auto read = 0uz;
+
+        while (read < out.size()) {
+            auto pos   = static_cast<usize>(offset) + read;
+            auto index = pos / m_chunk_size;
+
+            for (auto ahead : sv::iota(index, index + m_ring.size())) {
+                schedule(exec, ahead);
+            }
+
+            auto chunk = co_await fetch(exec, index);
+            if (not chunk) {
+                if (read > 0) {
+                    break;
+                }
+                co_return Unexpect{ chunk.error() };
+            }
+
+            auto size  = (*chunk)->size;
+            auto local = pos - index * m_chunk_size;
+            if (local >= size) {
+                break;
+            }
+
+            auto len = std::min(size - local, out.size() - read);
+            std::copy_n((*chunk)->data.get() + local, len, out.data() + read);
+            read += len;
+
+            if (size < m_chunk_size) {
+                break;    // end of file
+            }
+        }
+
+        m_position = offset + static_cast<off_t>(read);
+        co_return read;
+    }
+
+    AExpect<usize> Stream::write(Span<const char> in, off_t offset)
+    {
+        // the chunks may overlap the written range
+        sr::fill(m_ring, nullptr);
+        m_modified = true;
+
+        // re-checked after every submit since other writes may come in between
+        while (not m_pending.empty()
+               and offset != m_pending_offset + static_cast<off_t>(m_pending.size())) {
+            if (auto res = co_await submit(); not res) {
+                co_return Unexpect{ res.error() };
+            }
+        }
+
+        if (m_pending.empty()) {
+            m_pending_offset = offset;
+        }
+        m_pending.insert(m_pending.end(), in.begin(), in.end());
+
+        if (m_pending.size() >= m_chunk_size) {
+            if (auto res = co_await submit(); not res) {
+                co_return Unexpect{ res.error() };
+            }
+        }
+
+        co_return in.size();
+    }
+
+    AExpect<void> Stream::flush()
+    {
+        if (auto res = co_await submit(); not res) {
+            co_return Unexpect{ res.error() };
+        }
+        co_return co_await drain(0);
+    }
+
+    void Stream::schedule(async::Executor exec, usize index)
+    {
+        auto& slot = m_ring[index % m_ring.size()];
+        if (slot and slot->index == index) {
+            return;
+        }
+
+        auto promise = saf::promise<Errc>{ exec };
+        auto data    = std::make_unique_for_overwrite<char[]>(m_chunk_size);
+        auto future  = promise.get_future().share();
+
+        slot = std::make_shared<Chunk>(index, 0uz, std::move(data), std::move(future));
+
+        auto work = [](Connection& conn, u64 fd, Shared<Chunk> chunk, usize size, saf::promise<Errc> promise)
+            -> Await<void> {
+            auto offset = static_cast<off_t>(chunk->index * size);
+            auto res    = co_await conn.read(fd, Span{ chunk->data.get(), size }, offset);
+
+            chunk->size = res.value_or(0);
+            promise.set_value(res ? Errc{} : res.error());
+        };
+
+        auto coro = work(m_connection, m_fd, slot, m_chunk_size, std::move(promise));
+        async::spawn(exec, std::move(coro), [](std::exception_ptr e) { log::log_exception(e, "Stream"); });
+    }
+
+    AExpect<Shared<Stream::Chunk>> Stream::fetch(async::Executor exec, usize index)
+    {
+        schedule(exec, index);
+
+        auto& slot  = m_ring[index % m_ring.size()];
+        auto  chunk = slot;
+        auto  fut   = chunk->ready;
+
+        co_await fut.async_wait();
+
+        if (auto err = fut.get(); err != Errc{}) {
+            // failed chunk is requested again on next read
+            if (slot == chunk) {
+                slot = nullptr;
+            }
+            co_return Unexpect{ err };
+        }
+
+        co_return chunk;
+    }
+
+    AExpect<void> Stream::submit()
+    {
+        if (m_pending.empty()) {
+            co_return Expect<void>{};
+        }
+
+        // take the data before waiting so that the next writes start a new chunk
+        auto data   = std::exchange(m_pending, {});
+        auto offset = m_pending_offset;
+
+        if (auto res = co_await drain(m_ring.size() - 1); not res) {
+            co_return Unexpect{ res.error() };
+        }
+
+        auto exec    = co_await async::current_executor();
+        auto promise = saf::promise<Errc>{ exec };
+        m_writes.push_back(promise.get_future().share());
+
+        auto work = [](Connection& conn, u64 fd, Vec<char> data, off_t offset, saf::promise<Errc> promise)
+            -> Await<void> {
+            auto res = co_await conn.write(fd, data, offset);
+            if (not res) {
+                promise.set_value(res.error());
+            } else if (*res != data.size()) {
+                promise.set_value(Errc::io_error);    // device is full most likely
+            } else {
+                promise.set_value(Errc{});
+            }
+        };
+
+        auto coro = work(m_connection, m_fd, std::move(data), offset, std::move(promise));
+        async::spawn(exec, std::move(coro), [](std::exception_ptr e) { log::log_exception(e, "Stream"); });
+
+        co_return Expect<void>{};
+    }
+
+    AExpect<void> Stream::drain(usize keep)
+    {
+        auto res = Expect<void>{};
+
+        while (m_writes.size() > keep) {
+            auto fut = m_writes.front();
+            m_writes.pop_front();
+
+            co_await fut.async_wait();
+            if (auto err = fut.get(); err != Errc{} and res) {
+                log_e(__func__, "write on [fd={}] failed: {}", m_fd, err_msg(err));
+                res = Unexpect{ err };
+            }
+        }
+
+        co_return res;
+    }
+}
@@ -0,0 +1,34 @@
+#include "madbfs/task_group.hpp"
+
+#include <cassert>
+
+// task_group.hpp impl
+namespace madbfs
+{
+    void TaskGroup::leave()
+    {
+        assert(m_count > 0);
+
+        if (--m_count == 0 and m_idle) {
+            m_idle->set_value(Errc{});
+            m_idle.reset();
+            m_idle_future.reset();
+        }
+    }
+
+    Await<void> TaskGroup::wait()
+    {
+        if (m_count == 0) {
+            co_return;
+        }
+
+        // the waiters share one promise, fulfilled by the last task to leave
+        if (not m_idle) {
+            m_idle.emplace(co_await async::current_executor());
+            m_idle_future.emplace(m_idle->get_future().share());
+        }
+
+        auto future = *m_idle_future;
+        co_await future.async_wait();
+    }
+}
@@ -0,0 +1,70 @@
+#include "madbfs/trace.hpp"
+
+// helper functions/classes
+namespace
+{
+    madbfs::trace::Recorder g_recorder;
+}
+
+// trace.hpp impl
+namespace madbfs::trace
+{
+    void Context::record(
+        Str                     name,
+        Str                     category,
+        SteadyClock::time_point start,
+        SteadyClock::time_point end,
+        Side                    side
+    ) const
+    {
+        if (sampled()) {
+            recorder().record({
+                .trace    = m_id,
+                .name     = name,
+                .category = category,
+                .side     = side,
+                .start    = start,
+                .end      = end,
+            });
+        }
+    }
+
+    Context Recorder::start()
+    {
+        auto rate = this->rate();
+        if (rate == 0) {
+            return {};
+        }
+
+        // the sequence number of the operation doubles as the trace id, it's never 0
+        auto seq = m_counter.fetch_add(1, std::memory_order_relaxed) + 1;
+        return seq % rate == 0 ? Context{ seq } : Context{};
+    }
+
+    void Recorder::record(Event event)
+    {
+        auto lock = std::scoped_lock{ m_mutex };
+
+        if (m_events.size() < max_spans) {
+            m_events.push_back(event);
+        } else {
+            m_events[m_next] = event;
+            m_next           = (m_next + 1) % max_spans;
+        }
+    }
+
+    Vec<Event> Recorder::take()
+    {
+        auto lock   = std::scoped_lock{ m_mutex };
+        auto events = std::exchange(m_events, {});
+        auto next   = std::exchange(m_next, 0);
+
+        sr::rotate(events, events.begin() + static_cast<isize>(next));
+        return events;
+    }
+
+    Recorder& recorder()
+    {
+        return g_recorder;
+    }
+}
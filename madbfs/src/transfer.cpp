@@ -0,0 +1,528 @@
+#include "madbfs/transfer.hpp"
+
+#include "madbfs/filesystem.hpp"
+
+#include <madbfs-common/log.hpp>
+#include <madbfs-common/util/defer.hpp>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// helper functions/classes
+namespace
+{
+    madbfs::Errc last_err()
+    {
+        return static_cast<madbfs::Errc>(errno);
+    }
+
+    /**
+     * @brief Record an error of a job, only the first one is kept.
+     *
+     * @param job The job.
+     * @param err The error.
+     */
+    void record(madbfs::Transfers::Job& job, madbfs::Errc err)
+    {
+        if (job.error == madbfs::Errc{}) {
+            job.error = err;
+        }
+    }
+
+    /**
+     * @brief Read from a host file at an offset, blocking the calling thread.
+     *
+     * @param fd Host file descriptor.
+     * @param out Output buffer.
+     * @param offset Read offset.
+     *
+     * @return Number of bytes read, less than the buffer size only at the end of the file.
+     */
+    madbfs::AExpect<madbfs::usize> pread_all(int fd, madbfs::Span<char> out, madbfs::usize offset)
+    {
+        auto read = 0uz;
+        while (read < out.size()) {
+            auto off = static_cast<off_t>(offset + read);
+            auto res = ::pread(fd, out.data() + read, out.size() - read, off);
+            if (res < 0 and errno == EINTR) {
+                continue;
+            } else if (res < 0) {
+                co_return madbfs::Unexpect{ last_err() };
+            } else if (res == 0) {
+                break;
+            }
+            read += static_cast<madbfs::usize>(res);
+        }
+        co_return read;
+    }
+
+    /**
+     * @brief Write the whole buffer into a host file at an offset, blocking the calling thread.
+     *
+     * @param fd Host file descriptor.
+     * @param in Input buffer.
+     * @param offset Write offset.
+     */
+    madbfs::AExpect<void> pwrite_all(int fd, madbfs::Span<const char> in, madbfs::usize offset)
+    {
+        auto written = 0uz;
+        while (written < in.size()) {
+            auto off = static_cast<off_t>(offset + written);
+            auto res = ::pwrite(fd, in.data() + written, in.size() - written, off);
+            if (res < 0 and errno == EINTR) {
+                continue;
+            } else if (res < 0) {
+                co_return madbfs::Unexpect{ last_err() };
+            }
+            written += static_cast<madbfs::usize>(res);
+        }
+        co_return madbfs::Expect<void>{};
+    }
+}
+
+// transfer.hpp impl
+namespace madbfs
+{
+    Transfers::Transfers(Filesystem& fs, usize parallel, usize chunk_size)
+        : m_fs{ fs }
+        , m_pool{ 1 }
+        , m_parallel{ std::max(parallel, 1uz) }
+        , m_chunk_size{ std::max(chunk_size, 1uz) }
+    {
+    }
+
+    AExpect<u64> Transfers::pull(path::PathBuf device, std::filesystem::path host, bool resume)
+    {
+        return start(Kind::Pull, std::move(device), std::move(host), resume);
+    }
+
+    AExpect<u64> Transfers::push(std::filesystem::path host, path::PathBuf device, bool resume)
+    {
+        return start(Kind::Push, std::move(device), std::move(host), resume);
+    }
+
+    Expect<Ref<const Transfers::Job>> Transfers::cancel(u64 id)
+    {
+        auto found = m_jobs.find(id);
+        if (found == m_jobs.end()) {
+            return Unexpect{ Errc::no_such_process };
+        }
+
+        found->second->cancel = true;
+        return std::cref(*found->second);
+    }
+
+    Await<void> Transfers::shutdown()
+    {
+        for (auto& job : m_jobs | sv::values) {
+            job->cancel = true;
+        }
+
+        // jobs stop as soon as their chunks in flight are done
+        co_await m_running.wait();
+    }
+
+    AExpect<u64> Transfers::start(Kind kind, path::PathBuf device, std::filesystem::path host, bool resume)
+    {
+        // the host path is interpreted by this process, whose working directory is not of the caller's
+        if (not host.is_absolute()) {
+            co_return Unexpect{ Errc::invalid_argument };
+        }
+
+        // forget the oldest finished jobs
+        auto finished = sr::count_if(m_jobs | sv::values, [](auto& job) {
+            return job->status != Status::Running;
+        });
+        for (auto it = m_jobs.begin(); it != m_jobs.end() and finished >= max_finished;) {
+            if (it->second->status != Status::Running) {
+                it = m_jobs.erase(it);
+                --finished;
+            } else {
+                ++it;
+            }
+        }
+
+        auto id  = m_next_id++;
+        auto job = std::make_shared<Job>(id, kind, std::move(device), std::move(host), resume);
+
+        m_jobs.emplace(id, job);
+
+        log_i(
+            __func__,
+            "job {} started: {} [device={:?}|host={:?}|resume={}]",
+            id,
+            kind == Kind::Pull ? "pull" : "push",
+            job->device,
+            job->host.c_str(),
+            job->resume
+        );
+
+        auto exec = co_await async::current_executor();
+        async::spawn(exec, run(std::move(job)), [](std::exception_ptr e) {
+            log::log_exception(e, "Transfers");
+        });
+
+        co_return id;
+    }
+
+    Await<void> Transfers::run(Shared<Job> job)
+    {
+        m_running.enter();
+        auto guard = util::defer([&] { m_running.leave(); });
+
+        auto files = job->kind == Kind::Pull ? co_await scan_device(*job) : co_await scan_host(*job);
+        if (not files) {
+            log_e(__func__, "job {} failed to scan: {}", job->id, err_msg(files.error()));
+            record(*job, files.error());
+            job->status = Status::Failed;
+            co_return;
+        }
+
+        job->files.total = files->size();
+        for (const auto& entry : *files) {
+            job->bytes.total += entry.size;
+        }
+
+        auto next   = 0uz;
+        auto worker = [&](usize) -> AExpect<void> {
+            while (next < files->size() and not job->cancel) {
+                const auto& entry = (*files)[next++];
+
+                auto res = job->kind == Kind::Pull ? co_await pull_file(*job, entry)
+                                                   : co_await push_file(*job, entry);
+                if (not res) {
+                    auto msg = err_msg(res.error());
+                    log_e(__func__, "job {} failed on {:?}: {}", job->id, entry.device, msg);
+                    record(*job, res.error());
+                    continue;
+                }
+
+                ++job->files.done;
+            }
+            co_return Expect<void>{};
+        };
+
+        auto count = std::min(m_parallel, files->size());
+        std::ignore = co_await async::wait_all(sv::iota(0uz, count) | sv::transform(worker));
+
+        if (job->cancel) {
+            job->status = Status::Cancelled;
+        } else if (job->error != Errc{}) {
+            job->status = Status::Failed;
+        } else {
+            job->status = Status::Done;
+        }
+
+        log_i(__func__, "job {} finished: {} of {} files", job->id, job->files.done, job->files.total);
+    }
+
+    AExpect<Vec<Transfers::Entry>> Transfers::scan_device(Job& job)
+    {
+        if (auto stat = co_await m_fs.getattr(job.device.view()); not stat) {
+            co_return Unexpect{ stat.error() };
+        }
+
+        auto entries = Vec<Entry>{};
+        auto pending = Vec<Pair<path::PathBuf, std::filesystem::path>>{};
+
+        pending.emplace_back(job.device, job.host);
+
+        while (not pending.empty() and not job.cancel) {
+            auto [device, host] = std::move(pending.back());
+            pending.pop_back();
+
+            auto stat = co_await m_fs.getattr(device.view());
+            if (not stat) {
+                log_w(__func__, "job {} can't stat {:?}: {}", job.id, device, err_msg(stat.error()));
+                record(job, stat.error());
+                continue;
+            }
+
+            auto mode = stat->stat.mode;
+            if (S_ISREG(mode)) {
+                auto size = static_cast<usize>(stat->stat.size);
+                entries.emplace_back(std::move(device), std::move(host), size);
+                continue;
+            } else if (not S_ISDIR(mode)) {
+                log_i(__func__, "job {} skips {:?}: not a regular file or directory", job.id, device);
+                continue;
+            }
+
+            auto ec = std::error_code{};
+            std::filesystem::create_directories(host, ec);
+            if (ec) {
+                log_w(__func__, "job {} can't create dir {:?}: {}", job.id, host.c_str(), ec.message());
+                record(job, static_cast<Errc>(ec.value()));
+                continue;
+            }
+
+            auto names  = Vec<String>{};
+            auto filler = [&](const char* name, off_t) {
+                names.emplace_back(name);
+                return false;
+            };
+
+            // a bulk scan reads every file anyway, prefetching media headers ahead of it is wasted work
+            if (auto res = co_await m_fs.readdir(device.view(), 0, filler, false); not res) {
+                log_w(__func__, "job {} can't list {:?}: {}", job.id, device, err_msg(res.error()));
+                record(job, res.error());
+                continue;
+            }
+
+            for (const auto& name : names) {
+                if (auto child = device.extend_copy(name); child) {
+                    pending.emplace_back(std::move(*child), host / name);
+                }
+            }
+        }
+
+        co_return entries;
+    }
+
+    AExpect<Vec<Transfers::Entry>> Transfers::scan_host(Job& job)
+    {
+        auto ec = std::error_code{};
+        if (std::filesystem::symlink_status(job.host, ec); ec) {
+            co_return Unexpect{ static_cast<Errc>(ec.value()) };
+        }
+
+        auto entries = Vec<Entry>{};
+        auto pending = Vec<Pair<path::PathBuf, std::filesystem::path>>{};
+
+        pending.emplace_back(job.device, job.host);
+
+        while (not pending.empty() and not job.cancel) {
+            auto [device, host] = std::move(pending.back());
+            pending.pop_back();
+
+            auto status = std::filesystem::symlink_status(host, ec);
+            if (ec) {
+                log_w(__func__, "job {} can't stat {:?}: {}", job.id, host.c_str(), ec.message());
+                record(job, static_cast<Errc>(ec.value()));
+                continue;
+            }
+
+            if (std::filesystem::is_regular_file(status)) {
+                auto size = static_cast<usize>(std::filesystem::file_size(host, ec));
+                entries.emplace_back(std::move(device), std::move(host), ec ? 0 : size);
+                continue;
+            } else if (not std::filesystem::is_directory(status)) {
+                log_i(__func__, "job {} skips {:?}: not a regular file or directory", job.id, host.c_str());
+                continue;
+            }
+
+            if (auto made = co_await m_fs.mkdir(device.view(), S_IFDIR | 0755);
+                not made and made.error() != Errc::file_exists) {
+                log_w(__func__, "job {} can't create dir {:?}: {}", job.id, device, err_msg(made.error()));
+                record(job, made.error());
+                continue;
+            }
+
+            for (const auto& child : std::filesystem::directory_iterator{ host, ec }) {
+                auto name = child.path().filename().string();
+                if (auto path = device.extend_copy(name); path) {
+                    pending.emplace_back(std::move(*path), child.path());
+                }
+            }
+        }
+
+        co_return entries;
+    }
+
+    AExpect<void> Transfers::pull_file(Job& job, const Entry& entry)
+    {
+        // without resume a file left at the destination is never trusted to be a part of the source
+        auto flags = O_RDWR | O_CREAT | O_CLOEXEC | (job.resume ? 0 : O_TRUNC);
+        auto host  = ::open(entry.host.c_str(), flags, 0644);
+        if (host < 0) {
+            co_return Unexpect{ last_err() };
+        }
+        auto close_host = util::defer([&] { ::close(host); });
+
+        auto offset = 0uz;
+
+        if (job.resume) {
+            struct stat host_stat = {};
+            if (::fstat(host, &host_stat) < 0) {
+                co_return Unexpect{ last_err() };
+            }
+
+            auto size = static_cast<usize>(host_stat.st_size);
+            if (size > 0 and size <= entry.size) {
+                auto same = co_await same_tail(entry.device.view(), host, size);
+                if (not same) {
+                    co_return Unexpect{ same.error() };
+                }
+                offset = *same ? size : 0;
+            }
+
+            if (offset == 0 and size > 0 and ::ftruncate(host, 0) < 0) {
+                co_return Unexpect{ last_err() };
+            }
+        }
+
+        job.bytes.done += offset;
+        if (offset == entry.size) {
+            co_return Expect<void>{};
+        }
+
+        log_d(__func__, "job {} pulls {:?} from {}", job.id, entry.device, offset);
+
+        auto fd = co_await m_fs.open(entry.device.view(), O_RDONLY | O_DIRECT);
+        if (not fd) {
+            co_return Unexpect{ fd.error() };
+        }
+
+        auto buf = Vec<char>(m_chunk_size);
+        auto res = Expect<void>{};
+
+        while (offset < entry.size and not job.cancel) {
+            auto read = co_await m_fs.read(*fd, buf, static_cast<off_t>(offset));
+            if (not read) {
+                res = Unexpect{ read.error() };
+                break;
+            } else if (*read == 0) {
+                break;    // the file got shorter on the device
+            }
+
+            if (auto written = co_await write_host(host, Span{ buf.data(), *read }, offset); not written) {
+                res = Unexpect{ written.error() };
+                break;
+            }
+
+            offset         += *read;
+            job.bytes.done += *read;
+        }
+
+        std::ignore = co_await m_fs.release(*fd);
+
+        co_return res;
+    }
+
+    AExpect<void> Transfers::push_file(Job& job, const Entry& entry)
+    {
+        auto host = ::open(entry.host.c_str(), O_RDONLY | O_CLOEXEC);
+        if (host < 0) {
+            co_return Unexpect{ last_err() };
+        }
+        auto close_host = util::defer([&] { ::close(host); });
+
+        auto offset = 0uz;
+        auto flags  = O_WRONLY | O_DIRECT;
+        auto fd     = Expect<u64>{};
+
+        if (auto stat = co_await m_fs.getattr(entry.device.view()); stat) {
+            auto size = static_cast<usize>(stat->stat.size);
+            if (job.resume and size > 0 and size <= entry.size) {
+                auto same = co_await same_tail(entry.device.view(), host, size);
+                if (not same) {
+                    co_return Unexpect{ same.error() };
+                }
+                offset = *same ? size : 0;
+            }
+
+            job.bytes.done += offset;
+            if (offset > 0 and offset == entry.size) {
+                co_return Expect<void>{};
+            }
+
+            // without resume a file left at the destination is never trusted to be a part of the source
+            fd = co_await m_fs.open(entry.device.view(), offset == 0 ? flags | O_TRUNC : flags);
+        } else if (stat.error() == Errc::no_such_file_or_directory) {
+            fd = co_await m_fs.create(entry.device.view(), S_IFREG | 0644, flags | O_CREAT);
+        } else {
+            co_return Unexpect{ stat.error() };
+        }
+
+        if (not fd) {
+            co_return Unexpect{ fd.error() };
+        }
+
+        log_d(__func__, "job {} pushes {:?} from {}", job.id, entry.device, offset);
+
+        auto buf = Vec<char>(m_chunk_size);
+        auto res = Expect<void>{};
+
+        while (offset < entry.size and not job.cancel) {
+            auto read = co_await read_host(host, buf, offset);
+            if (not read) {
+                res = Unexpect{ read.error() };
+                break;
+            } else if (*read == 0) {
+                break;    // the file got shorter on the host
+            }
+
+            auto written = co_await m_fs.write(*fd, Str{ buf.data(), *read }, static_cast<off_t>(offset));
+            if (not written) {
+                res = Unexpect{ written.error() };
+                break;
+            } else if (*written != *read) {
+                res = Unexpect{ Errc::io_error };
+                break;
+            }
+
+            offset         += *read;
+            job.bytes.done += *read;
+        }
+
+        // pending writes are flushed on release, its error matters as much as the writes
+        if (auto released = co_await m_fs.release(*fd); not released and res) {
+            res = Unexpect{ released.error() };
+        }
+
+        co_return res;
+    }
+
+    AExpect<bool> Transfers::same_tail(path::Path device, int host, usize size)
+    {
+        auto len    = std::min(size, m_chunk_size);
+        auto offset = size - len;
+
+        auto host_buf = Vec<char>(len);
+        if (auto read = co_await read_host(host, host_buf, offset); not read) {
+            co_return Unexpect{ read.error() };
+        } else if (*read != len) {
+            co_return false;
+        }
+
+        auto fd = co_await m_fs.open(device, O_RDONLY | O_DIRECT);
+        if (not fd) {
+            co_return Unexpect{ fd.error() };
+        }
+
+        auto device_buf = Vec<char>(len);
+        auto read       = 0uz;
+        auto res        = Expect<bool>{ true };
+
+        while (read < len) {
+            auto span = Span{ device_buf.data() + read, len - read };
+            auto got  = co_await m_fs.read(*fd, span, static_cast<off_t>(offset + read));
+            if (not got) {
+                res = Unexpect{ got.error() };
+                break;
+            } else if (*got == 0) {
+                res = false;    // the file got shorter on the device
+                break;
+            }
+            read += *got;
+        }
+
+        std::ignore = co_await m_fs.release(*fd);
+
+        if (res and *res) {
+            res = sr::equal(host_buf, device_buf);
+        }
+        co_return res;
+    }
+
+    AExpect<usize> Transfers::read_host(int fd, Span<char> out, usize offset)
+    {
+        co_return co_await async::spawn(m_pool, pread_all(fd, out, offset), async::use_awaitable);
+    }
+
+    AExpect<void> Transfers::write_host(int fd, Span<const char> in, usize offset)
+    {
+        co_return co_await async::spawn(m_pool, pwrite_all(fd, in, offset), async::use_awaitable);
+    }
+}
@@ -116,6 +116,44 @@ namespace
         return fmt::format("\"{}\"", path);
     }
 
+    /**
+     * @brief Run a shell command on the device then stat a file within the same shell invocation.
+     *
+     * @param cmd Shell command without the `adb shell` prefix, may be empty to only stat the file.
+     * @param path Path of the file to stat once the command succeeds.
+     *
+     * @return Stat of the file after the command.
+     */
+    AExpect<rpc::resp::Stat> exec_then_stat(Init<Str> cmd, Str path)
+    {
+        const auto qpath = quote(path);
+
+        auto full = Vec<Str>{ "adb", "shell" };
+        if (cmd.size() != 0) {
+            full.insert(full.end(), cmd);
+            full.push_back("&&");
+        }
+        full.insert(full.end(), { "stat", "-c", "'%f|%h|%s|%u|%g|%x|%y|%z|%n'", qpath });
+
+        auto res = co_await cmd::exec(full);
+        if (not res.has_value()) {
+            co_return Unexpect{ res.error() };
+        }
+
+        // the command may print something before the stat, the stat is always on the last line
+        auto out  = util::strip(*res);
+        auto last = out.rfind('\n');
+        auto line = last == Str::npos ? out : out.substr(last + 1);
+
+        auto parsed = parse_file_stat(line);
+        if (not parsed) {
+            log_e(__func__, "parsing stat failed [{}]", path);
+            co_return Unexpect{ Errc::io_error };
+        }
+
+        co_return parsed->second;
+    }
+
     /**
      * @brief Check whether the device is connected through adb.
      */
@@ -243,14 +281,14 @@ namespace
 
         AExpect<rpc::Response> handle_req(rpc::req::Mknod req)
         {
-            auto res = co_await cmd::exec({ "adb", "shell", "touch", quote(req.path) });
-            co_return res.transform([](auto&&) { return rpc::resp::Mknod{}; });
+            auto res = co_await exec_then_stat({ "touch", quote(req.path) }, req.path);
+            co_return res.transform([](auto stat) { return rpc::resp::Mknod{ .stat = stat }; });
         }
 
         AExpect<rpc::Response> handle_req(rpc::req::Mkdir req)
         {
-            auto res = co_await cmd::exec({ "adb", "shell", "mkdir", quote(req.path) });
-            co_return res.transform([](auto&&) { return rpc::resp::Mkdir{}; });
+            auto res = co_await exec_then_stat({ "mkdir", quote(req.path) }, req.path);
+            co_return res.transform([](auto stat) { return rpc::resp::Mkdir{ .stat = stat }; });
         }
 
         AExpect<rpc::Response> handle_req(rpc::req::Unlink req)
@@ -273,24 +311,24 @@ namespace
                 // rename(2)
                 co_return Unexpect{ Errc::invalid_argument };
             } else if (req.flags == RENAME_NOREPLACE) {
-                auto res = co_await cmd::exec({ "adb", "shell", "mv", "-n", quote(req.from), quote(req.to) });
-                co_return res.transform([&](auto&&) {
+                auto res = co_await exec_then_stat({ "mv", "-n", quote(req.from), quote(req.to) }, req.to);
+                co_return res.transform([&](auto stat) {
                     for (auto& [k, v] : m_fd_map) {
                         if (v == req.from) {
                             v = req.to;
                         }
                     }
-                    return rpc::resp::Rename{};
+                    return rpc::resp::Rename{ .stat = stat };
                 });
             } else {
-                auto res = co_await cmd::exec({ "adb", "shell", "mv", quote(req.from), quote(req.to) });
-                co_return res.transform([&](auto&&) {
+                auto res = co_await exec_then_stat({ "mv", quote(req.from), quote(req.to) }, req.to);
+                co_return res.transform([&](auto stat) {
                     for (auto& [k, v] : m_fd_map) {
                         if (v == req.from) {
                             v = req.to;
                         }
                     }
-                    return rpc::resp::Rename{};
+                    return rpc::resp::Rename{ .stat = stat };
                 });
             }
         }
@@ -299,8 +337,8 @@ namespace
         {
             const auto size_str = fmt::format("{}", req.size);
 
-            auto res = co_await cmd::exec({ "adb", "shell", "truncate", "-s", size_str, quote(req.path) });
-            co_return res.transform([](auto&&) { return rpc::resp::Truncate{}; });
+            auto res = co_await exec_then_stat({ "truncate", "-s", size_str, quote(req.path) }, req.path);
+            co_return res.transform([](auto stat) { return rpc::resp::Truncate{ .stat = stat }; });
         }
 
         AExpect<rpc::Response> handle_req(rpc::req::Utimens req)
@@ -344,7 +382,9 @@ namespace
                 }
             }
 
-            co_return rpc::resp::Utimens{};
+            // touch can't print the stat, so it is queried separately
+            auto stat = co_await exec_then_stat({}, req.path);
+            co_return stat.transform([](auto stat) { return rpc::resp::Utimens{ .stat = stat }; });
         }
 
         AExpect<rpc::Response> handle_req(rpc::req::CopyFileRange req)
@@ -381,21 +421,60 @@ namespace
              * 1048576 bytes (1.0 M) copied, 0.054401 s, 18 M/s
              */
 
-            co_return res.transform([&](Str str) {
-                log_d(__func__, "copy_file_range: {:?}", str);
-                return util::split_n<4>(str, '\n')
-                    .and_then([](util::SplitResult<4> r) { return util::split_n<1>(r.result[3], ' '); })
-                    .and_then([](util::SplitResult<1> r) { return parse_integral<usize>(r.result[0], 10); })
-                    .transform([](auto n) { return rpc::resp::CopyFileRange{ .size = n }; })
-                    .value_or(rpc::resp::CopyFileRange{ .size = 0 });
+            if (not res.has_value()) {
+                co_return Unexpect{ res.error() };
+            }
+
+            log_d(__func__, "copy_file_range: {:?}", *res);
+            auto split_line = [](util::SplitResult<4> r) { return util::split_n<1>(r.result[3], ' '); };
+            auto parse_size = [](util::SplitResult<1> r) { return parse_integral<usize>(r.result[0], 10); };
+
+            auto size = util::split_n<4>(*res, '\n').and_then(split_line).and_then(parse_size).value_or(0);
+
+            // dd output is parsed by line, so the stat is queried separately
+            auto stat = co_await exec_then_stat({}, req.out_path);
+            co_return stat.transform([&](auto stat) {
+                return rpc::resp::CopyFileRange{ .size = size, .stat = stat };
             });
         }
 
         AExpect<rpc::Response> handle_req(rpc::req::Open req)
         {
+            auto stat = rpc::resp::Stat{};
+
+            // create/truncate then stat in one shell invocation; O_EXCL is left to the kernel which only
+            // calls create on negative lookup
+            if (req.flags != 0) {
+                const auto qpath  = quote(req.path);
+                const auto create = (req.flags & rpc::open_flag::create) != 0;
+                const auto trunc  = (req.flags & rpc::open_flag::truncate) != 0;
+
+                auto cmd = Vec<Str>{};
+                if (trunc and create) {
+                    cmd = { "adb", "shell", "truncate", "-s", "0", qpath };
+                } else if (trunc) {
+                    cmd = { "adb", "shell", "truncate", "-c", "-s", "0", qpath };
+                } else {
+                    cmd = { "adb", "shell", "[", "-e", qpath, "]", "||", "touch", qpath };
+                }
+                cmd.insert(cmd.end(), { "&&", "stat", "-c", "'%f|%h|%s|%u|%g|%x|%y|%z|%n'", qpath });
+
+                auto res = co_await cmd::exec(cmd);
+                if (not res.has_value()) {
+                    co_return Unexpect{ res.error() };
+                }
+
+                auto parsed = parse_file_stat(util::strip(*res));
+                if (not parsed) {
+                    log_e(__func__, "parsing stat failed [{}]", req.path);
+                    co_return Unexpect{ Errc::io_error };
+                }
+                stat = parsed->second;
+            }
+
             auto fd = ++m_fd_counter;
             m_fd_map.emplace(fd, req.path);
-            co_return rpc::resp::Open{ .fd = fd };
+            co_return rpc::resp::Open{ .fd = fd, .stat = stat };
         }
 
         AExpect<rpc::Response> handle_req(rpc::req::Close req)
@@ -405,8 +484,9 @@ namespace
                 co_return Unexpect{ Errc::bad_file_descriptor };
             }
 
+            // files are not kept open on the device, there is nothing that changes on close
             m_fd_map.erase(entry);
-            co_return rpc::resp::Close{};
+            co_return rpc::resp::Close{ .stat = std::nullopt };
         }
 
         AExpect<rpc::Response> handle_req(rpc::req::Read req)
@@ -457,6 +537,62 @@ namespace
             co_return res.transform([&](auto&&) { return rpc::resp::Write{ .size = in_str.size() }; });
         }
 
+        AExpect<rpc::Response> handle_req(rpc::req::StatPath req)
+        {
+            auto prefixes = Vec<Str>{};
+            auto quoted   = Vec<String>{};
+            for (auto end = 1uz; end <= req.path.size(); ++end) {
+                if (end < req.path.size() and req.path[end] != '/') {
+                    continue;
+                } else if (req.path[end - 1] == '/') {    // empty component
+                    continue;
+                }
+                prefixes.push_back(req.path.substr(0, end));
+                quoted.push_back(quote(prefixes.back()));
+            }
+
+            auto cmd = Vec<Str>{ "adb", "shell", "stat", "-c", "'%f|%h|%s|%u|%g|%x|%y|%z|%n'" };
+            cmd.insert(cmd.end(), quoted.begin(), quoted.end());
+
+            // stat exits with non-zero status if any of the path fails, the output still contains the rest.
+            // stderr comes after stdout, its first line is the error of the first failing component
+            auto res = co_await cmd::exec(cmd, "", false, true);
+            if (not res.has_value()) {
+                co_return Unexpect{ res.error() };
+            }
+
+            auto out   = Str{ *res };
+            auto lines = util::StringSplitter{ out, '\n' };
+            auto stats = Vec<rpc::resp::Stat>{};
+            auto rest  = Str{};
+
+            // every component after the first failing one fails as well, so the lines are in prefix order
+            while (auto line = lines.next()) {
+                auto parsed = parse_file_stat(util::strip(*line));
+                if (not parsed or stats.size() >= prefixes.size()
+                    or parsed->first != get_basename(prefixes[stats.size()])) {
+                    rest = out.substr(static_cast<usize>(line->data() - out.data()));
+                    break;
+                }
+
+                stats.push_back(parsed->second);
+            }
+
+            auto status = stats.size() == prefixes.size() ? rpc::Status{} : cmd::parse_error(rest);
+            co_return rpc::resp::StatPath{ .stats = std::move(stats), .status = status };
+        }
+
+        AExpect<rpc::Response> handle_req(rpc::req::Lseek req)
+        {
+            if (not m_fd_map.contains(req.fd)) {
+                co_return Unexpect{ Errc::bad_file_descriptor };
+            }
+
+            // NOTE: there is no shell utility that exposes SEEK_DATA/SEEK_HOLE, the caller should treat the
+            // whole file as data instead
+            co_return Unexpect{ Errc::operation_not_supported };
+        }
+
         AExpect<rpc::Response> handle_req(rpc::req::Ping req)
         {
             auto res = co_await check_connection();
@@ -487,6 +623,12 @@ namespace madbfs::transport
         co_return Uniq<AdbTransport>{ new AdbTransport{ co_await async::current_executor() } };
     }
 
+    Transport::Depth AdbTransport::depth() const
+    {
+        auto queued = std::min(m_queued, m_requests.size());
+        return { .queued = queued, .inflight = m_requests.size() - queued };
+    }
+
     void AdbTransport::stop(rpc::Status status)
     {
         if (m_running) {
@@ -497,6 +639,7 @@ namespace madbfs::transport
             }
             m_requests.clear();
 
+            m_queued = 0;
             m_in_channel.cancel();
             m_in_channel.close();
             m_out_channel.cancel();
@@ -531,6 +674,7 @@ namespace madbfs::transport
             }
 
             m_requests.clear();
+            m_queued = 0;
             m_in_channel.cancel();
             m_in_channel.reset();
             m_out_channel.cancel();
@@ -546,7 +690,7 @@ namespace madbfs::transport
         });
     }
 
-    AExpect<rpc::Response> AdbTransport::send(rpc::Request req)
+    AExpect<rpc::Response> AdbTransport::send(rpc::Request req, trace::Context /* trace */)
     {
         if (not m_running) {
             co_return Unexpect{ Errc::resource_unavailable_try_again };
@@ -559,7 +703,9 @@ namespace madbfs::transport
         auto [_, ok] = m_requests.try_emplace(id, req.proc(), std::move(promise));
         assert(ok and "id is always incremented, insertion should always happens");
 
+        ++m_queued;
         if (auto res = co_await m_in_channel.async_send({}, { id, req }); not res) {
+            m_queued -= m_queued > 0;
             log_e(__func__, "failed to send payload to channel: {}", res.error().message());
             co_return Unexpect{ async::to_generic_err(res.error(), Errc::broken_pipe) };
         }
@@ -582,7 +728,9 @@ namespace madbfs::transport
         auto [_, ok] = m_requests.try_emplace(id, req.proc(), std::move(promise));
         assert(ok and "id is always incremented, insertion should always happens");
 
+        ++m_queued;
         if (auto res = co_await m_in_channel.async_send({}, { id, req }); not res) {
+            m_queued -= m_queued > 0;
             log_e(__func__, "failed to send payload to channel: {}", res.error().message());
             co_return Unexpect{ async::to_generic_err(res.error(), Errc::broken_pipe) };
         }
@@ -610,6 +758,8 @@ namespace madbfs::transport
                 co_return Unexpect{ async::to_generic_err(id_req.error(), Errc::broken_pipe) };
             }
 
+            m_queued -= m_queued > 0;    // reset on stop, senders may still be pending
+
             auto [id, req] = std::move(*id_req);
             auto promise   = m_requests.find(id);
             if (promise == m_requests.end()) {
@@ -165,6 +165,12 @@ namespace madbfs::transport
     {
     }
 
+    Transport::Depth ProxyTransport::depth() const
+    {
+        auto queued = std::min(m_queued, m_requests.size());
+        return { .queued = queued, .inflight = m_requests.size() - queued };
+    }
+
     void ProxyTransport::stop(rpc::Status status)
     {
         if (m_running) {
@@ -175,6 +181,7 @@ namespace madbfs::transport
             }
             m_requests.clear();
 
+            m_queued = 0;
             m_channel.cancel();
             m_channel.close();
         }
@@ -227,6 +234,7 @@ namespace madbfs::transport
             }
 
             m_requests.clear();
+            m_queued = 0;
             m_channel.cancel();
             m_channel.reset();
         });
@@ -239,20 +247,23 @@ namespace madbfs::transport
         });
     }
 
-    AExpect<rpc::Response> ProxyTransport::send(rpc::Request req)
+    AExpect<rpc::Response> ProxyTransport::send(rpc::Request req, trace::Context trace)
     {
         if (not m_running) {
             co_return Unexpect{ Errc::resource_unavailable_try_again };
         }
 
-        auto id      = next_id();
+        auto id      = next_id().with_trace(trace.sampled());
         auto promise = saf::promise<Expect<rpc::Response>>{ co_await async::current_executor() };
         auto future  = promise.get_future();
+        auto queued  = trace.sampled() ? SteadyClock::now() : SteadyClock::time_point{};
 
-        auto [_, ok] = m_requests.try_emplace(id, req, std::move(promise));
+        auto [_, ok] = m_requests.try_emplace(id, req, std::move(promise), trace, queued);
         assert(ok and "id is always incremented, insertion should always happens");
 
+        ++m_queued;
         if (auto res = co_await m_channel.async_send({}, { id, req }); not res) {
+            m_queued -= m_queued > 0;
             log_e(__func__, "failed to send payload to channel: {}", res.error().message());
             co_return Unexpect{ async::to_generic_err(res.error(), Errc::broken_pipe) };
         }
@@ -275,7 +286,9 @@ namespace madbfs::transport
         auto [_, ok] = m_requests.try_emplace(id, req, std::move(promise));
         assert(ok and "id is always incremented, insertion should always happens");
 
+        ++m_queued;
         if (auto res = co_await m_channel.async_send({}, { id, req }); not res) {
+            m_queued -= m_queued > 0;
             log_e(__func__, "failed to send payload to channel: {}", res.error().message());
             co_return Unexpect{ async::to_generic_err(res.error(), Errc::broken_pipe) };
         }
@@ -303,7 +316,10 @@ namespace madbfs::transport
                 co_return Unexpect{ async::to_generic_err(id_req.error(), Errc::broken_pipe) };
             }
 
+            m_queued -= m_queued > 0;    // reset on stop, senders may still be pending
+
             auto [id, req] = std::move(*id_req);
+            auto dequeued  = id.traced() ? SteadyClock::now() : SteadyClock::time_point{};
 
             if (auto res = co_await rpc::send_request(m_socket, payload_buf, req, id); not res) {
                 log_e(__func__, "failed to send request [{}]: {}", id.inner(), err_msg(res.error()));
@@ -311,6 +327,13 @@ namespace madbfs::transport
                     entry->second.result.set_value(Unexpect{ res.error() });
                     m_requests.erase(entry);
                 }
+            } else if (id.traced()) {
+                if (auto entry = m_requests.find(id); entry != m_requests.end()) {
+                    auto& promise = entry->second;
+                    promise.sent  = SteadyClock::now();
+                    promise.trace.record("channel", "transport", promise.queued, dequeued);
+                    promise.trace.record("socket write", "transport", dequeued, promise.sent);
+                }
             }
         }
 
@@ -337,10 +360,40 @@ namespace madbfs::transport
                 continue;
             }
 
-            auto& [req, res] = entry.mapped();
-            res.set_value(co_await rpc::receive_response(m_socket, payload_buf, *header, req));
+            auto& promise  = entry.mapped();
+            auto  received = header->id.traced() ? SteadyClock::now() : SteadyClock::time_point{};
+            auto  response = co_await rpc::receive_response(m_socket, payload_buf, *header, promise.req);
+
+            if (header->id.traced()) {
+                record_round_trip(promise, header->timing, received);
+            }
+            promise.result.set_value(std::move(response));
         }
 
         co_return Expect<void>{};
     }
+
+    void ProxyTransport::record_round_trip(
+        const Promise&          promise,
+        rpc::Timing             timing,
+        SteadyClock::time_point received
+    )
+    {
+        using std::chrono::microseconds;
+
+        const auto& trace = promise.trace;
+
+        auto on_server = microseconds{ timing.queue } + microseconds{ timing.exec };
+        auto round     = received - promise.sent;
+        auto network   = std::max(round - on_server, SteadyClock::duration::zero()) / 2;
+
+        auto queue_start = promise.sent + network;
+        auto exec_start  = queue_start + microseconds{ timing.queue };
+        auto exec_end    = exec_start + microseconds{ timing.exec };
+
+        trace.record("round trip", "transport", promise.sent, received);
+        trace.record("queue", "server", queue_start, exec_start, trace::Side::Server);
+        trace.record(rpc::to_string(promise.req), "server", exec_start, exec_end, trace::Side::Server);
+        trace.record("socket read", "transport", received);
+    }
 }
@@ -0,0 +1,355 @@
+#include "madbfs/tree_snapshot.hpp"
+
+#include "madbfs/node.hpp"
+
+#include <madbfs-common/log.hpp>
+
+#include <bit>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+using namespace madbfs;
+
+// helper functions/classes
+namespace
+{
+    constexpr auto magic     = Array{ 'm', 'a', 'd', 'b', 'f', 's', 'T', 'R' };
+    constexpr auto version   = u32{ 1 };
+    constexpr auto max_depth = 4096uz;    // guard against corrupted file
+
+    /**
+     * @brief Node kinds as written on the snapshot.
+     */
+    enum class Kind : u8
+    {
+        Regular   = 0,
+        Directory = 1,
+        Link      = 2,
+        Other     = 3,
+    };
+
+    /**
+     * @class Writer
+     *
+     * @brief Simple append-only binary writer.
+     */
+    struct Writer
+    {
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        void write(T value)
+        {
+            auto bytes = std::bit_cast<Array<char, sizeof(T)>>(value);
+            buf.insert(buf.end(), bytes.begin(), bytes.end());
+        }
+
+        void write_str(Str str)
+        {
+            write(static_cast<u32>(str.size()));
+            buf.insert(buf.end(), str.begin(), str.end());
+        }
+
+        void write_stat(const Stat& stat)
+        {
+            write(static_cast<u64>(stat.links));
+            write(static_cast<i64>(stat.size));
+            for (auto time : { stat.mtime, stat.atime, stat.ctime }) {
+                write(static_cast<i64>(time.tv_sec));
+                write(static_cast<i64>(time.tv_nsec));
+            }
+            write(static_cast<u32>(stat.mode));
+            write(static_cast<u32>(stat.uid));
+            write(static_cast<u32>(stat.gid));
+        }
+
+        Vec<char> buf;
+    };
+
+    /**
+     * @class Reader
+     *
+     * @brief Simple binary reader, every read fails once the buffer is exhausted.
+     */
+    struct Reader
+    {
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        Opt<T> read()
+        {
+            if (buf.size() - offset < sizeof(T)) {
+                return std::nullopt;
+            }
+            auto bytes = Array<char, sizeof(T)>{};
+            std::memcpy(bytes.data(), buf.data() + offset, sizeof(T));
+            offset += sizeof(T);
+            return std::bit_cast<T>(bytes);
+        }
+
+        Opt<Str> read_str()
+        {
+            auto len = read<u32>();
+            if (not len or buf.size() - offset < *len) {
+                return std::nullopt;
+            }
+            auto str  = Str{ buf.data() + offset, *len };
+            offset   += *len;
+            return str;
+        }
+
+        Opt<Stat> read_stat()
+        {
+            auto links = read<u64>();
+            auto size  = read<i64>();
+            auto times = Array<timespec, 3>{};
+            for (auto& time : times) {
+                auto sec  = read<i64>();
+                auto nsec = read<i64>();
+                if (not sec or not nsec) {
+                    return std::nullopt;
+                }
+                time = timespec{ .tv_sec = *sec, .tv_nsec = *nsec };
+            }
+            auto mode = read<u32>();
+            auto uid  = read<u32>();
+            auto gid  = read<u32>();
+
+            if (not links or not size or not mode or not uid or not gid) {
+                return std::nullopt;
+            }
+
+            return Stat{
+                .links = static_cast<nlink_t>(*links),
+                .size  = static_cast<off_t>(*size),
+                .mtime = times[0],
+                .atime = times[1],
+                .ctime = times[2],
+                .mode  = static_cast<mode_t>(*mode),
+                .uid   = static_cast<uid_t>(*uid),
+                .gid   = static_cast<gid_t>(*gid),
+            };
+        }
+
+        Span<const char> buf;
+        usize            offset = 0;
+    };
+
+    Opt<Kind> kind_of(const Node& node)
+    {
+        // clang-format off
+        auto overload = Overload{
+            [](const node::Regular&  ) -> Opt<Kind> { return Kind::Regular;   },
+            [](const node::Directory&) -> Opt<Kind> { return Kind::Directory; },
+            [](const node::Link&     ) -> Opt<Kind> { return Kind::Link;      },
+            [](const node::Other&    ) -> Opt<Kind> { return Kind::Other;     },
+            [](const node::Error&    ) -> Opt<Kind> { return std::nullopt;    },
+        };
+        // clang-format on
+
+        return std::visit(overload, node.value());
+    }
+
+    /**
+     * @brief Write node and its children (pre-order) into writer.
+     *
+     * @return Number of nodes written.
+     */
+    usize write_node(Writer& writer, const Node& node, Kind kind)
+    {
+        writer.write(kind);
+        writer.write(static_cast<u8>(node.has_synced()));
+        writer.write_str(node.name());
+        writer.write_stat(node.stat());
+
+        if (kind != Kind::Directory) {
+            return 1;
+        }
+
+        const auto& children = node.as_directory()->get().children();
+        auto        valid    = children | sv::filter([](const Uniq<Node>& n) { return not n->is_error(); });
+
+        writer.write(static_cast<u32>(sr::distance(valid)));
+
+        auto count = 1uz;
+        for (const auto& child : valid) {
+            count += write_node(writer, *child, kind_of(*child).value());
+        }
+        return count;
+    }
+
+    /**
+     * @brief Read children of a directory node (pre-order) from reader.
+     *
+     * @return Number of nodes read.
+     */
+    Expect<usize> read_children(Reader& reader, Node& parent, usize depth)
+    {
+        if (depth > max_depth) {
+            return Unexpect{ Errc::bad_message };
+        }
+
+        auto count = reader.read<u32>();
+        if (not count) {
+            return Unexpect{ Errc::bad_message };
+        }
+
+        auto total = 0uz;
+        for (auto i = 0u; i < *count; ++i) {
+            auto kind   = reader.read<Kind>();
+            auto synced = reader.read<u8>();
+            auto name   = reader.read_str();
+            auto stat   = reader.read_stat();
+
+            if (not kind or not synced or not name or not stat) {
+                return Unexpect{ Errc::bad_message };
+            }
+
+            auto file = File{};
+            switch (*kind) {
+            case Kind::Regular: file = node::Regular{}; break;
+            case Kind::Directory: file = node::Directory{}; break;
+            case Kind::Link: file = node::Link{}; break;
+            case Kind::Other: file = node::Other{}; break;
+            default: return Unexpect{ Errc::bad_message };
+            }
+
+            auto child = parent.build(*name, *stat, std::move(file));
+            if (not child) {
+                return Unexpect{ Errc::bad_message };
+            }
+
+            auto& node = child->get();
+            node.expires_after(Seconds{ 0 });
+            ++total;
+
+            if (*kind == Kind::Directory) {
+                node.set_synced(*synced != 0);
+                auto res = read_children(reader, node, depth + 1);
+                if (not res) {
+                    return Unexpect{ res.error() };
+                }
+                total += *res;
+            }
+        }
+
+        return total;
+    }
+}
+
+// tree_snapshot.hpp impl
+namespace madbfs::tree_snapshot
+{
+    Opt<std::filesystem::path> default_path(Str serial, path::Path root)
+    {
+        auto dir = std::filesystem::path{};
+        if (const auto* cache = std::getenv("XDG_CACHE_HOME"); cache != nullptr and *cache != '\0') {
+            dir = cache;
+        } else if (const auto* home = std::getenv("HOME"); home != nullptr and *home != '\0') {
+            dir = std::filesystem::path{ home } / ".cache";
+        } else {
+            return std::nullopt;
+        }
+
+        auto name = String{ serial };
+        if (not root.is_root()) {
+            sr::replace_copy(root.str(), std::back_inserter(name), '/', '%');
+        }
+
+        return dir / "madbfs" / fmt::format("{}.tree", name);
+    }
+
+    Expect<usize> save(const Node& root, const std::filesystem::path& file)
+    {
+        if (not root.is_directory()) {
+            return Unexpect{ Errc::not_a_directory };
+        }
+
+        auto writer = Writer{};
+        writer.buf.insert(writer.buf.end(), magic.begin(), magic.end());
+        writer.write(version);
+
+        auto count = write_node(writer, root, Kind::Directory);
+
+        auto ec = std::error_code{};
+        std::filesystem::create_directories(file.parent_path(), ec);
+        if (ec) {
+            log_e(__func__, "failed to create directory {:?}: {}", file.parent_path().c_str(), ec.message());
+            return Unexpect{ static_cast<Errc>(ec.value()) };
+        }
+
+        auto tmp = std::filesystem::path{ file }.concat(".tmp");
+        {
+            auto out = std::ofstream{ tmp, std::ios::binary | std::ios::trunc };
+            out.write(writer.buf.data(), static_cast<std::streamsize>(writer.buf.size()));
+            if (not out) {
+                log_e(__func__, "failed to write snapshot {:?}", tmp.c_str());
+                return Unexpect{ Errc::io_error };
+            }
+        }
+
+        std::filesystem::rename(tmp, file, ec);
+        if (ec) {
+            log_e(__func__, "failed to rename snapshot {:?}: {}", tmp.c_str(), ec.message());
+            return Unexpect{ static_cast<Errc>(ec.value()) };
+        }
+
+        log_i(__func__, "saved {} nodes [{} KiB] into {:?}", count, writer.buf.size() / 1024, file.c_str());
+        return count;
+    }
+
+    Expect<usize> load(Node& root, const std::filesystem::path& file)
+    {
+        auto dir = root.as_directory();
+        if (not dir) {
+            return Unexpect{ dir.error() };
+        } else if (not dir->get().children().empty()) {
+            return Unexpect{ Errc::directory_not_empty };
+        }
+
+        auto in = std::ifstream{ file, std::ios::binary | std::ios::ate };
+        if (not in) {
+            return Unexpect{ Errc::no_such_file_or_directory };
+        }
+
+        auto buf = Vec<char>(static_cast<usize>(in.tellg()));
+        in.seekg(0);
+        if (not in.read(buf.data(), static_cast<std::streamsize>(buf.size()))) {
+            log_e(__func__, "failed to read snapshot {:?}", file.c_str());
+            return Unexpect{ Errc::io_error };
+        }
+
+        auto reader = Reader{ .buf = buf };
+
+        auto header = reader.read<decltype(magic)>();
+        auto ver    = reader.read<u32>();
+        if (header != magic or ver != version) {
+            log_w(__func__, "snapshot {:?} has incompatible format, ignored", file.c_str());
+            return Unexpect{ Errc::bad_message };
+        }
+
+        auto kind   = reader.read<Kind>();
+        auto synced = reader.read<u8>();
+        auto name   = reader.read_str();
+        auto stat   = reader.read_stat();
+
+        if (kind != Kind::Directory or not synced or not name or not stat) {
+            log_w(__func__, "snapshot {:?} is corrupted, ignored", file.c_str());
+            return Unexpect{ Errc::bad_message };
+        }
+
+        auto res = read_children(reader, root, 0);
+        if (not res) {
+            log_w(__func__, "snapshot {:?} is corrupted, ignored", file.c_str());
+            dir->get().clear();
+            return Unexpect{ res.error() };
+        }
+
+        // root stat is replaced as well so the revalidation compares against the snapshot
+        root.set_stat(*stat);
+        root.set_synced(*synced != 0);
+        root.expires_after(Seconds{ 0 });
+
+        log_i(__func__, "loaded {} nodes from {:?}", *res, file.c_str());
+        return *res;
+    }
+}
@@ -0,0 +1,109 @@
+#include "madbfs/ttl_policy.hpp"
+
+#include <madbfs-common/util/split.hpp>
+
+#include <fnmatch.h>
+
+#include <charconv>
+
+namespace madbfs
+{
+    Expect<TtlPolicy> TtlPolicy::parse(Str spec)
+    {
+        auto policy = TtlPolicy{};
+
+        for (auto entry : util::split(spec, ';')) {
+            entry = util::strip(entry);
+            if (entry.empty()) {
+                continue;
+            }
+
+            auto eq = entry.rfind('=');
+            if (eq == Str::npos) {
+                return Unexpect{ Errc::invalid_argument };
+            }
+
+            auto pattern = util::strip(entry.substr(0, eq));
+            auto value   = util::strip(entry.substr(eq + 1));
+
+            auto sec       = 0l;
+            auto [ptr, ec] = std::from_chars(value.begin(), value.end(), sec);
+            if (ec != std::errc{} or ptr != value.end() or sec < 0) {
+                return Unexpect{ Errc::invalid_argument };
+            }
+
+            if (pattern.empty() or pattern.front() != '/') {
+                return Unexpect{ Errc::invalid_argument };
+            }
+
+            auto glob = pattern.find_first_of("*?[") != Str::npos;
+
+            // trailing slashes are meaningless for prefix, strip them except for root
+            if (not glob) {
+                while (pattern.size() > 1 and pattern.back() == '/') {
+                    pattern.remove_suffix(1);
+                }
+            }
+
+            policy.m_rules.push_back(Rule{
+                .pattern = String{ pattern },
+                .ttl     = sec == 0 ? std::nullopt : Opt<Seconds>{ sec },
+                .glob    = glob,
+            });
+        }
+
+        return policy;
+    }
+
+    Opt<Opt<Seconds>> TtlPolicy::match(path::Path path, path::Path root) const
+    {
+        auto str = path.str();
+
+        if (not root.is_root()) {
+            if (not str.starts_with(root.str())) {
+                return std::nullopt;
+            }
+            str.remove_prefix(root.str().size());
+            if (str.empty()) {
+                str = "/";
+            } else if (str.front() != '/') {
+                return std::nullopt;    // sibling of the root that shares its prefix
+            }
+        }
+
+        for (const auto& rule : m_rules) {
+            if (rule.glob) {
+                // Path is not guaranteed to be null-terminated
+                auto buf = String{ str };
+                if (::fnmatch(rule.pattern.c_str(), buf.c_str(), 0) == 0) {
+                    return rule.ttl;
+                }
+                continue;
+            }
+
+            if (rule.pattern == "/") {
+                return rule.ttl;
+            } else if (str.starts_with(rule.pattern)) {
+                auto rest = str.substr(rule.pattern.size());
+                if (rest.empty() or rest.front() == '/') {
+                    return rule.ttl;
+                }
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    String TtlPolicy::to_string() const
+    {
+        auto buf = String{};
+        for (const auto& rule : m_rules) {
+            if (not buf.empty()) {
+                buf += ';';
+            }
+            auto sec = rule.ttl.value_or(Seconds{ 0 }).count();
+            fmt::format_to(std::back_inserter(buf), "{}={}", rule.pattern, sec);
+        }
+        return buf;
+    }
+}
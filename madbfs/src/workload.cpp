@@ -0,0 +1,422 @@
+#include "madbfs/workload.hpp"
+
+#include "madbfs/filesystem.hpp"
+
+#include <madbfs-common/log.hpp>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+using namespace madbfs;
+
+// helper functions/classes
+namespace
+{
+    constexpr auto magic   = Array{ 'm', 'a', 'd', 'b', 'f', 's', 'W', 'L' };
+    constexpr auto version = u32{ 1 };
+
+    workload::Recorder g_recorder;
+
+    /**
+     * @brief Record kinds as written on the workload file.
+     */
+    enum class Tag : u8
+    {
+        Path = 1,
+        Op   = 2,
+    };
+
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    void write(Vec<char>& buf, T value)
+    {
+        auto bytes = std::bit_cast<Array<char, sizeof(T)>>(value);
+        buf.insert(buf.end(), bytes.begin(), bytes.end());
+    }
+
+    /**
+     * @class Reader
+     *
+     * @brief Simple binary reader, every read fails once the buffer is exhausted.
+     */
+    struct Reader
+    {
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        bool read(T& value)
+        {
+            if (buf.size() - offset < sizeof(T)) {
+                return false;
+            }
+            auto bytes = Array<char, sizeof(T)>{};
+            std::memcpy(bytes.data(), buf.data() + offset, sizeof(T));
+            offset += sizeof(T);
+            value   = std::bit_cast<T>(bytes);
+            return true;
+        }
+
+        bool read_str(String& str)
+        {
+            auto len = u32{};
+            if (not read(len) or buf.size() - offset < len) {
+                return false;
+            }
+            str.assign(buf.data() + offset, len);
+            offset += len;
+            return true;
+        }
+
+        bool read_entry(workload::Entry& e)
+        {
+            return read(e.op) and read(e.pid) and read(e.path) and read(e.path2) and read(e.flags)
+               and read(e.mode) and read(e.fh) and read(e.fh2) and read(e.offset) and read(e.offset2)
+               and read(e.size) and read(e.result) and read(e.start) and read(e.duration);
+        }
+
+        Span<const char> buf;
+        usize            offset = 0;
+    };
+
+    void write_entry(Vec<char>& buf, const workload::Entry& e)
+    {
+        write(buf, e.op);
+        write(buf, e.pid);
+        write(buf, e.path);
+        write(buf, e.path2);
+        write(buf, e.flags);
+        write(buf, e.mode);
+        write(buf, e.fh);
+        write(buf, e.fh2);
+        write(buf, e.offset);
+        write(buf, e.offset2);
+        write(buf, e.size);
+        write(buf, e.result);
+        write(buf, e.start);
+        write(buf, e.duration);
+    }
+
+    /**
+     * @brief Wait for a filesystem operation and turn its result into the value returned to FUSE.
+     *
+     * @param ctx Async context of the filesystem.
+     * @param coro The operation.
+     */
+    template <typename T>
+    i64 block(async::Context& ctx, AExpect<T> coro)
+    {
+        auto res = async::block(ctx, std::move(coro));
+        if (not res) {
+            return -static_cast<i64>(res.error());
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            return static_cast<i64>(*res);
+        } else {
+            return 0;
+        }
+    }
+
+    /**
+     * @brief Check whether an operation refers to an open handle.
+     *
+     * @param op The operation.
+     */
+    bool uses_fh(metrics::FuseOp op)
+    {
+        using Op = metrics::FuseOp;
+        return op == Op::Read or op == Op::Write or op == Op::Flush or op == Op::Release or op == Op::Lseek
+            or op == Op::CopyFileRange;
+    }
+}
+
+// workload.hpp impl
+namespace madbfs::workload
+{
+    Expect<Workload> load(const std::filesystem::path& file)
+    {
+        auto in = std::ifstream{ file, std::ios::binary | std::ios::ate };
+        if (not in) {
+            return Unexpect{ Errc::no_such_file_or_directory };
+        }
+
+        auto buf = Vec<char>(static_cast<usize>(in.tellg()));
+        in.seekg(0);
+        if (not in.read(buf.data(), static_cast<std::streamsize>(buf.size()))) {
+            log_e(__func__, "failed to read workload {:?}", file.c_str());
+            return Unexpect{ Errc::io_error };
+        }
+
+        auto reader = Reader{ .buf = buf };
+
+        auto header = decltype(magic){};
+        auto ver    = u32{};
+        if (not reader.read(header) or not reader.read(ver) or header != magic or ver != version) {
+            log_e(__func__, "{:?} is not a workload file", file.c_str());
+            return Unexpect{ Errc::bad_message };
+        }
+
+        auto workload = Workload{ .paths = { String{} }, .entries = {} };
+        auto tag      = Tag{};
+
+        while (reader.read(tag)) {
+            switch (tag) {
+            case Tag::Path: {
+                auto id   = u32{};
+                auto path = String{};
+                if (not reader.read(id) or not reader.read_str(path)) {
+                    break;
+                } else if (id != workload.paths.size()) {
+                    log_e(__func__, "path id out of order: {} (expects {})", id, workload.paths.size());
+                    return Unexpect{ Errc::bad_message };
+                }
+                workload.paths.push_back(std::move(path));
+                continue;
+            }
+            case Tag::Op: {
+                auto entry = Entry{};
+                if (not reader.read_entry(entry)) {
+                    break;
+                } else if (entry.path >= workload.paths.size() or entry.path2 >= workload.paths.size()) {
+                    log_e(__func__, "unknown path id on entry {}", workload.entries.size());
+                    return Unexpect{ Errc::bad_message };
+                } else if (static_cast<usize>(entry.op) >= metrics::fuse_op_count) {
+                    log_e(__func__, "unknown operation on entry {}", workload.entries.size());
+                    return Unexpect{ Errc::bad_message };
+                }
+                workload.entries.push_back(entry);
+                continue;
+            }
+            default: {
+                log_e(__func__, "unknown record tag: {}", std::to_underlying(tag));
+                return Unexpect{ Errc::bad_message };
+            }
+            }
+
+            log_w(__func__, "workload {:?} is truncated at byte {}", file.c_str(), reader.offset);
+            break;
+        }
+
+        return workload;
+    }
+
+    Opt<Pair<u64, u64>> Handles::map(const Entry& entry) const
+    {
+        auto lock   = std::scoped_lock{ m_mutex };
+        auto mapped = [&](u64 fh) -> Opt<u64> {
+            if (auto found = m_handles.find(fh); found != m_handles.end()) {
+                return found->second;
+            }
+            return std::nullopt;
+        };
+
+        auto fh  = uses_fh(entry.op) ? mapped(entry.fh) : Opt<u64>{ 0 };
+        auto fh2 = entry.op == metrics::FuseOp::CopyFileRange ? mapped(entry.fh2) : Opt<u64>{ 0 };
+        if (not fh or not fh2) {
+            return std::nullopt;
+        }
+
+        return Pair{ *fh, *fh2 };
+    }
+
+    void Handles::update(const Entry& entry, i64 result)
+    {
+        using Op = metrics::FuseOp;
+
+        auto lock = std::scoped_lock{ m_mutex };
+        if ((entry.op == Op::Open or entry.op == Op::Create) and entry.result >= 0 and result >= 0) {
+            m_handles[static_cast<u64>(entry.result)] = static_cast<u64>(result);
+        } else if (entry.op == Op::Release) {
+            m_handles.erase(entry.fh);
+        }
+    }
+
+    void Handles::clear()
+    {
+        auto lock = std::scoped_lock{ m_mutex };
+        m_handles.clear();
+    }
+
+    i64 issue(async::Context& ctx, Filesystem& fs, const Entry& e, Str path, Str path2, u64 fh, u64 fh2)
+    {
+        using Op = metrics::FuseOp;
+
+        thread_local auto buf = Vec<char>{};
+
+        auto p  = path::create_buf(path);
+        auto p2 = path::create_buf(path2);
+        if (not p or not p2) {
+            return -static_cast<i64>(EINVAL);
+        }
+
+        auto mode = static_cast<mode_t>(e.mode);
+        auto flag = static_cast<int>(e.flags);
+        auto now  = timespec{ .tv_sec = 0, .tv_nsec = UTIME_NOW };
+
+        switch (e.op) {
+        case Op::Getattr: return block(ctx, fs.getattr(*p));
+        case Op::Readlink: return block(ctx, fs.readlink(*p));
+        case Op::Mknod: return block(ctx, fs.mknod(*p, mode, 0));
+        case Op::Mkdir: return block(ctx, fs.mkdir(*p, mode | S_IFDIR));
+        case Op::Unlink: return block(ctx, fs.unlink(*p));
+        case Op::Rmdir: return block(ctx, fs.rmdir(*p));
+        case Op::Rename: return block(ctx, fs.rename(*p, *p2, e.flags));
+        case Op::Truncate: return block(ctx, fs.truncate(*p, e.offset));
+        case Op::Open: return block(ctx, fs.open(*p, flag));
+        case Op::Create: return block(ctx, fs.create(*p, mode, flag));
+        case Op::Read: {
+            buf.resize(std::max(buf.size(), e.size));
+            return block(ctx, fs.read(fh, { buf.data(), e.size }, e.offset));
+        }
+        case Op::Write: {
+            buf.resize(std::max(buf.size(), e.size), 'x');
+            return block(ctx, fs.write(fh, { buf.data(), e.size }, e.offset));
+        }
+        case Op::Flush: return block(ctx, fs.flush(fh));
+        case Op::Release: return block(ctx, fs.release(fh));
+        case Op::Readdir: {
+            return block(ctx, fs.readdir(*p, e.offset, [](const char*, off_t) { return false; }));
+        }
+        case Op::Utimens: return block(ctx, fs.utimens(*p, now, now));
+        case Op::Lseek: return block(ctx, fs.lseek(fh, e.offset, flag));
+        case Op::CopyFileRange: {
+            return block(ctx, fs.copy_file_range(*p, fh, e.offset, *p2, fh2, e.offset2, e.size));
+        }
+        }
+
+        return -static_cast<i64>(ENOSYS);
+    }
+
+    Expect<void> Recorder::start(const std::filesystem::path& file)
+    {
+        auto lock = std::scoped_lock{ m_mutex };
+        if (recording()) {
+            return Unexpect{ Errc::device_or_resource_busy };
+        }
+
+        m_out = std::ofstream{ file, std::ios::binary | std::ios::trunc };
+        if (not m_out) {
+            log_e(__func__, "failed to open workload file {:?}", file.c_str());
+            return Unexpect{ Errc::permission_denied };
+        }
+
+        m_file    = file;
+        m_origin  = SteadyClock::now();
+        m_entries = 0;
+        m_bytes   = 0;
+        m_paths.clear();
+        m_buf.clear();
+
+        m_buf.insert(m_buf.end(), magic.begin(), magic.end());
+        write(m_buf, version);
+
+        m_recording.store(true, std::memory_order_relaxed);
+        log_i(__func__, "recording workload into {:?}", file.c_str());
+
+        return {};
+    }
+
+    Expect<Recorder::Stats> Recorder::stop()
+    {
+        auto lock = std::scoped_lock{ m_mutex };
+        if (not recording()) {
+            return Unexpect{ Errc::invalid_argument };
+        }
+
+        m_recording.store(false, std::memory_order_relaxed);
+
+        auto ok = flush();
+        m_out.close();
+
+        auto stats = Stats{
+            .file    = m_file.string(),
+            .entries = m_entries,
+            .paths   = m_paths.size(),
+            .bytes   = m_bytes,
+        };
+
+        m_paths.clear();
+        m_buf = {};
+
+        log_i(__func__, "recorded {} operations [{} KiB] into {:?}", m_entries, m_bytes / 1024, stats.file);
+
+        if (not ok) {
+            return Unexpect{ Errc::io_error };
+        }
+        return stats;
+    }
+
+    void Recorder::record(
+        const Call&             call,
+        u32                     pid,
+        SteadyClock::time_point start,
+        SteadyClock::time_point end,
+        i64                     result
+    )
+    {
+        using std::chrono::duration_cast, std::chrono::microseconds;
+
+        auto lock = std::scoped_lock{ m_mutex };
+        if (not recording()) {
+            return;
+        }
+
+        auto micros   = [](SteadyClock::duration d) { return duration_cast<microseconds>(d).count(); };
+        auto duration = std::clamp<i64>(micros(end - start), 0, std::numeric_limits<u32>::max());
+
+        auto entry = Entry{
+            .op       = call.op,
+            .pid      = pid,
+            .path     = call.path.empty() ? 0 : intern(call.path),
+            .path2    = call.path2.empty() ? 0 : intern(call.path2),
+            .flags    = call.flags,
+            .mode     = call.mode,
+            .fh       = call.fh,
+            .fh2      = call.fh2,
+            .offset   = call.offset,
+            .offset2  = call.offset2,
+            .size     = call.size,
+            .result   = result,
+            .start    = static_cast<u64>(std::max<i64>(micros(start - m_origin), 0)),
+            .duration = static_cast<u32>(duration),
+        };
+
+        write(m_buf, Tag::Op);
+        write_entry(m_buf, entry);
+        ++m_entries;
+
+        if (m_buf.size() >= flush_threshold and not flush()) {
+            log_e(__func__, "failed to write workload file {:?}, recording stopped", m_file.c_str());
+            m_recording.store(false, std::memory_order_relaxed);
+            m_out.close();
+        }
+    }
+
+    u32 Recorder::intern(Str path)
+    {
+        auto [it, inserted] = m_paths.try_emplace(String{ path }, static_cast<u32>(m_paths.size() + 1));
+        if (inserted) {
+            write(m_buf, Tag::Path);
+            write(m_buf, it->second);
+            write(m_buf, static_cast<u32>(path.size()));
+            m_buf.insert(m_buf.end(), path.begin(), path.end());
+        }
+        return it->second;
+    }
+
+    bool Recorder::flush()
+    {
+        m_out.write(m_buf.data(), static_cast<std::streamsize>(m_buf.size()));
+        m_out.flush();
+
+        m_bytes += m_buf.size();
+        m_buf.clear();
+
+        return static_cast<bool>(m_out);
+    }
+
+    Recorder& recorder()
+    {
+        return g_recorder;
+    }
+}
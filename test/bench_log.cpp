@@ -0,0 +1,153 @@
+#include <madbfs-common/aliases.hpp>
+#include <madbfs-common/log.hpp>
+
+#include <spdlog/sinks/basic_file_sink.h>
+
+#include <charconv>
+#include <chrono>
+
+using namespace madbfs::aliases;
+
+namespace mlog = madbfs::log;
+
+/**
+ * @class Scenario
+ *
+ * @brief A logger setup to measure.
+ */
+struct Scenario
+{
+    Str         name;
+    bool        async;
+    mlog::Level level;
+};
+
+/**
+ * @class Result
+ *
+ * @brief Time spent by the callers and until every message is written, per operation.
+ */
+struct Result
+{
+    double caller  = 0.0;    // nanoseconds per operation
+    double drained = 0.0;    // nanoseconds per operation, including the time the messages are written
+    u64    dropped = 0;
+};
+
+/**
+ * @brief Simulate the logging of a hot path operation like a cache read.
+ *
+ * @param i Operation index.
+ */
+void operation(usize i)
+{
+    madbfs::log_d(__func__, "read [offset={}|size={}] of {:?}", i * 4096, 4096, "/sdcard/DCIM/Camera/a.jpg");
+    madbfs::log_t(__func__, "REQ QUEUED {} [{}]", i, "Read");
+}
+
+/**
+ * @brief Run the operation on several threads against a logger writing to /dev/null.
+ *
+ * @param scenario Logger setup.
+ * @param ops Number of operations per thread.
+ * @param threads Number of threads.
+ */
+Result run(const Scenario& scenario, usize ops, usize threads)
+{
+    auto sink   = std::make_shared<spdlog::sinks::basic_file_sink_mt>("/dev/null");
+    auto logger = Shared<spdlog::logger>{};
+
+    if (scenario.async) {
+        auto async = std::make_shared<mlog::AsyncLogger>("bench");
+        async->add_sink(sink);
+        async->start();
+        logger = async;
+    } else {
+        logger = std::make_shared<spdlog::logger>("bench", sink);
+    }
+
+    logger->set_pattern(mlog::logger_pattern);
+    logger->set_level(scenario.level);
+    spdlog::set_default_logger(logger);
+
+    auto start = SteadyClock::now();
+    {
+        auto workers = Vec<std::jthread>{};
+        for (auto t : sv::iota(0uz, threads)) {
+            workers.emplace_back([=] {
+                for (auto i : sv::iota(0uz, ops)) {
+                    operation(t * ops + i);
+                }
+            });
+        }
+    }
+    auto called = SteadyClock::now();
+    logger->flush();
+    auto drained = SteadyClock::now();
+
+    auto total = static_cast<double>(ops * threads);
+    auto nanos = [&](auto duration) {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    };
+
+    auto result = Result{
+        .caller  = nanos(called - start) / total,
+        .drained = nanos(drained - start) / total,
+    };
+
+    if (auto async = std::dynamic_pointer_cast<mlog::AsyncLogger>(logger); async) {
+        result.dropped = async->dropped();
+        async->stop();
+    }
+
+    spdlog::set_default_logger(std::make_shared<spdlog::logger>("none"));
+    return result;
+}
+
+Opt<usize> parse_arg(Str arg)
+{
+    auto value     = 0uz;
+    auto [ptr, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+    if (ec != std::errc{} or ptr != arg.data() + arg.size() or value == 0) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+int main(int argc, char** argv)
+{
+    auto ops     = argc > 1 ? parse_arg(argv[1]) : 200'000uz;
+    auto threads = argc > 2 ? parse_arg(argv[2]) : 4uz;
+
+    if (not ops or not threads) {
+        fmt::println(stderr, "usage: {} [ops per thread] [threads]", argv[0]);
+        return 1;
+    }
+
+    fmt::println(
+        "{} ops on {} threads, level floor '{}' (debug calls are {})\n",
+        *ops,
+        *threads,
+        mlog::level_to_str(mlog::level_floor),
+        mlog::level_floor > mlog::Level::debug ? "compiled out" : "compiled in"
+    );
+
+    auto scenarios = std::to_array<Scenario>({
+        { .name = "sync, debug enabled", .async = false, .level = mlog::Level::debug },
+        { .name = "async, debug enabled", .async = true, .level = mlog::Level::debug },
+        { .name = "sync, debug disabled", .async = false, .level = mlog::Level::info },
+        { .name = "async, debug disabled", .async = true, .level = mlog::Level::info },
+    });
+
+    fmt::println("{:<24} {:>12} {:>12} {:>10}", "scenario", "caller ns/op", "total ns/op", "dropped");
+    for (const auto& scenario : scenarios) {
+        auto result = run(scenario, *ops, *threads);
+        fmt::println(
+            "{:<24} {:>12.1f} {:>12.1f} {:>10}",
+            scenario.name,
+            result.caller,
+            result.drained,
+            result.dropped
+        );
+    }
+}
@@ -0,0 +1,83 @@
+#include <madbfs-cachesim/simulator.hpp>
+
+#include <boost/ut.hpp>
+
+#include <fcntl.h>
+
+namespace ut       = boost::ut;
+namespace workload = madbfs::workload;
+
+using namespace madbfs::aliases;
+
+using madbfs::cachesim::Config;
+using madbfs::cachesim::Device;
+using madbfs::cachesim::Link;
+using madbfs::cachesim::Simulator;
+using madbfs::metrics::FuseOp;
+
+/**
+ * @brief A workload that reads the same file twice through one handle, then lists its directory.
+ *
+ * The last read is on a handle opened before the recording started.
+ */
+workload::Workload synthetic()
+{
+    auto workload = workload::Workload{ .paths = { "", "/d", "/d/a" }, .entries = {} };
+    auto entries  = {
+        workload::Entry{ .op = FuseOp::Getattr, .path = 2 },
+        workload::Entry{ .op = FuseOp::Open, .path = 2, .flags = O_RDONLY, .result = 5 },
+        workload::Entry{ .op = FuseOp::Read, .fh = 5, .size = 4096, .result = 4096 },
+        workload::Entry{ .op = FuseOp::Read, .fh = 5, .size = 4096, .result = 4096 },
+        workload::Entry{ .op = FuseOp::Release, .fh = 5 },
+        workload::Entry{ .op = FuseOp::Readdir, .path = 1 },
+        workload::Entry{ .op = FuseOp::Read, .fh = 9, .size = 4096, .result = 4096 },
+    };
+
+    for (auto entry : entries) {
+        entry.start = workload.entries.size();
+        workload.entries.push_back(entry);
+    }
+
+    return workload;
+}
+
+int main()
+{
+    using namespace ut::literals;
+    using namespace ut::operators;
+    using ut::expect, ut::that;
+
+    "Device is inferred from the workload"_test = [] {
+        auto workload = synthetic();
+        auto device   = Device::infer(workload);
+
+        const auto& files = device.files();
+
+        expect((files.size() == 3uz) >> ut::fatal);
+        expect(files.at("/")->dir);
+        expect(files.at("/d")->dir);
+        expect(not files.at("/d/a")->dir);
+        expect(that % files.at("/d/a")->size == 4096);
+    };
+
+    "Simulated cache serves the repeated read"_test = [] {
+        auto workload  = synthetic();
+        auto device    = Device::infer(workload);
+        auto link      = Link{ .latency = 500, .bandwidth = 40.0 };
+        auto simulator = Simulator{ workload, device, link, Seconds{ 60 } };
+
+        auto uncached = simulator.run(std::nullopt);
+        expect(that % uncached.skipped == 1);
+        expect(that % uncached.requests > 0);
+        expect(that % uncached.fetched == 2 * 4096);
+        expect(that % uncached.cache.hits == 0);
+        expect(uncached.seconds > 0.0);
+
+        auto cached = simulator.run(Config{ .page_size = 64 * 1024, .max_pages = 16, .cache_size = 1 });
+        expect(that % cached.skipped == 1);
+        expect(that % cached.cache.misses >= 1);
+        expect(that % cached.cache.hits >= 1);
+        expect(that % cached.fetched < uncached.fetched);
+        expect(cached.hit_ratio() > 0.0);
+    };
+}
@@ -0,0 +1,135 @@
+#include <madbfs/fair_queue.hpp>
+
+#include <boost/ut.hpp>
+
+#include <unistd.h>
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace ut = boost::ut;
+using namespace madbfs::aliases;
+
+using madbfs::FairQueue;
+
+/**
+ * @brief Issue operations of several processes into a queue with a single slot and record the order they are
+ * admitted in.
+ *
+ * @param queue The queue.
+ * @param ops Name of the process of each operation, its first letter also serves as its pid.
+ *
+ * The slot is held while the operations are queued, so all of them contend.
+ */
+Vec<String> admission_order(FairQueue& queue, Vec<Str> ops)
+{
+    auto pid_of = [](Str name) { return static_cast<pid_t>(name.front()) + 100; };
+
+    auto mutex   = std::mutex{};
+    auto order   = Vec<String>{};
+    auto holder  = Opt<FairQueue::Ticket>{ queue.acquire({ .pid = 1, .name = "holder" }) };
+    auto workers = Vec<std::jthread>{};
+
+    for (auto name : ops) {
+        auto expected = queue.waiting() + 1;
+        workers.emplace_back([&, name] {
+            auto ticket = queue.acquire({ .pid = pid_of(name), .name = String{ name } });
+            auto lock   = std::scoped_lock{ mutex };
+            order.emplace_back(ticket.process());
+        });
+        while (queue.waiting() < expected) {
+            std::this_thread::yield();
+        }
+    }
+
+    holder.reset();
+    workers.clear();
+
+    return order;
+}
+
+int main()
+{
+    using namespace ut::literals;
+    using namespace ut::operators;
+    using ut::expect, ut::that;
+
+    "Weights parse from and round-trip through their string form"_test = [] {
+        auto weights = FairQueue::parse_weights(" tumbler = 1 ;; cp=16;ffmpegthumbnailer=1 ");
+        expect((weights.has_value()) >> ut::fatal);
+
+        expect(weights->size() == 3uz);
+        expect(weights->at("tumbler") == 1u);
+        expect(weights->at("cp") == 16u);
+        expect(weights->at("ffmpegthumbnailer") == 1u);
+
+        expect(FairQueue::to_string(*weights) == "cp=16;ffmpegthumbnailer=1;tumbler=1");
+        expect(FairQueue::parse_weights("").value().empty());
+        expect(FairQueue::parse_weights("cp=2;cp=3").value().at("cp") == 3u);
+    };
+
+    "Malformed weights are rejected"_test = [] {
+        for (auto spec : { "cp", "cp=", "=4", "cp=0", "cp=-1", "cp=4x", "cp=1.5" }) {
+            expect(not FairQueue::parse_weights(spec).has_value()) << spec;
+        }
+    };
+
+    "A process alone is not limited by the slots"_test = [] {
+        auto queue = FairQueue{ 1 };
+
+        auto first  = queue.acquire({ .pid = 10, .name = "cp" });
+        auto second = queue.acquire({ .pid = 10, .name = "cp" });
+
+        // another process has to wait for the slot now
+        auto admitted = std::atomic<bool>{ false };
+        auto other    = std::jthread{ [&] {
+            auto ticket = queue.acquire({ .pid = 20, .name = "tumbler" });
+            admitted    = true;
+        } };
+
+        while (queue.waiting() == 0) {
+            std::this_thread::yield();
+        }
+        expect(not admitted);
+
+        {
+            auto released = std::move(first);
+        }
+        expect(not admitted);
+        {
+            auto released = std::move(second);
+        }
+        other.join();
+        expect(admitted);
+    };
+
+    "Contending processes are interleaved instead of served in arrival order"_test = [] {
+        auto queue = FairQueue{ 1 };
+        auto order = admission_order(queue, { "a", "a", "a", "b" });
+        expect(order == Vec<String>{ "a", "b", "a", "a" });
+    };
+
+    "A process with a higher weight goes first"_test = [] {
+        auto queue = FairQueue{ 1 };
+        queue.set_weights(FairQueue::parse_weights("b=16").value());
+
+        auto order = admission_order(queue, { "a", "a", "a", "b" });
+        expect(order == Vec<String>{ "b", "a", "a", "a" });
+    };
+
+    "Threads are resolved to their process"_test = [] {
+        auto comm = std::ifstream{ "/proc/self/comm" };
+        auto name = String{};
+        std::getline(comm, name);
+
+        auto process = FairQueue::Process{};
+        std::jthread{ [&] { process = FairQueue::resolve(::gettid()); } }.join();
+
+        expect(that % process.pid == ::getpid());
+        expect(process.name == name);
+
+        expect(that % FairQueue::resolve(0).pid == 0);
+    };
+}
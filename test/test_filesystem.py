@@ -16,6 +16,7 @@ import errno
 import filecmp
 import json
 import logging
+import mmap
 import os
 import re
 import shutil
@@ -36,7 +37,7 @@ from subprocess import (
     TimeoutExpired,
     run,
 )
-from tempfile import NamedTemporaryFile
+from tempfile import NamedTemporaryFile, TemporaryDirectory
 
 import pytest
 
@@ -165,6 +166,7 @@ def environ(request) -> tuple[Environ, Case]:
         "-f",
         f"--log-file={log_path}",
         f"--log-level={DEFAULT_LOG_LEVEL}",
+        "--metrics=unix",
     ]
     if not request.param.use_server:
         mount_cmd.append("--no-server")
@@ -216,6 +218,15 @@ def ipc_connect(serial: str) -> socket:
     pytest.fail("failed to connect to socket")
 
 
+def ipc_request(serial: str, op: dict) -> dict:
+    with ipc_connect(serial) as sock:
+        Protocol.send(sock, json.dumps(op))
+        resp = Protocol.receive(sock)
+        assert resp is not None
+        logger.info(resp)
+        return json.loads(resp)
+
+
 def wait_for_mount(mount_process: Popen[str], mnt_dir: Path):
     elapsed = 0
     while elapsed < 30:
@@ -414,6 +425,29 @@ def tst_create(work_dir: Path):
     file.unlink()
 
 
+def tst_overwrite(work_dir: Path):
+    file = work_dir / name_generator()
+
+    with os_open(file, os.O_CREAT | os.O_EXCL | os.O_WRONLY) as fd:
+        os.write(fd, TEST_DATA)
+    assert file.stat().st_size == len(TEST_DATA)
+
+    with pytest.raises(OSError) as exc_info:
+        os.open(file, os.O_CREAT | os.O_EXCL | os.O_WRONLY)
+    assert exc_info.value.errno == errno.EEXIST
+
+    # open(O_TRUNC) on existing file must drop the old content (including the cached one)
+    with os_open(file, os.O_CREAT | os.O_TRUNC | os.O_WRONLY) as fd:
+        assert os.fstat(fd).st_size == 0
+        os.write(fd, b"foo\n")
+
+    assert file.stat().st_size == 4
+    with open(file, "rb") as fh:
+        assert fh.read() == b"foo\n"
+
+    file.unlink()
+
+
 def tst_append(work_dir: Path):
     file = work_dir / name_generator()
 
@@ -446,6 +480,104 @@ def tst_seek(work_dir: Path):
     file.unlink()
 
 
+def tst_seek_hole(work_dir: Path):
+    file = work_dir / name_generator()
+    size = 4 * 1024 * 1024
+    data_off = size // 2
+
+    os_create(file)
+    os.truncate(file, size)
+    with os_open(file, os.O_WRONLY) as fd:
+        os.lseek(fd, data_off, os.SEEK_SET)
+        os.write(fd, b"data")
+
+    # the device may not support sparse files, in that case the whole file is data
+    with os_open(file, os.O_RDONLY) as fd:
+        data = os.lseek(fd, 0, os.SEEK_DATA)
+        assert data <= data_off
+        hole = os.lseek(fd, data, os.SEEK_HOLE)
+        assert data_off < hole <= size
+
+        with pytest.raises(OSError) as exc_info:
+            os.lseek(fd, size, os.SEEK_DATA)
+        assert exc_info.value.errno == errno.ENXIO
+
+    # reads inside the holes must still be zeros
+    with open(file, "rb") as fh:
+        content = fh.read()
+    assert len(content) == size
+    assert content[data_off : data_off + 4] == b"data"
+    assert content.count(0) == size - 4
+
+    file.unlink()
+
+
+def tst_direct_io(work_dir: Path):
+    file = work_dir / name_generator()
+    block = 4096
+    size = 3 * 1024 * 1024 + 5 * block  # not a multiple of the stream chunk
+
+    # O_DIRECT needs an aligned buffer, mmap-ed memory is page aligned
+    data = os.urandom(size)
+    buf = mmap.mmap(-1, size)
+    buf.write(data)
+
+    with os_open(file, os.O_CREAT | os.O_WRONLY | os.O_DIRECT) as fd:
+        assert os.write(fd, buf) == size
+    assert file.stat().st_size == size
+
+    # written data must be visible to a cached handle
+    with open(file, "rb") as fh:
+        assert fh.read() == data
+
+    with os_open(file, os.O_RDONLY | os.O_DIRECT) as fd:
+        out = mmap.mmap(-1, size)
+        assert os.readv(fd, [out]) == size
+        assert out[:] == data
+
+        # random access is forwarded as is
+        part = mmap.mmap(-1, block)
+        assert os.preadv(fd, [part], 7 * block) == block
+        assert part[:] == data[7 * block : 8 * block]
+
+    file.unlink()
+
+
+def tst_copy_file_range(work_dir: Path):
+    src = work_dir / name_generator()
+    dst = work_dir / name_generator()
+    size = len(TEST_DATA)
+    page = DEFAULT_PAGE_SIZE * 1024
+
+    src.write_bytes(TEST_DATA)
+    with open(src, "rb") as fh:
+        assert fh.read() == TEST_DATA  # make the source pages resident
+
+    # page-aligned copy of the whole file, the copy is read right after
+    with os_open(src, os.O_RDONLY) as fd_in, os_open(dst, os.O_CREAT | os.O_RDWR) as fd_out:
+        copied = 0
+        while copied < size:
+            n = os.copy_file_range(fd_in, fd_out, size - copied, copied, copied)
+            assert n > 0
+            copied += n
+    assert dst.read_bytes() == TEST_DATA
+
+    # writing into the copy must not change the source
+    with open(dst, "r+b") as fh:
+        fh.write(b"x" * 10)
+    assert src.read_bytes() == TEST_DATA
+    assert dst.read_bytes() == b"x" * 10 + TEST_DATA[10:]
+
+    # unaligned copy over cached pages of the destination
+    with os_open(src, os.O_RDONLY) as fd_in, os_open(dst, os.O_RDWR) as fd_out:
+        assert os.copy_file_range(fd_in, fd_out, page, 1, page + 3) == page
+    expected = b"x" * 10 + TEST_DATA[10 : page + 3] + TEST_DATA[1 : page + 1] + TEST_DATA[2 * page + 3 :]
+    assert dst.read_bytes() == expected
+
+    src.unlink()
+    dst.unlink()
+
+
 def tst_mkdir(work_dir: Path):
     dir = work_dir / name_generator()
 
@@ -657,6 +789,230 @@ def tst_open_rename(work_dir: Path):
     file2.unlink()
 
 
+def tst_transfer(work_dir: Path, serial: str, mount_point: Path):
+    def wait(id: int) -> dict:
+        for _ in range(300):
+            resp = ipc_request(serial, {"op": "jobs"})
+            assert resp["status"] == "success"
+            job = next(job for job in resp["value"]["jobs"] if job["id"] == id)
+            if job["status"] != "running":
+                return job
+            time.sleep(0.1)
+        pytest.fail(f"job {id} is not finished")
+
+    src = work_dir / name_generator()
+    src.mkdir()
+    (src / "sub").mkdir()
+    (src / "a").write_bytes(TEST_DATA)
+    (src / "sub" / "b").write_bytes(TEST_DATA[:1000])
+    device = "/" + str(src.relative_to(mount_point))
+
+    with TemporaryDirectory() as tmp:
+        host = Path(tmp) / "pulled"
+
+        resp = ipc_request(serial, {"op": "pull", "value": {"device": device, "host": str(host)}})
+        assert resp["status"] == "success"
+        job = wait(resp["value"]["id"])
+        assert job["status"] == "done"
+        assert job["files"] == {"done": 2, "total": 2}
+        assert job["bytes"]["done"] == job["bytes"]["total"] == len(TEST_DATA) + 1000
+        assert (host / "a").read_bytes() == TEST_DATA
+        assert (host / "sub" / "b").read_bytes() == TEST_DATA[:1000]
+
+        # partially copied file is resumed only when asked to
+        resume = {"device": device, "host": str(host), "resume": True}
+        os.truncate(host / "a", len(TEST_DATA) // 2)
+        resp = ipc_request(serial, {"op": "pull", "value": resume})
+        assert resp["status"] == "success"
+        job = wait(resp["value"]["id"])
+        assert job["status"] == "done"
+        assert job["resume"]
+        assert (host / "a").read_bytes() == TEST_DATA
+
+        # a file that is not a prefix of the source is copied again even when resuming
+        (host / "a").write_bytes(bytes(len(TEST_DATA) // 2))
+        resp = ipc_request(serial, {"op": "pull", "value": resume})
+        assert resp["status"] == "success"
+        assert wait(resp["value"]["id"])["status"] == "done"
+        assert (host / "a").read_bytes() == TEST_DATA
+
+        # without resume, a file of the same size is overwritten instead of being considered done
+        (host / "a").write_bytes(bytes(len(TEST_DATA)))
+        resp = ipc_request(serial, {"op": "pull", "value": {"device": device, "host": str(host)}})
+        assert resp["status"] == "success"
+        assert wait(resp["value"]["id"])["status"] == "done"
+        assert (host / "a").read_bytes() == TEST_DATA
+
+        dst = work_dir / name_generator()
+        device = "/" + str(dst.relative_to(mount_point))
+
+        resp = ipc_request(serial, {"op": "push", "value": {"host": str(host), "device": device}})
+        assert resp["status"] == "success"
+        assert wait(resp["value"]["id"])["status"] == "done"
+        assert not filecmp.dircmp(host, dst).diff_files
+        assert (dst / "a").read_bytes() == TEST_DATA
+        assert (dst / "sub" / "b").read_bytes() == TEST_DATA[:1000]
+
+        resp = ipc_request(serial, {"op": "pull", "value": {"device": device, "host": "relative"}})
+        assert resp["status"] == "error"
+        assert resp["value"] == os.strerror(errno.EINVAL)
+
+        resp = ipc_request(serial, {"op": "cancel", "value": 1000000})
+        assert resp["status"] == "error"
+        assert resp["value"] == os.strerror(errno.ESRCH)
+
+    shutil.rmtree(src)
+    shutil.rmtree(dst)
+
+
+def tst_top(work_dir: Path, serial: str, use_cache: bool):
+    path = work_dir / "top.bin"
+    path.write_bytes(os.urandom(256 * 1024))
+
+    with ipc_connect(serial) as sock:
+        Protocol.send(sock, json.dumps({"op": "top"}))
+
+        # the frames are queued on the socket while reading
+        deadline = time.monotonic() + 2.5
+        while time.monotonic() < deadline:
+            path.read_bytes()
+            time.sleep(0.05)
+
+        frames = []
+        for _ in range(2):
+            resp = Protocol.receive(sock)
+            assert resp is not None
+            frames.append(json.loads(resp))
+
+    logger.info(frames)
+
+    for frame in frames:
+        assert frame["interval"] > 0
+        assert frame["transport"]["inflight"] >= 0
+        assert (frame["cache"] is not None) == use_cache
+
+    assert any("getattr" in frame["ops"] or "open" in frame["ops"] for frame in frames)
+    assert any(frame["processes"] for frame in frames)
+
+    path.unlink()
+
+
+def tst_trace(work_dir: Path, serial: str, use_server: bool):
+    path = work_dir / "trace.bin"
+
+    resp = ipc_request(serial, {"op": "set_trace_rate", "value": 1})
+    assert resp["status"] == "success"
+    assert resp["value"]["trace_rate"] == {"old": 0, "new": 1}
+
+    # written instead of read since reads may be served from the kernel page cache
+    ipc_request(serial, {"op": "trace"})  # drop what's recorded before
+    path.write_bytes(os.urandom(64 * 1024))
+
+    resp = ipc_request(serial, {"op": "trace"})
+    assert resp["status"] == "success"
+    logger.info(f"{len(resp['value']['traceEvents'])} trace events")
+
+    events = [e for e in resp["value"]["traceEvents"] if e["ph"] == "X"]
+    assert any(e["cat"] == "fuse" and e["name"] == "write" for e in events)
+    assert any(e["cat"] == "transport" for e in events) == use_server
+    assert any(e["cat"] == "server" for e in events) == use_server
+
+    resp = ipc_request(serial, {"op": "set_trace_rate", "value": 0})
+    assert resp["value"]["trace_rate"] == {"old": 1, "new": 0}
+
+    path.unlink()
+
+
+def tst_record(work_dir: Path, serial: str):
+    path = work_dir / "record.bin"
+
+    with TemporaryDirectory() as tmp:
+        workload = Path(tmp) / "workload.bin"
+
+        resp = ipc_request(serial, {"op": "record_start", "value": "relative.bin"})
+        assert resp["status"] == "error"
+
+        resp = ipc_request(serial, {"op": "record_start", "value": str(workload)})
+        assert resp["status"] == "success"
+
+        resp = ipc_request(serial, {"op": "record_start", "value": str(workload)})
+        assert resp["status"] == "error"
+
+        path.write_bytes(os.urandom(64 * 1024))
+        path.stat()
+        path.unlink()
+
+        resp = ipc_request(serial, {"op": "record_stop"})
+        assert resp["status"] == "success"
+        logger.info(resp["value"])
+
+        assert resp["value"]["file"] == str(workload)
+        assert resp["value"]["entries"] >= 3
+        assert resp["value"]["bytes"] == workload.stat().st_size
+        assert workload.read_bytes().startswith(b"madbfsWL")
+
+        resp = ipc_request(serial, {"op": "record_stop"})
+        assert resp["status"] == "error"
+
+
+def tst_cache_map(work_dir: Path, serial: str, mount_point: Path, use_cache: bool):
+    path = work_dir / name_generator()
+    device = "/" + str(path.relative_to(mount_point))
+
+    fd = os.open(path, os.O_RDWR | os.O_CREAT, 0o644)
+    try:
+        os.write(fd, os.urandom(64 * 1024))
+
+        resp = ipc_request(serial, {"op": "cache_map", "value": device})
+        if not use_cache:
+            assert resp["status"] == "error"
+            return
+
+        assert resp["status"] == "success"
+        logger.info(resp["value"])
+
+        files = resp["value"]["files"]
+        assert len(files) == 1
+
+        file = files[0]
+        assert file["path"].endswith(device)
+        assert file["map"][0] == "d"
+        assert file["resident"] >= 1 and file["dirty"] >= 1
+        assert file["writers"] >= 1 and file["pinned"]
+
+        resp = ipc_request(serial, {"op": "cache_map", "value": ""})
+        assert resp["status"] == "success"
+        assert any(f["path"] == file["path"] for f in resp["value"]["files"])
+    finally:
+        os.close(fd)
+        path.unlink()
+
+
+def tst_metrics(_: str, serial: str, use_cache: bool):
+    path = os.environ["XDG_RUNTIME_DIR"]
+
+    with socket(AF_UNIX, SOCK_STREAM) as sock:
+        sock.connect(f"{path}/madbfs-metrics@{serial}.sock")
+        sock.sendall(b"GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n")
+
+        resp = b""
+        while packet := sock.recv(4096):
+            resp += packet
+
+    head, _, body = resp.decode().partition("\r\n\r\n")
+    logger.info(head)
+
+    assert head.startswith("HTTP/1.1 200 OK")
+    assert "application/openmetrics-text" in head
+    assert body.endswith("# EOF\n")
+
+    assert "madbfs_mount_info{" in body
+    assert re.search(r"^madbfs_tree_nodes [1-9]", body, re.MULTILINE)
+    assert re.search(r"^madbfs_transport_requests_total [1-9]", body, re.MULTILINE)
+    assert re.search(r'^madbfs_fuse_latency_seconds_count\{op="getattr"\} [1-9]', body, re.MULTILINE)
+    assert ("madbfs_cache_hits_total" in body) == use_cache
+
+
 # first args is there just for symmetry, it's unused
 def tst_ipc(_: str, serial: str, custom_root: bool, use_server: bool, use_cache: bool):
     version_re = re.compile(r"^[0-9]+\.[0-9]+\.[0-9]+(-dev\+g[0-9a-f]{7})?$")
@@ -698,6 +1054,7 @@ def tst_ipc(_: str, serial: str, custom_root: bool, use_server: bool, use_cache:
         assert resp["value"]["log_level"] == DEFAULT_LOG_LEVEL
         assert resp["value"]["ttl"] == DEFAULT_TTL
         assert resp["value"]["timeout"] == timeout
+        assert resp["value"]["weights"] == ""
         if use_cache:
             assert resp["value"]["cache"] is not None
             assert resp["value"]["cache"]["page_size"] == DEFAULT_PAGE_SIZE
@@ -768,6 +1125,49 @@ def tst_ipc(_: str, serial: str, custom_root: bool, use_server: bool, use_cache:
         assert resp["value"]["ttl"]["old"] == DEFAULT_TTL
         assert resp["value"]["ttl"]["new"] == 20
 
+    with ipc_connect(serial) as sock:
+        policy = "/DCIM/Camera=5;/Android/media/*WhatsApp*=10;/system=0"
+        Protocol.send(sock, json.dumps({"op": "set_ttl_policy", "value": policy}))
+        resp = Protocol.receive(sock)
+        assert resp is not None
+        logger.info(resp)
+        resp = json.loads(resp)
+        assert resp["status"] == "success"
+        assert resp["value"]
+        assert resp["value"]["ttl_policy"]
+        assert resp["value"]["ttl_policy"]["old"] == ""
+        assert resp["value"]["ttl_policy"]["new"] == policy
+
+    with ipc_connect(serial) as sock:
+        Protocol.send(sock, json.dumps({"op": "set_ttl_policy", "value": "no-slash=5"}))
+        resp = Protocol.receive(sock)
+        assert resp is not None
+        logger.info(resp)
+        resp = json.loads(resp)
+        assert resp["status"] == "error"
+        assert resp["value"] == os.strerror(errno.EINVAL)
+
+    with ipc_connect(serial) as sock:
+        Protocol.send(sock, json.dumps({"op": "set_weights", "value": "tumbler=1; cp=16"}))
+        resp = Protocol.receive(sock)
+        assert resp is not None
+        logger.info(resp)
+        resp = json.loads(resp)
+        assert resp["status"] == "success"
+        assert resp["value"]
+        assert resp["value"]["weights"]
+        assert resp["value"]["weights"]["old"] == ""
+        assert resp["value"]["weights"]["new"] == "cp=16;tumbler=1"
+
+    with ipc_connect(serial) as sock:
+        Protocol.send(sock, json.dumps({"op": "set_weights", "value": "tumbler=0"}))
+        resp = Protocol.receive(sock)
+        assert resp is not None
+        logger.info(resp)
+        resp = json.loads(resp)
+        assert resp["status"] == "error"
+        assert resp["value"] == os.strerror(errno.EINVAL)
+
     with ipc_connect(serial) as sock:
         Protocol.send(sock, json.dumps({"op": "set_timeout", "value": 5}))
         resp = Protocol.receive(sock)
@@ -780,6 +1180,37 @@ def tst_ipc(_: str, serial: str, custom_root: bool, use_server: bool, use_cache:
         assert resp["value"]["timeout"]["old"] == timeout
         assert resp["value"]["timeout"]["new"] == 5
 
+    with ipc_connect(serial) as sock:
+        Protocol.send(sock, json.dumps({"op": "metrics"}))
+        resp = Protocol.receive(sock)
+        assert resp is not None
+        logger.info(resp)
+        resp = json.loads(resp)
+        assert resp["status"] == "success"
+        for name in ["getattr", "open", "read", "write", "release", "readdir"]:
+            op = resp["value"]["fuse"][name]
+            assert op["count"] > 0
+            assert op["errors"] <= op["count"]
+            assert op["p50"] <= op["p90"] <= op["p99"] <= op["max"]
+        for name in ["Listdir", "Open", "Close"]:
+            proc = resp["value"]["rpc"][name]
+            assert proc["count"] > 0
+            assert proc["p50"] <= proc["p90"] <= proc["p99"] <= proc["max"]
+
+    with ipc_connect(serial) as sock:
+        Protocol.send(sock, json.dumps({"op": "lag"}))
+        resp = Protocol.receive(sock)
+        assert resp is not None
+        logger.info(resp)
+        resp = json.loads(resp)
+        assert resp["status"] == "success"
+        lag = resp["value"]["lag"]
+        assert lag["count"] > 0
+        assert lag["p50"] <= lag["p90"] <= lag["p99"] <= lag["max"]
+        assert resp["value"]["depth"]["read_queue"] >= 0
+        for stall in resp["value"]["stalls"]:
+            assert stall["lag"] >= resp["value"]["threshold"]
+
     with ipc_connect(serial) as sock:
         Protocol.send(sock, json.dumps({"op": "set_log_level", "value": "info"}))
         resp = Protocol.receive(sock)
@@ -859,8 +1290,12 @@ def test_filesystem(environ):
         call(tst_open_write)
         call(tst_open_write_big)
         call(tst_create)
+        call(tst_overwrite)
         call(tst_append)
         call(tst_seek)
+        call(tst_seek_hole)
+        call(tst_direct_io)
+        call(tst_copy_file_range)
         call(tst_mkdir)
         call(tst_rmdir)
         call(tst_unlink)
@@ -872,6 +1307,12 @@ def test_filesystem(environ):
         call(tst_truncate_fd)
         call(tst_open_unlink)
         call(tst_open_rename)
+        call(tst_transfer, serial, mount_point)
+        call(tst_metrics, serial, use_cache)
+        call(tst_top, serial, use_cache)
+        call(tst_trace, serial, use_server)
+        call(tst_record, serial)
+        call(tst_cache_map, serial, mount_point, use_cache)
         call(tst_ipc, serial, custom_root, use_server, use_cache)
 
         logger.info(f"all tests complete in {time.perf_counter() - start_time}s")
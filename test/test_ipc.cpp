@@ -30,6 +30,21 @@ AExpect<boost::json::value> server_handler(ipc::FsOp op)
     };
 }
 
+// number of frames produced since watched, the first one is null
+std::atomic<int> g_top_frames = -1;
+
+boost::json::value server_top(bool watched)
+{
+    if (not watched) {
+        g_top_frames = -1;
+        return nullptr;
+    }
+    if (++g_top_frames == 0) {
+        return nullptr;
+    }
+    return boost::json::value{ { "frame", g_top_frames.load() } };
+}
+
 template <typename Var>
 constexpr Opt<Str> variant_name_from_index(usize index)
 {
@@ -66,7 +81,7 @@ int main()
     fs::remove(socket_path);
 
     auto server = ipc::Server::create(context, socket_path);
-    async::spawn(context, server->launch(server_handler), async::detached);
+    async::spawn(context, server->launch(server_handler, server_top), async::detached);
 
     "ipc client-server communication should still work even in high traffic"_test = [&] {
         constexpr auto multiplier   = 200uz;
@@ -120,6 +135,41 @@ int main()
         fmt::println("duration: {} ({} per ops)", to_sec(duration), to_ms(duration / ops.size()));
     };
 
+    "ipc top should stream frames every second until the subscriber is gone"_test = [&] {
+        {
+            auto client = ipc::Client::create(context, socket_path);
+            expect(client.has_value() >> fatal);
+
+            auto frames = sync_wait(client->top());
+            expect(frames.has_value() >> fatal);
+
+            auto prev = 0;
+            for (auto awaitable : *frames) {
+                auto frame = sync_wait(std::move(awaitable));
+                expect(frame.has_value() >> fatal);
+
+                auto number = boost::json::parse(*frame).at("frame").to_number<int>();
+                expect(number > prev) << "frames must be produced in order, skipping the null ones";
+                prev = number;
+
+                if (number == 2) {
+                    break;
+                }
+            }
+
+            client->stop();
+        }
+
+        // the producer must be told once the subscriber is gone, noticed on the next send
+        for (auto _ : sv::iota(0, 30)) {
+            if (g_top_frames == -1) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 100 });
+        }
+        expect(that % g_top_frames.load() == -1);
+    };
+
     guard.reset();
     context.stop();
 }
@@ -0,0 +1,130 @@
+#include <madbfs-common/aliases.hpp>
+#include <madbfs-common/log.hpp>
+
+#include <boost/ut.hpp>
+#include <spdlog/sinks/base_sink.h>
+
+#include <algorithm>
+#include <atomic>
+
+namespace ut = boost::ut;
+using namespace madbfs::aliases;
+
+using madbfs::log::AsyncLogger;
+
+/**
+ * @class CaptureSink
+ *
+ * @brief Sink that keeps the payload of every message, optionally blocking on the first one until released.
+ */
+class CaptureSink final : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+    CaptureSink(bool block = false)
+        : m_blocked{ block }
+    {
+    }
+
+    Vec<String> messages()
+    {
+        auto lock = std::scoped_lock{ this->mutex_ };
+        return m_messages;
+    }
+
+    void wait_blocked() { m_entered.wait(false); }
+
+    void release()
+    {
+        m_blocked = false;
+        m_blocked.notify_all();
+    }
+
+protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override
+    {
+        m_messages.emplace_back(msg.payload.begin(), msg.payload.end());
+
+        m_entered = true;
+        m_entered.notify_all();
+        m_blocked.wait(true);
+    }
+
+    void flush_() override { /* do nothing */ }
+
+private:
+    Vec<String>       m_messages;
+    std::atomic<bool> m_blocked = false;
+    std::atomic<bool> m_entered = false;
+};
+
+int main()
+{
+    using namespace ut::literals;
+    using namespace ut::operators;
+    using ut::expect, ut::that;
+
+    "Async logger must write directly before it's started"_test = [] {
+        auto sink   = std::make_shared<CaptureSink>();
+        auto logger = std::make_shared<AsyncLogger>("test-direct");
+        logger->add_sink(sink);
+
+        logger->info("before {}", 1);
+        expect((sink->messages().size() == 1uz) >> ut::fatal);
+        expect(sink->messages()[0] == "before 1");
+    };
+
+    "Async logger must write every message in order once flushed"_test = [] {
+        auto sink   = std::make_shared<CaptureSink>();
+        auto logger = std::make_shared<AsyncLogger>("test-order");
+        logger->add_sink(sink);
+        logger->start();
+
+        for (auto i : sv::iota(0, 1000)) {
+            logger->info("message {}", i);
+        }
+        logger->flush();
+
+        auto messages = sink->messages();
+        expect((messages.size() == 1000uz) >> ut::fatal);
+        expect(messages.front() == "message 0");
+        expect(messages.back() == "message 999");
+        expect(that % logger->dropped() == 0);
+    };
+
+    "Async logger must drop messages instead of blocking when the ring buffer is full"_test = [] {
+        auto sink   = std::make_shared<CaptureSink>(true);
+        auto logger = std::make_shared<AsyncLogger>("test-full");
+        logger->add_sink(sink);
+        logger->start();
+
+        logger->info("first");
+        sink->wait_blocked();    // the first message is popped, the ring buffer is empty again
+
+        for (auto i : sv::iota(0uz, AsyncLogger::capacity + 10)) {
+            logger->info("message {}", i);
+        }
+        expect(that % logger->dropped() == 10);
+
+        sink->release();
+        logger->stop();
+
+        // the drop is reported after the batch the first message is written in
+        auto messages = sink->messages();
+        expect((messages.size() == AsyncLogger::capacity + 2) >> ut::fatal);
+        expect(messages[1] == "message 0");
+        expect(that % sr::count(messages, "dropped 10 messages, log buffer is full") == 1);
+    };
+
+    "Levels below the floor are raised to it"_test = [] {
+        namespace mlog = madbfs::log;
+
+        auto prev = mlog::get_level();
+        auto set  = mlog::set_level(mlog::Level::trace);
+
+        expect(set == std::max(mlog::Level::trace, mlog::level_floor));
+        expect(mlog::get_level() == set);
+        expect(mlog::set_level(mlog::Level::off) == mlog::Level::off);
+
+        mlog::set_level(prev);
+    };
+}
@@ -0,0 +1,260 @@
+#include <madbfs/metrics.hpp>
+#include <madbfs/trace.hpp>
+
+#include <boost/ut.hpp>
+
+#include <thread>
+
+namespace ut = boost::ut;
+using namespace madbfs::aliases;
+
+using madbfs::metrics::Activity;
+using madbfs::metrics::Histogram;
+using madbfs::metrics::Loop;
+
+namespace trace = madbfs::trace;
+
+int main()
+{
+    using namespace ut::literals;
+    using namespace ut::operators;
+    using ut::expect, ut::that;
+
+    "Small values must have a bucket each"_test = [] {
+        for (auto value : sv::iota(0uz, 1uz << Histogram::sub_bits)) {
+            expect(that % Histogram::bucket_of(value) == value);
+            expect(that % Histogram::highest_of(Histogram::bucket_of(value)) == value);
+        }
+    };
+
+    "Value must fall within the bounds of its bucket"_test = [] {
+        auto prev_bucket = 0uz;
+        for (auto value = 1uz; value < (1uz << 20); value = value * 9 / 8 + 1) {
+            auto bucket  = Histogram::bucket_of(value);
+            auto highest = Histogram::highest_of(bucket);
+
+            expect(bucket >= prev_bucket) << "buckets must be monotonic";
+            expect(value <= highest) << value << " is above bucket " << bucket;
+            expect(highest - value <= value / 8) << value << " has relative error above 12.5%";
+
+            prev_bucket = bucket;
+        }
+    };
+
+    "Huge values must be put into the last bucket"_test = [] {
+        expect(that % Histogram::bucket_of(~0ul) == Histogram::bucket_count - 1);
+        expect(that % Histogram::bucket_of(1ul << (Histogram::max_exp + 1)) == Histogram::bucket_count - 1);
+    };
+
+    "Empty histogram must summarize to zeroes"_test = [] {
+        auto histogram = std::make_unique<Histogram>();
+        auto summary   = histogram->summary();
+
+        expect(that % summary.count == 0);
+        expect(that % summary.p99 == 0);
+        expect(that % summary.max == 0);
+    };
+
+    "Summary must report percentiles, errors, and max"_test = [] {
+        auto histogram = std::make_unique<Histogram>();
+
+        for (auto value : sv::iota(1uz, 1001uz)) {
+            histogram->record(value, value % 10 == 0);
+        }
+
+        auto summary = histogram->summary();
+
+        expect(that % summary.count == 1000);
+        expect(that % summary.errors == 100);
+        expect(that % summary.max == 1000);
+        expect(that % summary.sum == 500500);
+        expect(summary.p50 >= 500 and summary.p50 <= 500 + 500 / 8) << summary.p50;
+        expect(summary.p90 >= 900 and summary.p90 <= 900 + 900 / 8) << summary.p90;
+        expect(summary.p99 >= 990 and summary.p99 <= 1000) << summary.p99;
+    };
+
+    "Cumulative counts must only include whole buckets"_test = [] {
+        auto histogram = std::make_unique<Histogram>();
+
+        for (auto value : sv::iota(0uz, 100uz)) {
+            histogram->record(value, false);
+        }
+
+        auto bounds = Array<u64, 4>{ 7, 63, 99, 1000 };
+        auto counts = histogram->count_below(bounds);
+
+        expect(that % counts.size() == bounds.size());
+        expect(that % counts[0] == 8);
+        expect(that % counts[1] == 64);
+        expect(counts[2] <= 100 and counts[2] >= 96) << counts[2];
+        expect(that % counts[3] == 100);
+    };
+
+    "Cumulative counts of a snapshot must not exceed its count while recording"_test = [] {
+        auto histogram = std::make_unique<Histogram>();
+        auto recorder  = std::jthread{ [&](std::stop_token stop) {
+            for (auto i = 0_u64; not stop.stop_requested(); ++i) {
+                histogram->record(i % 1000, false);
+            }
+        } };
+
+        auto bounds = Array<u64, 2>{ 100, 1'000'000 };
+        for (auto i = 0; i < 1000; ++i) {
+            auto snapshot = histogram->snapshot();
+            auto counts   = snapshot.count_below(bounds);
+            expect(that % counts[1] == snapshot.summary().count);
+        }
+    };
+
+    "Recordings from many threads must all be counted"_test = [] {
+        auto histogram = std::make_unique<Histogram>();
+        auto threads   = Vec<std::jthread>{};
+
+        for (auto i : sv::iota(0uz, 32uz)) {
+            threads.emplace_back([&, i] {
+                for (auto j : sv::iota(0uz, 1000uz)) {
+                    histogram->record(i * 1000 + j, false);
+                }
+            });
+        }
+        threads.clear();
+
+        auto summary = histogram->summary();
+
+        expect(that % summary.count == 32000);
+        expect(that % summary.errors == 0);
+        expect(that % summary.max == 31999);
+    };
+
+    "Activity must not be recorded unless enabled"_test = [] {
+        auto activity = std::make_unique<Activity>();
+
+        activity->record_io("/a", 100, false);
+        activity->record_op("cp");
+
+        auto window = activity->take();
+        expect(window.path_bytes.empty());
+        expect(window.process_ops.empty());
+        expect(that % window.read_bytes == 0);
+    };
+
+    "Activity window must be restarted on take"_test = [] {
+        auto activity = std::make_unique<Activity>();
+        activity->set_enabled(true);
+
+        activity->record_io("/a", 100, false);
+        activity->record_io("/a", 50, true);
+        activity->record_io("/b", 10, false);
+        activity->record_op("cp");
+        activity->record_op("cp");
+        activity->record_op("tumbler");
+
+        auto window = activity->take();
+        expect(that % window.path_bytes.at("/a") == 150);
+        expect(that % window.path_bytes.at("/b") == 10);
+        expect(that % window.process_ops.at("cp") == 2);
+        expect(that % window.process_ops.at("tumbler") == 1);
+        expect(that % window.read_bytes == 110);
+        expect(that % window.write_bytes == 50);
+
+        auto next = activity->take();
+        expect(next.path_bytes.empty());
+        expect(that % next.read_bytes == 0);
+    };
+
+    "Activity must put keys over the limit together"_test = [] {
+        auto activity = std::make_unique<Activity>();
+        activity->set_enabled(true);
+
+        for (auto i : sv::iota(0uz, Activity::max_keys + 10)) {
+            activity->record_io(fmt::format("/file-{}", i), 1, false);
+        }
+
+        auto window = activity->take();
+        expect(that % window.path_bytes.size() == Activity::max_keys + 1);
+        expect(that % window.path_bytes.at(madbfs::String{ Activity::other_key }) == 10);
+    };
+
+    "Loop must only keep lags above the stall threshold"_test = [] {
+        auto loop = std::make_unique<Loop>();
+
+        loop->record(1'000, {});
+        loop->record(Loop::stall_threshold, { .transport_queued = 3, .read_queue = 2 });
+
+        auto summary = loop->lag().summary();
+        expect(that % summary.count == 2);
+
+        auto stalls = loop->stalls();
+        expect((stalls.size() == 1uz) >> ut::fatal);
+        expect(that % stalls[0].lag == Loop::stall_threshold);
+        expect(that % stalls[0].depth.transport_queued == 3);
+        expect(that % stalls[0].depth.read_queue == 2);
+    };
+
+    "Loop must keep the latest stalls in order"_test = [] {
+        auto loop = std::make_unique<Loop>();
+
+        for (auto i : sv::iota(1uz, Loop::max_stalls + 11)) {
+            loop->record(Loop::stall_threshold + i, {});
+        }
+
+        auto stalls = loop->stalls();
+        expect(that % stalls.size() == Loop::max_stalls);
+        expect(that % stalls.front().lag == Loop::stall_threshold + 11);
+        expect(that % stalls.back().lag == Loop::stall_threshold + Loop::max_stalls + 10);
+    };
+
+    "Tracing must sample nothing unless a rate is set"_test = [] {
+        auto recorder = std::make_unique<trace::Recorder>();
+
+        for (auto _ : sv::iota(0, 100)) {
+            expect(not recorder->start().sampled());
+        }
+    };
+
+    "Tracing must sample one in every rate operations"_test = [] {
+        auto recorder = std::make_unique<trace::Recorder>();
+        recorder->set_rate(10);
+
+        auto ids = Vec<u64>{};
+        for (auto _ : sv::iota(0, 100)) {
+            if (auto context = recorder->start(); context.sampled()) {
+                ids.push_back(context.id());
+            }
+        }
+
+        expect(that % ids.size() == 10);
+        expect(that % ids.front() == 10);
+        expect(that % ids.back() == 100);
+    };
+
+    "Trace recorder must keep the latest spans in order"_test = [] {
+        auto recorder = std::make_unique<trace::Recorder>();
+
+        auto count = trace::Recorder::max_spans + 10;
+        for (auto i : sv::iota(1uz, count + 1)) {
+            recorder->record({ .trace = i, .name = "read", .category = "fuse", .side = trace::Side::Client });
+        }
+
+        auto events = recorder->take();
+        expect(that % events.size() == trace::Recorder::max_spans);
+        expect(that % events.front().trace == 11);
+        expect(that % events.back().trace == count);
+        expect(recorder->take().empty());
+    };
+
+    "Trace scope must only be recorded if sampled"_test = [] {
+        std::ignore = trace::recorder().take();
+
+        {
+            auto unsampled = trace::Scope{ trace::Context{}, "evict", "cache" };
+            auto sampled   = trace::Scope{ trace::Context{ 7 }, "evict", "cache" };
+        }
+
+        auto events = trace::recorder().take();
+        expect((events.size() == 1uz) >> ut::fatal);
+        expect(that % events[0].trace == 7);
+        expect(events[0].name == "evict");
+        expect(events[0].end >= events[0].start);
+    };
+}
@@ -46,6 +46,8 @@ rpc::Request create_dummy_request(rpc::Procedure proc, Vec<u8>& buf)
     case Proc::Close         : return req::Close         { }; break;
     case Proc::Read          : return req::Read          { }; break;
     case Proc::Write         : return req::Write         { }; break;
+    case Proc::StatPath      : return req::StatPath      { }; break;
+    case Proc::Lseek         : return req::Lseek         { }; break;
     case Proc::Ping          : return req::Ping          { }; break;
     default                  : return req::Ping          { }; break;
     }
@@ -74,6 +76,8 @@ rpc::Response create_dummy_response(rpc::Procedure proc)
     case Proc::Close         : return resp::Close         { }; break;
     case Proc::Read          : return resp::Read          { }; break;
     case Proc::Write         : return resp::Write         { }; break;
+    case Proc::StatPath      : return resp::StatPath      { }; break;
+    case Proc::Lseek         : return resp::Lseek         { }; break;
     case Proc::Ping          : return resp::Ping          { }; break;
     default                  : return resp::Ping          { }; break;
     }
@@ -160,7 +164,7 @@ Await<void> echo_response()
         }
 
         auto payload_buf = Vec<u8>{};
-        std::ignore      = co_await rpc::send_response(*sock, payload_buf, *resp, header->id);
+        std::ignore = co_await rpc::send_response(*sock, payload_buf, *resp, header->id, header->timing);
     }
 }
 
@@ -201,6 +205,8 @@ int main()
         ut::expect(Request{ req::Read         {} }.proc() == Procedure::Read         );
         ut::expect(Request{ req::Write        {} }.proc() == Procedure::Write        );
         ut::expect(Request{ req::Ping         {} }.proc() == Procedure::Ping         );
+        ut::expect(Request{ req::StatPath     {} }.proc() == Procedure::StatPath     );
+        ut::expect(Request{ req::Lseek        {} }.proc() == Procedure::Lseek        );
         // clang-format on
 
         // clang-format off
@@ -220,7 +226,13 @@ int main()
         ut::expect(Response{ resp::Read         {} }.proc() == Procedure::Read         );
         ut::expect(Response{ resp::Write        {} }.proc() == Procedure::Write        );
         ut::expect(Response{ resp::Ping         {} }.proc() == Procedure::Ping         );
+        ut::expect(Response{ resp::StatPath     {} }.proc() == Procedure::StatPath     );
+        ut::expect(Response{ resp::Lseek        {} }.proc() == Procedure::Lseek        );
         // clang-format on
+
+        // peers of an older version only understand the procedures up to `Ping`, their values must not move
+        ut::expect(std::to_underlying(Procedure::Write) == 14);
+        ut::expect(std::to_underlying(Procedure::Ping) == 15);
     };
 
     "Request should survive roundtrip"_test = [&] {
@@ -332,6 +344,107 @@ int main()
         }
     };
 
+    "Partial StatPath response should keep its status after roundtrip"_test = [&] {
+        using namespace rpc;
+
+        auto socket = async::block(context, connect(echo_response_port));
+
+        auto id       = Id{ 43 };
+        auto buffer   = Vec<u8>{};
+        auto response = resp::StatPath{
+            .stats = Vec<resp::Stat>{
+                resp::Stat{ .size = 4096, .links = 2, .mode = S_IFDIR | 0755, .uid = 1000, .gid = 1000 },
+                resp::Stat{ .size = 3452, .links = 3, .mode = S_IFDIR | 0700, .uid = 1000, .gid = 1000 },
+            },
+            .status = Status::permission_denied,
+        };
+
+        std::ignore = async::block(context, rpc::send_response(socket, buffer, response, id));
+
+        auto header = async::block(context, rpc::receive_response_header(socket));
+        ut::expect(header.has_value() >> ut::fatal);
+
+        auto dummy_buf = Vec<u8>{};
+        auto dummy     = create_dummy_request(header->proc, dummy_buf);
+
+        auto roundtrip = async::block(context, rpc::receive_response(socket, buffer, *header, dummy));
+        ut::expect(roundtrip.has_value() >> ut::fatal);
+        ut::expect(roundtrip->proc() == Procedure::StatPath);
+
+        auto underlying = std::get<resp::StatPath>(*roundtrip);
+        ut::expect(underlying.status == Status::permission_denied);
+        ut::expect((underlying.stats.size() == 2uz) >> ut::fatal);
+
+        for (auto i : sv::iota(0uz, underlying.stats.size())) {
+            ut::expect(response.stats[i].size == underlying.stats[i].size);
+            ut::expect(response.stats[i].links == underlying.stats[i].links);
+            ut::expect(response.stats[i].mode == underlying.stats[i].mode);
+        }
+    };
+
+    "Close response should keep its optional stat after roundtrip"_test = [&] {
+        using namespace rpc;
+
+        auto socket = async::block(context, connect(echo_response_port));
+
+        auto stat  = resp::Stat{ .size = 1024, .mode = S_IFREG | 0644 };
+        auto stats = Array{ Opt<resp::Stat>{}, Opt<resp::Stat>{ stat } };
+
+        for (auto maybe_stat : stats) {
+            auto id       = Id{ 44 };
+            auto buffer   = Vec<u8>{};
+            auto response = resp::Close{ .stat = maybe_stat };
+
+            std::ignore = async::block(context, rpc::send_response(socket, buffer, response, id));
+
+            auto header = async::block(context, rpc::receive_response_header(socket));
+            ut::expect(header.has_value() >> ut::fatal);
+
+            auto dummy_buf = Vec<u8>{};
+            auto dummy     = create_dummy_request(header->proc, dummy_buf);
+
+            auto roundtrip = async::block(context, rpc::receive_response(socket, buffer, *header, dummy));
+            ut::expect(roundtrip.has_value() >> ut::fatal);
+            ut::expect(roundtrip->proc() == Procedure::Close);
+
+            auto underlying = std::get<resp::Close>(*roundtrip);
+            ut::expect((underlying.stat.has_value() == maybe_stat.has_value()) >> ut::fatal);
+            if (maybe_stat) {
+                ut::expect(underlying.stat->size == stat.size);
+                ut::expect(underlying.stat->mode == stat.mode);
+            }
+        }
+    };
+
+    "Traced response should carry server timing after roundtrip"_test = [&] {
+        using namespace rpc;
+
+        auto socket = async::block(context, connect(echo_response_port));
+
+        auto id       = Id{ 45 }.with_trace(true);
+        auto buffer   = Vec<u8>{};
+        auto response = resp::Write{ .size = 4096 };
+        auto timing   = Timing{ .queue = 120, .exec = 3456 };
+
+        ut::expect(id.traced());
+        ut::expect(id.with_trace(false).inner() == 45u);
+
+        std::ignore = async::block(context, rpc::send_response(socket, buffer, response, id, timing));
+
+        auto header = async::block(context, rpc::receive_response_header(socket));
+        ut::expect(header.has_value() >> ut::fatal);
+        ut::expect(header->id == id);
+        ut::expect(header->timing.queue == timing.queue);
+        ut::expect(header->timing.exec == timing.exec);
+
+        auto dummy_buf = Vec<u8>{};
+        auto dummy     = create_dummy_request(header->proc, dummy_buf);
+
+        auto roundtrip = async::block(context, rpc::receive_response(socket, buffer, *header, dummy));
+        ut::expect(roundtrip.has_value() >> ut::fatal);
+        ut::expect(std::get<resp::Write>(*roundtrip).size == response.size);
+    };
+
     guard.reset();
     context.stop();
 }
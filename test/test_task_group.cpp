@@ -0,0 +1,61 @@
+#include <madbfs/task_group.hpp>
+
+#include <boost/ut.hpp>
+
+namespace ut    = boost::ut;
+namespace async = madbfs::async;
+namespace net   = madbfs::net;
+
+using namespace madbfs::aliases;
+
+using madbfs::Await;
+using madbfs::TaskGroup;
+
+int main()
+{
+    using namespace ut::literals;
+    using namespace ut::operators;
+    using ut::expect, ut::that;
+
+    "Waiting on an empty group returns right away"_test = [] {
+        auto group = TaskGroup{};
+        auto done  = false;
+
+        async::once([&] -> Await<void> {
+            co_await group.wait();
+            done = true;
+        }());
+
+        expect(done);
+    };
+
+    "Waiters are woken up by the last task to leave"_test = [] {
+        auto context = async::Context{};
+        auto group   = TaskGroup{};
+        auto woken   = 0uz;
+
+        group.enter();
+        group.enter();
+
+        auto waiter = [&] -> Await<void> {
+            co_await group.wait();
+            ++woken;
+        };
+        async::spawn(context, waiter(), async::detached);
+        async::spawn(context, waiter(), async::detached);
+
+        async::once(context, [&] -> Await<void> {
+            co_await net::post(co_await async::current_executor(), async::use_awaitable);
+
+            group.leave();
+            co_await net::post(co_await async::current_executor(), async::use_awaitable);
+            expect(that % woken == 0);
+            expect(that % group.count() == 1);
+
+            group.leave();
+        }());
+
+        expect(that % woken == 2);
+        expect(that % group.count() == 0);
+    };
+}
@@ -10,6 +10,10 @@
 #include <spdlog/sinks/null_sink.h>
 #include <spdlog/spdlog.h>
 
+#include <fcntl.h>
+
+#include <filesystem>
+#include <map>
 #include <source_location>
 
 namespace ut = boost::ext::ut;
@@ -171,7 +175,7 @@ namespace mock
 
         Await<void> start() override { co_return; };
 
-        AExpect<rpc::Response> send(rpc::Request req) override
+        AExpect<rpc::Response> send(rpc::Request req, trace::Context /* trace */) override
         {
             using namespace rpc;
             co_return req.visit(Overload{
@@ -191,6 +195,8 @@ namespace mock
                 [] (const req::Close&        ) -> rpc::Response { return resp::Close        {}; },
                 [] (const req::Read&         ) -> rpc::Response { return resp::Read         {}; },
                 [] (const req::Write&        ) -> rpc::Response { return resp::Write        {}; },
+                [] (const req::StatPath&     ) -> rpc::Response { return resp::StatPath     {}; },
+                [] (const req::Lseek&        ) -> rpc::Response { return resp::Lseek        {}; },
                 [] (const req::Ping&         ) -> rpc::Response { return resp::Ping         {}; },
                 // clang-format on
             });
@@ -198,13 +204,132 @@ namespace mock
 
         AExpect<rpc::Response> send(rpc::Request req, Milliseconds /* timeout */) override
         {
-            return send(std::move(req));
+            return send(std::move(req), trace::Context{});
         }
     };
 
     const auto dummy_strategy = connection_strategy::Custom{ .create = [] {
         return std::make_unique<DummyTransport>();
     } };
+
+    /**
+     * @class Device
+     *
+     * @brief In-memory device tree that counts the requests it receives.
+     */
+    struct Device
+    {
+        std::map<String, rpc::resp::Stat, std::less<>> files;     // absolute path to stat, "/" included
+        std::map<String, Errc, std::less<>>             errors;    // paths that fail to be stat-ed
+        std::map<rpc::Procedure, usize>                 requests;
+
+        void add(String path, mode_t mode, off_t size = 0)
+        {
+            auto stat = rpc::resp::Stat{ .size = size, .links = 1, .mode = mode };
+            files.insert_or_assign(std::move(path), stat);
+        }
+
+        usize count(rpc::Procedure proc) const
+        {
+            auto found = requests.find(proc);
+            return found != requests.end() ? found->second : 0;
+        }
+    };
+
+    /**
+     * @class DeviceTransport
+     *
+     * @brief Transport that serves a `Device`: reads always return EOF, writes are dropped and other
+     * mutations are not supported.
+     */
+    struct DeviceTransport final : public transport::Transport
+    {
+        DeviceTransport(Device& device)
+            : m_device{ device }
+        {
+        }
+
+        Str name() const override { return "device"; }
+
+        bool running() const override { return true; }
+
+        void stop(rpc::Status) override{};
+
+        Await<void> start() override { co_return; };
+
+        AExpect<rpc::Response> send(rpc::Request req, trace::Context /* trace */) override
+        {
+            using namespace rpc;
+
+            ++m_device.requests[req.proc()];
+
+            auto find = [&](Str path) -> Expect<resp::Stat> {
+                if (auto error = m_device.errors.find(path); error != m_device.errors.end()) {
+                    return Unexpect{ error->second };
+                }
+                auto found = m_device.files.find(path);
+                if (found == m_device.files.end()) {
+                    return Unexpect{ Errc::no_such_file_or_directory };
+                }
+                return found->second;
+            };
+
+            co_return req.visit(Overload{
+                [&](const req::Stat& req) -> Expect<Response> { return find(req.path); },
+                [&](const req::Listdir& req) -> Expect<Response> {
+                    auto prefix  = req.path == "/" ? String{ "/" } : fmt::format("{}/", req.path);
+                    auto entries = Vec<Pair<Str, resp::Stat>>{};
+                    for (const auto& [path, stat] : m_device.files) {
+                        auto name = Str{ path };
+                        if (name.starts_with(prefix) and name.size() > prefix.size()) {
+                            name.remove_prefix(prefix.size());
+                            if (not name.contains('/')) {
+                                entries.emplace_back(name, stat);
+                            }
+                        }
+                    }
+                    return resp::Listdir{ std::move(entries) };
+                },
+                [&](const req::StatPath& req) -> Expect<Response> {
+                    auto stats   = Vec<resp::Stat>{};
+                    auto current = String{};
+                    for (auto name : util::split(req.path, '/')) {
+                        current += fmt::format("/{}", name);
+                        if (auto stat = find(current); stat) {
+                            stats.push_back(*stat);
+                        } else {
+                            return resp::StatPath{ std::move(stats), stat.error() };
+                        }
+                    }
+                    return resp::StatPath{ std::move(stats), Status{} };
+                },
+                [&](const req::Open& req) -> Expect<Response> {
+                    return find(req.path).transform([&](resp::Stat stat) {
+                        return resp::Open{ .fd = ++m_fd, .stat = stat };
+                    });
+                },
+                [&](const req::Close&) -> Expect<Response> { return resp::Close{}; },
+                [&](const req::Read& req) -> Expect<Response> { return resp::Read{ req.out.first(0) }; },
+                [&](const req::Write& req) -> Expect<Response> { return resp::Write{ req.in.size() }; },
+                [&](const req::Ping& req) -> Expect<Response> { return resp::Ping{ req.num }; },
+                [&](const auto&) -> Expect<Response> { return Unexpect{ Errc::operation_not_supported }; },
+            });
+        }
+
+        AExpect<rpc::Response> send(rpc::Request req, Milliseconds /* timeout */) override
+        {
+            return send(std::move(req), trace::Context{});
+        }
+
+    private:
+        Device& m_device;
+        u64     m_fd = 0;
+    };
+
+    connection_strategy::Custom device_strategy(Device& device)
+    {
+        return { .create = [&device] { return std::make_unique<DeviceTransport>(device); } };
+    }
 }
 
 int main()
@@ -286,6 +411,20 @@ int main()
 
             tree_str = fmt::format("\n{}", tree.root());
             expect(expected_rm == tree_str) << diff_str(expected_rm, tree_str);
+
+            // symlink target is not persisted, it will be read lazily
+            auto snapshot          = std::filesystem::temp_directory_path() / "madbfs-test-tree.tree";
+            auto restored          = Filesystem{ connection, std::nullopt, std::nullopt };
+            auto expected_snapshot = String{ expected_rm };
+            auto link_target       = Str{ "/bye/friends/work/loughshinny <3.txt\n" };
+            expected_snapshot.replace(expected_snapshot.rfind(link_target), link_target.size(), "[none]\n");
+
+            tree.save_snapshot(snapshot).unwrap(usize);
+            restored.load_snapshot(snapshot).unwrap(usize);
+            std::filesystem::remove(snapshot);
+
+            tree_str = fmt::format("\n{}", restored.root());
+            expect(expected_snapshot == tree_str) << diff_str(expected_snapshot, tree_str);
         };
 
 #undef unwrap
@@ -295,4 +434,334 @@ int main()
         guard.reset();
         context.stop();
     };
+
+    "Media prefetch only follows a fresh listing and stops on shutdown"_test = [&] {
+        using namespace madbfs;
+        using namespace std::chrono_literals;
+        using madbfs::path::operator""_path;
+
+        auto device = mock::Device{};
+        device.add("/", S_IFDIR | 0755);
+        device.add("/notes.txt", S_IFREG | 0644, 16);
+        for (auto name : { "a", "b", "c", "d", "e" }) {
+            device.add(fmt::format("/{}.jpg", name), S_IFREG | 0644, 1024);
+        }
+
+        auto context    = madbfs::async::Context{};
+        auto guard      = madbfs::net::make_work_guard(context);
+        auto thread     = std::jthread{ [&] { context.run(); } };
+        auto connection = madbfs::Connection{ context, mock::device_strategy(device) };
+        auto caching    = Caching{ .page_size = 64 * 1024, .max_pages = 64, .prefetch_budget = 1024 * 1024 };
+
+        auto listed = 0uz;
+        auto filler = [&](const char*, off_t) {
+            ++listed;
+            return false;
+        };
+
+        // waits a bit for the background prefetch, returns the number of files opened so far
+        auto opened = [&](usize target) -> Await<usize> {
+            auto timer = async::Timer{ co_await async::current_executor() };
+            for (auto i = 0; i < 100 and device.count(rpc::Procedure::Open) < target; ++i) {
+                timer.expires_after(10ms);
+                std::ignore = co_await timer.async_wait();
+            }
+            co_return device.count(rpc::Procedure::Open);
+        };
+
+        auto coro = [&] -> Await<void> {
+            auto fs = Filesystem{ connection, caching, std::nullopt };
+
+            expect((co_await fs.readdir("/"_path, 0, filler)).has_value() >> ut::fatal);
+            expect(that % listed == 6uz);
+            expect(that % co_await opened(5) == 5uz);
+
+            // cached listing and listing for a bulk transfer don't prefetch again
+            expect((co_await fs.readdir("/"_path, 0, filler)).has_value());
+            expect(that % co_await opened(6) == 5uz);
+            expect(that % device.count(rpc::Procedure::Listdir) == 1uz);
+
+            co_await fs.shutdown();
+
+            auto scan = Filesystem{ connection, caching, std::nullopt };
+            expect((co_await scan.readdir("/"_path, 0, filler, false)).has_value());
+            expect(that % co_await opened(6) == 5uz);
+            co_await scan.shutdown();
+
+            // shutdown waits for the prefetch that is still running, nothing is opened after it returns
+            auto stopping = Filesystem{ connection, caching, std::nullopt };
+            expect((co_await stopping.readdir("/"_path, 0, filler)).has_value());
+            expect(that % device.count(rpc::Procedure::Listdir) == 3uz);
+            co_await stopping.shutdown();
+
+            auto stopped = device.count(rpc::Procedure::Open);
+            expect(that % co_await opened(11) == stopped);
+        };
+
+        madbfs::async::block(context, coro());
+
+        guard.reset();
+        context.stop();
+    };
+
+    "Expired entries of an unchanged directory are revalidated without listing it"_test = [&] {
+        using namespace madbfs;
+        using madbfs::path::operator""_path;
+
+        auto device = mock::Device{};
+        device.add("/", S_IFDIR | 0755);
+        device.add("/dir", S_IFDIR | 0755);
+        for (auto i : sv::iota(0, 10)) {
+            device.add(fmt::format("/dir/link{}", i), S_IFLNK | 0777);
+        }
+
+        auto context    = madbfs::async::Context{};
+        auto guard      = madbfs::net::make_work_guard(context);
+        auto thread     = std::jthread{ [&] { context.run(); } };
+        auto connection = madbfs::Connection{ context, mock::device_strategy(device) };
+
+        auto coro = [&] -> Await<void> {
+            auto fs     = Filesystem{ connection, std::nullopt, Seconds{ 3600 } };
+            auto filler = [](const char*, off_t) { return false; };
+
+            expect((co_await fs.readdir("/dir"_path, 0, filler)).has_value() >> ut::fatal);
+            expect(not (co_await fs.getattr("/dir/missing"_path)).has_value());
+
+            fs.expires_all();
+            device.requests.clear();
+
+            // symlinks and non-existing entries can't change while the directory mtime stays the same
+            for (auto i : sv::iota(0, 10)) {
+                auto path = path::create_buf(fmt::format("/dir/link{}", i)).value();
+                expect((co_await fs.getattr(path)).has_value());
+            }
+            expect(not (co_await fs.getattr("/dir/missing"_path)).has_value());
+
+            expect(that % device.count(rpc::Procedure::Stat) <= 2uz);
+            expect(that % device.count(rpc::Procedure::Listdir) == 0uz);
+            expect(that % device.count(rpc::Procedure::StatPath) == 0uz);
+
+            // other errors may be transient, they need the directory to be listed again
+            device.errors.emplace("/dir/denied", Errc::permission_denied);
+            auto denied = co_await fs.getattr("/dir/denied"_path);
+            expect((not denied.has_value() and denied.error() == Errc::permission_denied) >> ut::fatal);
+
+            fs.expires_all();
+            device.requests.clear();
+
+            expect((co_await fs.getattr("/dir/link0"_path)).has_value());
+            expect(that % device.count(rpc::Procedure::Listdir) == 1uz);
+
+            co_await fs.shutdown();
+        };
+
+        madbfs::async::block(context, coro());
+
+        guard.reset();
+        context.stop();
+    };
+
+    "Handles of files removed on the device are dropped when their directory is synced again"_test = [&] {
+        using namespace madbfs;
+        using madbfs::path::operator""_path;
+
+        auto device = mock::Device{};
+        device.add("/", S_IFDIR | 0755);
+        device.add("/dir", S_IFDIR | 0755);
+        device.add("/dir/song.mp3", S_IFREG | 0644, 1024);
+        device.add("/dir/album", S_IFDIR | 0755);
+        device.add("/dir/album/cover.jpg", S_IFREG | 0644, 1024);
+
+        auto context    = madbfs::async::Context{};
+        auto guard      = madbfs::net::make_work_guard(context);
+        auto thread     = std::jthread{ [&] { context.run(); } };
+        auto connection = madbfs::Connection{ context, mock::device_strategy(device) };
+
+        auto coro = [&] -> Await<void> {
+            auto fs     = Filesystem{ connection, std::nullopt, Seconds{ 3600 } };
+            auto filler = [](const char*, off_t) { return false; };
+
+            auto song  = co_await fs.open("/dir/song.mp3"_path, O_RDONLY);
+            auto cover = co_await fs.open("/dir/album/cover.jpg"_path, O_RDONLY);
+            expect((song.has_value() and cover.has_value()) >> ut::fatal);
+            expect(that % fs.handles().count_open() == 2uz);
+
+            // a player keeps the files open while they are deleted on the phone
+            device.files.erase("/dir/song.mp3");
+            device.files.erase("/dir/album");
+            device.files.erase("/dir/album/cover.jpg");
+            device.files["/dir"].mtime = { .tv_sec = 1, .tv_nsec = 0 };
+
+            fs.expires_all();
+            expect((co_await fs.readdir("/dir"_path, 0, filler)).has_value() >> ut::fatal);
+            expect(not (co_await fs.getattr("/dir/song.mp3"_path)).has_value());
+            expect(that % fs.handles().count_open() == 0uz);
+
+            // the kernel releases the handles after their nodes are gone
+            expect(not (co_await fs.release(*song)).has_value());
+            expect(not (co_await fs.release(*cover)).has_value());
+
+            co_await fs.shutdown();
+        };
+
+        madbfs::async::block(context, coro());
+
+        guard.reset();
+        context.stop();
+    };
+
+    "A file written through the cache before it's streamed expires after its release"_test = [&] {
+        using namespace madbfs;
+        using madbfs::path::operator""_path;
+
+        auto device = mock::Device{};
+        device.add("/", S_IFDIR | 0755);
+        device.add("/video.mp4", S_IFREG | 0644);
+
+        auto context    = madbfs::async::Context{};
+        auto guard      = madbfs::net::make_work_guard(context);
+        auto thread     = std::jthread{ [&] { context.run(); } };
+        auto connection = madbfs::Connection{ context, mock::device_strategy(device) };
+        auto caching    = Caching{ .page_size = 64 * 1024, .max_pages = 64, .stream_threshold = 256 * 1024 };
+
+        auto coro = [&] -> Await<void> {
+            auto fs = Filesystem{ connection, caching, Seconds{ 3600 } };
+
+            auto fd = co_await fs.open("/video.mp4"_path, O_RDWR);
+            expect(fd.has_value() >> ut::fatal);
+
+            // the first three chunks go through the cache, the fourth one reaches the threshold
+            auto chunk = String(64 * 1024, 'x');
+            for (auto i : sv::iota(0, 4)) {
+                auto offset = static_cast<off_t>(i) * static_cast<off_t>(chunk.size());
+                expect((co_await fs.write(*fd, chunk, offset)).has_value() >> ut::fatal);
+            }
+
+            auto node = fs.traverse("/video.mp4"_path);
+            expect(node.has_value() >> ut::fatal);
+            expect(not node->get().as_regular()->get().dirty);
+            expect(that % device.count(rpc::Procedure::Write) >= 1uz);
+
+            expect((co_await fs.release(*fd)).has_value());
+
+            fs.expires_all();
+            expect(node->get().expired());
+
+            co_await fs.shutdown();
+        };
+
+        madbfs::async::block(context, coro());
+
+        guard.reset();
+        context.stop();
+    };
+
+    "FileHandleStore reuses slots and erases handles per node"_test = [&] {
+        using namespace madbfs;
+
+        auto store = FileHandleStore{};
+        auto foo   = Node{ "foo", nullptr, {}, node::Regular{} };
+        auto bar   = Node{ "bar", nullptr, {}, node::Regular{} };
+
+        auto foo_fds = Vec<u64>{};
+        for (auto i = 0uz; i < 3000; ++i) {
+            foo_fds.push_back(store.store(&foo, OpenMode::Read, 0));
+        }
+        auto bar_fd = store.store(&bar, OpenMode::ReadWrite, 42);
+
+        expect(store.count_open() == 3001uz);
+        expect(store.count_empty() == store.capacity() - 3001uz);
+
+        auto released = store.release(foo_fds[1]);
+        expect((released.has_value() and released->node == &foo) >> ut::fatal);
+        expect(not store.release(foo_fds[1]).has_value());
+
+        // released slot is handed out again
+        expect(store.store(&bar, OpenMode::Write, 0) == foo_fds[1]);
+
+        expect(store.erase(&foo) == 2999uz);
+        expect(store.erase(&foo) == 0uz);
+        expect(store.count_open() == 2uz);
+        expect(not store.find(foo_fds[0]).has_value());
+
+        auto handle = store.find(bar_fd, OpenMode::Read);
+        expect((handle.has_value() and handle->real_fd == 42) >> ut::fatal);
+
+        expect(store.erase(&bar) == 2uz);
+        expect(store.count_open() == 0uz);
+        expect(store.count_erased() == 3001uz);
+
+        // erased slots are only handed out again once the kernel releases them
+        auto fresh = store.store(&foo, OpenMode::Read, 0);
+        expect(fresh != bar_fd and fresh != foo_fds[0]);
+        expect(not store.release(bar_fd).has_value());
+        expect(store.count_erased() == 3000uz);
+        expect(store.store(&bar, OpenMode::Read, 0) == bar_fd);
+    };
+
+    "Node count follows the nodes inserted into and erased from the tree"_test = [&] {
+        using namespace madbfs;
+
+        auto  before = Node::count();
+        auto  root   = Node{ "/", nullptr, {}, node::Directory{} };
+        auto& dir    = root.as_directory()->get();
+
+        for (auto name : { "a", "b" }) {
+            auto  sub   = std::make_unique<Node>(name, &root, Stat{}, node::Directory{});
+            auto& child = dir.insert(std::move(sub), false).value().first.get();
+            auto  leaf  = std::make_unique<Node>("leaf", &child, Stat{}, node::Regular{});
+            expect(child.as_directory()->get().insert(std::move(leaf), false).has_value());
+        }
+        expect(that % Node::count() == before + 5);
+
+        // erasing a directory drops its whole subtree
+        expect(dir.erase("a").has_value());
+        expect(that % Node::count() == before + 3);
+
+        dir.clear();
+        expect(that % Node::count() == before + 1);
+    };
+
+    "Directory listing resumes after a cookie even when entries change"_test = [&] {
+        using namespace madbfs;
+
+        auto  root = Node{ "/", nullptr, {}, node::Directory{} };
+        auto& dir  = root.as_directory()->get();
+
+        auto insert = [&](Str name) {
+            auto node = std::make_unique<Node>(name, &root, Stat{}, node::Regular{});
+            expect(dir.insert(std::move(node), false).has_value() >> ut::fatal);
+        };
+
+        for (auto name : { "a", "b", "c", "d" }) {
+            insert(name);
+        }
+
+        auto list = [&](u64 cookie) {
+            return dir.list_after(cookie)
+                 | sv::transform([](auto pair) { return String{ pair.second->name() }; })
+                 | sr::to<Vec<String>>();
+        };
+
+        auto b_cookie = dir.find("b").value().get().cookie();
+        expect(list(0) == Vec<String>{ "a", "b", "c", "d" });
+        expect(list(b_cookie) == Vec<String>{ "c", "d" });
+
+        // removal of a listed entry and insertion don't shift the position of the rest
+        expect(dir.erase("a").has_value());
+        insert("e");
+        expect(list(b_cookie) == Vec<String>{ "c", "d", "e" });
+
+        // an overwritten entry keeps its position, it's neither listed twice nor skipped
+        auto d_cookie = dir.find("d").value().get().cookie();
+        auto replaced = std::make_unique<Node>("d", &root, Stat{}, node::Directory{});
+        expect(dir.insert(std::move(replaced), true).has_value() >> ut::fatal);
+        expect(dir.find("d").value().get().cookie() == d_cookie);
+        expect(dir.find("d").value().get().is_directory());
+        expect(list(b_cookie) == Vec<String>{ "c", "d", "e" });
+        expect(list(d_cookie) == Vec<String>{ "e" });
+
+        dir.clear();
+        expect(list(0).empty());
+    };
 }
@@ -0,0 +1,75 @@
+#include <madbfs/path.hpp>
+#include <madbfs/ttl_policy.hpp>
+
+#include <boost/ut.hpp>
+
+namespace ut = boost::ut;
+using namespace madbfs::aliases;
+
+using madbfs::TtlPolicy;
+using madbfs::path::operator""_path;
+
+// result of a match with a finite TTL
+Opt<Opt<Seconds>> ttl(i64 sec)
+{
+    return Opt<Seconds>{ sec };
+}
+
+int main()
+{
+    using namespace ut::literals;
+    using namespace ut::operators;
+    using ut::expect, ut::that;
+
+    "Policy parses rules in order and round-trips through its string form"_test = [] {
+        auto policy = TtlPolicy::parse(" /DCIM/Camera/ = 5 ; /Android/media/*WhatsApp*=10;;/system=0 ");
+        expect((policy.has_value()) >> ut::fatal);
+
+        auto rules = policy->rules();
+        expect((rules.size() == 3uz) >> ut::fatal);
+
+        expect(rules[0].pattern == "/DCIM/Camera");
+        expect(rules[0].ttl == Opt<Seconds>{ 5 });
+        expect(not rules[0].glob);
+
+        expect(rules[1].pattern == "/Android/media/*WhatsApp*");
+        expect(rules[1].ttl == Opt<Seconds>{ 10 });
+        expect(rules[1].glob);
+
+        expect(rules[2].pattern == "/system");
+        expect(not rules[2].ttl.has_value());
+
+        expect(policy->to_string() == "/DCIM/Camera=5;/Android/media/*WhatsApp*=10;/system=0");
+        expect(TtlPolicy::parse("").value().empty());
+    };
+
+    "Malformed policies are rejected"_test = [] {
+        for (auto spec : { "/DCIM", "/DCIM=", "/DCIM=-1", "/DCIM=5s", "DCIM=5", "=5" }) {
+            expect(not TtlPolicy::parse(spec).has_value()) << spec;
+        }
+    };
+
+    "Prefix rules match per component and the first matching rule wins"_test = [] {
+        auto policy = TtlPolicy::parse("/DCIM/Camera=5;/DCIM=30;/Android/media/*WhatsApp*=10").value();
+
+        expect(policy.match("/DCIM/Camera"_path) == ttl(5));
+        expect(policy.match("/DCIM/Camera/a.jpg"_path) == ttl(5));
+        expect(policy.match("/DCIM/CameraRoll"_path) == ttl(30));
+        expect(policy.match("/Android/media/com.WhatsApp/a/b.opus"_path) == ttl(10));
+        expect(not policy.match("/Download/a.pdf"_path).has_value());
+        expect(not policy.match("/"_path).has_value());
+    };
+
+    "Rules are relative to the mounted root"_test = [] {
+        auto policy = TtlPolicy::parse("/DCIM/Camera=5;/=60").value();
+        auto root   = "/sdcard"_path;
+
+        expect(policy.match("/sdcard/DCIM/Camera/a.jpg"_path, root) == ttl(5));
+        expect(policy.match("/sdcard"_path, root) == ttl(60));
+
+        // paths outside of the root, including the ones sharing its prefix, match nothing
+        expect(not policy.match("/"_path, root).has_value());
+        expect(not policy.match("/storage/DCIM/Camera"_path, root).has_value());
+        expect(not policy.match("/sdcardx/DCIM/Camera"_path, root).has_value());
+    };
+}
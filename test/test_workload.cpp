@@ -0,0 +1,157 @@
+#include <madbfs/workload.hpp>
+
+#include <boost/ut.hpp>
+#include <fmt/format.h>
+
+#include <unistd.h>
+
+namespace ut = boost::ut;
+using namespace madbfs::aliases;
+
+namespace fs       = std::filesystem;
+namespace workload = madbfs::workload;
+
+using madbfs::metrics::FuseOp;
+
+/**
+ * @class TempFile
+ *
+ * @brief A file path in the temporary directory that is removed on destruction.
+ */
+struct TempFile
+{
+    TempFile(Str name)
+        : path{ fs::temp_directory_path() / fmt::format("madbfs-test-{}-{}", ::getpid(), name) }
+    {
+    }
+
+    ~TempFile()
+    {
+        auto ec = std::error_code{};
+        fs::remove(path, ec);
+    }
+
+    fs::path path;
+};
+
+/**
+ * @brief Record a small workload: a path used twice, and a rename that introduces a second path.
+ *
+ * @param file The workload file.
+ */
+workload::Recorder::Stats record(const fs::path& file)
+{
+    using namespace ut::operators;
+    using ut::expect;
+
+    auto recorder = workload::Recorder{};
+    expect((recorder.start(file).has_value()) >> ut::fatal);
+
+    auto now = SteadyClock::now();
+
+    auto getattr = workload::Call{ .op = FuseOp::Getattr, .path = "/a" };
+    auto read    = workload::Call{ .op = FuseOp::Read, .path = "/a", .fh = 3, .offset = 4096, .size = 128 };
+    auto rename  = workload::Call{ .op = FuseOp::Rename, .path = "/a", .path2 = "/b", .flags = 1 };
+
+    recorder.record(getattr, 10, now, now, 0);
+    recorder.record(read, 11, now, now + std::chrono::microseconds{ 250 }, 128);
+    recorder.record(rename, 10, now, now, -2);
+
+    auto stats = recorder.stop();
+    expect((stats.has_value()) >> ut::fatal);
+
+    return *stats;
+}
+
+int main()
+{
+    using namespace ut::literals;
+    using namespace ut::operators;
+    using ut::expect, ut::that;
+
+    "Recorded workload loads back with its paths interned"_test = [] {
+        auto file  = TempFile{ "roundtrip" };
+        auto stats = record(file.path);
+
+        expect(that % stats.entries == 3);
+        expect(that % stats.paths == 2);
+        expect(that % stats.bytes == fs::file_size(file.path));
+
+        auto loaded = workload::load(file.path);
+        expect((loaded.has_value()) >> ut::fatal);
+
+        expect(loaded->paths == Vec<String>{ "", "/a", "/b" });
+        expect((loaded->entries.size() == 3uz) >> ut::fatal);
+
+        const auto& getattr = loaded->entries[0];
+        expect(getattr.op == FuseOp::Getattr);
+        expect(that % getattr.pid == 10);
+        expect(that % getattr.path == 1);
+        expect(that % getattr.path2 == 0);
+
+        const auto& read = loaded->entries[1];
+        expect(read.op == FuseOp::Read);
+        expect(that % read.path == 1);
+        expect(that % read.fh == 3);
+        expect(that % read.offset == 4096);
+        expect(that % read.size == 128);
+        expect(that % read.result == 128);
+        expect(that % read.duration == 250);
+
+        const auto& rename = loaded->entries[2];
+        expect(rename.op == FuseOp::Rename);
+        expect(that % rename.path == 1);
+        expect(that % rename.path2 == 2);
+        expect(that % rename.flags == 1);
+        expect(that % rename.result == -2);
+    };
+
+    "Truncated workload is loaded up to its last complete record"_test = [] {
+        auto file = TempFile{ "truncated" };
+        record(file.path);
+
+        fs::resize_file(file.path, fs::file_size(file.path) - 5);
+
+        auto loaded = workload::load(file.path);
+        expect((loaded.has_value()) >> ut::fatal);
+        expect(loaded->paths == Vec<String>{ "", "/a", "/b" });
+        expect(that % loaded->entries.size() == 2uz);
+
+        // cut in the middle of the path record of the rename destination
+        constexpr auto header = 8uz + 4;                         // magic, version
+        constexpr auto path   = 1uz + 4 + 4 + 2;                 // tag, id, length, "/a"
+        constexpr auto op     = 1uz + 1 + 4 * 5 + 8 * 7 + 4;    // tag, entry
+
+        fs::resize_file(file.path, header + path + 2 * op + 5);
+
+        loaded = workload::load(file.path);
+        expect((loaded.has_value()) >> ut::fatal);
+        expect(loaded->paths == Vec<String>{ "", "/a" });
+        expect(that % loaded->entries.size() == 2uz);
+    };
+
+    "File that is not a workload is rejected"_test = [] {
+        auto file = TempFile{ "bad" };
+
+        {
+            auto out = std::ofstream{ file.path, std::ios::binary };
+            out << "notmadbfs and some more bytes";
+        }
+        expect(workload::load(file.path).error() == madbfs::Errc::bad_message);
+
+        // header shorter than the magic
+        fs::resize_file(file.path, 4);
+        expect(workload::load(file.path).error() == madbfs::Errc::bad_message);
+
+        // right magic, unknown record
+        record(file.path);
+        {
+            auto out = std::ofstream{ file.path, std::ios::binary | std::ios::app };
+            out.put(static_cast<char>(0x7f));
+        }
+        expect(workload::load(file.path).error() == madbfs::Errc::bad_message);
+
+        auto missing = TempFile{ "missing" };
+        expect(workload::load(missing.path).error() == madbfs::Errc::no_such_file_or_directory);
+    };
+}